@@ -36,6 +36,16 @@ typedef enum {
     AI_AUDIO_PLAYER_STAT_MAX,
 } AI_AUDIO_PLAYER_STATE_E;
 
+typedef struct {
+    uint32_t ttfa_ms;       // ai_audio_player_start to the first audio played, last stream
+    uint32_t first_data_ms; // ai_audio_player_start to the first data written, last stream
+    uint32_t jitter_ms;     // smoothed peak arrival lag the buffer is sized from
+    uint32_t target_ms;     // PCM buffered before the next stream plays
+    uint32_t underrun_cnt;  // buffer ran empty before the end of a stream
+    uint32_t underrun_ms;   // time spent buffering again after underruns
+    uint32_t stream_cnt;
+} AI_AUDIO_PLAYER_STATS_T;
+
 /***********************************************************
 ********************function declaration********************
 ***********************************************************/
@@ -87,6 +97,15 @@ OPERATE_RET ai_audio_player_stop(void);
  */
 uint8_t ai_audio_player_is_playing(void);
 
+/**
+ * @brief Gets the playback statistics: time to first audio, arrival jitter and underruns.
+ *
+ * @param stats     Filled with the statistics.
+ *
+ * @return          Returns OPRT_OK on success, otherwise returns an error code.
+ */
+OPERATE_RET ai_audio_player_stats_get(AI_AUDIO_PLAYER_STATS_T *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,7 @@
 ************************macro define************************
 ***********************************************************/
 #define MP3_STREAM_BUFF_MAX_LEN (1024 * 64 * 2)
+#define PCM_JITTER_BUFF_LEN     (1024 * 64)
 
 #define MAINBUF_SIZE 1940
 
@@ -36,6 +37,16 @@
 
 #define MP3_PCM_SIZE_MAX           (MAX_NSAMP * MAX_NCHAN * MAX_NGRAN * 2)
 #define PLAYING_NO_DATA_TIMEOUT_MS (5 * 1000)
+#define PLAYER_STAT_WAIT_MS        1000
+#define PLAYER_SPACE_WAIT_MS       100
+
+// PCM jitter buffer
+#define PLAYER_PLAY_CHUNK_MS       20  // PCM handed to the speaker per call
+#define PLAYER_JB_MIN_MS           60  // least PCM buffered before playing
+#define PLAYER_JB_MAX_MS           1000
+#define PLAYER_JB_MARGIN_MS        40  // on top of the arrival jitter, for decoding and scheduling
+#define PLAYER_JB_UNDERRUN_STEP_MS 80  // target raise after an underrun, for the rest of the stream
+#define PLAYER_JITTER_INIT_MS      120 // arrival jitter assumed before any stream was measured
 
 #define AI_AUDIO_PLAYER_STAT_CHANGE(last_stat, new_stat)                                                               \
     do {                                                                                                               \
@@ -47,6 +58,20 @@
 /***********************************************************
 ***********************typedef define***********************
 ***********************************************************/
+/*
+ * MP3 input ring. The MAINBUF_SIZE bytes after the end mirror the start of
+ * the ring, so the decoder always finds up to MAINBUF_SIZE contiguous bytes
+ * at the read position and the tail never has to be moved. One writer and
+ * one reader, rd and wr belong to their side, used is under spk_rb_mutex.
+ */
+typedef struct {
+    uint8_t *buf; // size + MAINBUF_SIZE bytes
+    uint32_t size;
+    uint32_t rd;
+    uint32_t wr;
+    uint32_t used;
+} MP3_RING_T;
+
 typedef struct {
     bool is_playing;
     bool is_writing;
@@ -56,21 +81,47 @@ typedef struct {
     TDL_AUDIO_HANDLE_T audio_hdl;
     MUTEX_HANDLE mutex;
     THREAD_HANDLE thrd_hdl;
+    SEM_HANDLE play_sem; // wakes the player thread: commands, PCM decoded
+    SEM_HANDLE stat_sem; // the player thread handled a command
 
     char *id;
-    TUYA_RINGBUFF_T rb_hdl;
+    MP3_RING_T mp3_ring;
     MUTEX_HANDLE spk_rb_mutex;
+    SEM_HANDLE space_sem; // MP3 consumed, the writer may go on
     uint8_t is_eof;
     TIMER_ID tm_id;
 
+    // decode thread
+    THREAD_HANDLE dec_thrd_hdl;
+    SEM_HANDLE dec_sem; // wakes the decode thread: MP3 written, PCM played
+    MUTEX_HANDLE dec_mutex;
+    bool dec_run;
+    bool dec_done; // end of stream decoded
+
     mp3dec_t *mp3_dec;
     mp3dec_frame_info_t mp3_frame_info;
-    uint8_t *mp3_raw;
-    uint8_t *mp3_raw_head;
-    uint32_t mp3_raw_used_len;
     uint8_t *mp3_pcm; // mp3 decode to pcm buffer
+    uint32_t kbps;
+
+    // PCM jitter buffer
+    TUYA_RINGBUFF_T pcm_rb;
+    MUTEX_HANDLE pcm_mutex;
+    uint8_t *play_pcm;
+    uint32_t pcm_bytes_per_ms;
+    bool is_buffering;
+    uint32_t target_ms;
+    uint32_t jitter_ms;
+
+    // arrival lag of the current stream
+    SYS_TIME_T start_ms;
+    SYS_TIME_T rx_start_ms;
+    uint32_t rx_bytes;
+    uint32_t rx_cnt;
+    int32_t lag_peak_ms;
+    SYS_TIME_T underrun_start_ms;
 
     uint8_t is_first_play;
+    AI_AUDIO_PLAYER_STATS_T stats;
 } APP_PLAYER_T;
 
 /***********************************************************
@@ -85,6 +136,98 @@ static APP_PLAYER_T sg_player;
 /***********************************************************
 ***********************function define**********************
 ***********************************************************/
+static void __mp3_ring_reset(MP3_RING_T *ring)
+{
+    ring->rd = 0;
+    ring->wr = 0;
+    ring->used = 0;
+}
+
+static void __mp3_ring_write(MP3_RING_T *ring, const uint8_t *data, uint32_t len)
+{
+    uint32_t first = GET_MIN_LEN(len, ring->size - ring->wr);
+
+    memcpy(ring->buf + ring->wr, data, first);
+    if (ring->wr < MAINBUF_SIZE) {
+        memcpy(ring->buf + ring->size + ring->wr, data, GET_MIN_LEN(first, MAINBUF_SIZE - ring->wr));
+    }
+
+    if (len > first) {
+        memcpy(ring->buf, data + first, len - first);
+        memcpy(ring->buf + ring->size, data + first, GET_MIN_LEN(len - first, MAINBUF_SIZE));
+    }
+
+    ring->wr = (ring->wr + len) % ring->size;
+}
+
+static uint32_t __ai_audio_player_target_clamp(uint32_t target_ms)
+{
+    if (target_ms < PLAYER_JB_MIN_MS) {
+        return PLAYER_JB_MIN_MS;
+    }
+
+    return GET_MIN_LEN(target_ms, PLAYER_JB_MAX_MS);
+}
+
+static OPERATE_RET __ai_audio_player_post(AI_AUDIO_PLAYER_STATE_E stat)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    TUYA_CALL_ERR_LOG(tal_queue_post(sg_player.state_queue, &stat, 0));
+    tal_semaphore_post(sg_player.play_sem);
+
+    return rt;
+}
+
+static OPERATE_RET __ai_audio_player_stat_wait(AI_AUDIO_PLAYER_STATE_E stat, uint32_t timeout_ms)
+{
+    SYS_TIME_T start_time = tal_system_get_millisecond();
+
+    while (sg_player.stat != stat) {
+        uint32_t pass_ms = tal_system_get_millisecond() - start_time;
+        if (pass_ms >= timeout_ms) {
+            return OPRT_TIMEOUT;
+        }
+        tal_semaphore_wait(sg_player.stat_sem, timeout_ms - pass_ms);
+    }
+
+    return OPRT_OK;
+}
+
+static void __ai_audio_player_arrival_update(uint32_t len)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    SYS_TIME_T now = tal_system_get_millisecond();
+
+    if (0 == ctx->rx_cnt) {
+        ctx->rx_start_ms = now;
+        ctx->stats.first_data_ms = now - ctx->start_ms;
+    } else if (ctx->kbps) {
+        // how late this data is against a real time stream that began with the first data
+        int32_t lag_ms = (int32_t)(now - ctx->rx_start_ms) - (int32_t)(ctx->rx_bytes * 8 / ctx->kbps);
+        if (lag_ms > ctx->lag_peak_ms) {
+            ctx->lag_peak_ms = lag_ms;
+        }
+    }
+
+    ctx->rx_bytes += len;
+    ctx->rx_cnt++;
+}
+
+static void __ai_audio_player_jitter_update(void)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+
+    // a stream written in one go, e.g. a local alert, tells nothing about the network
+    if (ctx->rx_cnt > 1) {
+        ctx->jitter_ms = (ctx->jitter_ms * 3 + GET_MIN_LEN(ctx->lag_peak_ms, PLAYER_JB_MAX_MS)) / 4;
+    }
+
+    ctx->target_ms = __ai_audio_player_target_clamp(ctx->jitter_ms + PLAYER_JB_MARGIN_MS);
+    ctx->stats.jitter_ms = ctx->jitter_ms;
+    ctx->stats.target_ms = ctx->target_ms;
+}
+
 static OPERATE_RET __ai_audio_player_mp3_start(void)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -95,70 +238,215 @@ static OPERATE_RET __ai_audio_player_mp3_start(void)
             PR_ERR("malloc mp3dec_t failed");
             return OPRT_MALLOC_FAILED;
         }
-
-        mp3dec_init(sg_player.mp3_dec);
     }
 
-    sg_player.mp3_raw_used_len = 0;
+    mp3dec_init(sg_player.mp3_dec);
+
+    // the decode thread is parked, it only runs while dec_run is set
+    tal_mutex_lock(sg_player.dec_mutex);
+    tal_mutex_lock(sg_player.spk_rb_mutex);
+    __mp3_ring_reset(&sg_player.mp3_ring);
+    tal_mutex_unlock(sg_player.spk_rb_mutex);
+    tal_mutex_lock(sg_player.pcm_mutex);
+    tuya_ring_buff_reset(sg_player.pcm_rb);
+    tal_mutex_unlock(sg_player.pcm_mutex);
+    sg_player.dec_done = false;
+    sg_player.dec_run = true;
+    tal_mutex_unlock(sg_player.dec_mutex);
+    tal_semaphore_post(sg_player.dec_sem);
 
     return rt;
 }
 
-static OPERATE_RET __ai_audio_player_mp3_playing(void)
+/**
+ * @brief check that the window holds a whole frame and the header after it
+ *
+ * minimp3 resets the decoder, bit reservoir included, when it is given a
+ * frame it cannot confirm by the next header. A short window is only decoded
+ * once that header is in, a window without a header at its start only when
+ * it is full and the decoder can resync.
+ */
+static bool __ai_audio_player_mp3_frame_ready(const uint8_t *mp3, uint32_t len)
+{
+    if (len >= MAINBUF_SIZE) {
+        return true;
+    }
+
+    if (len < HDR_SIZE || !hdr_valid(mp3)) {
+        return false;
+    }
+
+    uint32_t frame_len = hdr_frame_bytes(mp3, sg_player.mp3_dec->free_format_bytes);
+    if (0 == frame_len) {
+        // free format, the size is only known from the next header
+        return false;
+    }
+
+    return (frame_len + hdr_padding(mp3) + HDR_SIZE <= len);
+}
+
+static OPERATE_RET __ai_audio_player_mp3_decode(void)
 {
-    OPERATE_RET rt = OPRT_OK;
     APP_PLAYER_T *ctx = &sg_player;
+    MP3_RING_T *ring = &ctx->mp3_ring;
 
     if (NULL == ctx->mp3_dec) {
         PR_ERR("mp3 decoder is NULL");
         return OPRT_COM_ERROR;
     }
 
-    tal_mutex_lock(sg_player.spk_rb_mutex);
-    uint32_t rb_used_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
-    tal_mutex_unlock(sg_player.spk_rb_mutex);
-    if (0 == rb_used_len && 0 == ctx->mp3_raw_used_len) {
-        // PR_DEBUG("mp3 data is empty");
-        rt = OPRT_RECV_DA_NOT_ENOUGH;
-        goto __EXIT;
+    tal_mutex_lock(ctx->pcm_mutex);
+    uint32_t pcm_free = tuya_ring_buff_free_size_get(ctx->pcm_rb);
+    tal_mutex_unlock(ctx->pcm_mutex);
+    if (pcm_free < MP3_PCM_SIZE_MAX) {
+        // jitter buffer full, the player posts dec_sem when it took some
+        return OPRT_EXCEED_UPPER_LIMIT;
     }
 
-    if (NULL != ctx->mp3_raw_head && ctx->mp3_raw_used_len > 0 && ctx->mp3_raw_head != ctx->mp3_raw) {
-        // PR_DEBUG("move data, offset=%d, used_len=%d", ctx->mp3_raw_head - ctx->mp3_raw, ctx->mp3_raw_used_len);
-        memmove(ctx->mp3_raw, ctx->mp3_raw_head, ctx->mp3_raw_used_len);
+    tal_mutex_lock(ctx->spk_rb_mutex);
+    uint32_t used = ring->used;
+    uint8_t is_eof = ctx->is_eof;
+    tal_mutex_unlock(ctx->spk_rb_mutex);
+
+    uint32_t frame_bytes = 0;
+    int samples = 0;
+    uint32_t avail = GET_MIN_LEN(used, MAINBUF_SIZE);
+    if (avail > 0 && (is_eof || __ai_audio_player_mp3_frame_ready(ring->buf + ring->rd, avail))) {
+        samples = mp3dec_decode_frame(ctx->mp3_dec, ring->buf + ring->rd, avail, (mp3d_sample_t *)ctx->mp3_pcm,
+                                      &ctx->mp3_frame_info);
+        frame_bytes = ctx->mp3_frame_info.frame_bytes;
     }
-    ctx->mp3_raw_head = ctx->mp3_raw;
 
-    // read new data
-    if (rb_used_len > 0 && ctx->mp3_raw_used_len < MAINBUF_SIZE) {
-        uint32_t read_len = ((MAINBUF_SIZE - ctx->mp3_raw_used_len) > rb_used_len)
-                                ? rb_used_len
-                                : (MAINBUF_SIZE - ctx->mp3_raw_used_len);
+    if (0 == frame_bytes) {
+        if (is_eof) {
+            // nothing decodable is left, drop the rest of the stream
+            ring->rd = (ring->rd + used) % ring->size;
+            tal_mutex_lock(ctx->spk_rb_mutex);
+            ring->used -= used;
+            tal_mutex_unlock(ctx->spk_rb_mutex);
 
-        tal_mutex_lock(sg_player.spk_rb_mutex);
-        uint32_t rt_len = tuya_ring_buff_read(ctx->rb_hdl, ctx->mp3_raw + ctx->mp3_raw_used_len, read_len);
-        tal_mutex_unlock(sg_player.spk_rb_mutex);
-        //  PR_DEBUG("read_len=%d rt_len: %d", read_len, rt_len);
+            // the player reads it before the PCM level, so the level it then sees holds the tail
+            __atomic_store_n(&ctx->dec_done, true, __ATOMIC_RELEASE);
+            tal_semaphore_post(ctx->play_sem);
+        }
+        return OPRT_RECV_DA_NOT_ENOUGH;
+    }
 
-        ctx->mp3_raw_used_len += rt_len;
+    ring->rd = (ring->rd + frame_bytes) % ring->size;
+    tal_mutex_lock(ctx->spk_rb_mutex);
+    ring->used -= frame_bytes;
+    tal_mutex_unlock(ctx->spk_rb_mutex);
+    tal_semaphore_post(ctx->space_sem);
+
+    if (samples > 0) {
+        ctx->pcm_bytes_per_ms = ctx->mp3_frame_info.hz * 2 / 1000;
+        ctx->kbps = ctx->mp3_frame_info.bitrate_kbps;
+
+        tal_mutex_lock(ctx->pcm_mutex);
+        tuya_ring_buff_write(ctx->pcm_rb, ctx->mp3_pcm, samples * 2);
+        tal_mutex_unlock(ctx->pcm_mutex);
+        tal_semaphore_post(ctx->play_sem);
     }
 
-    int samples = mp3dec_decode_frame(ctx->mp3_dec, ctx->mp3_raw_head, ctx->mp3_raw_used_len,
-                                      (mp3d_sample_t *)ctx->mp3_pcm, &ctx->mp3_frame_info);
-    if (samples <= 0 && ctx->mp3_frame_info.frame_bytes == 0) {
-        // need more data
-        goto __EXIT;
+    return OPRT_OK;
+}
+
+static void __ai_audio_player_decode_task(void *arg)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+
+    for (;;) {
+        tal_semaphore_wait_forever(ctx->dec_sem);
+
+        tal_mutex_lock(ctx->dec_mutex);
+        while (ctx->dec_run && !ctx->dec_done) {
+            if (OPRT_OK != __ai_audio_player_mp3_decode()) {
+                break;
+            }
+        }
+        tal_mutex_unlock(ctx->dec_mutex);
     }
+}
 
-    ctx->mp3_raw_used_len -= ctx->mp3_frame_info.frame_bytes;
-    ctx->mp3_raw_head += ctx->mp3_frame_info.frame_bytes;
+static void __ai_audio_player_buffering_start(void)
+{
+    APP_PLAYER_T *ctx = &sg_player;
 
-    if (samples) {
-        tdl_audio_play(ctx->audio_hdl, ctx->mp3_pcm, samples * 2);
+    ctx->is_buffering = true;
+    if (!tal_sw_timer_is_running(ctx->tm_id)) {
+        tal_sw_timer_start(ctx->tm_id, PLAYING_NO_DATA_TIMEOUT_MS, TAL_TIMER_ONCE);
     }
+}
 
-__EXIT:
-    return rt;
+/**
+ * @brief play PCM from the jitter buffer, outside of sg_player.mutex
+ *
+ * @return OPRT_OK when played or finished, OPRT_RECV_DA_NOT_ENOUGH to wait for play_sem
+ */
+static OPERATE_RET __ai_audio_player_pcm_play(void)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+
+    // dec_done first: once it is seen, the PCM level read after it includes the last decoded frame
+    bool dec_done = __atomic_load_n(&ctx->dec_done, __ATOMIC_ACQUIRE);
+    tal_mutex_lock(ctx->pcm_mutex);
+    uint32_t pcm_used = tuya_ring_buff_used_size_get(ctx->pcm_rb);
+    tal_mutex_unlock(ctx->pcm_mutex);
+
+    if (ctx->is_buffering) {
+        uint32_t target_len = GET_MIN_LEN(ctx->target_ms * ctx->pcm_bytes_per_ms, PCM_JITTER_BUFF_LEN - MP3_PCM_SIZE_MAX);
+        if (!dec_done && (0 == target_len || pcm_used < target_len)) {
+            return OPRT_RECV_DA_NOT_ENOUGH;
+        }
+
+        ctx->is_buffering = false;
+        tal_sw_timer_stop(ctx->tm_id);
+        if (ctx->underrun_start_ms) {
+            ctx->stats.underrun_ms += tal_system_get_millisecond() - ctx->underrun_start_ms;
+            ctx->underrun_start_ms = 0;
+        }
+    }
+
+    if (0 == pcm_used) {
+        if (dec_done) {
+            PR_DEBUG("app player end");
+            tal_mutex_lock(ctx->mutex);
+            if (AI_AUDIO_PLAYER_STAT_PLAY == ctx->stat) {
+                ctx->stat = AI_AUDIO_PLAYER_STAT_FINISH;
+            }
+            tal_mutex_unlock(ctx->mutex);
+            return OPRT_OK;
+        }
+
+        ctx->stats.underrun_cnt++;
+        ctx->underrun_start_ms = tal_system_get_millisecond();
+        ctx->target_ms = __ai_audio_player_target_clamp(ctx->target_ms + PLAYER_JB_UNDERRUN_STEP_MS);
+        PR_DEBUG("app player underrun, buffer %d ms", ctx->target_ms);
+        __ai_audio_player_buffering_start();
+        return OPRT_RECV_DA_NOT_ENOUGH;
+    }
+
+    uint32_t play_len = GET_MIN_LEN(pcm_used, PLAYER_PLAY_CHUNK_MS * ctx->pcm_bytes_per_ms);
+    play_len = GET_MIN_LEN(play_len, MP3_PCM_SIZE_MAX) & ~1;
+    if (0 == play_len) {
+        play_len = GET_MIN_LEN(pcm_used, MP3_PCM_SIZE_MAX);
+    }
+
+    tal_mutex_lock(ctx->pcm_mutex);
+    play_len = tuya_ring_buff_read(ctx->pcm_rb, ctx->play_pcm, play_len);
+    tal_mutex_unlock(ctx->pcm_mutex);
+    tal_semaphore_post(ctx->dec_sem);
+
+    if (ctx->is_first_play) {
+        ctx->is_first_play = 0;
+        ctx->stats.ttfa_ms = tal_system_get_millisecond() - ctx->start_ms;
+        PR_DEBUG("app player first audio %d ms, first data %d ms, buffer %d ms", ctx->stats.ttfa_ms,
+                 ctx->stats.first_data_ms, ctx->target_ms);
+    }
+
+    tdl_audio_play(ctx->audio_hdl, ctx->play_pcm, play_len);
+
+    return OPRT_OK;
 }
 
 static OPERATE_RET __ai_audio_player_mp3_init(void)
@@ -167,23 +455,32 @@ static OPERATE_RET __ai_audio_player_mp3_init(void)
 
     PR_DEBUG("app player mp3 init...");
 
-    sg_player.mp3_raw = (uint8_t *)tkl_system_psram_malloc(MAINBUF_SIZE);
-    TUYA_CHECK_NULL_GOTO(sg_player.mp3_raw, __ERR);
+    sg_player.mp3_ring.size = MP3_STREAM_BUFF_MAX_LEN;
+    sg_player.mp3_ring.buf = (uint8_t *)tkl_system_psram_malloc(MP3_STREAM_BUFF_MAX_LEN + MAINBUF_SIZE);
+    TUYA_CHECK_NULL_GOTO(sg_player.mp3_ring.buf, __ERR);
 
     sg_player.mp3_pcm = (uint8_t *)tkl_system_psram_malloc(MP3_PCM_SIZE_MAX);
     TUYA_CHECK_NULL_GOTO(sg_player.mp3_pcm, __ERR);
 
+    sg_player.play_pcm = (uint8_t *)tkl_system_psram_malloc(MP3_PCM_SIZE_MAX);
+    TUYA_CHECK_NULL_GOTO(sg_player.play_pcm, __ERR);
+
     return rt;
 
 __ERR:
+    if (sg_player.play_pcm) {
+        tkl_system_psram_free(sg_player.play_pcm);
+        sg_player.play_pcm = NULL;
+    }
+
     if (sg_player.mp3_pcm) {
         tkl_system_psram_free(sg_player.mp3_pcm);
         sg_player.mp3_pcm = NULL;
     }
 
-    if (sg_player.mp3_raw) {
-        tkl_system_psram_free(sg_player.mp3_raw);
-        sg_player.mp3_raw = NULL;
+    if (sg_player.mp3_ring.buf) {
+        tkl_system_psram_free(sg_player.mp3_ring.buf);
+        sg_player.mp3_ring.buf = NULL;
     }
 
     return OPRT_COM_ERROR;
@@ -194,17 +491,25 @@ static void __ai_audio_player_task(void *arg)
     OPERATE_RET rt = OPRT_OK;
     APP_PLAYER_T *ctx = &sg_player;
     static AI_AUDIO_PLAYER_STATE_E last_state = 0xFF;
-    uint32_t delay_ms = 5;
-
-    SYS_TIME_T start_time = 0;
+    AI_AUDIO_PLAYER_STATE_E stat;
+    bool is_wait = false;
 
     ctx->stat = AI_AUDIO_PLAYER_STAT_IDLE;
 
     for (;;) {
-        delay_ms = ((ctx->stat == AI_AUDIO_PLAYER_STAT_IDLE) ? (20) : (5));
-        tal_queue_fetch(sg_player.state_queue, &ctx->stat, delay_ms);
+        bool is_cmd = (OPRT_OK == tal_queue_fetch(ctx->state_queue, &stat, 0));
+        if (!is_cmd && is_wait) {
+            tal_semaphore_wait_forever(ctx->play_sem);
+            is_wait = false;
+            continue;
+        }
+        is_wait = false;
 
-        tal_mutex_lock(sg_player.mutex);
+        tal_mutex_lock(ctx->mutex);
+
+        if (is_cmd) {
+            ctx->stat = stat;
+        }
 
         AI_AUDIO_PLAYER_STAT_CHANGE(last_state, ctx->stat);
         last_state = ctx->stat;
@@ -215,69 +520,75 @@ static void __ai_audio_player_task(void *arg)
                 tal_sw_timer_stop(ctx->tm_id);
             }
             ctx->is_eof = 0;
+            is_wait = true;
         } break;
         case AI_AUDIO_PLAYER_STAT_START: {
+            ctx->start_ms = tal_system_get_millisecond();
+            ctx->rx_bytes = 0;
+            ctx->rx_cnt = 0;
+            ctx->lag_peak_ms = 0;
+            ctx->underrun_start_ms = 0;
+            ctx->stats.ttfa_ms = 0;
+            ctx->stats.first_data_ms = 0;
+            ctx->stats.stream_cnt++;
+
             rt = __ai_audio_player_mp3_start();
             if (rt != OPRT_OK) {
                 ctx->stat = AI_AUDIO_PLAYER_STAT_IDLE;
             } else {
                 ctx->stat = AI_AUDIO_PLAYER_STAT_PLAY;
+                __ai_audio_player_buffering_start();
             }
             ctx->is_first_play = 1;
-            start_time = tal_system_get_millisecond();
-        } break;
-        case AI_AUDIO_PLAYER_STAT_PLAY: {
-            // wait more data
-            if (ctx->is_first_play) {
-                tal_mutex_lock(ctx->spk_rb_mutex);
-                uint32_t cache_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
-                tal_mutex_unlock(ctx->spk_rb_mutex);
-
-                if (cache_len >= 3 * 1024 || tal_system_get_millisecond() - start_time > 1000) {
-                    ctx->is_first_play = 0;
-                }
-                break;
-            }
-
-            rt = __ai_audio_player_mp3_playing();
-            if (OPRT_RECV_DA_NOT_ENOUGH == rt) {
-                tal_sw_timer_start(ctx->tm_id, PLAYING_NO_DATA_TIMEOUT_MS, TAL_TIMER_ONCE);
-            } else if (OPRT_OK == rt) {
-                if (tal_sw_timer_is_running(ctx->tm_id)) {
-                    tal_sw_timer_stop(ctx->tm_id);
-                }
-            }
-            tal_mutex_lock(ctx->spk_rb_mutex);
-            uint32_t rb_used_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
-            tal_mutex_unlock(ctx->spk_rb_mutex);
-            if (rb_used_len == 0 && 0 == ctx->mp3_raw_used_len && ctx->is_eof) {
-                PR_DEBUG("app player end");
-                ctx->stat = AI_AUDIO_PLAYER_STAT_FINISH;
-            }
         } break;
+        case AI_AUDIO_PLAYER_STAT_PLAY:
+            // played below, without holding the mutex
+            break;
         case AI_AUDIO_PLAYER_STAT_FINISH: {
             tal_sw_timer_stop(ctx->tm_id);
 
+            ctx->dec_run = false;
+            tal_semaphore_post(ctx->space_sem);
+            __ai_audio_player_jitter_update();
+            PR_DEBUG("app player stream end, first audio %d ms, peak lag %d ms, underrun %d", ctx->stats.ttfa_ms,
+                     ctx->lag_peak_ms, ctx->stats.underrun_cnt);
+
             ctx->is_playing = false;
             ctx->stat = AI_AUDIO_PLAYER_STAT_IDLE;
             ctx->is_eof = 0;
+            is_wait = true;
         } break;
         case AI_AUDIO_PLAYER_STAT_PAUSE:
-            // do nothing
+            ctx->dec_run = false;
+            tal_semaphore_post(ctx->space_sem);
+            is_wait = true;
             break;
         default:
+            is_wait = true;
             break;
         }
 
-        tal_mutex_unlock(sg_player.mutex);
+        tal_mutex_unlock(ctx->mutex);
+
+        if (is_cmd) {
+            tal_semaphore_post(ctx->stat_sem);
+        }
+
+        if (AI_AUDIO_PLAYER_STAT_PLAY == ctx->stat) {
+            is_wait = (OPRT_RECV_DA_NOT_ENOUGH == __ai_audio_player_pcm_play());
+        }
     }
 }
 
 static void __app_playing_tm_cb(TIMER_ID timer_id, void *arg)
 {
-    OPERATE_RET rt = OPRT_OK;
-    AI_AUDIO_PLAYER_STATE_E stat = AI_AUDIO_PLAYER_STAT_FINISH;
-    TUYA_CALL_ERR_LOG(tal_queue_post(sg_player.state_queue, &stat, 0));
+    // no audio for too long, play out what is buffered and finish
+    tal_mutex_lock(sg_player.spk_rb_mutex);
+    sg_player.is_eof = 1;
+    tal_mutex_unlock(sg_player.spk_rb_mutex);
+
+    tal_semaphore_post(sg_player.dec_sem);
+    tal_semaphore_post(sg_player.play_sem);
     PR_DEBUG("app player timeout cb, stop playing");
     return;
 }
@@ -323,13 +634,27 @@ OPERATE_RET ai_audio_player_init(void)
     TUYA_CALL_ERR_GOTO(tal_sw_timer_create(__app_playing_tm_cb, NULL, &sg_player.tm_id), __ERR);
 
     TUYA_CALL_ERR_GOTO(__ai_audio_player_mp3_init(), __ERR);
-    // ring buffer init
-    TUYA_CALL_ERR_GOTO(tuya_ring_buff_create(MP3_STREAM_BUFF_MAX_LEN, OVERFLOW_PSRAM_STOP_TYPE, &sg_player.rb_hdl),
-                       __ERR);
     // ring buffer mutex init
     TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_player.spk_rb_mutex), __ERR);
-
-    // thread init
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&sg_player.space_sem, 0, 1), __ERR);
+
+    // pcm jitter buffer init
+    TUYA_CALL_ERR_GOTO(tuya_ring_buff_create(PCM_JITTER_BUFF_LEN, OVERFLOW_PSRAM_STOP_TYPE, &sg_player.pcm_rb), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_player.pcm_mutex), __ERR);
+    sg_player.jitter_ms = PLAYER_JITTER_INIT_MS;
+    sg_player.target_ms = __ai_audio_player_target_clamp(PLAYER_JITTER_INIT_MS + PLAYER_JB_MARGIN_MS);
+    sg_player.stats.jitter_ms = sg_player.jitter_ms;
+    sg_player.stats.target_ms = sg_player.target_ms;
+
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&sg_player.play_sem, 0, 1), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&sg_player.stat_sem, 0, 1), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&sg_player.dec_sem, 0, 1), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_player.dec_mutex), __ERR);
+
+    // thread init, decoding runs below the player so the speaker is fed first
+    TUYA_CALL_ERR_GOTO(tkl_thread_create(&sg_player.dec_thrd_hdl, "ai_player_dec", 1024 * 4, THREAD_PRIO_1,
+                                         __ai_audio_player_decode_task, NULL),
+                       __ERR);
     TUYA_CALL_ERR_GOTO(
         tkl_thread_create(&sg_player.thrd_hdl, "ai_player", 1024 * 4, THREAD_PRIO_0, __ai_audio_player_task, NULL),
         __ERR);
@@ -354,9 +679,39 @@ __ERR:
         sg_player.spk_rb_mutex = NULL;
     }
 
-    if (sg_player.rb_hdl) {
-        tuya_ring_buff_free(sg_player.rb_hdl);
-        sg_player.rb_hdl = NULL;
+    if (sg_player.pcm_mutex) {
+        tal_mutex_release(sg_player.pcm_mutex);
+        sg_player.pcm_mutex = NULL;
+    }
+
+    if (sg_player.dec_mutex) {
+        tal_mutex_release(sg_player.dec_mutex);
+        sg_player.dec_mutex = NULL;
+    }
+
+    if (sg_player.space_sem) {
+        tal_semaphore_release(sg_player.space_sem);
+        sg_player.space_sem = NULL;
+    }
+
+    if (sg_player.play_sem) {
+        tal_semaphore_release(sg_player.play_sem);
+        sg_player.play_sem = NULL;
+    }
+
+    if (sg_player.stat_sem) {
+        tal_semaphore_release(sg_player.stat_sem);
+        sg_player.stat_sem = NULL;
+    }
+
+    if (sg_player.dec_sem) {
+        tal_semaphore_release(sg_player.dec_sem);
+        sg_player.dec_sem = NULL;
+    }
+
+    if (sg_player.pcm_rb) {
+        tuya_ring_buff_free(sg_player.pcm_rb);
+        sg_player.pcm_rb = NULL;
     }
 
     return rt;
@@ -398,20 +753,14 @@ OPERATE_RET ai_audio_player_start(char *id)
 
     sg_player.is_playing = true;
 
-    AI_AUDIO_PLAYER_STATE_E stat = AI_AUDIO_PLAYER_STAT_START;
-    TUYA_CALL_ERR_LOG(tal_queue_post(sg_player.state_queue, &stat, 0));
+    __ai_audio_player_post(AI_AUDIO_PLAYER_STAT_START);
 
     tal_mutex_unlock(sg_player.mutex);
 
-    uint32_t wait_cnt = 0;
-    while (sg_player.stat != AI_AUDIO_PLAYER_STAT_PLAY) {
-        tal_system_sleep(10);
-        wait_cnt++;
-        if (wait_cnt > 100) {
-            // maybe __ai_audio_player_mp3_start failed
-            PR_ERR("wait player start timeout");
-            rt = OPRT_COM_ERROR;
-        }
+    if (OPRT_OK != __ai_audio_player_stat_wait(AI_AUDIO_PLAYER_STAT_PLAY, PLAYER_STAT_WAIT_MS)) {
+        // maybe __ai_audio_player_mp3_start failed
+        PR_ERR("wait player start timeout");
+        return OPRT_COM_ERROR;
     }
 
     PR_NOTICE("ai audio player start");
@@ -449,33 +798,42 @@ OPERATE_RET ai_audio_player_data_write(char *id, uint8_t *data, uint32_t len, ui
     // PR_DEBUG("write data len:%d, is_eof:%d", len, is_eof);
 
     if (NULL != data && len > 0) {
+        __ai_audio_player_arrival_update(len);
+
         while ((alreay_write_len < len) &&
                (AI_AUDIO_PLAYER_STAT_PLAY == sg_player.stat || AI_AUDIO_PLAYER_STAT_START == sg_player.stat)) {
 
             sg_player.is_writing = true;
             tal_mutex_lock(sg_player.spk_rb_mutex);
-            uint32_t rb_free_len = tuya_ring_buff_free_size_get(sg_player.rb_hdl);
+            uint32_t rb_free_len = sg_player.mp3_ring.size - sg_player.mp3_ring.used;
             tal_mutex_unlock(sg_player.spk_rb_mutex);
             if (0 == rb_free_len) {
-                // need unlock mutex before sleep
+                // need unlock mutex before waiting, the decode thread posts space_sem
                 tal_mutex_unlock(sg_player.mutex);
-                tal_system_sleep(5);
+                tal_semaphore_wait(sg_player.space_sem, PLAYER_SPACE_WAIT_MS);
                 tal_mutex_lock(sg_player.mutex);
                 continue;
             }
 
             write_len = GET_MIN_LEN(rb_free_len, (len - alreay_write_len));
 
+            __mp3_ring_write(&sg_player.mp3_ring, data + alreay_write_len, write_len);
             tal_mutex_lock(sg_player.spk_rb_mutex);
-            tuya_ring_buff_write(sg_player.rb_hdl, data + alreay_write_len, write_len);
+            sg_player.mp3_ring.used += write_len;
             tal_mutex_unlock(sg_player.spk_rb_mutex);
+            tal_semaphore_post(sg_player.dec_sem);
 
             alreay_write_len += write_len;
         };
         sg_player.is_writing = false;
     }
 
-    sg_player.is_eof = is_eof;
+    if (is_eof) {
+        tal_mutex_lock(sg_player.spk_rb_mutex);
+        sg_player.is_eof = is_eof;
+        tal_mutex_unlock(sg_player.spk_rb_mutex);
+        tal_semaphore_post(sg_player.dec_sem);
+    }
     tal_mutex_unlock(sg_player.mutex);
 
     return OPRT_OK;
@@ -496,10 +854,9 @@ OPERATE_RET ai_audio_player_stop(void)
     }
 
     // PAUSE player first
-    AI_AUDIO_PLAYER_STATE_E stat = AI_AUDIO_PLAYER_STAT_PAUSE;
-    TUYA_CALL_ERR_LOG(tal_queue_post(sg_player.state_queue, &stat, 0));
-    while (sg_player.stat != AI_AUDIO_PLAYER_STAT_PAUSE) {
-        tal_system_sleep(10);
+    __ai_audio_player_post(AI_AUDIO_PLAYER_STAT_PAUSE);
+    if (OPRT_OK != __ai_audio_player_stat_wait(AI_AUDIO_PLAYER_STAT_PAUSE, PLAYER_STAT_WAIT_MS)) {
+        PR_ERR("wait player pause timeout");
     }
 
     tal_mutex_lock(sg_player.mutex);
@@ -515,21 +872,26 @@ OPERATE_RET ai_audio_player_stop(void)
         tal_mutex_lock(sg_player.mutex);
     }
 
+    // the decode thread is parked once it left its current frame
+    tal_mutex_lock(sg_player.dec_mutex);
     tal_mutex_lock(sg_player.spk_rb_mutex);
-    tuya_ring_buff_reset(sg_player.rb_hdl);
+    __mp3_ring_reset(&sg_player.mp3_ring);
     tal_mutex_unlock(sg_player.spk_rb_mutex);
+    tal_mutex_lock(sg_player.pcm_mutex);
+    tuya_ring_buff_reset(sg_player.pcm_rb);
+    tal_mutex_unlock(sg_player.pcm_mutex);
+    tal_mutex_unlock(sg_player.dec_mutex);
 
     tdl_audio_play_stop(sg_player.audio_hdl);
 
     sg_player.is_playing = false;
 
-    stat = AI_AUDIO_PLAYER_STAT_IDLE;
-    TUYA_CALL_ERR_LOG(tal_queue_post(sg_player.state_queue, &stat, 0));
+    __ai_audio_player_post(AI_AUDIO_PLAYER_STAT_IDLE);
 
     tal_mutex_unlock(sg_player.mutex);
 
-    while (sg_player.stat != AI_AUDIO_PLAYER_STAT_IDLE) {
-        tal_system_sleep(10);
+    if (OPRT_OK != __ai_audio_player_stat_wait(AI_AUDIO_PLAYER_STAT_IDLE, PLAYER_STAT_WAIT_MS)) {
+        PR_ERR("wait player idle timeout");
     }
 
     PR_NOTICE("ai audio player stop");
@@ -547,3 +909,21 @@ uint8_t ai_audio_player_is_playing(void)
 {
     return sg_player.is_playing;
 }
+
+/**
+ * @brief Gets the playback statistics: time to first audio, arrival jitter and underruns.
+ *
+ * @param stats     Filled with the statistics.
+ *
+ * @return          Returns OPRT_OK on success, otherwise returns an error code.
+ */
+OPERATE_RET ai_audio_player_stats_get(AI_AUDIO_PLAYER_STATS_T *stats)
+{
+    TUYA_CHECK_NULL_RETURN(stats, OPRT_INVALID_PARM);
+
+    tal_mutex_lock(sg_player.mutex);
+    memcpy(stats, &sg_player.stats, sizeof(AI_AUDIO_PLAYER_STATS_T));
+    tal_mutex_unlock(sg_player.mutex);
+
+    return OPRT_OK;
+}
@@ -0,0 +1,231 @@
+/**
+ * @file example_ai_packet_crypto_bench.c
+ * @brief Host side benchmark of the AI packet seal and sign stage.
+ *
+ * Every security level is measured twice at common audio frame sizes: once the way packets used to be sealed
+ * (cipher and HMAC contexts set up and torn down per packet, GCM through the allocating wrapper) and once through
+ * the keyed AI_CRYPTO_CTX_T the protocol keeps per connection, which seals in place and signs from the packet.
+ * Throughput is reported in MB/s and, on x86 hosts, in cycles per byte.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tkl_output.h"
+#include "tal_hash.h"
+#include "tal_symmetry.h"
+#include "cipher_wrapper.h"
+#include "tuya_ai_crypto.h"
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_MIN_BYTES (8 * 1024 * 1024)
+#define BENCH_HEAD_LEN  25
+#define BENCH_PAD_LEN   (AI_GCM_TAG_LEN + 16)
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef OPERATE_RET (*BENCH_SEAL_CB)(AI_PACKET_SL sl, UCHAR_T *pkt, UINT_T len);
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+/* opus 16kbps 20ms, opus 32kbps 20ms, pcm 16k 10ms/20ms/60ms/100ms, one fragment */
+static const UINT_T sg_frame_size[] = {40, 80, 320, 640, 1920, 3200, 8192};
+static const AI_PACKET_SL sg_sl[] = {AI_PACKET_SL2, AI_PACKET_SL3, AI_PACKET_SL4};
+
+static UCHAR_T sg_crypt_key[AI_KEY_LEN];
+static UCHAR_T sg_sign_key[AI_KEY_LEN];
+static UCHAR_T sg_iv[AI_IV_LEN];
+static AI_CRYPTO_CTX_T sg_crypto;
+static UCHAR_T sg_pkt[BENCH_HEAD_LEN + 8192 + BENCH_PAD_LEN + AI_SIGN_LEN];
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint64_t __now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t __cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief per packet setup, the way the protocol sealed packets before the crypto stage
+ */
+static OPERATE_RET __seal_per_packet(AI_PACKET_SL sl, UCHAR_T *pkt, UINT_T len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    UCHAR_T *payload = pkt + BENCH_HEAD_LEN;
+    UCHAR_T sign_data[64];
+    size_t olen = 0;
+
+    if (sl == AI_PACKET_SL4) {
+        UCHAR_T tag[AI_GCM_TAG_LEN];
+        rt = mbedtls_cipher_auth_encrypt_wrapper(&(const cipher_params_t){.cipher_type = MBEDTLS_CIPHER_AES_256_GCM,
+                                                                          .key = sg_crypt_key,
+                                                                          .key_len = AI_KEY_LEN,
+                                                                          .nonce = sg_iv,
+                                                                          .nonce_len = AI_IV_LEN,
+                                                                          .data = payload,
+                                                                          .data_len = len},
+                                                 payload, &olen, tag, sizeof(tag));
+        memcpy(payload + len, tag, sizeof(tag));
+        return rt;
+    }
+
+    if (sl == AI_PACKET_SL2) {
+        rt = mbedtls_chacha20_crypt(sg_crypt_key, sg_iv, 0, len, payload, payload);
+    } else {
+        rt = tal_aes256_cbc_encode_raw(payload, len, sg_crypt_key, sg_iv, payload);
+    }
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+    memcpy(sign_data, pkt, 32);
+    memcpy(sign_data + 32, payload + len - 32, 32);
+    return tal_sha256_mac(sg_sign_key, AI_KEY_LEN, sign_data, sizeof(sign_data), payload + len);
+}
+
+/**
+ * @brief keyed per connection contexts, sealed in place and signed straight from the packet
+ */
+static OPERATE_RET __seal_persistent(AI_PACKET_SL sl, UCHAR_T *pkt, UINT_T len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    UCHAR_T *payload = pkt + BENCH_HEAD_LEN;
+
+    if (sl == AI_PACKET_SL4) {
+        return tuya_ai_crypto_seal(&sg_crypto, sl, sg_iv, payload, len, payload + len);
+    }
+    rt = tuya_ai_crypto_seal(&sg_crypto, sl, sg_iv, payload, len, NULL);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+    return tuya_ai_crypto_sign(&sg_crypto, pkt, BENCH_HEAD_LEN, len, payload + len);
+}
+
+static void __bench_run(const char *name, BENCH_SEAL_CB seal, AI_PACKET_SL sl, UINT_T len)
+{
+    UINT_T loops = BENCH_MIN_BYTES / len;
+    UINT_T i = 0;
+
+    /* CBC seals whole blocks, the protocol pkcs7-pads the frame first */
+    if (sl == AI_PACKET_SL3) {
+        len = (len + 15) & ~15;
+    }
+
+    if (loops < 256) {
+        loops = 256;
+    }
+
+    uint64_t start_ns = __now_ns();
+    uint64_t start_cyc = __cycles();
+    for (i = 0; i < loops; i++) {
+        if (OPRT_OK != seal(sl, sg_pkt, len)) {
+            PR_ERR("%s sl%d len %d seal failed", name, sl, len);
+            return;
+        }
+    }
+    uint64_t cyc = __cycles() - start_cyc;
+    uint64_t ns = __now_ns() - start_ns;
+
+    uint64_t bytes = (uint64_t)loops * len;
+    double mbps = (double)bytes / ((double)ns / 1e9) / (1024.0 * 1024.0);
+    double cpb = cyc ? (double)cyc / (double)bytes : 0;
+    PR_NOTICE("%-12s SL%d %5d B  %9.2f MB/s  %8.2f cycles/B  %7.0f pkt/s", name, sl, len, mbps, cpb,
+              (double)loops / ((double)ns / 1e9));
+}
+
+/**
+ * @brief user_main
+ *
+ * @return none
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    UINT_T s = 0, f = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_DEBUG, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    memset(sg_crypt_key, 0x5a, sizeof(sg_crypt_key));
+    memset(sg_sign_key, 0xa5, sizeof(sg_sign_key));
+    memset(sg_iv, 0x3c, sizeof(sg_iv));
+    memset(sg_pkt, 0x11, sizeof(sg_pkt));
+
+    TUYA_CALL_ERR_GOTO(tuya_ai_crypto_init(&sg_crypto), __EXIT);
+    TUYA_CALL_ERR_GOTO(tuya_ai_crypto_set_crypt_key(&sg_crypto, sg_crypt_key), __EXIT);
+    TUYA_CALL_ERR_GOTO(tuya_ai_crypto_set_sign_key(&sg_crypto, sg_sign_key), __EXIT);
+
+    PR_NOTICE("ai packet seal+sign benchmark, SL2 chacha20+hmac, SL3 aes256-cbc+hmac, SL4 aes256-gcm");
+    for (s = 0; s < CNTSOF(sg_sl); s++) {
+        for (f = 0; f < CNTSOF(sg_frame_size); f++) {
+            __bench_run("per-packet", __seal_per_packet, sg_sl[s], sg_frame_size[f]);
+            __bench_run("persistent", __seal_persistent, sg_sl[s], sg_frame_size[f]);
+        }
+    }
+
+__EXIT:
+    tuya_ai_crypto_deinit(&sg_crypto);
+    return;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.stackDepth = 1024 * 4;
+    thrd_param.priority = THREAD_PRIO_1;
+    thrd_param.thrdname = "tuya_app_main";
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
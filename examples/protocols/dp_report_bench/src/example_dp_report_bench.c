@@ -0,0 +1,279 @@
+/**
+ * @file example_dp_report_bench.c
+ * @brief Benchmark of the object DP report encoding on the host.
+ *
+ * Encodes the same report of a light, two switches, a value, an enum and two strings, into the MQTT payload in two
+ * ways: the previous path, dp_rept_json_output() followed by the devId envelope in a second heap buffer, and the
+ * streaming path, dp_rept_stream_output() with the envelope straight into the report arena. Both run the same
+ * dp_rept_valid_check(). Reports per second and the heap used per report are printed, the heap is measured by
+ * wrapping the C allocator of the process.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "dp_schema.h"
+#include "tkl_output.h"
+
+#include <time.h>
+#include <malloc.h>
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_REPORT_NUM 200000
+#define BENCH_DEVID      "6c0a1b2c3d4e5f6a7bxyzq"
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    uint32_t allocs;
+    uint32_t in_use;
+    uint32_t peak;
+} BENCH_HEAP_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const char *sg_schema_json =
+    "[{\"mode\":\"rw\",\"property\":{\"type\":\"bool\"},\"id\":20,\"type\":\"obj\"},"
+    "{\"mode\":\"rw\",\"property\":{\"range\":[\"white\",\"colour\",\"scene\",\"music\"],\"type\":\"enum\"},"
+    "\"id\":21,\"type\":\"obj\"},"
+    "{\"mode\":\"rw\",\"property\":{\"min\":10,\"max\":1000,\"scale\":0,\"step\":1,\"type\":\"value\"},\"id\":22,"
+    "\"type\":\"obj\"},"
+    "{\"mode\":\"rw\",\"property\":{\"type\":\"string\",\"maxlen\":255},\"id\":24,\"type\":\"obj\"},"
+    "{\"mode\":\"rw\",\"property\":{\"type\":\"string\",\"maxlen\":255},\"id\":25,\"type\":\"obj\"},"
+    "{\"mode\":\"rw\",\"property\":{\"type\":\"bool\"},\"id\":41,\"type\":\"obj\"}]";
+
+static dp_obj_t sg_dps[] = {
+    {20, PROP_BOOL, {.dp_bool = TRUE}, 0},
+    {21, PROP_ENUM, {.dp_enum = 1}, 0},
+    {22, PROP_VALUE, {.dp_value = 860}, 0},
+    {24, PROP_STR, {.dp_str = "00f003e803e8"}, 0},
+    {25, PROP_STR, {.dp_str = "010b0a0a0000000000000000000000000000000000000000000000000000000000000000"}, 0},
+    {41, PROP_BOOL, {.dp_bool = FALSE}, 0},
+};
+
+static BENCH_HEAP_T sg_heap;
+static volatile BOOL_T sg_heap_track = FALSE;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static void __heap_add(void *ptr)
+{
+    if (ptr && sg_heap_track) {
+        sg_heap.allocs++;
+        sg_heap.in_use += malloc_usable_size(ptr);
+        if (sg_heap.in_use > sg_heap.peak) {
+            sg_heap.peak = sg_heap.in_use;
+        }
+    }
+}
+
+static void __heap_sub(void *ptr)
+{
+    if (ptr && sg_heap_track) {
+        sg_heap.in_use -= malloc_usable_size(ptr);
+    }
+}
+
+// tal_malloc ends in malloc on the host, wrap it to see the heap of a report
+void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+    __heap_add(ptr);
+    return ptr;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *ptr = __libc_calloc(nmemb, size);
+    __heap_add(ptr);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    __heap_sub(ptr);
+    ptr = __libc_realloc(ptr, size);
+    __heap_add(ptr);
+    return ptr;
+}
+
+void free(void *ptr)
+{
+    __heap_sub(ptr);
+    __libc_free(ptr);
+}
+#endif
+
+static uint64_t __now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static dp_rept_valid_t *__report_check(dp_schema_t *schema, dp_rept_in_t *dpin)
+{
+    dp_rept_valid_t *dpvalid = tal_malloc(sizeof(dp_rept_valid_t) + dpin->dpscnt);
+    if (NULL == dpvalid) {
+        return NULL;
+    }
+    memset(dpvalid, 0, sizeof(dp_rept_valid_t) + dpin->dpscnt);
+
+    if (OPRT_OK != dp_rept_valid_check(schema, dpin, dpvalid)) {
+        tal_free(dpvalid);
+        return NULL;
+    }
+
+    return dpvalid;
+}
+
+// dp_rept_json_output, then the devId envelope of tuya_iot_dp_report_json_common
+static int __report_json(dp_schema_t *schema, dp_rept_in_t *dpin, char *out, uint32_t out_len)
+{
+    int len = -1;
+    dp_rept_out_t dpout;
+    dp_rept_valid_t *dpvalid = __report_check(schema, dpin);
+
+    TUYA_CHECK_NULL_RETURN(dpvalid, -1);
+    memset(&dpout, 0, sizeof(dpout));
+    if (OPRT_OK == dp_rept_json_output(schema, dpin, dpvalid, &dpout)) {
+        size_t buf_len = strlen(dpout.dpsjson) + 64;
+        char *buffer = tal_malloc(buf_len);
+        if (buffer) {
+            len = snprintf(buffer, buf_len, "{\"devId\":\"%s\",\"dps\":%s}", schema->devid, dpout.dpsjson);
+            snprintf(out, out_len, "%s", buffer);
+            tal_free(buffer);
+        }
+        tal_free(dpout.dpsjson);
+    }
+    tal_free(dpvalid);
+
+    return len;
+}
+
+static int __report_stream(dp_schema_t *schema, dp_rept_in_t *dpin, char *out, uint32_t out_len)
+{
+    char prefix[48];
+    uint32_t size = 0, len = 0;
+    dp_rept_valid_t *dpvalid = __report_check(schema, dpin);
+
+    TUYA_CHECK_NULL_RETURN(dpvalid, -1);
+    snprintf(prefix, sizeof(prefix), "{\"devId\":\"%s\",\"dps\":", schema->devid);
+    char *buf = dp_rept_arena_acquire(&size);
+    if (OPRT_OK == dp_rept_stream_output(schema, dpin, dpvalid, prefix, "}", buf, size, &len)) {
+        snprintf(out, out_len, "%s", buf);
+    } else {
+        len = (uint32_t)-1;
+    }
+    dp_rept_arena_release();
+    tal_free(dpvalid);
+
+    return (int)len;
+}
+
+static void __bench(const char *name, dp_schema_t *schema,
+                    int (*report)(dp_schema_t *, dp_rept_in_t *, char *, uint32_t), char *out, uint32_t out_len)
+{
+    uint32_t i = 0;
+    uint64_t start_ns = 0, ns = 0;
+    dp_rept_in_t dpin = {
+        .rept_type = T_OBJ_REPT, .flags = DP_REPT_NO_FILTER_FLAG, .dpscnt = CNTSOF(sg_dps), .dps = sg_dps};
+
+    memset(&sg_heap, 0, sizeof(sg_heap));
+    sg_heap_track = TRUE;
+    report(schema, &dpin, out, out_len);
+    sg_heap_track = FALSE;
+    PR_NOTICE("%-6s heap per report: %d allocs, peak %d bytes", name, sg_heap.allocs, sg_heap.peak);
+
+    start_ns = __now_ns();
+    for (i = 0; i < BENCH_REPORT_NUM; i++) {
+        if (report(schema, &dpin, out, out_len) < 0) {
+            PR_ERR("%s report failed", name);
+            return;
+        }
+    }
+    ns = __now_ns() - start_ns;
+    PR_NOTICE("%-6s %d reports: %8.0f reports/s, %6.0f ns/report", name, BENCH_REPORT_NUM,
+              (double)BENCH_REPORT_NUM / ((double)ns / 1e9), (double)ns / BENCH_REPORT_NUM);
+}
+
+/**
+ * @brief user_main
+ *
+ * @return none
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    dp_schema_t *schema = NULL;
+    static char json_out[512], stream_out[512];
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+    TUYA_CALL_ERR_GOTO(dp_schema_create(BENCH_DEVID, (char *)sg_schema_json, &schema), __EXIT);
+
+    __bench("json", schema, __report_json, json_out, sizeof(json_out));
+    __bench("stream", schema, __report_stream, stream_out, sizeof(stream_out));
+
+    PR_NOTICE("payload %d bytes, %s", strlen(stream_out), strcmp(json_out, stream_out) ? "MISMATCH" : "identical");
+    PR_NOTICE("%s", stream_out);
+
+__EXIT:
+    if (schema) {
+        dp_schema_delete(BENCH_DEVID);
+    }
+    return;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.stackDepth = 1024 * 4;
+    thrd_param.priority = THREAD_PRIO_1;
+    thrd_param.thrdname = "tuya_app_main";
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
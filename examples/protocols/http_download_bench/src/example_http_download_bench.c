@@ -0,0 +1,175 @@
+/**
+ * @file example_http_download_bench.c
+ * @brief Throughput benchmark of http_file_download on the host.
+ *
+ * Downloads an image from tools/ota_http_server.py once with the serial single connection download and then with 1,
+ * 2 and 4 concurrent range connections, checkpointing into KV like an OTA would. Each run reports its throughput and
+ * the SHA-256 of the delivered bytes, which must match the one the server printed at start.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "http_download.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_URL          "http://127.0.0.1:8080/firmware.bin"
+#define BENCH_RANGE_LENGTH (16 * 1024)
+#define BENCH_CKPT_KEY     "dl_bench_ckpt"
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    TKL_HASH_HANDLE sha256;
+    size_t file_size;
+    size_t received;
+    int result;
+} BENCH_RUN_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const uint8_t sg_connections[] = {0, 1, 2, 4};
+static const char *sg_url = BENCH_URL;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static void __download_event_cb(http_download_event_id_t id, http_download_event_t *event)
+{
+    BENCH_RUN_T *run = (BENCH_RUN_T *)event->user_data;
+
+    switch (id) {
+    case DL_EVENT_ON_FILESIZE:
+        run->file_size = event->file_size;
+        // every run measures the whole file
+        event->offset = 0;
+        break;
+
+    case DL_EVENT_ON_DATA:
+        tal_sha256_update_ret(run->sha256, event->data, event->data_len);
+        run->received += event->data_len;
+        event->remain_len = 0;
+        break;
+
+    case DL_EVENT_FINISH:
+        run->result = OPRT_OK;
+        break;
+
+    case DL_EVENT_FAULT:
+        run->result = OPRT_COM_ERROR;
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void __bench_run(uint8_t connections)
+{
+    BENCH_RUN_T run = {0};
+    uint8_t digest[32];
+    char digest_str[32 * 2 + 1];
+    SYS_TIME_T start_ms = 0, cost_ms = 0;
+    uint32_t i = 0;
+
+    run.result = OPRT_COM_ERROR;
+    tal_sha256_create_init(&run.sha256);
+    tal_sha256_starts_ret(run.sha256, 0);
+
+    http_download_config_t cfg = {
+        .url = sg_url,
+        .timeout_ms = 5000,
+        .range_length = BENCH_RANGE_LENGTH,
+        .connections = connections,
+        .checkpoint_key = BENCH_CKPT_KEY,
+        .user_data = &run,
+        .event_handler = __download_event_cb,
+    };
+
+    start_ms = tal_system_get_millisecond();
+    http_file_download(&cfg);
+    cost_ms = tal_system_get_millisecond() - start_ms;
+
+    tal_sha256_finish_ret(run.sha256, digest);
+    tal_sha256_free(run.sha256);
+    for (i = 0; i < sizeof(digest); i++) {
+        snprintf(digest_str + i * 2, 3, "%02x", digest[i]);
+    }
+
+    PR_NOTICE("connections %d: %s %d/%d bytes in %d ms, %.1f KB/s", connections,
+              OPRT_OK == run.result ? "ok" : "fail", (int)run.received, (int)run.file_size, (int)cost_ms,
+              cost_ms ? (double)run.received * 1000 / cost_ms / 1024 : 0);
+    PR_NOTICE("sha256 %s", digest_str);
+}
+
+/**
+ * @brief user_main
+ *
+ * @return none
+ */
+void user_main(void)
+{
+    uint32_t i = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+    tal_kv_init(&(tal_kv_cfg_t){
+        .seed = "vmlkasdh93dlvlcy",
+        .key = "dflfuap134ddlduq",
+    });
+
+    PR_NOTICE("download %s", sg_url);
+    for (i = 0; i < CNTSOF(sg_connections); i++) {
+        __bench_run(sg_connections[i]);
+    }
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    if (argc > 1) {
+        sg_url = argv[1];
+    }
+    user_main();
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.stackDepth = 1024 * 4;
+    thrd_param.priority = THREAD_PRIO_1;
+    thrd_param.thrdname = "tuya_app_main";
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
@@ -22,6 +22,7 @@
 
 #include "tuya_cloud_types.h"
 #include "http_client_interface.h"
+#include "tuya_tls.h"
 
 #include "tal_api.h"
 #include "tkl_output.h"
@@ -47,6 +48,8 @@
 ********************** typedef define **********************
 ***********************************************************/
 #define HTTP_REQUEST_TIMEOUT 10 * 1000
+// the second request resumes the TLS session of the first one
+#define HTTP_REQUEST_COUNT 2
 
 /***********************************************************
 ********************** variable define *********************
@@ -67,44 +70,55 @@ OPERATE_RET __link_status_cb(void *data)
     int rt = OPRT_OK;
     uint16_t cacert_len = 0;
     uint8_t *cacert = NULL;
+    uint32_t i = 0;
+    tuya_tls_stats_t tls_stats = {0};
     static netmgr_status_e status = NETMGR_LINK_DOWN;
     if (status == (netmgr_status_e)data && NETMGR_LINK_UP == (netmgr_status_e)data)
         return OPRT_OK;
 
-    /* HTTP Response */
-    http_client_response_t http_response = {0};
-
     /* HTTPS cert */
     TUYA_CALL_ERR_RETURN(tuya_iotdns_query_domain_certs(URL, &cacert, &cacert_len));
 
     /* HTTP headers */
     http_client_header_t headers[] = {{.key = "Content-Type", .value = "application/json"}};
 
-    /* HTTP Request send */
-    PR_DEBUG("http request send!");
-    http_client_status_t http_status = http_client_request(
-        &(const http_client_request_t){.cacert = cacert,
-                                       .cacert_len = cacert_len,
-                                       .host = URL,
-                                       .port = 443,
-                                       .method = "GET",
-                                       .path = PATH,
-                                       .headers = headers,
-                                       .headers_count = sizeof(headers) / sizeof(http_client_header_t),
-                                       .body = "",
-                                       .body_length = 0,
-                                       .timeout_ms = HTTP_REQUEST_TIMEOUT},
-        &http_response);
-
-    if (HTTP_CLIENT_SUCCESS != http_status) {
-        PR_ERR("http_request_send error:%d", http_status);
-        rt = OPRT_LINK_CORE_HTTP_CLIENT_SEND_ERROR;
-        goto err_exit;
+    for (i = 0; i < HTTP_REQUEST_COUNT; i++) {
+        /* HTTP Response */
+        http_client_response_t http_response = {0};
+
+        /* HTTP Request send */
+        PR_DEBUG("http request send!");
+        http_client_status_t http_status = http_client_request(
+            &(const http_client_request_t){.cacert = cacert,
+                                           .cacert_len = cacert_len,
+                                           .host = URL,
+                                           .port = 443,
+                                           .method = "GET",
+                                           .path = PATH,
+                                           .headers = headers,
+                                           .headers_count = sizeof(headers) / sizeof(http_client_header_t),
+                                           .body = "",
+                                           .body_length = 0,
+                                           .timeout_ms = HTTP_REQUEST_TIMEOUT},
+            &http_response);
+
+        if (HTTP_CLIENT_SUCCESS != http_status) {
+            PR_ERR("http_request_send error:%d", http_status);
+            http_client_free(&http_response);
+            rt = OPRT_LINK_CORE_HTTP_CLIENT_SEND_ERROR;
+            break;
+        }
+
+        PR_DEBUG_RAW("http_get_example body: \n%s\n", (char *)http_response.body);
+        http_client_free(&http_response);
     }
 
-    PR_DEBUG_RAW("http_get_example body: \n%s\n", (char *)http_response.body);
-err_exit:
-    http_client_free(&http_response);
+    /* TLS handshake cost, with and without session resumption */
+    tuya_tls_stats_get(&tls_stats);
+    PR_NOTICE("tls full handshake: %d, avg %d ms", tls_stats.full_cnt,
+              tls_stats.full_cnt ? tls_stats.full_ms / tls_stats.full_cnt : 0);
+    PR_NOTICE("tls resumed handshake: %d, avg %d ms", tls_stats.resumed_cnt,
+              tls_stats.resumed_cnt ? tls_stats.resumed_ms / tls_stats.resumed_cnt : 0);
 
     return rt;
 }
@@ -0,0 +1,297 @@
+/**
+ * @file example_lan_sock_bench.c
+ * @brief Benchmark of the LAN socket loop and tal_net_poll on the host.
+ *
+ * Measures how long a socket registered with tuya_reg_lan_sock takes to get its first read callback, then runs a UDP
+ * echo server over 256 loopback sockets and pings them from a client. The server either waits on a tal_net_poll set
+ * and dispatches the ready sockets, or rebuilds the fd sets and scans every socket after select like the previous LAN
+ * loop. The round trip time of both is reported.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tal_net_poll.h"
+#include "lan_sock.h"
+#include "tkl_output.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_REG_NUM    20
+#define BENCH_SOCK_NUM   256
+#define BENCH_PING_NUM   20000
+#define BENCH_PORT_BASE  41000
+#define BENCH_EVENT_NUM  16
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static SEM_HANDLE sg_read_sem = NULL;
+static int sg_srv_fd[BENCH_SOCK_NUM];
+static TAL_NET_POLL_HANDLE sg_poll = NULL;
+static THREAD_HANDLE sg_srv_thread = NULL;
+static volatile BOOL_T sg_srv_poll_mode = TRUE;
+static volatile BOOL_T sg_srv_running = FALSE;
+static uint32_t sg_rtt_us[BENCH_PING_NUM];
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint64_t __now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int __cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int __udp_bind(uint16_t port)
+{
+    int fd = tal_net_socket_create(PROTOCOL_UDP);
+    if (fd < 0) {
+        return -1;
+    }
+    tal_net_set_reuse(fd);
+    if (UNW_SUCCESS != tal_net_bind(fd, TY_IPADDR_LOOPBACK, port)) {
+        tal_net_close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void __echo(int fd)
+{
+    uint8_t buf[64];
+    TUYA_IP_ADDR_T addr = 0;
+    uint16_t port = 0;
+
+    int len = tal_net_recvfrom(fd, buf, sizeof(buf), &addr, &port);
+    if (len > 0) {
+        tal_net_send_to(fd, buf, len, addr, port);
+    }
+}
+
+static void __lan_read(int32_t sock)
+{
+    uint8_t buf[16];
+    TUYA_IP_ADDR_T addr = 0;
+    uint16_t port = 0;
+
+    tal_net_recvfrom(sock, buf, sizeof(buf), &addr, &port);
+    tal_semaphore_post(sg_read_sem);
+}
+
+// time from tuya_reg_lan_sock to the first read of a socket that already has data
+static void __bench_reg(void)
+{
+    uint64_t start_us = 0, total_us = 0, max_us = 0;
+    int fd = -1;
+    uint32_t i = 0;
+
+    tal_semaphore_create_init(&sg_read_sem, 0, 1);
+    if (OPRT_OK != tuya_sock_loop_init()) {
+        PR_ERR("sock loop init err");
+        return;
+    }
+
+    for (i = 0; i < BENCH_REG_NUM; i++) {
+        fd = __udp_bind(BENCH_PORT_BASE + BENCH_SOCK_NUM);
+        if (fd < 0) {
+            PR_ERR("bind err");
+            return;
+        }
+        tal_net_send_to(fd, "r", 1, TY_IPADDR_LOOPBACK, BENCH_PORT_BASE + BENCH_SOCK_NUM);
+
+        sloop_sock_t sock_info = {.sock = fd, .pre_select = NULL, .read = __lan_read, .err = NULL, .quit = NULL};
+        start_us = __now_us();
+        tuya_reg_lan_sock(sock_info);
+        tal_semaphore_wait(sg_read_sem, 5000);
+        start_us = __now_us() - start_us;
+        total_us += start_us;
+        if (start_us > max_us) {
+            max_us = start_us;
+        }
+
+        // closed by the loop
+        tuya_unreg_lan_sock(fd);
+        tal_system_sleep(10);
+    }
+
+    PR_NOTICE("lan reg -> first read: avg %llu us, max %llu us", total_us / BENCH_REG_NUM, max_us);
+    tuya_dump_lan_sock_reader();
+}
+
+static void __srv_task(void *arg)
+{
+    TAL_NET_POLL_EVENT_T events[BENCH_EVENT_NUM];
+    TUYA_FD_SET_T rfds, efds;
+    int max_fd = 0;
+    int i = 0, n = 0;
+
+    while (sg_srv_running) {
+        if (sg_srv_poll_mode) {
+            n = tal_net_poll_wait(sg_poll, events, BENCH_EVENT_NUM, 100);
+            for (i = 0; i < n; i++) {
+                __echo(events[i].fd);
+            }
+            continue;
+        }
+
+        // the previous LAN loop: rebuild, select, scan everything
+        tal_net_fd_zero(&rfds);
+        tal_net_fd_zero(&efds);
+        for (i = 0, max_fd = 0; i < BENCH_SOCK_NUM; i++) {
+            tal_net_fd_set(sg_srv_fd[i], &rfds);
+            tal_net_fd_set(sg_srv_fd[i], &efds);
+            max_fd = (sg_srv_fd[i] > max_fd) ? sg_srv_fd[i] : max_fd;
+        }
+        n = tal_net_select(max_fd + 1, &rfds, NULL, &efds, 100);
+        if (n <= 0) {
+            continue;
+        }
+        for (i = 0; i < BENCH_SOCK_NUM; i++) {
+            tal_net_fd_isset(sg_srv_fd[i], &efds);
+        }
+        for (i = 0; i < BENCH_SOCK_NUM; i++) {
+            if (tal_net_fd_isset(sg_srv_fd[i], &rfds)) {
+                __echo(sg_srv_fd[i]);
+            }
+        }
+    }
+}
+
+static void __bench_rtt(const char *name, int cli_fd)
+{
+    uint8_t buf[64] = "ping";
+    TUYA_IP_ADDR_T addr = 0;
+    uint16_t port = 0;
+    uint64_t total_us = 0, start_us = 0;
+    uint32_t i = 0, lost = 0;
+
+    for (i = 0; i < BENCH_PING_NUM; i++) {
+        start_us = __now_us();
+        tal_net_send_to(cli_fd, buf, 32, TY_IPADDR_LOOPBACK, BENCH_PORT_BASE + rand() % BENCH_SOCK_NUM);
+        if (tal_net_recvfrom(cli_fd, buf, sizeof(buf), &addr, &port) <= 0) {
+            lost++;
+        }
+        sg_rtt_us[i] = (uint32_t)(__now_us() - start_us);
+        total_us += sg_rtt_us[i];
+    }
+    qsort(sg_rtt_us, BENCH_PING_NUM, sizeof(uint32_t), __cmp_u32);
+    PR_NOTICE("%-6s %d sockets: rtt avg %llu us, p50 %u us, p99 %u us, lost %u", name, BENCH_SOCK_NUM,
+              total_us / BENCH_PING_NUM, sg_rtt_us[BENCH_PING_NUM / 2], sg_rtt_us[BENCH_PING_NUM * 99 / 100], lost);
+}
+
+/**
+ * @brief user_main
+ *
+ * @return none
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    int cli_fd = -1;
+    uint32_t i = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    __bench_reg();
+
+    for (i = 0; i < BENCH_SOCK_NUM; i++) {
+        sg_srv_fd[i] = -1;
+    }
+    TUYA_CALL_ERR_GOTO(tal_net_poll_create(BENCH_SOCK_NUM, &sg_poll), __EXIT);
+    for (i = 0; i < BENCH_SOCK_NUM; i++) {
+        sg_srv_fd[i] = __udp_bind(BENCH_PORT_BASE + i);
+        if (sg_srv_fd[i] < 0) {
+            PR_ERR("bind port %d err", BENCH_PORT_BASE + i);
+            goto __EXIT;
+        }
+        tal_net_set_block(sg_srv_fd[i], FALSE);
+        TUYA_CALL_ERR_GOTO(tal_net_poll_add(sg_poll, sg_srv_fd[i], NULL), __EXIT);
+    }
+    cli_fd = tal_net_socket_create(PROTOCOL_UDP);
+    tal_net_set_timeout(cli_fd, 1000, TRANS_RECV);
+
+    THREAD_CFG_T thrd_param = {.stackDepth = 4096, .priority = THREAD_PRIO_1, .thrdname = "echo_srv"};
+    sg_srv_running = TRUE;
+    TUYA_CALL_ERR_GOTO(tal_thread_create_and_start(&sg_srv_thread, NULL, NULL, __srv_task, NULL, &thrd_param),
+                       __EXIT);
+
+    sg_srv_poll_mode = FALSE;
+    tal_system_sleep(200);
+    __bench_rtt("select", cli_fd);
+
+    sg_srv_poll_mode = TRUE;
+    tal_system_sleep(200);
+    __bench_rtt("poll", cli_fd);
+
+__EXIT:
+    sg_srv_running = FALSE;
+    tal_system_sleep(300);
+    if (cli_fd >= 0) {
+        tal_net_close(cli_fd);
+    }
+    for (i = 0; i < BENCH_SOCK_NUM; i++) {
+        if (sg_srv_fd[i] >= 0) {
+            tal_net_poll_del(sg_poll, sg_srv_fd[i]);
+            tal_net_close(sg_srv_fd[i]);
+        }
+    }
+    if (sg_poll) {
+        tal_net_poll_release(sg_poll);
+    }
+    return;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.stackDepth = 1024 * 4;
+    thrd_param.priority = THREAD_PRIO_1;
+    thrd_param.thrdname = "tuya_app_main";
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
@@ -0,0 +1,260 @@
+/**
+ * @file example_kv_bench.c
+ * @brief Benchmark of the kv store cache on a RAM block device.
+ *
+ * Mounts the kv store on lfs_rambd with the program and erase callbacks wrapped to count flash operations, then runs
+ * three workloads once with every set written through and once with the write-back cache: a config heavy boot that
+ * reads every key many times, frequent DP persistence on a few hot keys, and a batch of keys saved together with and
+ * without a transaction. It reports ops/s and flash programs per op.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tkl_output.h"
+#include "bd/lfs_rambd.h"
+
+#include <time.h>
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_BLOCK_SIZE  4096
+#define BENCH_BLOCK_COUNT 128
+
+#define BENCH_CONFIG_KEYS   24
+#define BENCH_CONFIG_ROUNDS 20
+#define BENCH_DP_KEYS       8
+#define BENCH_DP_SETS       5000
+#define BENCH_BATCH_KEYS    24
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    uint32_t prog;
+    uint32_t prog_bytes;
+    uint32_t erase;
+} BENCH_FLASH_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static uint8_t sg_flash[BENCH_BLOCK_SIZE * BENCH_BLOCK_COUNT];
+static lfs_rambd_t sg_rambd;
+static BENCH_FLASH_T sg_flash_cnt;
+static uint8_t sg_value[512];
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint64_t __now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int __bench_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer,
+                        lfs_size_t size)
+{
+    sg_flash_cnt.prog++;
+    sg_flash_cnt.prog_bytes += size;
+    return lfs_rambd_prog(c, block, off, buffer, size);
+}
+
+static int __bench_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    sg_flash_cnt.erase++;
+    return lfs_rambd_erase(c, block);
+}
+
+static const struct lfs_rambd_config sg_rambd_cfg = {
+    .read_size = 16,
+    .prog_size = 16,
+    .erase_size = BENCH_BLOCK_SIZE,
+    .erase_count = BENCH_BLOCK_COUNT,
+    .buffer = sg_flash,
+};
+
+static const struct lfs_config sg_lfs_cfg = {
+    .context = &sg_rambd,
+    .read = lfs_rambd_read,
+    .prog = __bench_prog,
+    .erase = __bench_erase,
+    .sync = lfs_rambd_sync,
+    .read_size = 16,
+    .prog_size = 16,
+    .block_size = BENCH_BLOCK_SIZE,
+    .block_count = BENCH_BLOCK_COUNT,
+    .cache_size = 256,
+    .lookahead_size = 16,
+    .block_cycles = 500,
+};
+
+static void __bench_report(const char *name, const char *mode, uint32_t ops, uint64_t ns, BENCH_FLASH_T *base)
+{
+    PR_NOTICE("%-14s %-13s %6d ops %10.0f ops/s  prog/op %6.2f  bytes/op %8.1f  erase %4d", name, mode, ops,
+              ops / ((double)ns / 1e9), (double)(sg_flash_cnt.prog - base->prog) / ops,
+              (double)(sg_flash_cnt.prog_bytes - base->prog_bytes) / ops, sg_flash_cnt.erase - base->erase);
+}
+
+static void __bench_key(char *key, const char *prefix, int i)
+{
+    snprintf(key, 16, "%s%d", prefix, i);
+}
+
+static void __bench_config_boot(const char *mode)
+{
+    char key[16];
+    uint8_t *value = NULL;
+    size_t len = 0;
+    BENCH_FLASH_T base = sg_flash_cnt;
+    uint64_t start_ns = 0;
+    int i = 0, r = 0;
+
+    // config keys of 32-512 bytes, written once
+    for (i = 0; i < BENCH_CONFIG_KEYS; i++) {
+        __bench_key(key, "cfg", i);
+        tal_kv_set(key, sg_value, 32 + (i * 97) % 481);
+    }
+    tal_kv_sync();
+
+    base = sg_flash_cnt;
+    start_ns = __now_ns();
+    for (r = 0; r < BENCH_CONFIG_ROUNDS; r++) {
+        for (i = 0; i < BENCH_CONFIG_KEYS; i++) {
+            __bench_key(key, "cfg", i);
+            if (OPRT_OK == tal_kv_get(key, &value, &len)) {
+                tal_kv_free(value);
+            }
+        }
+    }
+    __bench_report("config get", mode, BENCH_CONFIG_KEYS * BENCH_CONFIG_ROUNDS, __now_ns() - start_ns, &base);
+}
+
+static void __bench_dp_persist(const char *mode)
+{
+    char key[16];
+    BENCH_FLASH_T base = sg_flash_cnt;
+    uint64_t start_ns = __now_ns();
+    int i = 0;
+
+    for (i = 0; i < BENCH_DP_SETS; i++) {
+        __bench_key(key, "dp", i % BENCH_DP_KEYS);
+        sg_value[0] = (uint8_t)i;
+        tal_kv_set(key, sg_value, 64);
+    }
+    tal_kv_sync();
+    __bench_report("dp set", mode, BENCH_DP_SETS, __now_ns() - start_ns, &base);
+}
+
+static void __bench_batch(const char *mode, BOOL_T txn)
+{
+    char key[16];
+    BENCH_FLASH_T base = sg_flash_cnt;
+    uint64_t start_ns = __now_ns();
+    int i = 0;
+
+    if (txn) {
+        tal_kv_txn_begin();
+    }
+    for (i = 0; i < BENCH_BATCH_KEYS; i++) {
+        __bench_key(key, "batch", i);
+        tal_kv_set(key, sg_value, 128);
+    }
+    if (txn) {
+        tal_kv_txn_commit();
+    } else {
+        tal_kv_sync();
+    }
+    __bench_report(txn ? "batch txn" : "batch set", mode, BENCH_BATCH_KEYS, __now_ns() - start_ns, &base);
+}
+
+/**
+ * @brief user_main
+ *
+ * @return none
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    tal_kv_stat_t stat;
+    uint32_t i = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+    TUYA_CALL_ERR_GOTO(tal_sw_timer_init(), __EXIT);
+    TUYA_CALL_ERR_GOTO(tal_workq_init(), __EXIT);
+
+    for (i = 0; i < sizeof(sg_value); i++) {
+        sg_value[i] = (uint8_t)(i * 31);
+    }
+
+    TUYA_CALL_ERR_GOTO(lfs_rambd_create(&sg_lfs_cfg, &sg_rambd_cfg), __EXIT);
+    TUYA_CALL_ERR_GOTO(tal_kv_init_lfs(&(tal_kv_cfg_t){.seed = "vmlkasdh93dlvlcy", .key = "dflfuap134ddlduq"},
+                                       &sg_lfs_cfg),
+                       __EXIT);
+
+    PR_NOTICE("rambd %d x %d bytes, prog size %d", BENCH_BLOCK_COUNT, BENCH_BLOCK_SIZE, sg_lfs_cfg.prog_size);
+
+    tal_kv_flush_delay_set(0);
+    __bench_config_boot("write-through");
+    __bench_dp_persist("write-through");
+    __bench_batch("write-through", FALSE);
+
+    tal_kv_flush_delay_set(1000);
+    __bench_config_boot("write-back");
+    __bench_dp_persist("write-back");
+    __bench_batch("write-back", FALSE);
+    __bench_batch("write-back", TRUE);
+
+    tal_kv_stat_get(&stat);
+    PR_NOTICE("get %d hit %d, set %d coalesced %d, file write %d read %d, evict %d, txn %d", stat.get, stat.get_hit,
+              stat.set, stat.set_coalesced, stat.file_write, stat.file_read, stat.evict, stat.txn_commit);
+
+__EXIT:
+    return;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.stackDepth = 1024 * 4;
+    thrd_param.priority = THREAD_PRIO_1;
+    thrd_param.thrdname = "tuya_app_main";
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
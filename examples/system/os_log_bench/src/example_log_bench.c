@@ -0,0 +1,169 @@
+/**
+ * @file example_log_bench.c
+ * @brief Benchmark of the text, binary and asynchronous log paths on the host.
+ *
+ * Logs the same DP report style message through the text path, the binary frames of tal_log_bin_output_set and the
+ * asynchronous backend, and reports the cost per call and the bytes handed to the output for each mode. The binary
+ * stream can be saved with LOG_BENCH_BIN_FILE and decoded with tools/log_decoder.py.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tkl_output.h"
+
+#include <stdio.h>
+#include <time.h>
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_LOG_NUM    20000
+#define BENCH_RING_SIZE  (32 * 1024)
+#define LOG_BENCH_BIN_FILE "log_bench.bin"
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static BOOL_T sg_measuring = FALSE;
+static uint64_t sg_text_bytes = 0;
+static uint64_t sg_bin_bytes = 0;
+static FILE *sg_bin_file = NULL;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint64_t __now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void __text_output(const char *str)
+{
+    if (sg_measuring) {
+        sg_text_bytes += strlen(str);
+        return;
+    }
+    tkl_log_output(str);
+}
+
+static void __bin_output(const uint8_t *data, uint32_t len)
+{
+    sg_bin_bytes += len;
+    if (sg_bin_file) {
+        fwrite(data, 1, len, sg_bin_file);
+    }
+}
+
+static uint64_t __run(void)
+{
+    uint32_t i = 0;
+    uint64_t start_ns = 0;
+
+    sg_text_bytes = 0;
+    sg_bin_bytes = 0;
+    sg_measuring = TRUE;
+    start_ns = __now_ns();
+    for (i = 0; i < BENCH_LOG_NUM; i++) {
+        PR_DEBUG("dp report dpid:%d type:%s value:%d ts:%u seq:%u", 20 + i % 8, "bool", i & 1, i * 37, i);
+    }
+    start_ns = __now_ns() - start_ns;
+    tal_log_flush();
+    sg_measuring = FALSE;
+
+    return start_ns;
+}
+
+/**
+ * @brief user_main
+ *
+ * @return none
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TAL_LOG_ASYNC_STAT_T stat;
+    uint64_t ns = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_DEBUG, 1024, __text_output);
+    tal_log_set_ms_info(TRUE);
+    tal_log_color_enable_set(FALSE);
+
+    ns = __run();
+    PR_NOTICE("text    %6.0f ns/log %6.1f bytes/log", (double)ns / BENCH_LOG_NUM,
+              (double)sg_text_bytes / BENCH_LOG_NUM);
+
+    sg_bin_file = fopen(LOG_BENCH_BIN_FILE, "wb");
+    tal_log_bin_output_set(__bin_output);
+    ns = __run();
+    tal_log_bin_output_set(NULL);
+    if (sg_bin_file) {
+        fclose(sg_bin_file);
+        sg_bin_file = NULL;
+    }
+    PR_NOTICE("binary  %6.0f ns/log %6.1f bytes/log, saved to %s", (double)ns / BENCH_LOG_NUM,
+              (double)sg_bin_bytes / BENCH_LOG_NUM, LOG_BENCH_BIN_FILE);
+
+    TUYA_CALL_ERR_GOTO(tal_log_async_enable(BENCH_RING_SIZE, TAL_LOG_LEVEL_WARN), __EXIT);
+    ns = __run();
+    PR_NOTICE("async   %6.0f ns/log %6.1f bytes/log (caller side)", (double)ns / BENCH_LOG_NUM,
+              (double)sg_text_bytes / BENCH_LOG_NUM);
+
+    tal_log_bin_output_set(__bin_output);
+    ns = __run();
+    tal_log_bin_output_set(NULL);
+    PR_NOTICE("async+b %6.0f ns/log %6.1f bytes/log (caller side)", (double)ns / BENCH_LOG_NUM,
+              (double)sg_bin_bytes / BENCH_LOG_NUM);
+
+    tal_log_async_stat_get(&stat);
+    PR_NOTICE("async queued %d, dropped %d, sync %d, ring peak %d/%d", stat.queued, stat.dropped, stat.sync,
+              stat.ring_peak, stat.ring_size);
+
+__EXIT:
+    return;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.stackDepth = 1024 * 4;
+    thrd_param.priority = THREAD_PRIO_1;
+    thrd_param.thrdname = "tuya_app_main";
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
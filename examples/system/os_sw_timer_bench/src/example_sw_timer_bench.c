@@ -0,0 +1,201 @@
+/**
+ * @file example_sw_timer_bench.c
+ * @brief Stress benchmark of the software timer on the host.
+ *
+ * Creates 10k timers shaped like a busy gateway: periodic timers for DP reporting, heartbeats and LED effects, and
+ * one shot retry timers that re-arm themselves from their callback. It measures the cost of tal_sw_timer_start on a
+ * full wheel, then lets the timers run and reports callbacks per second together with the lateness histogram kept by
+ * the timer thread.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tal_sw_timer.h"
+#include "tkl_output.h"
+
+#include <time.h>
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_TIMER_NUM   10000
+#define BENCH_RESTART_NUM 100000
+#define BENCH_RUN_MS      (20 * 1000)
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    const char *name;
+    TIMER_TYPE type;
+    TIME_MS min_ms;
+    TIME_MS max_ms;
+    uint32_t share; // percent of the timers
+} BENCH_MIX_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const BENCH_MIX_T sg_mix[] = {
+    {"led effect", TAL_TIMER_CYCLE, 20, 100, 10},
+    {"dp report", TAL_TIMER_CYCLE, 500, 5000, 40},
+    {"heartbeat", TAL_TIMER_CYCLE, 10000, 60000, 20},
+    {"retry", TAL_TIMER_ONCE, 100, 3000, 30},
+};
+
+static TIMER_ID sg_timer[BENCH_TIMER_NUM];
+static TIME_MS sg_interval[BENCH_TIMER_NUM];
+static uint32_t sg_seed = 0x1234567;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint64_t __now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t __rand(void)
+{
+    sg_seed = sg_seed * 1103515245 + 12345;
+    return sg_seed >> 8;
+}
+
+static void __timer_cb(TIMER_ID timer_id, void *arg)
+{
+    uint32_t idx = (uint32_t)(uintptr_t)arg;
+
+    // retries re-arm from the callback, like a request timing out again
+    if (!tal_sw_timer_is_running(timer_id)) {
+        tal_sw_timer_start(timer_id, sg_interval[idx], TAL_TIMER_ONCE);
+    }
+}
+
+static void __stat_diff(TAL_SW_TIMER_STAT_T *now, TAL_SW_TIMER_STAT_T *base)
+{
+    uint32_t i = 0;
+
+    now->fired -= base->fired;
+    now->batches -= base->batches;
+    for (i = 0; i < TAL_SW_TIMER_LATE_BUCKETS; i++) {
+        now->late_hist[i] -= base->late_hist[i];
+    }
+}
+
+/**
+ * @brief user_main
+ *
+ * @return none
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TAL_SW_TIMER_STAT_T base, stat;
+    uint32_t i = 0, m = 0, n = 0, cnt = 0;
+    uint64_t start_ns = 0, ns = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+    TUYA_CALL_ERR_GOTO(tal_sw_timer_init(), __EXIT);
+
+    for (m = 0; m < CNTSOF(sg_mix); m++) {
+        cnt = BENCH_TIMER_NUM * sg_mix[m].share / 100;
+        for (n = 0; n < cnt && i < BENCH_TIMER_NUM; n++, i++) {
+            sg_interval[i] = sg_mix[m].min_ms + __rand() % (sg_mix[m].max_ms - sg_mix[m].min_ms + 1);
+            TUYA_CALL_ERR_GOTO(tal_sw_timer_create(__timer_cb, (void *)(uintptr_t)i, &sg_timer[i]), __EXIT);
+        }
+        PR_NOTICE("%-10s %5d timers, %s %d-%d ms", sg_mix[m].name, cnt,
+                  TAL_TIMER_CYCLE == sg_mix[m].type ? "cycle" : "once", sg_mix[m].min_ms, sg_mix[m].max_ms);
+    }
+
+    // start everything, then restart random timers on a full wheel
+    start_ns = __now_ns();
+    for (i = 0, m = 0; m < CNTSOF(sg_mix); m++) {
+        cnt = BENCH_TIMER_NUM * sg_mix[m].share / 100;
+        for (n = 0; n < cnt && i < BENCH_TIMER_NUM; n++, i++) {
+            tal_sw_timer_start(sg_timer[i], sg_interval[i], sg_mix[m].type);
+        }
+    }
+    ns = __now_ns() - start_ns;
+    PR_NOTICE("start   %d timers     %8.0f ns/op", i, (double)ns / i);
+
+    start_ns = __now_ns();
+    for (n = 0; n < BENCH_RESTART_NUM; n++) {
+        i = __rand() % BENCH_TIMER_NUM;
+        tal_sw_timer_stop(sg_timer[i]);
+        tal_sw_timer_start(sg_timer[i], sg_interval[i], TAL_TIMER_ONCE);
+    }
+    ns = __now_ns() - start_ns;
+    PR_NOTICE("restart %d times     %8.0f ns/op (stop+start)", BENCH_RESTART_NUM, (double)ns / BENCH_RESTART_NUM);
+
+    tal_sw_timer_stat_get(&base);
+    start_ns = __now_ns();
+    tal_system_sleep(BENCH_RUN_MS);
+    ns = __now_ns() - start_ns;
+    tal_sw_timer_stat_get(&stat);
+    __stat_diff(&stat, &base);
+
+    PR_NOTICE("run %d ms: %d callbacks, %.0f cb/s, %.1f cb per batch, running %d", BENCH_RUN_MS, stat.fired,
+              (double)stat.fired / ((double)ns / 1e9), stat.batches ? (double)stat.fired / stat.batches : 0,
+              tal_sw_timer_get_num());
+    for (i = 0; i < TAL_SW_TIMER_LATE_BUCKETS; i++) {
+        PR_NOTICE("late %s%5d ms %9d  %6.2f%%", (i == TAL_SW_TIMER_LATE_BUCKETS - 1) ? ">=" : "< ",
+                  (i == TAL_SW_TIMER_LATE_BUCKETS - 1) ? (1 << (i - 1)) : (1 << i), stat.late_hist[i],
+                  stat.fired ? 100.0 * stat.late_hist[i] / stat.fired : 0);
+    }
+    PR_NOTICE("max late %d ms", stat.max_late_ms);
+
+__EXIT:
+    for (i = 0; i < BENCH_TIMER_NUM; i++) {
+        if (sg_timer[i]) {
+            tal_sw_timer_delete(sg_timer[i]);
+            sg_timer[i] = NULL;
+        }
+    }
+    return;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.stackDepth = 1024 * 4;
+    thrd_param.priority = THREAD_PRIO_1;
+    thrd_param.thrdname = "tuya_app_main";
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
@@ -2773,7 +2773,8 @@ HTTPStatus_t HTTPClient_Request( const TransportInterface_t * pTransport,
                 LogError( ( "Failed to receive HTTP data: Transport recv() "
                             "returned error: TransportStatus=%ld",
                             ( long int ) currentReceived ) );
-                return HTTPNetworkError;
+                returnStatus = HTTPNetworkError;
+                goto __exit;
             }
             totalReceived += currentReceived;
             pResponse->pBuffer[totalReceived] = 0;
@@ -2859,7 +2860,8 @@ HTTPStatus_t HTTPClient_Request( const TransportInterface_t * pTransport,
                 LogError( ( "Failed to receive HTTP data: Transport recv() "
                             "returned error: TransportStatus=%ld",
                             ( long int ) currentReceived ) );
-                return HTTPNetworkError;
+                returnStatus = HTTPNetworkError;
+                goto __exit;
             }
             chunkLen = currentReceived;
             parsingContext.recvState = HTTP_PARSE_CHUNK;
@@ -2891,7 +2893,8 @@ HTTPStatus_t HTTPClient_Request( const TransportInterface_t * pTransport,
                 LogError( ( "Failed to receive HTTP data: Transport recv() "
                             "returned error: TransportStatus=%ld",
                             ( long int ) currentReceived ) );
-                return HTTPNetworkError;
+                returnStatus = HTTPNetworkError;
+                goto __exit;
             }
             bodyLen += currentReceived;
             if (pResponse->contentLength == bodyLen) {
@@ -2925,12 +2928,15 @@ __exit:
         HTTP_FREE(chunkBuffer);
     }
 
+    /* Callers may free the response again, leave no dangling pointers. */
     if (pResponse->pBuffer) {
         HTTP_FREE(pResponse->pBuffer);
+        pResponse->pBuffer = NULL;
     }
 
     if (pResponse->pBody) {
         HTTP_FREE(pResponse->pBody);
+        pResponse->pBody = NULL;
     }
 
     return returnStatus;
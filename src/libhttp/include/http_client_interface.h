@@ -31,6 +31,14 @@ typedef struct http_client_request {
     const uint8_t *body;
     size_t body_length;
     uint32_t timeout_ms;
+    /**
+     * @brief Keep the connection for the next request to the same host:port.
+     *
+     * Takes effect after http_client_pool_init(). A request that fails on a
+     * reused connection the server had closed is sent again on a new one only
+     * when none of it was sent, or it is idempotent and no response arrived.
+     */
+    bool keep_alive;
 } http_client_request_t;
 
 typedef struct http_client_response {
@@ -60,8 +68,44 @@ typedef struct http_client_response {
     uint16_t status_code;
 } http_client_response_t;
 
+/**
+ * @brief Counters of the keep-alive connection pool.
+ */
+typedef struct http_client_pool_stats {
+    uint32_t requests;   /**< Requests with keep_alive. */
+    uint32_t reused;     /**< Requests sent on a pooled connection. */
+    uint32_t connects;   /**< Connections opened for keep_alive requests. */
+    uint32_t connect_ms; /**< Time spent opening them, TLS handshake included. */
+    uint32_t saved_ms;   /**< Connect time avoided by the reused requests, estimated from connect_ms. */
+    uint32_t retries;    /**< Pooled connections the server had closed, the request was sent again. */
+    uint32_t evicted;    /**< Idle connections closed. */
+} http_client_pool_stats_t;
+
 http_client_status_t http_client_request(const http_client_request_t *request, http_client_response_t *response);
 
 int http_client_free(http_client_response_t *response);
 
+/**
+ * @brief Enable the keep-alive connection pool of http_client_request.
+ *
+ * Requests with keep_alive leave their connection in the pool, the next one to
+ * the same host:port skips the TCP and TLS setup. Connections idle for
+ * HTTP_CLIENT_POOL_IDLE_MS are closed.
+ *
+ * @return OPRT_OK on success, others on error.
+ */
+int http_client_pool_init(void);
+
+/**
+ * @brief Close all idle pooled connections, e.g. when the network went down.
+ */
+void http_client_pool_flush(void);
+
+/**
+ * @brief Get the counters of the connection pool.
+ *
+ * @param[out] stats Counters since http_client_pool_init.
+ */
+void http_client_pool_stats_get(http_client_pool_stats_t *stats);
+
 #endif /* ifndef HTTP_CLIENT_INTERFACE_H */
@@ -11,6 +11,8 @@ extern "C" {
 typedef enum {
     DL_EVENT_CONNECTED,
     DL_EVENT_START,
+    /* offset is where the download resumes from the checkpoint, the handler
+     * may set it to 0 to download the whole file again */
     DL_EVENT_ON_FILESIZE,
     DL_EVENT_ON_DATA,
     DL_EVENT_FINISH,
@@ -24,6 +26,9 @@ typedef struct {
     size_t file_size;
     uint32_t remain_len;
     void *user_data;
+    /* set by the handler to abort the download with this error, the
+     * checkpoint is dropped as the data was rejected */
+    int result;
 } http_download_event_t;
 
 typedef void (*http_download_event_cb_t)(http_download_event_id_t id, http_download_event_t *event);
@@ -37,6 +42,12 @@ typedef struct {
     size_t file_size;
     void *user_data;
     http_download_event_cb_t event_handler;
+    /* concurrent range connections, 0 streams the file over one connection */
+    uint8_t connections;
+    /* KV key of the progress checkpoint, NULL disables resuming */
+    const char *checkpoint_key;
+    /* identity of the file in the checkpoint, the url when NULL */
+    const char *checkpoint_id;
 } http_download_config_t;
 
 int http_file_download(http_download_config_t *config);
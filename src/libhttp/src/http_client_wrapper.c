@@ -4,6 +4,9 @@
 #include "core_http_client.h"
 #include "tuya_tls.h"
 #include "tal_log.h"
+#include "tal_mutex.h"
+#include "tal_system.h"
+#include "tal_sw_timer.h"
 
 #define log_debug PR_DEBUG
 #define log_error PR_ERR
@@ -11,6 +14,39 @@
 #define HEADER_BUFFER_LENGTH (255)
 #define DEFAULT_HTTP_PORT    (80)
 #define DEFAULT_HTTPS_PORT   (443)
+
+#ifndef HTTP_CLIENT_POOL_NUM
+#define HTTP_CLIENT_POOL_NUM (2)
+#endif
+
+/* below the keep-alive timeout of common servers, which close first otherwise */
+#ifndef HTTP_CLIENT_POOL_IDLE_MS
+#define HTTP_CLIENT_POOL_IDLE_MS (20 * 1000)
+#endif
+
+#define HTTP_CLIENT_POOL_HOST_LEN (128)
+
+typedef struct {
+    char host[HTTP_CLIENT_POOL_HOST_LEN]; /* empty when the slot is free */
+    uint16_t port;
+    bool tls;
+    bool busy;
+    NetworkContext_t network;
+    SYS_TIME_T idle_since;
+} http_pool_conn_t;
+
+/* what a request moved on its connection, to tell whether it may be sent again */
+typedef struct {
+    NetworkContext_t network; /* first, the transport callbacks get a pointer to it */
+    size_t sent;
+    size_t received;
+} http_send_ctx_t;
+
+static MUTEX_HANDLE s_pool_mutex = NULL;
+static TIMER_ID s_pool_timer = NULL;
+static http_pool_conn_t s_pool[HTTP_CLIENT_POOL_NUM];
+static http_client_pool_stats_t s_pool_stats;
+
 static http_client_status_t core_http_request_send(const TransportInterface_t *pTransportInterface,
                                                    const HTTPRequestInfo_t *requestInfo, http_client_header_t *headers,
                                                    uint8_t headers_count, const uint8_t *pRequestBodyBuf,
@@ -74,16 +110,14 @@ static http_client_status_t core_http_request_send(const TransportInterface_t *p
     return HTTP_CLIENT_SUCCESS;
 }
 
-http_client_status_t http_client_request(const http_client_request_t *request, http_client_response_t *response)
+static http_client_status_t http_client_connect(const http_client_request_t *request, NetworkContext_t *network)
 {
-    http_client_status_t rt = HTTP_CLIENT_SUCCESS;
     int ret = OPRT_OK;
 
     /* TLS pre init */
-    NetworkContext_t network;
     TUYA_TRANSPORT_TYPE_E transport_type = (request->cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
-    network = tuya_transporter_create(transport_type, NULL);
-    if (NULL == network) {
+    *network = tuya_transporter_create(transport_type, NULL);
+    if (NULL == *network) {
         return HTTP_CLIENT_MALLOC_FAULT;
     }
 
@@ -98,33 +132,68 @@ http_client_status_t http_client_request(const http_client_request_t *request, h
             .verify = true,
         };
 
-        ret = tuya_transporter_ctrl(network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config);
+        ret = tuya_transporter_ctrl(*network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config);
         if (OPRT_OK != ret) {
             log_error("network_tls_init fail:%d", ret);
-            return ret;
+            tuya_transporter_destroy(*network);
+            return HTTP_CLIENT_SEND_FAULT;
         }
 
-        ret = tuya_transporter_connect(network, tls_config.hostname, tls_config.port, tls_config.timeout);
+        ret = tuya_transporter_connect(*network, tls_config.hostname, tls_config.port, tls_config.timeout);
         if (OPRT_OK != ret) {
-            tuya_transporter_close(network);
-            tuya_transporter_destroy(network);
+            tuya_transporter_close(*network);
+            tuya_transporter_destroy(*network);
             return HTTP_CLIENT_SEND_FAULT;
         }
 
         log_debug("tls connencted!");
     } else {
-        ret = tuya_transporter_connect(network, request->host, (request->port == 0) ? DEFAULT_HTTP_PORT : request->port,
-                                       request->timeout_ms);
+        ret = tuya_transporter_connect(*network, request->host,
+                                       (request->port == 0) ? DEFAULT_HTTP_PORT : request->port, request->timeout_ms);
         if (OPRT_OK != ret) {
-            tuya_transporter_close(network);
-            tuya_transporter_destroy(network);
+            tuya_transporter_close(*network);
+            tuya_transporter_destroy(*network);
             return HTTP_CLIENT_SEND_FAULT;
         }
     }
+
+    return HTTP_CLIENT_SUCCESS;
+}
+
+static void http_client_disconnect(NetworkContext_t network)
+{
+    tuya_transporter_close(network);
+    tuya_transporter_destroy(network);
+}
+
+static int32_t http_transport_send(NetworkContext_t *pNetwork, const void *pBuffer, size_t len)
+{
+    http_send_ctx_t *ctx = (http_send_ctx_t *)pNetwork;
+    int ret = NetworkTransportSend(pNetwork, (const unsigned char *)pBuffer, len);
+
+    if (ret > 0) {
+        ctx->sent += ret;
+    }
+    return ret;
+}
+
+static int32_t http_transport_recv(NetworkContext_t *pNetwork, void *pBuffer, size_t len)
+{
+    http_send_ctx_t *ctx = (http_send_ctx_t *)pNetwork;
+    int ret = NetworkTransportRecv(pNetwork, (unsigned char *)pBuffer, len);
+
+    if (ret > 0) {
+        ctx->received += ret;
+    }
+    return ret;
+}
+
+static http_client_status_t http_client_send(const http_client_request_t *request, http_send_ctx_t *ctx,
+                                             HTTPResponse_t *http_response)
+{
     /* http client TransportInterface */
-    TransportInterface_t pTransportInterface = {.pNetworkContext = (NetworkContext_t *)&network,
-                                                .recv = (TransportRecv_t)NetworkTransportRecv,
-                                                .send = (TransportSend_t)NetworkTransportSend};
+    TransportInterface_t pTransportInterface = {
+        .pNetworkContext = &ctx->network, .recv = http_transport_recv, .send = http_transport_send};
 
     /* http client request object make */
     HTTPRequestInfo_t requestInfo = {
@@ -134,19 +203,245 @@ http_client_status_t http_client_request(const http_client_request_t *request, h
         .hostLen = strlen(request->host),
         .pPath = request->path,
         .pathLen = strlen(request->path),
+        .reqFlags = request->keep_alive ? HTTP_REQUEST_KEEP_ALIVE_FLAG : 0,
     };
 
-    HTTPResponse_t http_response = {0};
-
     /* HTTP request send */
     log_debug("http request send!");
-    rt = core_http_request_send((const TransportInterface_t *)&pTransportInterface,
-                                (const HTTPRequestInfo_t *)&requestInfo, request->headers, request->headers_count,
-                                (const uint8_t *)request->body, request->body_length, &http_response);
+    return core_http_request_send((const TransportInterface_t *)&pTransportInterface,
+                                  (const HTTPRequestInfo_t *)&requestInfo, request->headers, request->headers_count,
+                                  (const uint8_t *)request->body, request->body_length, http_response);
+}
 
-    /* tls disconnect */
-    tuya_transporter_close(network);
-    tuya_transporter_destroy(network);
+/* -------------------------------------------------------------------------- */
+/*                          keep-alive connection pool                        */
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief whether a request that failed on a reused connection may be sent again
+ *
+ * Always when no byte of it left, else only for idempotent methods and only
+ * when no byte of a response arrived, the server may have acted on it otherwise.
+ */
+static bool http_pool_retry_allowed(const http_client_request_t *request, const http_send_ctx_t *ctx)
+{
+    static const char *idempotent[] = {"GET", "HEAD", "PUT", "DELETE", "OPTIONS"};
+    uint32_t i = 0;
+
+    if (0 == ctx->sent) {
+        return true;
+    }
+    if (ctx->received) {
+        return false;
+    }
+    for (i = 0; i < sizeof(idempotent) / sizeof(idempotent[0]); i++) {
+        if (0 == strcmp(request->method, idempotent[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool http_pool_conn_match(const http_pool_conn_t *conn, const http_client_request_t *request)
+{
+    return conn->host[0] && !conn->busy && conn->tls == (request->cacert != NULL) && conn->port == request->port &&
+           0 == strcmp(conn->host, request->host);
+}
+
+/**
+ * @brief close the idle connections, all or those idle for HTTP_CLIENT_POOL_IDLE_MS
+ *
+ * The timer is armed again for the next one to expire.
+ */
+static void http_pool_evict(bool all)
+{
+    NetworkContext_t closing[HTTP_CLIENT_POOL_NUM];
+    uint32_t closing_num = 0, next_ms = 0, i = 0;
+    SYS_TIME_T now = tal_system_get_millisecond();
+
+    tal_mutex_lock(s_pool_mutex);
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        http_pool_conn_t *conn = &s_pool[i];
+        if (0 == conn->host[0] || conn->busy) {
+            continue;
+        }
+        if (all || now - conn->idle_since >= HTTP_CLIENT_POOL_IDLE_MS) {
+            closing[closing_num++] = conn->network;
+            memset(conn, 0, sizeof(http_pool_conn_t));
+            s_pool_stats.evicted++;
+        } else if (0 == next_ms || HTTP_CLIENT_POOL_IDLE_MS - (now - conn->idle_since) < next_ms) {
+            next_ms = HTTP_CLIENT_POOL_IDLE_MS - (now - conn->idle_since);
+        }
+    }
+    tal_mutex_unlock(s_pool_mutex);
+
+    if (next_ms) {
+        tal_sw_timer_start(s_pool_timer, next_ms, TAL_TIMER_ONCE);
+    }
+    for (i = 0; i < closing_num; i++) {
+        log_debug("http pool close idle connection");
+        http_client_disconnect(closing[i]);
+    }
+}
+
+static void http_pool_timer_cb(TIMER_ID timer_id, void *arg)
+{
+    http_pool_evict(false);
+}
+
+/**
+ * @brief take an idle connection to the host:port of request
+ *
+ * @return the connection, NULL when none is pooled
+ */
+static NetworkContext_t http_pool_take(const http_client_request_t *request)
+{
+    NetworkContext_t network = NULL;
+    tuya_tls_config_t *tls_config = NULL;
+    uint32_t i = 0;
+
+    tal_mutex_lock(s_pool_mutex);
+    s_pool_stats.requests++;
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        if (http_pool_conn_match(&s_pool[i], request) &&
+            tal_system_get_millisecond() - s_pool[i].idle_since < HTTP_CLIENT_POOL_IDLE_MS) {
+            s_pool[i].busy = true;
+            network = s_pool[i].network;
+            s_pool_stats.reused++;
+            break;
+        }
+    }
+    tal_mutex_unlock(s_pool_mutex);
+
+    if (network && request->cacert) {
+        /* the receive timeout follows the current request */
+        tuya_transporter_ctrl(network, TUYA_TRANSPORTER_GET_TLS_CONFIG, &tls_config);
+        if (tls_config) {
+            tls_config->timeout = request->timeout_ms;
+        }
+    }
+
+    return network;
+}
+
+static void http_pool_connected(uint32_t cost_ms)
+{
+    tal_mutex_lock(s_pool_mutex);
+    s_pool_stats.connects++;
+    s_pool_stats.connect_ms += cost_ms;
+    tal_mutex_unlock(s_pool_mutex);
+}
+
+/**
+ * @brief return the connection of a request to the pool, or close it
+ *
+ * @param[in] reuse false when the connection failed or the server asked to
+ * close it
+ */
+static void http_pool_put(const http_client_request_t *request, NetworkContext_t network, bool reuse)
+{
+    http_pool_conn_t *slot = NULL;
+    NetworkContext_t closing = NULL;
+    uint32_t i = 0;
+
+    tal_mutex_lock(s_pool_mutex);
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        if (s_pool[i].host[0] && s_pool[i].network == network) {
+            slot = &s_pool[i];
+            break;
+        }
+    }
+    if (NULL == slot && reuse) {
+        /* a free slot, else the one idle the longest */
+        for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+            http_pool_conn_t *conn = &s_pool[i];
+            if (0 == conn->host[0]) {
+                slot = conn;
+                break;
+            }
+            if (!conn->busy && (NULL == slot || conn->idle_since < slot->idle_since)) {
+                slot = conn;
+            }
+        }
+        if (slot && slot->host[0]) {
+            closing = slot->network;
+            s_pool_stats.evicted++;
+        }
+    }
+    if (slot && !reuse) {
+        memset(slot, 0, sizeof(http_pool_conn_t));
+    } else if (slot) {
+        snprintf(slot->host, sizeof(slot->host), "%s", request->host);
+        slot->port = request->port;
+        slot->tls = (request->cacert != NULL);
+        slot->busy = false;
+        slot->network = network;
+        slot->idle_since = tal_system_get_millisecond();
+    }
+    tal_mutex_unlock(s_pool_mutex);
+
+    if (closing) {
+        http_client_disconnect(closing);
+    }
+    if (NULL == slot || !reuse) {
+        http_client_disconnect(network);
+    } else {
+        tal_sw_timer_start(s_pool_timer, HTTP_CLIENT_POOL_IDLE_MS, TAL_TIMER_ONCE);
+    }
+}
+
+http_client_status_t http_client_request(const http_client_request_t *request, http_client_response_t *response)
+{
+    http_client_status_t rt = HTTP_CLIENT_SUCCESS;
+    NetworkContext_t network = NULL;
+    http_send_ctx_t ctx;
+    HTTPResponse_t http_response = {0};
+    bool pooled = request->keep_alive && s_pool_mutex;
+    bool reused = false;
+    SYS_TIME_T start_ms = 0;
+
+    if (pooled) {
+        network = http_pool_take(request);
+        reused = (network != NULL);
+    }
+
+    while (1) {
+        if (NULL == network) {
+            start_ms = tal_system_get_millisecond();
+            rt = http_client_connect(request, &network);
+            if (HTTP_CLIENT_SUCCESS != rt) {
+                return rt;
+            }
+            if (pooled) {
+                http_pool_connected((uint32_t)(tal_system_get_millisecond() - start_ms));
+            }
+        }
+
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.network = network;
+        rt = http_client_send(request, &ctx, &http_response);
+        if (HTTP_CLIENT_SEND_FAULT != rt || !reused || !http_pool_retry_allowed(request, &ctx)) {
+            break;
+        }
+
+        /* the server closed the connection while it was idle, send again on a new one */
+        log_debug("pooled connection to %s lost, reconnect", request->host);
+        http_pool_put(request, network, false);
+        network = NULL;
+        reused = false;
+        tal_mutex_lock(s_pool_mutex);
+        s_pool_stats.reused--;
+        s_pool_stats.retries++;
+        tal_mutex_unlock(s_pool_mutex);
+    }
+
+    /* keep the connection unless it failed or the server closes it */
+    if (pooled) {
+        http_pool_put(request, network,
+                      HTTP_CLIENT_SUCCESS == rt && !(http_response.respFlags & HTTP_RESPONSE_CONNECTION_CLOSE_FLAG));
+    } else {
+        /* tls disconnect */
+        http_client_disconnect(network);
+    }
 
     if (OPRT_OK != rt) {
         log_error("http_request_send error:%d", rt);
@@ -181,3 +476,43 @@ int http_client_free(http_client_response_t *response)
 
     return OPRT_OK;
 }
+
+int http_client_pool_init(void)
+{
+    int rt = OPRT_OK;
+
+    if (s_pool_mutex) {
+        return OPRT_OK;
+    }
+
+    TUYA_CALL_ERR_RETURN(tal_sw_timer_create(http_pool_timer_cb, NULL, &s_pool_timer));
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&s_pool_mutex), __exit);
+
+    return OPRT_OK;
+
+__exit:
+    tal_sw_timer_delete(s_pool_timer);
+    s_pool_timer = NULL;
+    return rt;
+}
+
+void http_client_pool_flush(void)
+{
+    if (NULL == s_pool_mutex) {
+        return;
+    }
+
+    http_pool_evict(true);
+}
+
+void http_client_pool_stats_get(http_client_pool_stats_t *stats)
+{
+    if (NULL == stats || NULL == s_pool_mutex) {
+        return;
+    }
+
+    tal_mutex_lock(s_pool_mutex);
+    *stats = s_pool_stats;
+    tal_mutex_unlock(s_pool_mutex);
+    stats->saved_ms = stats->connects ? (uint32_t)((uint64_t)stats->reused * stats->connect_ms / stats->connects) : 0;
+}
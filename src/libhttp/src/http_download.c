@@ -17,13 +17,45 @@ typedef enum {
     DL_STATE_COMPLETE,
 } http_download_state_t;
 
+typedef enum {
+    DL_SLOT_FREE,
+    DL_SLOT_BUSY,
+    DL_SLOT_READY,
+} http_download_slot_state_t;
+
 typedef struct {
-    http_download_config_t config;
-    http_download_event_t event;
+    NetworkContext_t network;
     TransportInterface_t transport;
     HTTPRequestHeaders_t requestHeaders;
-    HTTPRequestInfo_t requestInfo;
     HTTPResponse_t response;
+    bool connected;
+} http_download_conn_t;
+
+/* one range of the file, fetched by a worker and delivered in order */
+typedef struct {
+    uint8_t state;
+    size_t offset;
+    size_t len;
+    uint8_t *data;
+} http_download_slot_t;
+
+typedef struct {
+    struct http_download *ctx;
+    http_download_conn_t conn;
+    THREAD_HANDLE thread;
+} http_download_worker_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t file_size;
+    uint32_t offset;
+} http_download_checkpoint_t;
+
+typedef struct http_download {
+    http_download_config_t config;
+    http_download_event_t event;
+    HTTPRequestInfo_t requestInfo;
     char *host;
     char *path;
     uint16_t port;
@@ -31,8 +63,25 @@ typedef struct {
     size_t received_size;
     size_t remain_len;
     size_t offset;
+    size_t checkpoint;
     uint8_t state;
     uint8_t *buffer;
+    bool notified;
+
+    /* workers[0] is also the connection of the serial download */
+    http_download_worker_t *workers;
+    uint8_t worker_num;
+
+    /* parallel download */
+    MUTEX_HANDLE mutex;
+    SEM_HANDLE slot_free;
+    SEM_HANDLE slot_ready;
+    SEM_HANDLE worker_done;
+    http_download_slot_t *slots;
+    uint8_t slot_num;
+    size_t next_offset;
+    volatile bool stop;
+    int result;
 } http_download_t;
 
 #define MAX_RETRY_TIMES (8u)
@@ -69,8 +118,43 @@ typedef struct {
 //! timeout sec
 #define HTTP_DOWNLOAD_TIMEOUT 180
 
+//! delay before reconnecting, ms
+#define HTTP_DOWNLOAD_RETRY_DELAY_MS 3000
+
+/**
+ * @brief Upper bound of config.connections.
+ */
+#define HTTP_DOWNLOAD_CONNECTIONS_MAX 4
+
+/**
+ * @brief Stack of a parallel download worker, it runs the TLS handshake.
+ */
+#ifndef HTTP_DOWNLOAD_WORKER_STACK_SIZE
+#define HTTP_DOWNLOAD_WORKER_STACK_SIZE (4 * 1024)
+#endif
+
+/**
+ * @brief Bytes consumed by the event handler between two checkpoints.
+ */
+#ifndef HTTP_DOWNLOAD_CHECKPOINT_STEP
+#define HTTP_DOWNLOAD_CHECKPOINT_STEP (64 * 1024)
+#endif
+
+#define HTTP_DOWNLOAD_CHECKPOINT_MAGIC 0x48444C31 // "HDL1"
+
 /*-----------------------------------------------------------*/
-static int http_download_filesize_get(http_download_t *ctx)
+static void http_download_response_free(HTTPResponse_t *response)
+{
+    if (response->pBuffer) {
+        tal_free(response->pBuffer);
+    }
+    if (response->pBody) {
+        tal_free((void *)response->pBody);
+    }
+    memset(response, 0, sizeof(HTTPResponse_t));
+}
+
+static int http_download_filesize_get(http_download_t *ctx, http_download_conn_t *conn)
 {
     int rt = 0;
     /* The location of the file size in contentRangeValStr. */
@@ -80,19 +164,21 @@ static int http_download_filesize_get(http_download_t *ctx)
     size_t contentRangeValStrLength = 0;
 
     PR_DEBUG("Getting file object size from host...");
-    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&ctx->requestHeaders, &ctx->requestInfo), __exit);
-    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&ctx->requestHeaders, 0, 0), __exit);
-    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&ctx->transport, &ctx->requestHeaders, NULL, 0, &ctx->response, 0), __exit);
+    http_download_response_free(&conn->response);
+    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&conn->requestHeaders, &ctx->requestInfo), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&conn->requestHeaders, 0, 0), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&conn->transport, &conn->requestHeaders, NULL, 0, &conn->response, 0),
+                       __exit);
     PR_DEBUG("Received HTTP response from %s%s...", ctx->host, ctx->path);
-    PR_DEBUG("Response Headers:\n%.*s", (int32_t)ctx->response.headersLen, ctx->response.pHeaders);
-    if (ctx->response.statusCode != HTTP_STATUS_CODE_PARTIAL_CONTENT) {
+    PR_DEBUG("Response Headers:\n%.*s", (int32_t)conn->response.headersLen, conn->response.pHeaders);
+    if (conn->response.statusCode != HTTP_STATUS_CODE_PARTIAL_CONTENT) {
         PR_ERR("Received an invalid response from the server "
                "(Status Code: %u).",
-               ctx->response.statusCode);
+               conn->response.statusCode);
         rt = OPRT_NOT_SUPPORTED;
         goto __exit;
     }
-    TUYA_CALL_ERR_GOTO(HTTPClient_ReadHeader(&ctx->response, (char *)HTTP_CONTENT_RANGE_HEADER_FIELD,
+    TUYA_CALL_ERR_GOTO(HTTPClient_ReadHeader(&conn->response, (char *)HTTP_CONTENT_RANGE_HEADER_FIELD,
                                              (size_t)HTTP_CONTENT_RANGE_HEADER_FIELD_LENGTH,
                                              (const char **)&contentRangeValStr, &contentRangeValStrLength),
                        __exit);
@@ -105,35 +191,189 @@ static int http_download_filesize_get(http_download_t *ctx)
     pFileSizeStr += sizeof(char);
     ctx->file_size = (size_t)strtoul(pFileSizeStr, NULL, 10);
     PR_INFO("The file is %d bytes long.", (int32_t)ctx->file_size);
-    if (ctx->response.pBuffer) {
-        tal_free(ctx->response.pBuffer);
-    }
-    memset(&ctx->response, 0, sizeof(ctx->response));
+    http_download_response_free(&conn->response);
 __exit:
     return rt;
 }
 
-static int http_download_range_request(http_download_t *ctx, uint32_t range_start, uint32_t range_end)
+static int http_download_range_request(http_download_t *ctx, http_download_conn_t *conn, uint32_t range_start,
+                                       uint32_t range_end)
 {
     int rt = OPRT_OK;
 
     PR_DEBUG("Downloading bytes %d-%d, from %s...: ", range_start, range_end, ctx->host);
-    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&ctx->requestHeaders, &ctx->requestInfo), __exit);
-    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&ctx->requestHeaders, range_start, range_end), __exit);
-    PR_TRACE("Request Headers:\n%.*s", (int32_t)ctx->requestHeaders.headersLen, (char *)ctx->requestHeaders.pBuffer);
-    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&ctx->transport, &ctx->requestHeaders, NULL, 0, &ctx->response,
+    /* the previous response keeps its buffers until the next request */
+    http_download_response_free(&conn->response);
+    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&conn->requestHeaders, &ctx->requestInfo), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&conn->requestHeaders, range_start, range_end), __exit);
+    PR_TRACE("Request Headers:\n%.*s", (int32_t)conn->requestHeaders.headersLen,
+             (char *)conn->requestHeaders.pBuffer);
+    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&conn->transport, &conn->requestHeaders, NULL, 0, &conn->response,
                                           HTTP_SEND_DISABLE_RECV_BODY_FLAG),
                        __exit);
     PR_TRACE("Received HTTP response from %s%s...", ctx->host, ctx->path);
-    PR_TRACE("Response Headers:\n%.*s", (int32_t)ctx->response.headersLen, ctx->response.pHeaders);
+    PR_TRACE("Response Headers:\n%.*s", (int32_t)conn->response.headersLen, conn->response.pHeaders);
 __exit:
     return rt;
 }
 
+/*-----------------------------------------------------------*/
+static uint32_t http_download_id_hash(const char *str)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*str) {
+        hash = (hash ^ (uint8_t)*str++) * 16777619U;
+    }
+    return hash;
+}
+
+static uint32_t http_download_id(http_download_t *ctx)
+{
+    return http_download_id_hash(ctx->config.checkpoint_id ? ctx->config.checkpoint_id : ctx->config.url);
+}
+
+/**
+ * @brief offset saved by a previous download of the same file, 0 if none
+ */
+static size_t http_download_checkpoint_load(http_download_t *ctx)
+{
+    http_download_checkpoint_t *record = NULL;
+    size_t len = 0;
+    size_t offset = 0;
+
+    if (NULL == ctx->config.checkpoint_key) {
+        return 0;
+    }
+    if (OPRT_OK != tal_kv_get(ctx->config.checkpoint_key, (uint8_t **)&record, &len)) {
+        return 0;
+    }
+    if (len == sizeof(http_download_checkpoint_t) && record->magic == HTTP_DOWNLOAD_CHECKPOINT_MAGIC &&
+        record->id == http_download_id(ctx) && record->file_size == ctx->file_size &&
+        record->offset <= ctx->file_size) {
+        offset = record->offset;
+    } else {
+        PR_DEBUG("checkpoint of another file, ignored");
+    }
+    tal_kv_free((uint8_t *)record);
+
+    return offset;
+}
+
+/**
+ * @brief save the offset consumed by the event handler, every
+ * HTTP_DOWNLOAD_CHECKPOINT_STEP bytes
+ */
+static void http_download_checkpoint_save(http_download_t *ctx)
+{
+    http_download_checkpoint_t record;
+    size_t offset = ctx->received_size - ctx->remain_len;
+
+    if (NULL == ctx->config.checkpoint_key || offset < ctx->checkpoint + HTTP_DOWNLOAD_CHECKPOINT_STEP) {
+        return;
+    }
+
+    record.magic = HTTP_DOWNLOAD_CHECKPOINT_MAGIC;
+    record.id = http_download_id(ctx);
+    record.file_size = ctx->file_size;
+    record.offset = offset;
+    if (OPRT_OK == tal_kv_set(ctx->config.checkpoint_key, (const uint8_t *)&record, sizeof(record))) {
+        ctx->checkpoint = offset;
+    }
+}
+
+static void http_download_checkpoint_clear(http_download_t *ctx)
+{
+    if (ctx->config.checkpoint_key) {
+        tal_kv_del(ctx->config.checkpoint_key);
+    }
+}
+
+/**
+ * @brief report the file size and pick the offset to start from
+ */
+static int http_download_on_filesize(http_download_t *ctx)
+{
+    ctx->notified = true;
+    ctx->event.file_size = ctx->file_size;
+    ctx->event.offset = http_download_checkpoint_load(ctx);
+    if (ctx->config.event_handler) {
+        ctx->config.event_handler(DL_EVENT_ON_FILESIZE, &ctx->event);
+    }
+    if (ctx->event.offset > ctx->file_size) {
+        ctx->event.offset = 0;
+    }
+    ctx->received_size = ctx->event.offset;
+    ctx->checkpoint = ctx->event.offset;
+    ctx->remain_len = 0;
+    if (ctx->received_size) {
+        PR_INFO("Resume download at %d/%d", (int32_t)ctx->received_size, (int32_t)ctx->file_size);
+    }
+
+    return ctx->event.result;
+}
+
+/*-----------------------------------------------------------*/
+static int http_download_conn_init(http_download_t *ctx, http_download_conn_t *conn)
+{
+    int rt = OPRT_OK;
+
+    /* TLS pre init */
+    TUYA_TRANSPORT_TYPE_E transport_type = (ctx->config.cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
+    conn->network = tuya_transporter_create(transport_type, NULL);
+    TUYA_CHECK_NULL_RETURN(conn->network, OPRT_MALLOC_FAILED);
+    if (transport_type == TRANSPORT_TYPE_TLS) {
+        tuya_tls_config_t tls_config = {
+            .ca_cert = (char *)ctx->config.cacert,
+            .ca_cert_size = ctx->config.cacert_len,
+            .hostname = (char *)ctx->host,
+            .port = ctx->port,
+            .mode = TUYA_TLS_SERVER_CERT_MODE,
+            .verify = true,
+        };
+
+        TUYA_CALL_ERR_RETURN(tuya_transporter_ctrl(conn->network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config));
+    }
+    /* http client TransportInterface */
+    conn->transport.pNetworkContext = &conn->network;
+    conn->transport.send = (TransportSend_t)NetworkTransportSend;
+    conn->transport.recv = (TransportRecv_t)NetworkTransportRecv;
+
+    /* Set the buffer used for storing request headers. */
+    conn->requestHeaders.bufferLen = 512;
+    conn->requestHeaders.pBuffer = tal_malloc(conn->requestHeaders.bufferLen);
+    TUYA_CHECK_NULL_RETURN(conn->requestHeaders.pBuffer, OPRT_MALLOC_FAILED);
+
+    return rt;
+}
+
+static void http_download_conn_close(http_download_conn_t *conn)
+{
+    if (conn->network) {
+        tuya_transporter_close(conn->network);
+    }
+    conn->connected = false;
+}
+
+static void http_download_conn_deinit(http_download_conn_t *conn)
+{
+    if (conn->network) {
+        tuya_transporter_close(conn->network);
+        tuya_transporter_destroy(conn->network);
+        conn->network = NULL;
+    }
+    if (conn->requestHeaders.pBuffer) {
+        tal_free(conn->requestHeaders.pBuffer);
+        conn->requestHeaders.pBuffer = NULL;
+    }
+    http_download_response_free(&conn->response);
+}
+
 /*-----------------------------------------------------------*/
 static int http_file_download_init(http_download_t *ctx, http_download_config_t *config)
 {
     int rt = OPRT_OK;
+    uint8_t i = 0;
 
     if (NULL == ctx || NULL == config || NULL == config->url) {
         return OPRT_INVALID_PARM;
@@ -145,6 +385,9 @@ static int http_file_download_init(http_download_t *ctx, http_download_config_t
     if (config->range_length == 0) {
         ctx->config.range_length = RANGE_REQUEST_LENGTH_DEFAULT;
     }
+    if (ctx->config.connections > HTTP_DOWNLOAD_CONNECTIONS_MAX) {
+        ctx->config.connections = HTTP_DOWNLOAD_CONNECTIONS_MAX;
+    }
     ctx->event.user_data = ctx->config.user_data;
 
     /* url parse to host port path */
@@ -195,61 +438,61 @@ static int http_file_download_init(http_download_t *ctx, http_download_config_t
     requestInfo->pPath = ctx->path;
     requestInfo->pathLen = strlen(ctx->path);
     requestInfo->reqFlags = HTTP_REQUEST_KEEP_ALIVE_FLAG;
-    /* Set the buffer used for storing request headers. */
 
-    HTTPRequestHeaders_t *requestHeaders = &ctx->requestHeaders;
-    requestHeaders->bufferLen = 512;
-    requestHeaders->pBuffer = tal_malloc(requestHeaders->bufferLen);
-    TUYA_CHECK_NULL_RETURN(requestHeaders->pBuffer, OPRT_MALLOC_FAILED);
+    /* one connection per worker */
+    ctx->worker_num = ctx->config.connections ? ctx->config.connections : 1;
+    ctx->workers = tal_calloc(ctx->worker_num, sizeof(http_download_worker_t));
+    TUYA_CHECK_NULL_RETURN(ctx->workers, OPRT_MALLOC_FAILED);
+    for (i = 0; i < ctx->worker_num; i++) {
+        ctx->workers[i].ctx = ctx;
+        TUYA_CALL_ERR_RETURN(http_download_conn_init(ctx, &ctx->workers[i].conn));
+    }
 
     return rt;
 }
 
-int http_file_download(http_download_config_t *config)
+static void http_file_download_deinit(http_download_t *ctx)
 {
-    int rt = OPRT_OK;
-
-    http_download_t *ctx = tal_calloc(1, sizeof(http_download_t));
-    TUYA_CHECK_NULL_GOTO(ctx, __exit);
-    TUYA_CALL_ERR_GOTO(http_file_download_init(ctx, config), __exit);
-    /* TLS pre init */
-    TUYA_TRANSPORT_TYPE_E transport_type = (config->cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
-    NetworkContext_t network;
-    TUYA_CHECK_NULL_GOTO(network = tuya_transporter_create(transport_type, NULL), __exit);
-    if (transport_type == TRANSPORT_TYPE_TLS) {
-        tuya_tls_config_t tls_config = {
-            .ca_cert = (char *)config->cacert,
-            .ca_cert_size = config->cacert_len,
-            .hostname = (char *)ctx->host,
-            .port = ctx->port,
-            .mode = TUYA_TLS_SERVER_CERT_MODE,
-            .verify = true,
-        };
+    uint8_t i = 0;
 
-        TUYA_CALL_ERR_GOTO(tuya_transporter_ctrl(network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config), __exit);
+    if (ctx->workers) {
+        for (i = 0; i < ctx->worker_num; i++) {
+            http_download_conn_deinit(&ctx->workers[i].conn);
+        }
+        tal_free(ctx->workers);
     }
-    /* http client TransportInterface */
-    ctx->transport.pNetworkContext = (NetworkContext_t *)&network;
-    ctx->transport.send = (TransportSend_t)NetworkTransportSend;
-    ctx->transport.recv = (TransportRecv_t)NetworkTransportRecv;
+    if (ctx->host) {
+        tal_free(ctx->host);
+    }
+    if (ctx->path) {
+        tal_free(ctx->path);
+    }
+    if (ctx->buffer) {
+        tal_free(ctx->buffer);
+    }
+}
 
-    ctx->state = DL_STATE_NETWORK_CONNECT;
+/*-----------------------------------------------------------*/
+/**
+ * @brief stream the file over a single range request, reconnecting from the
+ * received size
+ */
+static int http_download_serial(http_download_t *ctx)
+{
+    int rt = OPRT_OK;
+    http_download_conn_t *conn = &ctx->workers[0].conn;
     TIME_T download_time = tal_time_get_posix();
-
     bool is_completed = false;
-
     int32_t read_size = 0;
 
-    if (ctx->config.event_handler) {
-        ctx->config.event_handler(DL_EVENT_START, &ctx->event);
-    }
+    ctx->state = DL_STATE_NETWORK_CONNECT;
 
     do {
 
         switch (ctx->state) {
 
         case DL_STATE_NETWORK_CONNECT:
-            rt = tuya_transporter_connect(network, ctx->host, ctx->port, config->timeout_ms);
+            rt = tuya_transporter_connect(conn->network, ctx->host, ctx->port, ctx->config.timeout_ms);
             if (OPRT_OK == rt) {
                 ctx->state = DL_STATE_FILESIZE_GET;
             } else {
@@ -259,21 +502,23 @@ int http_file_download(http_download_config_t *config)
 
         case DL_STATE_FILESIZE_GET:
             if (0 == ctx->file_size) {
-                rt = http_download_filesize_get(ctx);
+                rt = http_download_filesize_get(ctx, conn);
             }
             if (OPRT_OK != rt) {
                 ctx->state = DL_STATE_NETWORK_RECONNECT;
                 break;
             }
-            if (ctx->config.event_handler) {
-                ctx->event.file_size = ctx->file_size;
-                ctx->config.event_handler(DL_EVENT_ON_FILESIZE, &ctx->event);
+            if (!ctx->notified && OPRT_OK != http_download_on_filesize(ctx)) {
+                return ctx->event.result;
             }
             ctx->state = DL_STATE_RANGE_REQUEST;
+            if (ctx->received_size >= ctx->file_size) {
+                ctx->state = DL_STATE_COMPLETE;
+            }
             break;
 
         case DL_STATE_RANGE_REQUEST:
-            rt = http_download_range_request(ctx, ctx->received_size, ctx->file_size);
+            rt = http_download_range_request(ctx, conn, ctx->received_size, ctx->file_size);
             if (OPRT_OK != rt) {
                 ctx->state = DL_STATE_NETWORK_RECONNECT;
                 break;
@@ -281,7 +526,7 @@ int http_file_download(http_download_config_t *config)
             ctx->state = DL_STATE_DATE_GET;
 
         case DL_STATE_DATE_GET: {
-            read_size = HTTPClient_Recv(&ctx->transport, &ctx->response, ctx->buffer + ctx->remain_len,
+            read_size = HTTPClient_Recv(&conn->transport, &conn->response, ctx->buffer + ctx->remain_len,
                                         ctx->config.range_length - ctx->remain_len);
 
             if (read_size <= 0) {
@@ -295,12 +540,16 @@ int http_file_download(http_download_config_t *config)
                 ctx->event.offset = ctx->received_size - ctx->remain_len;
                 ctx->event.remain_len = ctx->remain_len;
                 ctx->config.event_handler(DL_EVENT_ON_DATA, &ctx->event);
+                if (OPRT_OK != ctx->event.result) {
+                    return ctx->event.result;
+                }
                 if (ctx->event.remain_len) {
                     memmove(ctx->buffer, ctx->buffer + (ctx->event.data_len - ctx->event.remain_len),
                             ctx->event.remain_len);
                 }
                 ctx->remain_len = ctx->event.remain_len;
                 ctx->received_size += read_size;
+                http_download_checkpoint_save(ctx);
             }
             //! reset time
             download_time = tal_time_get_posix();
@@ -312,45 +561,389 @@ int http_file_download(http_download_config_t *config)
         }
 
         case DL_STATE_NETWORK_RECONNECT:
-            tuya_transporter_close(network);
-            tal_system_sleep(3000);
+            tuya_transporter_close(conn->network);
+            tal_system_sleep(HTTP_DOWNLOAD_RETRY_DELAY_MS);
             ctx->state = DL_STATE_NETWORK_CONNECT;
             break;
 
         case DL_STATE_COMPLETE:
-            PR_INFO("Download Complete!");
             is_completed = true;
-            if (ctx->config.event_handler) {
-                ctx->config.event_handler(DL_EVENT_FINISH, &ctx->event);
-            }
             break;
         }
     } while (((tal_time_get_posix() - download_time) < HTTP_DOWNLOAD_TIMEOUT) && !is_completed);
 
-    tuya_transporter_close(network);
-    tuya_transporter_destroy(network);
+    return is_completed ? OPRT_OK : (OPRT_OK != rt ? rt : OPRT_TIMEOUT);
+}
 
-    if (!is_completed) {
-        if (ctx->config.event_handler) {
-            ctx->config.event_handler(DL_EVENT_FAULT, &ctx->event);
+/*-----------------------------------------------------------*/
+/**
+ * @brief fetch one slot on the worker's keep-alive connection, a broken
+ * connection is reopened and the range continues from the received bytes
+ */
+static int http_download_worker_fetch(http_download_worker_t *worker, http_download_slot_t *slot)
+{
+    int rt = OPRT_OK;
+    http_download_t *ctx = worker->ctx;
+    http_download_conn_t *conn = &worker->conn;
+    size_t filled = 0;
+    uint32_t retry = 0;
+    bool requested = false;
+    int32_t read_size = 0;
+
+    while (filled < slot->len) {
+        if (ctx->stop) {
+            return OPRT_COM_ERROR;
+        }
+        if (!conn->connected) {
+            rt = tuya_transporter_connect(conn->network, ctx->host, ctx->port, ctx->config.timeout_ms);
+            conn->connected = (OPRT_OK == rt);
+        }
+        if (OPRT_OK == rt && !requested) {
+            rt = http_download_range_request(ctx, conn, slot->offset + filled, slot->offset + slot->len - 1);
+            if (OPRT_OK == rt && conn->response.statusCode != HTTP_STATUS_CODE_PARTIAL_CONTENT) {
+                PR_ERR("range not supported, status code %u", conn->response.statusCode);
+                rt = OPRT_NOT_SUPPORTED;
+            }
+            requested = (OPRT_OK == rt);
+        }
+        if (OPRT_OK == rt) {
+            read_size = HTTPClient_Recv(&conn->transport, &conn->response, slot->data + filled, slot->len - filled);
+            if (read_size > 0) {
+                filled += read_size;
+                retry = 0;
+                continue;
+            }
+            rt = OPRT_COM_ERROR;
+        }
+
+        http_download_conn_close(conn);
+        requested = false;
+        if (++retry > MAX_RETRY_TIMES) {
+            PR_ERR("range %d-%d failed:%d", (int32_t)slot->offset, (int32_t)(slot->offset + slot->len - 1), rt);
+            return rt;
+        }
+        PR_WARN("range %d-%d error:%d, retry %d", (int32_t)slot->offset, (int32_t)(slot->offset + slot->len - 1), rt,
+                retry);
+        tal_system_sleep(HTTP_DOWNLOAD_RETRY_DELAY_MS);
+        rt = OPRT_OK;
+    }
+
+    return OPRT_OK;
+}
+
+static void http_download_worker_task(void *arg)
+{
+    int rt = OPRT_OK;
+    http_download_worker_t *worker = (http_download_worker_t *)arg;
+    http_download_t *ctx = worker->ctx;
+    THREAD_HANDLE thread = worker->thread;
+    http_download_slot_t *slot = NULL;
+    uint8_t i = 0;
+
+    for (;;) {
+        tal_semaphore_wait_forever(ctx->slot_free);
+
+        /* take the next range into a free slot */
+        slot = NULL;
+        tal_mutex_lock(ctx->mutex);
+        if (!ctx->stop && ctx->next_offset < ctx->file_size) {
+            for (i = 0; i < ctx->slot_num; i++) {
+                if (DL_SLOT_FREE == ctx->slots[i].state) {
+                    slot = &ctx->slots[i];
+                    slot->state = DL_SLOT_BUSY;
+                    slot->offset = ctx->next_offset;
+                    slot->len = ctx->file_size - ctx->next_offset;
+                    if (slot->len > ctx->config.range_length) {
+                        slot->len = ctx->config.range_length;
+                    }
+                    ctx->next_offset += slot->len;
+                    break;
+                }
+            }
+        }
+        tal_mutex_unlock(ctx->mutex);
+        if (NULL == slot) {
+            break;
+        }
+
+        rt = http_download_worker_fetch(worker, slot);
+
+        tal_mutex_lock(ctx->mutex);
+        if (OPRT_OK == rt) {
+            slot->state = DL_SLOT_READY;
+        } else if (!ctx->stop) {
+            ctx->stop = true;
+            ctx->result = rt;
+        }
+        tal_mutex_unlock(ctx->mutex);
+        tal_semaphore_post(ctx->slot_ready);
+        if (OPRT_OK != rt) {
+            break;
+        }
+    }
+
+    /* pass the wakeup on to the next idle worker */
+    tal_semaphore_post(ctx->slot_free);
+    http_download_conn_close(&worker->conn);
+    tal_semaphore_post(ctx->worker_done);
+    tal_thread_delete(thread);
+}
+
+/**
+ * @brief hand a fetched range to the event handler, the bytes it leaves in
+ * remain_len are carried in ctx->buffer in front of the next ones
+ */
+static int http_download_deliver(http_download_t *ctx, uint8_t *data, size_t len)
+{
+    size_t n = 0;
+
+    if (NULL == ctx->config.event_handler) {
+        ctx->received_size += len;
+        return OPRT_OK;
+    }
+
+    while (len) {
+        if (0 == ctx->remain_len) {
+            n = len;
+            ctx->event.data = data;
+        } else {
+            if (ctx->remain_len >= ctx->config.range_length) {
+                PR_ERR("nothing consumed of %d bytes", (int32_t)ctx->remain_len);
+                return OPRT_COM_ERROR;
+            }
+            n = ctx->config.range_length - ctx->remain_len;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(ctx->buffer + ctx->remain_len, data, n);
+            ctx->event.data = ctx->buffer;
+        }
+        ctx->event.data_len = ctx->remain_len + n;
+        ctx->event.offset = ctx->received_size - ctx->remain_len;
+        ctx->event.remain_len = ctx->remain_len;
+        ctx->config.event_handler(DL_EVENT_ON_DATA, &ctx->event);
+        if (OPRT_OK != ctx->event.result) {
+            return ctx->event.result;
+        }
+        if (ctx->event.remain_len) {
+            memmove(ctx->buffer, (uint8_t *)ctx->event.data + (ctx->event.data_len - ctx->event.remain_len),
+                    ctx->event.remain_len);
+        }
+        ctx->remain_len = ctx->event.remain_len;
+        ctx->received_size += n;
+        data += n;
+        len -= n;
+        http_download_checkpoint_save(ctx);
+    }
+
+    return OPRT_OK;
+}
+
+static http_download_slot_t *http_download_slot_ready(http_download_t *ctx, size_t offset)
+{
+    http_download_slot_t *slot = NULL;
+    uint8_t i = 0;
+
+    tal_mutex_lock(ctx->mutex);
+    for (i = 0; i < ctx->slot_num; i++) {
+        if (DL_SLOT_READY == ctx->slots[i].state && offset == ctx->slots[i].offset) {
+            slot = &ctx->slots[i];
+            break;
+        }
+    }
+    tal_mutex_unlock(ctx->mutex);
+
+    return slot;
+}
+
+/**
+ * @brief get the file size on the first connection, which the first worker
+ * then keeps using
+ */
+static int http_download_parallel_filesize_get(http_download_t *ctx)
+{
+    int rt = OPRT_OK;
+    http_download_conn_t *conn = &ctx->workers[0].conn;
+    uint32_t retry = 0;
+
+    while (0 == ctx->file_size) {
+        if (retry++) {
+            if (retry > MAX_RETRY_TIMES) {
+                return rt;
+            }
+            tal_system_sleep(HTTP_DOWNLOAD_RETRY_DELAY_MS);
+        }
+        rt = tuya_transporter_connect(conn->network, ctx->host, ctx->port, ctx->config.timeout_ms);
+        if (OPRT_OK == rt) {
+            conn->connected = true;
+            rt = http_download_filesize_get(ctx, conn);
+        }
+        if (OPRT_OK != rt) {
+            http_download_conn_close(conn);
+        }
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief download ranges on config.connections workers into connections + 1
+ * slots, so the event handler writes one range while the next ones are on
+ * the wire
+ */
+static int http_download_parallel(http_download_t *ctx)
+{
+    int rt = OPRT_OK;
+    http_download_slot_t *slot = NULL;
+    uint8_t started = 0;
+    uint8_t i = 0;
+    TIME_T download_time = 0;
+
+    TUYA_CALL_ERR_RETURN(http_download_parallel_filesize_get(ctx));
+    TUYA_CALL_ERR_RETURN(http_download_on_filesize(ctx));
+    if (ctx->received_size >= ctx->file_size) {
+        return OPRT_OK;
+    }
+
+    ctx->slot_num = ctx->worker_num + 1;
+    ctx->slots = tal_calloc(ctx->slot_num, sizeof(http_download_slot_t));
+    if (NULL == ctx->slots) {
+        rt = OPRT_MALLOC_FAILED;
+        goto __exit;
+    }
+    for (i = 0; i < ctx->slot_num; i++) {
+        ctx->slots[i].data = tal_malloc(ctx->config.range_length);
+        if (NULL == ctx->slots[i].data) {
+            rt = OPRT_MALLOC_FAILED;
+            goto __exit;
+        }
+    }
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ctx->mutex), __exit);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ctx->slot_free, ctx->slot_num, ctx->slot_num + ctx->worker_num),
+                       __exit);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ctx->slot_ready, 0, ctx->slot_num + ctx->worker_num), __exit);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ctx->worker_done, 0, ctx->worker_num), __exit);
+
+    ctx->next_offset = ctx->received_size;
+    for (i = 0; i < ctx->worker_num; i++) {
+        THREAD_CFG_T thrd_param = {0};
+        thrd_param.priority = THREAD_PRIO_3;
+        thrd_param.stackDepth = HTTP_DOWNLOAD_WORKER_STACK_SIZE;
+        thrd_param.thrdname = "http_dl";
+        if (OPRT_OK != tal_thread_create_and_start(&ctx->workers[i].thread, NULL, NULL, http_download_worker_task,
+                                                   &ctx->workers[i], &thrd_param)) {
+            break;
+        }
+        started++;
+    }
+    if (0 == started) {
+        rt = OPRT_OS_ADAPTER_THRD_CREAT_FAILED;
+        goto __exit;
+    }
+    PR_DEBUG("download on %d connections", started);
+
+    download_time = tal_time_get_posix();
+    while (ctx->received_size < ctx->file_size) {
+        tal_semaphore_wait(ctx->slot_ready, 1000);
+        if (ctx->stop) {
+            rt = ctx->result;
+            break;
+        }
+        /* deliver in file order, later ranges wait in their slots */
+        while (NULL != (slot = http_download_slot_ready(ctx, ctx->received_size))) {
+            rt = http_download_deliver(ctx, slot->data, slot->len);
+            tal_mutex_lock(ctx->mutex);
+            slot->state = DL_SLOT_FREE;
+            tal_mutex_unlock(ctx->mutex);
+            tal_semaphore_post(ctx->slot_free);
+            download_time = tal_time_get_posix();
+            if (OPRT_OK != rt) {
+                break;
+            }
+        }
+        if (OPRT_OK != rt) {
+            break;
+        }
+        if ((tal_time_get_posix() - download_time) >= HTTP_DOWNLOAD_TIMEOUT) {
+            rt = OPRT_TIMEOUT;
+            break;
         }
     }
 
 __exit:
-    if (ctx) {
-        if (ctx->host) {
-            tal_free(ctx->host);
+    if (started) {
+        tal_mutex_lock(ctx->mutex);
+        ctx->stop = true;
+        tal_mutex_unlock(ctx->mutex);
+        tal_semaphore_post(ctx->slot_free);
+        for (i = 0; i < started; i++) {
+            tal_semaphore_wait_forever(ctx->worker_done);
         }
-        if (ctx->path) {
-            tal_free(ctx->path);
+    }
+    if (ctx->worker_done) {
+        tal_semaphore_release(ctx->worker_done);
+    }
+    if (ctx->slot_ready) {
+        tal_semaphore_release(ctx->slot_ready);
+    }
+    if (ctx->slot_free) {
+        tal_semaphore_release(ctx->slot_free);
+    }
+    if (ctx->mutex) {
+        tal_mutex_release(ctx->mutex);
+    }
+    if (ctx->slots) {
+        for (i = 0; i < ctx->slot_num; i++) {
+            if (ctx->slots[i].data) {
+                tal_free(ctx->slots[i].data);
+            }
+        }
+        tal_free(ctx->slots);
+        ctx->slots = NULL;
+    }
+
+    return rt;
+}
+
+/*-----------------------------------------------------------*/
+int http_file_download(http_download_config_t *config)
+{
+    int rt = OPRT_OK;
+
+    http_download_t *ctx = tal_calloc(1, sizeof(http_download_t));
+    TUYA_CHECK_NULL_GOTO(ctx, __exit);
+    TUYA_CALL_ERR_GOTO(http_file_download_init(ctx, config), __exit);
+
+    if (ctx->config.event_handler) {
+        ctx->config.event_handler(DL_EVENT_START, &ctx->event);
+    }
+
+    if (ctx->config.connections) {
+        rt = http_download_parallel(ctx);
+    } else {
+        rt = http_download_serial(ctx);
+    }
+
+    if (OPRT_OK == rt) {
+        PR_INFO("Download Complete!");
+        http_download_checkpoint_clear(ctx);
+        if (ctx->config.event_handler) {
+            ctx->config.event_handler(DL_EVENT_FINISH, &ctx->event);
         }
-        if (ctx->requestHeaders.pBuffer) {
-            tal_free(ctx->requestHeaders.pBuffer);
+    } else {
+        PR_ERR("Download fault:%d, %d/%d", rt, (int32_t)(ctx->received_size - ctx->remain_len),
+               (int32_t)ctx->file_size);
+        if (OPRT_OK != ctx->event.result) {
+            http_download_checkpoint_clear(ctx);
         }
-        if (ctx->response.pBuffer) {
-            tal_free(ctx->response.pBuffer);
+        if (ctx->config.event_handler) {
+            ctx->config.event_handler(DL_EVENT_FAULT, &ctx->event);
         }
+    }
 
+__exit:
+    if (ctx) {
+        http_file_download_deinit(ctx);
         tal_free(ctx);
     }
 
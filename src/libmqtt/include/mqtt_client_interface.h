@@ -73,6 +73,18 @@ mqtt_client_status_t mqtt_client_disconnect(void *client);
 
 mqtt_client_status_t mqtt_client_yield(void *client);
 
+/* Processes the packets that are readable now and the keep alive, without the
+ * blocking receive window of mqtt_client_yield(). A packet that started
+ * arriving may take up to window_ms to complete. */
+mqtt_client_status_t mqtt_client_yield_nowait(void *client, uint32_t window_ms);
+
+/* Milliseconds until the keep alive needs mqtt_client_yield_nowait(), 0 if due,
+ * UINT32_MAX if disabled. */
+uint32_t mqtt_client_keepalive_remaining(void *client);
+
+/* Socket of the connection, -1 if not connected. */
+int mqtt_client_socket_get(void *client);
+
 uint16_t mqtt_client_subscribe(void *client, const char *topic, uint8_t qos);
 
 uint16_t mqtt_client_unsubscribe(void *client, const char *topic, uint8_t qos);
@@ -13,10 +13,16 @@
 #define log_debug PR_DEBUG
 #define log_error PR_ERR
 
+/* network_read result that ends MQTT_ProcessLoop once nothing is readable */
+#define MQTT_NOWAIT_IDLE (-1)
+
 typedef struct {
     mqtt_client_config_t config;
     MQTTContext_t mqclient;
     tuya_transporter_t network;
+    uint32_t read_timeout; // per read limit of mqtt_client_yield_nowait, 0 for the TLS timeout
+    uint8_t header_len;    // fixed header bytes read of the incoming packet, 0 between packets
+    uint8_t idle;          // reads that found no packet in this mqtt_client_yield_nowait
     uint8_t mqttbuffer[CORE_MQTT_BUFFER_SIZE];
 } mqtt_client_context_t;
 
@@ -101,12 +107,27 @@ static int network_write(NetworkContext_t *pNetwork, const unsigned char *pMsg,
 static int network_read(NetworkContext_t *pNetwork, unsigned char *pMsg, size_t len)
 {
     tuya_transporter_t transporter = *pNetwork;
+    mqtt_client_context_t *context =
+        (mqtt_client_context_t *)((uint8_t *)pNetwork - offsetof(mqtt_client_context_t, network));
 
     tuya_tls_config_t *tls_config = NULL;
 
     tuya_transporter_ctrl(transporter, TUYA_TRANSPORTER_GET_TLS_CONFIG, &tls_config);
 
     int timeout = tls_config ? tls_config->timeout : 5000;
+    if (context->read_timeout) {
+        timeout = context->read_timeout;
+    }
+
+    /* the fixed header is read a byte at a time outside the packet buffer */
+    bool header = (pMsg < context->mqttbuffer || pMsg >= context->mqttbuffer + sizeof(context->mqttbuffer));
+
+    /* no packet started and nothing readable: do not wait in the nowait yield. The
+     * first time reports no data so the keep alive runs, then the loop is ended. */
+    if (context->read_timeout && header && 0 == context->header_len &&
+        0 == tuya_transporter_poll_read(transporter, 0)) {
+        return (0 == context->idle++) ? 0 : MQTT_NOWAIT_IDLE;
+    }
 
     int result = tuya_transporter_read(transporter, (uint8_t *)pMsg, len, timeout);
 
@@ -114,6 +135,14 @@ static int network_read(NetworkContext_t *pNetwork, unsigned char *pMsg, size_t
         return 0;
     }
 
+    /* type byte, then remaining length bytes until one without the continuation bit */
+    if (header && result == 1) {
+        if (0 == context->header_len++ || (pMsg[0] & 0x80)) {
+            return result;
+        }
+        context->header_len = 0;
+    }
+
     return result;
 }
 static uint32_t __mqtt_client_get_current_time(void)
@@ -249,6 +278,71 @@ mqtt_client_status_t mqtt_client_disconnect(void *client)
     return MQTT_STATUS_SUCCESS;
 }
 
+mqtt_client_status_t mqtt_client_yield_nowait(void *client, uint32_t window_ms)
+{
+    mqtt_client_context_t *context = (mqtt_client_context_t *)client;
+    MQTTStatus_t mqtt_status;
+
+    /* nothing to read and no PINGREQ due: do not enter the receive loop */
+    if (0 == tuya_transporter_poll_read(context->network, 0) && mqtt_client_keepalive_remaining(client) > 0) {
+        return MQTT_STATUS_SUCCESS;
+    }
+
+    /* drain what arrived and leave as soon as nothing is readable, reads of a
+     * started packet give up after the window instead of the TLS timeout */
+    context->read_timeout = window_ms;
+    context->header_len = 0;
+    context->idle = 0;
+    mqtt_status = MQTT_ProcessLoop(&context->mqclient, window_ms);
+    context->read_timeout = 0;
+    if (mqtt_status == MQTTRecvFailed && context->idle > 1) {
+        mqtt_status = MQTTSuccess;
+    }
+    if (mqtt_status != MQTTSuccess) {
+        log_error("MQTT_ProcessLoop returned with status = %s.", MQTT_Status_strerror(mqtt_status));
+        mqtt_client_disconnect(context);
+        return MQTT_STATUS_NETWORK_TIMEOUT;
+    }
+    return MQTT_STATUS_SUCCESS;
+}
+
+uint32_t mqtt_client_keepalive_remaining(void *client)
+{
+    mqtt_client_context_t *context = (mqtt_client_context_t *)client;
+    MQTTContext_t *mqclient = &context->mqclient;
+    uint32_t keepalive_ms = 1000U * (uint32_t)mqclient->keepAliveIntervalSec;
+    uint32_t now = __mqtt_client_get_current_time();
+    uint32_t elapsed = 0;
+
+    if (0 == keepalive_ms) {
+        return UINT32_MAX;
+    }
+
+    /* same conditions as the keep alive handling of MQTT_ProcessLoop */
+    elapsed = now - mqclient->lastPacketTime;
+    if (elapsed <= keepalive_ms) {
+        return keepalive_ms - elapsed + 1;
+    }
+    if (mqclient->waitingForPingResp) {
+        elapsed = now - mqclient->pingReqSendTimeMs;
+        if (elapsed <= MQTT_PINGRESP_TIMEOUT_MS) {
+            return MQTT_PINGRESP_TIMEOUT_MS - elapsed + 1;
+        }
+    }
+    return 0;
+}
+
+int mqtt_client_socket_get(void *client)
+{
+    mqtt_client_context_t *context = (mqtt_client_context_t *)client;
+    int fd = -1;
+
+    if (OPRT_OK != tuya_transporter_ctrl(context->network, TUYA_TRANSPORTER_GET_TCP_SOCKET, &fd)) {
+        return -1;
+    }
+    return fd;
+}
+
 uint16_t mqtt_client_subscribe(void *client, const char *topic, uint8_t qos)
 {
     mqtt_client_context_t *context = (mqtt_client_context_t *)client;
@@ -60,6 +60,17 @@ typedef struct {
     char key[TAL_LV_KEY_LEN + 1];
 } tal_kv_cfg_t;
 
+typedef struct {
+    uint32_t get;           // tal_kv_get calls
+    uint32_t get_hit;       // served from the cache
+    uint32_t set;           // tal_kv_set calls
+    uint32_t set_coalesced; // sets that replaced a value not yet on flash
+    uint32_t file_write;    // value files written to flash
+    uint32_t file_read;     // value files read from flash
+    uint32_t evict;         // values dropped from the cache
+    uint32_t txn_commit;    // committed transactions
+} tal_kv_stat_t;
+
 /**
  * @brief Initializes the TAL Key-Value (KV) module.
  *
@@ -71,6 +82,19 @@ typedef struct {
  */
 int tal_kv_init(tal_kv_cfg_t *kv_cfg);
 
+/**
+ * @brief Initializes the TAL Key-Value (KV) module on a given block device.
+ *
+ * This function mounts the store on the block device described by lfs_cfg
+ * instead of the UF flash partition, e.g. lfs_rambd or lfs_filebd on a host.
+ *
+ * @param kv_cfg A pointer to the TAL KV configuration structure.
+ * @param lfs_cfg The littlefs configuration, it must stay valid while mounted.
+ * @return An integer value indicating the status of the initialization process.
+ *         Returns 0 on success, and a negative value on failure.
+ */
+int tal_kv_init_lfs(tal_kv_cfg_t *kv_cfg, const struct lfs_config *lfs_cfg);
+
 /**
  * @brief Sets the value of a key in the TAL Key-Value store.
  *
@@ -114,6 +138,62 @@ int tal_kv_get(const char *key, uint8_t **value, size_t *length);
  */
 int tal_kv_free(uint8_t *value);
 
+/**
+ * @brief Writes every cached value that is not on flash yet.
+ *
+ * With a write-back window set, values set are kept in RAM for up to the
+ * window before they are written. Call this when a value must survive a
+ * power cut or a reset right away.
+ *
+ * @return 0 if all values were written, or a negative error code if an error
+ * occurred.
+ */
+int tal_kv_sync(void);
+
+/**
+ * @brief Opens a transaction on the key-value store.
+ *
+ * Until the matching tal_kv_txn_commit, values set are only kept in RAM.
+ * Transactions are store wide: sets from other threads join the open
+ * transaction, and nested begin/commit pairs commit with the outermost one.
+ * tal_kv_del is not part of a transaction and takes effect at once.
+ *
+ * @return 0 on success, or a negative error code if an error occurred.
+ */
+int tal_kv_txn_begin(void);
+
+/**
+ * @brief Commits the values set since tal_kv_txn_begin.
+ *
+ * The values are written as one journal file first, so after a power cut
+ * either all of them or none of them are found by the next tal_kv_init.
+ *
+ * @return 0 if the values were committed, or a negative error code if an
+ * error occurred.
+ */
+int tal_kv_txn_commit(void);
+
+/**
+ * @brief Sets the write-back window of the key-value store.
+ *
+ * The window is 0 by default, so every set is written through. A caller
+ * that opens it must tal_kv_sync before a reset, or the values set in the
+ * last window are lost.
+ *
+ * @param delay_ms Time a set value may stay in RAM before it is written, 0
+ * writes every set through to flash. Pending values are flushed first.
+ * @return 0 on success, or a negative error code if an error occurred.
+ */
+int tal_kv_flush_delay_set(uint32_t delay_ms);
+
+/**
+ * @brief Gets the cache and flash statistics of the key-value store.
+ *
+ * @param stat The statistics, counted since boot.
+ * @return 0 on success, or a negative error code if an error occurred.
+ */
+int tal_kv_stat_get(tal_kv_stat_t *stat);
+
 /**
  * @brief Deletes the specified key from the TAL Key-Value store.
  *
@@ -16,6 +16,10 @@
  * layer (HAL) for flash operations. This ensures compatibility and optimal
  * performance across different Tuya devices and platforms.
  *
+ * Decrypted values are kept in a small LRU cache. Sets are written back after
+ * a short window so repeated sets of one key cost one flash write, and
+ * transactions commit many keys through a single journal file.
+ *
  * @note This file is part of the Tuya SDK and is intended for use in Tuya-based
  * applications. It requires the LittleFS library and Tuya's hardware
  * abstraction libraries for proper functionality.
@@ -30,15 +34,463 @@
 #include "tal_api.h"
 #include "tal_security.h"
 
+#ifndef KV_CACHE_NUM
+#define KV_CACHE_NUM 32 // values kept decrypted in RAM
+#endif
+
+#ifndef KV_CACHE_VALUE_MAX
+#define KV_CACHE_VALUE_MAX 1024 // larger values are written through and not cached
+#endif
+
+#ifndef KV_FLUSH_DELAY_MS
+#define KV_FLUSH_DELAY_MS 0 // write-back window, 0 writes every set through
+#endif
+
+#ifndef KV_CRYPT_BUF_KEEP
+#define KV_CRYPT_BUF_KEEP 2048 // crypt buffer kept between calls, bigger values use a temporary one
+#endif
+
+#define KV_TXN_FILE ".kv_txn"
+
+// a value cached in RAM, the list is kept in LRU order with the most recent first
+typedef struct {
+    LIST_HEAD node;
+    uint32_t hash;
+    char *key;
+    uint8_t *value;
+    size_t len;
+    uint8_t dirty; // newer than the copy on flash
+} kv_cache_t;
+
 // variables used by the filesystem
 static lfs_t lfs;
 static lfs_size_t lfs_flash_addr;
 static tal_kv_cfg_t lfs_kv_cfg;
 static MUTEX_HANDLE lfs_mutex;
 
+// variables used by the cache, protected by lfs_mutex
+static LIST_HEAD(kv_cache_lru);
+static uint16_t kv_cache_cnt;
+static uint16_t kv_dirty_cnt;
+static uint8_t kv_txn_depth;
+static uint32_t kv_flush_delay_ms = KV_FLUSH_DELAY_MS;
+static DELAYED_WORK_HANDLE kv_flush_work;
+static BOOL_T kv_flush_pending;
+static uint8_t *kv_crypt_buf;
+static uint32_t kv_crypt_buf_len;
+static tal_kv_stat_t kv_stat;
+
 extern int kv_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len);
 extern int kv_deserialize(const char *in, kv_db_t *db, const uint32_t dbcnt);
 
+static uint32_t __kv_hash(const char *key)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*key) {
+        hash = (hash ^ (uint8_t)*key++) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint8_t *__kv_crypt_buf_get(uint32_t len)
+{
+    uint8_t *buf = NULL;
+
+    if (len > KV_CRYPT_BUF_KEEP) {
+        return tal_malloc(len);
+    }
+
+    if (len > kv_crypt_buf_len) {
+        buf = tal_malloc(KV_CRYPT_BUF_KEEP);
+        if (NULL == buf) {
+            return NULL;
+        }
+        if (kv_crypt_buf) {
+            tal_free(kv_crypt_buf);
+        }
+        kv_crypt_buf = buf;
+        kv_crypt_buf_len = KV_CRYPT_BUF_KEEP;
+    }
+
+    return kv_crypt_buf;
+}
+
+static void __kv_crypt_buf_put(uint8_t *buf)
+{
+    if (buf && buf != kv_crypt_buf) {
+        tal_free(buf);
+    }
+}
+
+static int __kv_file_write(const char *key, const uint8_t *value, size_t length)
+{
+    int result;
+    int close_result;
+    lfs_file_t file;
+    uint8_t *ec_data = NULL;
+    uint32_t ec_len = 0;
+    uint8_t iv[16];
+
+    ec_data = __kv_crypt_buf_get(length + 16);
+    if (NULL == ec_data) {
+        return OPRT_MALLOC_FAILED;
+    }
+
+    memcpy(ec_data, value, length);
+    ec_len = tal_pkcs7padding_buffer(ec_data, length);
+    memcpy(iv, lfs_kv_cfg.seed, 16);
+    result = tal_aes128_cbc_encode_raw(ec_data, ec_len, (uint8_t *)lfs_kv_cfg.key, iv, ec_data);
+    if (OPRT_OK != result) {
+        __kv_crypt_buf_put(ec_data);
+        PR_DEBUG("key %s encrypt failed", key);
+        return result;
+    }
+
+    result = lfs_file_open(&lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
+    if (LFS_ERR_OK != result) {
+        __kv_crypt_buf_put(ec_data);
+        PR_ERR("lfs open %s err", key);
+        return result;
+    }
+    result = lfs_file_write(&lfs, &file, ec_data, ec_len);
+    close_result = lfs_file_close(&lfs, &file);
+    __kv_crypt_buf_put(ec_data);
+    kv_stat.file_write++;
+    if (result != ec_len || LFS_ERR_OK != close_result) {
+        PR_ERR("kv write fail %d %d", result, close_result);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    return OPRT_OK;
+}
+
+static int __kv_file_read(const char *key, uint8_t **value, size_t *length)
+{
+    int result;
+    lfs_file_t file;
+    uint8_t *ec_data = NULL;
+    uint32_t ec_len = 0;
+    int32_t dec_len = 0;
+    uint8_t iv[16];
+
+    result = lfs_file_open(&lfs, &file, key, LFS_O_RDONLY);
+    if (LFS_ERR_OK != result) {
+        PR_ERR("lfs open %s %d err", key, result);
+        return result;
+    }
+    ec_len = lfs_file_size(&lfs, &file);
+
+    ec_data = __kv_crypt_buf_get(ec_len);
+    if (NULL == ec_data) {
+        lfs_file_close(&lfs, &file);
+        return OPRT_MALLOC_FAILED;
+    }
+    PR_DEBUG("key:%s, len:%d", key, ec_len);
+    result = lfs_file_read(&lfs, &file, ec_data, ec_len);
+    lfs_file_close(&lfs, &file);
+    kv_stat.file_read++;
+    if (result <= 0) {
+        __kv_crypt_buf_put(ec_data);
+        PR_ERR("kv read error %d", result);
+        return OPRT_KVS_RD_FAIL;
+    }
+
+    memcpy(iv, lfs_kv_cfg.seed, 16);
+    result = tal_aes128_cbc_decode_raw(ec_data, ec_len, (uint8_t *)lfs_kv_cfg.key, iv, ec_data);
+    dec_len = tal_aes_get_actual_length(ec_data, ec_len);
+    if (OPRT_OK != result || dec_len < 0 || dec_len > ec_len) {
+        __kv_crypt_buf_put(ec_data);
+        PR_ERR("key %s decrypt failed %d, %d-%d", key, result, dec_len, ec_len);
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+
+    *value = tal_malloc(dec_len + 1);
+    if (NULL == *value) {
+        __kv_crypt_buf_put(ec_data);
+        return OPRT_MALLOC_FAILED;
+    }
+    memcpy(*value, ec_data, dec_len);
+    (*value)[dec_len] = 0;
+    *length = (size_t)dec_len;
+    __kv_crypt_buf_put(ec_data);
+
+    return OPRT_OK;
+}
+
+static kv_cache_t *__kv_cache_find(const char *key)
+{
+    struct tuya_list_head *p = NULL;
+    kv_cache_t *entry = NULL;
+    uint32_t hash = __kv_hash(key);
+
+    tuya_list_for_each(p, &kv_cache_lru)
+    {
+        entry = tuya_list_entry(p, kv_cache_t, node);
+        if (entry->hash == hash && 0 == strcmp(entry->key, key)) {
+            // move to the front, the tail is evicted first
+            tuya_list_del(&entry->node);
+            tuya_list_add(&entry->node, &kv_cache_lru);
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void __kv_cache_drop(kv_cache_t *entry)
+{
+    tuya_list_del(&entry->node);
+    if (entry->dirty) {
+        kv_dirty_cnt--;
+    }
+    kv_cache_cnt--;
+    tal_free(entry->value);
+    tal_free(entry->key);
+    tal_free(entry);
+}
+
+static int __kv_cache_flush_entry(kv_cache_t *entry)
+{
+    int result = OPRT_OK;
+
+    if (entry->dirty) {
+        result = __kv_file_write(entry->key, entry->value, entry->len);
+        if (OPRT_OK == result) {
+            entry->dirty = 0;
+            kv_dirty_cnt--;
+        }
+    }
+
+    return result;
+}
+
+// keep the cache within KV_CACHE_NUM, clean values go first, a dirty one is written out before it goes.
+// Inside a transaction dirty values must stay in RAM until the commit, so the cache may grow instead
+static void __kv_cache_shrink(void)
+{
+    struct tuya_list_head *p = NULL;
+    kv_cache_t *entry = NULL;
+    kv_cache_t *victim = NULL;
+
+    while (kv_cache_cnt > KV_CACHE_NUM) {
+        victim = NULL;
+        for (p = kv_cache_lru.prev; p != &kv_cache_lru; p = p->prev) {
+            entry = tuya_list_entry(p, kv_cache_t, node);
+            if (!entry->dirty) {
+                victim = entry;
+                break;
+            }
+        }
+
+        if (NULL == victim) {
+            if (kv_txn_depth) {
+                return;
+            }
+            victim = tuya_list_entry(kv_cache_lru.prev, kv_cache_t, node);
+            if (OPRT_OK != __kv_cache_flush_entry(victim)) {
+                return;
+            }
+        }
+
+        kv_stat.evict++;
+        __kv_cache_drop(victim);
+    }
+}
+
+static int __kv_cache_put(const char *key, const uint8_t *value, size_t length, BOOL_T dirty)
+{
+    kv_cache_t *entry = __kv_cache_find(key);
+    uint8_t *copy = NULL;
+
+    copy = tal_malloc(length + 1);
+    if (NULL == copy) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memcpy(copy, value, length);
+    copy[length] = 0;
+
+    if (NULL == entry) {
+        entry = (kv_cache_t *)tal_calloc(1, sizeof(kv_cache_t));
+        if (NULL == entry) {
+            tal_free(copy);
+            return OPRT_MALLOC_FAILED;
+        }
+        entry->key = tal_malloc(strlen(key) + 1);
+        if (NULL == entry->key) {
+            tal_free(entry);
+            tal_free(copy);
+            return OPRT_MALLOC_FAILED;
+        }
+        strcpy(entry->key, key);
+        entry->hash = __kv_hash(key);
+        tuya_list_add(&entry->node, &kv_cache_lru);
+        kv_cache_cnt++;
+    } else {
+        if (entry->dirty && dirty) {
+            kv_stat.set_coalesced++;
+        }
+        tal_free(entry->value);
+    }
+
+    entry->value = copy;
+    entry->len = length;
+    if (dirty && !entry->dirty) {
+        kv_dirty_cnt++;
+    }
+    entry->dirty = entry->dirty || dirty;
+
+    __kv_cache_shrink();
+
+    return OPRT_OK;
+}
+
+// write every dirty value, in least recently used order
+static int __kv_cache_flush(void)
+{
+    struct tuya_list_head *p = NULL;
+    struct tuya_list_head *n = NULL;
+    int result = OPRT_OK;
+
+    for (p = kv_cache_lru.prev, n = p->prev; p != &kv_cache_lru && kv_dirty_cnt; p = n, n = p->prev) {
+        if (OPRT_OK != __kv_cache_flush_entry(tuya_list_entry(p, kv_cache_t, node))) {
+            result = OPRT_KVS_WR_FAIL;
+        }
+    }
+
+    return result;
+}
+
+// journal record: key length (1 byte), key, value length (4 bytes, little endian), value
+static uint32_t __kv_txn_record_len(kv_cache_t *entry)
+{
+    return 1 + strlen(entry->key) + 4 + entry->len;
+}
+
+// write all dirty values into one journal file, so a power cut leaves either none or all of them
+static int __kv_txn_journal_write(void)
+{
+    struct tuya_list_head *p = NULL;
+    kv_cache_t *entry = NULL;
+    uint8_t *buf = NULL;
+    uint32_t total = 0;
+    uint32_t off = 0;
+    uint8_t key_len = 0;
+    int result;
+
+    tuya_list_for_each(p, &kv_cache_lru)
+    {
+        entry = tuya_list_entry(p, kv_cache_t, node);
+        if (entry->dirty) {
+            total += __kv_txn_record_len(entry);
+        }
+    }
+
+    buf = tal_malloc(total);
+    if (NULL == buf) {
+        return OPRT_MALLOC_FAILED;
+    }
+
+    tuya_list_for_each(p, &kv_cache_lru)
+    {
+        entry = tuya_list_entry(p, kv_cache_t, node);
+        if (!entry->dirty) {
+            continue;
+        }
+        key_len = (uint8_t)strlen(entry->key);
+        buf[off++] = key_len;
+        memcpy(buf + off, entry->key, key_len);
+        off += key_len;
+        buf[off++] = (uint8_t)(entry->len);
+        buf[off++] = (uint8_t)(entry->len >> 8);
+        buf[off++] = (uint8_t)(entry->len >> 16);
+        buf[off++] = (uint8_t)(entry->len >> 24);
+        memcpy(buf + off, entry->value, entry->len);
+        off += entry->len;
+    }
+
+    result = __kv_file_write(KV_TXN_FILE, buf, total);
+    tal_free(buf);
+
+    return result;
+}
+
+// apply a journal left by a commit that did not finish
+static void __kv_txn_journal_replay(void)
+{
+    struct lfs_info info;
+    uint8_t *buf = NULL;
+    size_t total = 0;
+    size_t off = 0;
+    uint32_t len = 0;
+    char key[LFS_NAME_MAX + 1];
+    uint8_t key_len = 0;
+
+    if (lfs_stat(&lfs, KV_TXN_FILE, &info) < 0) {
+        return;
+    }
+
+    if (OPRT_OK == __kv_file_read(KV_TXN_FILE, &buf, &total)) {
+        PR_NOTICE("kv replay journal %d", total);
+        while (off + 1 <= total) {
+            key_len = buf[off++];
+            if (off + key_len + 4 > total) {
+                break;
+            }
+            memcpy(key, buf + off, key_len);
+            key[key_len] = 0;
+            off += key_len;
+            len = buf[off] | (buf[off + 1] << 8) | (buf[off + 2] << 16) | ((uint32_t)buf[off + 3] << 24);
+            off += 4;
+            if (off + len > total) {
+                break;
+            }
+            __kv_file_write(key, buf + off, len);
+            off += len;
+        }
+        tal_free(buf);
+    }
+
+    lfs_remove(&lfs, KV_TXN_FILE);
+}
+
+static void __kv_flush_work_cb(void *data)
+{
+    tal_mutex_lock(lfs_mutex);
+    kv_flush_pending = FALSE;
+    if (0 == kv_txn_depth) {
+        __kv_cache_flush();
+    }
+    tal_mutex_unlock(lfs_mutex);
+}
+
+// open the write-back window if it is not open yet, FALSE when it cannot be scheduled
+static BOOL_T __kv_flush_schedule(void)
+{
+    if (0 == kv_flush_delay_ms) {
+        return FALSE;
+    }
+
+    if (NULL == kv_flush_work) {
+        // the workqueue service may come up after the kv
+        if (OPRT_OK != tal_workq_init_delayed(WORKQ_SYSTEM, __kv_flush_work_cb, NULL, &kv_flush_work)) {
+            kv_flush_work = NULL;
+            return FALSE;
+        }
+    }
+
+    // a fixed window from the first dirty value, a steady stream of sets must not keep pushing it out
+    if (!kv_flush_pending) {
+        if (OPRT_OK != tal_workq_start_delayed(kv_flush_work, kv_flush_delay_ms, LOOP_ONCE)) {
+            return FALSE;
+        }
+        kv_flush_pending = TRUE;
+    }
+
+    return TRUE;
+}
+
 /**
  * Reads data from a user-provided block device.
  *
@@ -137,17 +589,6 @@ int user_provided_block_device_sync(const struct lfs_config *c)
  */
 int tal_kv_init(tal_kv_cfg_t *kv_cfg)
 {
-    uint8_t sha256_ret[32];
-
-    //! init flash key
-    memset(&lfs_kv_cfg, 0, sizeof(lfs_kv_cfg));
-    tal_sha256_ret((const uint8_t *)kv_cfg->seed, TAL_LV_KEY_LEN, sha256_ret, 0);
-    memcpy(lfs_kv_cfg.seed, sha256_ret, TAL_LV_KEY_LEN);
-    tal_sha256_ret((const uint8_t *)kv_cfg->key, TAL_LV_KEY_LEN, sha256_ret, 0);
-    memcpy(lfs_kv_cfg.key, sha256_ret, TAL_LV_KEY_LEN);
-
-    tal_mutex_create_init(&lfs_mutex);
-
     TUYA_FLASH_BASE_INFO_T info;
     tkl_flash_get_one_type_info(TUYA_FLASH_TYPE_UF, &info);
     lfs_flash_addr = info.partition[0].start_addr;
@@ -168,14 +609,53 @@ int tal_kv_init(tal_kv_cfg_t *kv_cfg)
     lfs_cfg.lookahead_size = lfs_cfg.block_count / 8 + (8 - (lfs_cfg.block_count / 8));
     lfs_cfg.block_cycles = 500;
 
+    return tal_kv_init_lfs(kv_cfg, &lfs_cfg);
+}
+
+/**
+ * @brief Initializes the TAL Key-Value (KV) module on a given block device.
+ *
+ * This function mounts the store on the block device described by lfs_cfg
+ * instead of the UF flash partition, e.g. lfs_rambd or lfs_filebd on a host.
+ *
+ * @param kv_cfg A pointer to the TAL KV configuration structure.
+ * @param lfs_cfg The littlefs configuration, it must stay valid while mounted.
+ * @return An integer value indicating the status of the initialization process.
+ *         Returns 0 on success, and a negative value on failure.
+ */
+int tal_kv_init_lfs(tal_kv_cfg_t *kv_cfg, const struct lfs_config *lfs_cfg)
+{
+    uint8_t sha256_ret[32];
+
+    if (NULL == kv_cfg || NULL == lfs_cfg) {
+        return OPRT_INVALID_PARM;
+    }
+
+    //! init flash key
+    memset(&lfs_kv_cfg, 0, sizeof(lfs_kv_cfg));
+    tal_sha256_ret((const uint8_t *)kv_cfg->seed, TAL_LV_KEY_LEN, sha256_ret, 0);
+    memcpy(lfs_kv_cfg.seed, sha256_ret, TAL_LV_KEY_LEN);
+    tal_sha256_ret((const uint8_t *)kv_cfg->key, TAL_LV_KEY_LEN, sha256_ret, 0);
+    memcpy(lfs_kv_cfg.key, sha256_ret, TAL_LV_KEY_LEN);
+
+    if (NULL == lfs_mutex) {
+        tal_mutex_create_init(&lfs_mutex);
+    }
+
     // mount the filesystem
-    int err = lfs_mount(&lfs, &lfs_cfg);
+    int err = lfs_mount(&lfs, lfs_cfg);
 
     // reformat if we can't mount the filesystem
     // this should only happen on the first boot
     if (err) {
-        lfs_format(&lfs, &lfs_cfg);
-        err = lfs_mount(&lfs, &lfs_cfg);
+        lfs_format(&lfs, lfs_cfg);
+        err = lfs_mount(&lfs, lfs_cfg);
+    }
+
+    if (LFS_ERR_OK == err) {
+        tal_mutex_lock(lfs_mutex);
+        __kv_txn_journal_replay();
+        tal_mutex_unlock(lfs_mutex);
     }
 
     return err;
@@ -197,7 +677,7 @@ int tal_kv_init(tal_kv_cfg_t *kv_cfg)
 int tal_kv_set(const char *key, const uint8_t *value, size_t length)
 {
     int result;
-    lfs_file_t file;
+    kv_cache_t *entry = NULL;
 
     PR_DEBUG("key:%s, len %d", key, length);
 
@@ -206,36 +686,31 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length)
     }
 
     tal_mutex_lock(lfs_mutex);
-    result = lfs_file_open(&lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
-    if (LFS_ERR_OK != result) {
+    kv_stat.set++;
+
+    // values of a transaction stay in RAM until the commit whatever their size
+    if (kv_txn_depth || (length <= KV_CACHE_VALUE_MAX && __kv_flush_schedule())) {
+        result = __kv_cache_put(key, value, length, TRUE);
         tal_mutex_unlock(lfs_mutex);
-        PR_ERR("lfs open %s err", key);
         return result;
     }
-    uint8_t *ec_data = NULL;
-    uint32_t ec_len = 0;
-    uint8_t iv[16];
 
-    memcpy(iv, lfs_kv_cfg.seed, 16);
-    result =
-        tal_aes128_cbc_encode((uint8_t *)value, length, (uint8_t *)lfs_kv_cfg.key, iv, &ec_data, (uint32_t *)&ec_len);
-    if (OPRT_OK != result) {
-        lfs_file_close(&lfs, &file);
-        tal_mutex_unlock(lfs_mutex);
-        PR_DEBUG("key %s encrypt failed", key);
-        return result;
+    // write through, a cached copy is refreshed or dropped so reads never see a stale value
+    result = __kv_file_write(key, value, length);
+    entry = __kv_cache_find(key);
+    if (entry) {
+        if (entry->dirty) {
+            entry->dirty = 0;
+            kv_dirty_cnt--;
+        }
+        if (OPRT_OK != result || length > KV_CACHE_VALUE_MAX ||
+            OPRT_OK != __kv_cache_put(key, value, length, FALSE)) {
+            __kv_cache_drop(entry);
+        }
     }
-    lfs_file_rewind(&lfs, &file);
-    result = lfs_file_write(&lfs, &file, ec_data, ec_len);
-    lfs_file_close(&lfs, &file);
-    tal_aes_free_data(ec_data);
     tal_mutex_unlock(lfs_mutex);
-    if (result != ec_len) {
-        PR_ERR("kv write fail %d", result);
-        return OPRT_KVS_WR_FAIL;
-    }
 
-    return OPRT_OK;
+    return result;
 }
 
 /**
@@ -257,55 +732,38 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length)
 int tal_kv_get(const char *key, uint8_t **value, size_t *length)
 {
     int result;
-    lfs_file_t file;
+    kv_cache_t *entry = NULL;
 
     if (NULL == key || NULL == value || NULL == length) {
         return OPRT_INVALID_PARM;
     }
 
     tal_mutex_lock(lfs_mutex);
-    result = lfs_file_open(&lfs, &file, key, LFS_O_RDONLY);
-    if (LFS_ERR_OK != result) {
-        PR_ERR("lfs open %s %d err", key, result);
+    kv_stat.get++;
+    entry = __kv_cache_find(key);
+    if (entry) {
+        kv_stat.get_hit++;
+        *value = tal_malloc(entry->len + 1);
+        if (NULL == *value) {
+            tal_mutex_unlock(lfs_mutex);
+            return OPRT_MALLOC_FAILED;
+        }
+        memcpy(*value, entry->value, entry->len + 1);
+        *length = entry->len;
         tal_mutex_unlock(lfs_mutex);
-        return result;
+        return OPRT_OK;
     }
-    uint8_t *ec_data = NULL;
-    uint32_t ec_len = lfs_file_size(&lfs, &file);
 
-    ec_data = tal_malloc(ec_len + 1);
-    if (NULL == ec_data) {
-        result = OPRT_MALLOC_FAILED;
-        tal_mutex_unlock(lfs_mutex);
-        return result;
+    result = __kv_file_read(key, value, length);
+    if (OPRT_OK == result && *length <= KV_CACHE_VALUE_MAX) {
+        __kv_cache_put(key, *value, *length, FALSE);
     }
-    PR_DEBUG("key:%s, len:%d", key, ec_len);
-    result = lfs_file_read(&lfs, &file, ec_data, ec_len);
-    lfs_file_close(&lfs, &file);
     tal_mutex_unlock(lfs_mutex);
-    if (result <= 0) {
+    if (OPRT_OK != result) {
         *length = 0;
-        tal_free(ec_data);
-        PR_ERR("kv read error %d", result);
-        return OPRT_KVS_RD_FAIL;
     }
-    uint8_t *dec_data = NULL;
-    uint32_t dec_len = 0;
-    uint8_t iv[16];
-
-    memcpy(iv, lfs_kv_cfg.seed, 16);
-    result = tal_aes128_cbc_decode(ec_data, ec_len, (uint8_t *)lfs_kv_cfg.key, iv, &dec_data, (uint32_t *)&dec_len);
-    dec_len = tal_aes_get_actual_length(dec_data, dec_len);
-    tal_free(ec_data);
-    if (OPRT_OK != result || dec_len > ec_len) {
-        PR_ERR("key %s decrypt failed %d, %d-%d", key, result, dec_len, ec_len);
-        return OPRT_BUFFER_NOT_ENOUGH;
-    }
-    *value = dec_data;
-    *length = (size_t)dec_len;
-    dec_data[dec_len] = 0;
 
-    return OPRT_OK;
+    return result;
 }
 
 /**
@@ -322,9 +780,15 @@ int tal_kv_del(const char *key)
     PR_DEBUG("key:%s", key);
 
     tal_mutex_lock(lfs_mutex);
+    kv_cache_t *entry = __kv_cache_find(key);
+    BOOL_T unflushed = (entry && entry->dirty);
+    if (entry) {
+        __kv_cache_drop(entry);
+    }
     int result = lfs_remove(&lfs, key);
     tal_mutex_unlock(lfs_mutex);
-    if (LFS_ERR_OK == result) {
+    // a value that only lived in the cache is gone as well
+    if (LFS_ERR_OK == result || (LFS_ERR_NOENT == result && unflushed)) {
         PR_DEBUG("Deleted successfully");
         return OPRT_OK;
     }
@@ -354,6 +818,130 @@ int tal_kv_free(uint8_t *value)
     return OPRT_OK;
 }
 
+/**
+ * @brief Writes every cached value that is not on flash yet.
+ *
+ * This function flushes the write-back cache right away instead of waiting
+ * for the flush window, e.g. before a reboot or after a value that must
+ * survive a power cut.
+ *
+ * @return OPRT_OK if all values were written, or an error code otherwise.
+ */
+int tal_kv_sync(void)
+{
+    int result = OPRT_OK;
+
+    tal_mutex_lock(lfs_mutex);
+    if (0 == kv_txn_depth) {
+        result = __kv_cache_flush();
+    }
+    tal_mutex_unlock(lfs_mutex);
+
+    return result;
+}
+
+/**
+ * @brief Opens a transaction on the key-value store.
+ *
+ * Until the matching tal_kv_txn_commit, values set are only kept in RAM and
+ * the flush window is held back. Transactions are store wide: sets from
+ * other threads join the open transaction, and nested begin/commit pairs
+ * commit with the outermost one.
+ *
+ * @return OPRT_OK on success, or an error code if an error occurred.
+ */
+int tal_kv_txn_begin(void)
+{
+    tal_mutex_lock(lfs_mutex);
+    if (UINT8_MAX == kv_txn_depth) {
+        tal_mutex_unlock(lfs_mutex);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    kv_txn_depth++;
+    tal_mutex_unlock(lfs_mutex);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Commits the values set since tal_kv_txn_begin.
+ *
+ * The values are first written together as one journal file, which is a
+ * single littlefs commit, and then to their own files. A power cut in
+ * between is repaired by tal_kv_init, which replays the journal, so either
+ * all of the values or none of them survive.
+ *
+ * @return OPRT_OK if the values were committed, or an error code otherwise.
+ */
+int tal_kv_txn_commit(void)
+{
+    int result = OPRT_OK;
+
+    tal_mutex_lock(lfs_mutex);
+    if (0 == kv_txn_depth) {
+        tal_mutex_unlock(lfs_mutex);
+        return OPRT_COM_ERROR;
+    }
+
+    if (0 == --kv_txn_depth && kv_dirty_cnt) {
+        if (kv_dirty_cnt > 1) {
+            result = __kv_txn_journal_write();
+        }
+        if (OPRT_OK == result) {
+            result = __kv_cache_flush();
+        }
+        if (OPRT_OK == result && kv_dirty_cnt == 0) {
+            lfs_remove(&lfs, KV_TXN_FILE);
+        }
+        kv_stat.txn_commit++;
+        // the cache may have grown past its size while the transaction held dirty values
+        __kv_cache_shrink();
+    }
+    tal_mutex_unlock(lfs_mutex);
+
+    return result;
+}
+
+/**
+ * @brief Sets the write-back window of the key-value store.
+ *
+ * @param delay_ms Time a set value may stay in RAM before it is written, 0
+ * writes every set through to flash. Pending values are flushed first.
+ * @return OPRT_OK on success, or an error code if an error occurred.
+ */
+int tal_kv_flush_delay_set(uint32_t delay_ms)
+{
+    int result = OPRT_OK;
+
+    tal_mutex_lock(lfs_mutex);
+    if (0 == kv_txn_depth) {
+        result = __kv_cache_flush();
+    }
+    kv_flush_delay_ms = delay_ms;
+    tal_mutex_unlock(lfs_mutex);
+
+    return result;
+}
+
+/**
+ * @brief Gets the cache and flash statistics of the key-value store.
+ *
+ * @param stat The statistics, counted since boot.
+ * @return OPRT_OK on success, or an error code if an error occurred.
+ */
+int tal_kv_stat_get(tal_kv_stat_t *stat)
+{
+    if (NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(lfs_mutex);
+    memcpy(stat, &kv_stat, sizeof(tal_kv_stat_t));
+    tal_mutex_unlock(lfs_mutex);
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Executes the TAL KV command.
  *
@@ -365,6 +953,21 @@ int tal_kv_free(uint8_t *value)
  */
 void tal_kv_cmd(int argc, char *argv[])
 {
+    tal_kv_stat_t stat;
+
+    if (argc >= 2 && 0 == strcmp("sync", argv[1])) {
+        tal_kv_sync();
+        return;
+    }
+
+    if (argc >= 2 && 0 == strcmp("stat", argv[1])) {
+        tal_kv_stat_get(&stat);
+        PR_DEBUG("get %d hit %d, set %d coalesced %d, file write %d read %d, evict %d, txn %d", stat.get,
+                 stat.get_hit, stat.set, stat.set_coalesced, stat.file_write,
+                 stat.file_read, stat.evict, stat.txn_commit);
+        return;
+    }
+
     if (argc < 3) {
         return;
     }
@@ -381,6 +984,7 @@ void tal_kv_cmd(int argc, char *argv[])
     } else if (0 == strcmp("del", argv[1])) {
         tal_kv_del(argv[2]);
     } else if (0 == strcmp("list", argv[1])) {
+        tal_kv_sync();
         lfs_dir_t dir;
         lfs_dir_open(&lfs, &dir, argv[2]);
         struct lfs_info info;
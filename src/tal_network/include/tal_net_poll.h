@@ -0,0 +1,121 @@
+/**
+ * @file tal_net_poll.h
+ * @brief Readiness polling of a set of sockets for Tuya SDK.
+ *
+ * This header file defines an event loop primitive over the TAL network layer.
+ * Sockets are registered once together with a user context, and a wait call
+ * returns only the sockets that are ready, so the dispatch cost follows the
+ * number of active sockets instead of the number of registered ones. A wakeup
+ * call interrupts a pending wait from any thread, e.g. after queuing a new
+ * registration.
+ *
+ * On Linux with the POSIX network card the set is an epoll instance woken by an
+ * eventfd. Elsewhere it falls back to tal_net_select() over an incrementally
+ * maintained fd set, woken by a datagram to a loopback UDP socket.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __TAL_NET_POLL_H__
+#define __TAL_NET_POLL_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define TAL_NET_POLL_IN  0x01 // readable, or a pending connection on a listening socket
+#define TAL_NET_POLL_ERR 0x02 // error or exception condition
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef void *TAL_NET_POLL_HANDLE;
+
+typedef struct {
+    int fd;
+    uint32_t events; // TAL_NET_POLL_xxx
+    void *ctx;       // context given to tal_net_poll_add
+} TAL_NET_POLL_EVENT_T;
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/**
+ * @brief create a poll set
+ *
+ * @param[in] max_fds: sockets the set can hold
+ * @param[out] handle: poll set
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_create(uint32_t max_fds, TAL_NET_POLL_HANDLE *handle);
+
+/**
+ * @brief add a socket to the poll set
+ *
+ * @param[in] handle: poll set
+ * @param[in] fd: socket, watched for TAL_NET_POLL_IN and TAL_NET_POLL_ERR
+ * @param[in] ctx: returned with the events of the socket
+ *
+ * @note Not thread safe against tal_net_poll_wait, call it from the thread
+ * that waits.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_add(TAL_NET_POLL_HANDLE handle, int fd, void *ctx);
+
+/**
+ * @brief remove a socket from the poll set, before closing it
+ *
+ * @param[in] handle: poll set
+ * @param[in] fd: socket
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_del(TAL_NET_POLL_HANDLE handle, int fd);
+
+/**
+ * @brief wait for ready sockets
+ *
+ * @param[in] handle: poll set
+ * @param[out] events: ready sockets
+ * @param[in] max_events: size of events, the rest is reported by the next wait
+ * @param[in] timeout_ms: longest wait
+ *
+ * @return number of ready sockets, 0 on timeout or wakeup, < 0 on error
+ */
+int tal_net_poll_wait(TAL_NET_POLL_HANDLE handle, TAL_NET_POLL_EVENT_T *events, int max_events, uint32_t timeout_ms);
+
+/**
+ * @brief interrupt a pending or the next tal_net_poll_wait, from any thread
+ *
+ * @param[in] handle: poll set
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_wakeup(TAL_NET_POLL_HANDLE handle);
+
+/**
+ * @brief release the poll set, the sockets in it are not closed
+ *
+ * @param[in] handle: poll set
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_release(TAL_NET_POLL_HANDLE handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TAL_NET_POLL_H__ */
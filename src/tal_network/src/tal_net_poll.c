@@ -0,0 +1,483 @@
+/**
+ * @file tal_net_poll.c
+ * @brief Readiness polling of a set of sockets for Tuya SDK.
+ *
+ * This source file implements the poll set declared in tal_net_poll.h. On
+ * Linux with the POSIX network card it uses epoll and an eventfd, so a wait
+ * costs O(ready sockets). Other platforms and network cards use
+ * tal_net_select() on fd sets that are updated on add/del instead of rebuilt
+ * for every wait, and a loopback UDP socket as the wakeup channel.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_iot_config.h"
+#include "tal_api.h"
+#include "tal_network_register.h"
+#include "tal_net_poll.h"
+
+#if 100 == OPERATING_SYSTEM
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define NET_POLL_USING_EPOLL 1
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define NET_POLL_WAKE_PORT_BASE 49152
+#define NET_POLL_WAKE_PORT_NUM  16384
+#define NET_POLL_WAKE_BIND_TRY  16
+#define NET_POLL_WAKE_SLOT      0xFFFFFFFFu
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    int fd; // -1 when free
+    void *ctx;
+} NET_POLL_SLOT_T;
+
+typedef struct {
+    uint32_t max_fds;
+    uint32_t slot_hw; // slots in use are below
+    NET_POLL_SLOT_T *slots;
+
+    BOOL_T epoll;
+#if defined(NET_POLL_USING_EPOLL) && (NET_POLL_USING_EPOLL == 1)
+    int epfd;
+    int evfd;
+    struct epoll_event *ep_events;
+#endif
+
+    // select fallback
+    int max_fd;
+    int wake_fd;
+    uint16_t wake_port;
+    uint8_t wake_pending;
+    TUYA_FD_SET_T rfds;
+    TUYA_FD_SET_T efds;
+    TUYA_FD_SET_T wait_rfds;
+    TUYA_FD_SET_T wait_efds;
+} NET_POLL_T;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static int __poll_slot_find(NET_POLL_T *poll, int fd)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < poll->slot_hw; i++) {
+        if (poll->slots[i].fd == fd) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static OPERATE_RET __poll_wake_sock_create(NET_POLL_T *poll)
+{
+    int fd = -1;
+    uint32_t i = 0;
+    uint16_t port = 0;
+
+    fd = tal_net_socket_create(PROTOCOL_UDP);
+    if (fd < 0) {
+        return OPRT_SOCK_ERR;
+    }
+    tal_net_set_block(fd, FALSE);
+
+    port = NET_POLL_WAKE_PORT_BASE + tal_system_get_random(NET_POLL_WAKE_PORT_NUM);
+    for (i = 0; i < NET_POLL_WAKE_BIND_TRY; i++) {
+        if (UNW_SUCCESS == tal_net_bind(fd, TY_IPADDR_LOOPBACK, port)) {
+            poll->wake_fd = fd;
+            poll->wake_port = port;
+            return OPRT_OK;
+        }
+        port = NET_POLL_WAKE_PORT_BASE + (port - NET_POLL_WAKE_PORT_BASE + 1) % NET_POLL_WAKE_PORT_NUM;
+    }
+
+    tal_net_close(fd);
+    return OPRT_SOCK_ERR;
+}
+
+static void __poll_wake_sock_drain(NET_POLL_T *poll)
+{
+    uint8_t buf[8];
+    TUYA_IP_ADDR_T addr = 0;
+    uint16_t port = 0;
+
+    __atomic_store_n(&poll->wake_pending, 0, __ATOMIC_RELEASE);
+    while (tal_net_recvfrom(poll->wake_fd, buf, sizeof(buf), &addr, &port) > 0) {
+    }
+}
+
+/**
+ * @brief Creates a poll set.
+ *
+ * @param max_fds Sockets the set can hold.
+ * @param handle Receives the poll set.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_create(uint32_t max_fds, TAL_NET_POLL_HANDLE *handle)
+{
+    OPERATE_RET rt = OPRT_OK;
+    NET_POLL_T *poll = NULL;
+    uint32_t i = 0;
+
+    if (0 == max_fds || NULL == handle) {
+        return OPRT_INVALID_PARM;
+    }
+
+    poll = tal_malloc(sizeof(NET_POLL_T));
+    TUYA_CHECK_NULL_RETURN(poll, OPRT_MALLOC_FAILED);
+    memset(poll, 0, sizeof(NET_POLL_T));
+    poll->max_fds = max_fds;
+    poll->max_fd = -1;
+    poll->wake_fd = -1;
+#if defined(NET_POLL_USING_EPOLL) && (NET_POLL_USING_EPOLL == 1)
+    poll->epfd = -1;
+    poll->evfd = -1;
+#endif
+
+    poll->slots = tal_malloc(max_fds * sizeof(NET_POLL_SLOT_T));
+    TUYA_CHECK_NULL_GOTO(poll->slots, __ERR);
+    for (i = 0; i < max_fds; i++) {
+        poll->slots[i].fd = -1;
+        poll->slots[i].ctx = NULL;
+    }
+
+#if defined(NET_POLL_USING_EPOLL) && (NET_POLL_USING_EPOLL == 1)
+    // epoll only understands the fds of the host stack
+    if (TAL_NET_TYPE_POSIX == tal_network_card_get_active_type()) {
+        struct epoll_event ev = {0};
+
+        poll->ep_events = tal_malloc((max_fds + 1) * sizeof(struct epoll_event));
+        TUYA_CHECK_NULL_GOTO(poll->ep_events, __ERR);
+        poll->epfd = epoll_create1(EPOLL_CLOEXEC);
+        poll->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (poll->epfd < 0 || poll->evfd < 0) {
+            PR_ERR("epoll init err");
+            rt = OPRT_COM_ERROR;
+            goto __ERR;
+        }
+        ev.events = EPOLLIN;
+        ev.data.u32 = NET_POLL_WAKE_SLOT;
+        if (0 != epoll_ctl(poll->epfd, EPOLL_CTL_ADD, poll->evfd, &ev)) {
+            rt = OPRT_COM_ERROR;
+            goto __ERR;
+        }
+        poll->epoll = TRUE;
+        *handle = poll;
+        return OPRT_OK;
+    }
+#endif
+
+    tal_net_fd_zero(&poll->rfds);
+    tal_net_fd_zero(&poll->efds);
+    // without a wakeup socket the wait timeout bounds the latency of a wakeup
+    if (OPRT_OK != __poll_wake_sock_create(poll)) {
+        PR_WARN("net poll has no wakeup socket");
+    }
+
+    *handle = poll;
+    return OPRT_OK;
+
+__ERR:
+    tal_net_poll_release(poll);
+    return (OPRT_OK != rt) ? rt : OPRT_MALLOC_FAILED;
+}
+
+/**
+ * @brief Adds a socket to the poll set.
+ *
+ * @param handle Poll set.
+ * @param fd Socket, watched for readability and errors.
+ * @param ctx Context returned with the events of the socket.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_add(TAL_NET_POLL_HANDLE handle, int fd, void *ctx)
+{
+    NET_POLL_T *poll = (NET_POLL_T *)handle;
+    int idx = 0;
+
+    if (NULL == poll || fd < 0) {
+        return OPRT_INVALID_PARM;
+    }
+    if (__poll_slot_find(poll, fd) >= 0) {
+        return OPRT_COM_ERROR;
+    }
+    idx = __poll_slot_find(poll, -1);
+    if (idx < 0) {
+        if (poll->slot_hw >= poll->max_fds) {
+            return OPRT_EXCEED_UPPER_LIMIT;
+        }
+        idx = poll->slot_hw;
+    }
+
+#if defined(NET_POLL_USING_EPOLL) && (NET_POLL_USING_EPOLL == 1)
+    if (poll->epoll) {
+        struct epoll_event ev = {0};
+        ev.events = EPOLLIN | EPOLLPRI;
+        ev.data.u32 = (uint32_t)idx;
+        if (0 != epoll_ctl(poll->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+            PR_ERR("epoll add %d err", fd);
+            return OPRT_COM_ERROR;
+        }
+    }
+#endif
+    if (!poll->epoll) {
+        tal_net_fd_set(fd, &poll->rfds);
+        tal_net_fd_set(fd, &poll->efds);
+        if (fd > poll->max_fd) {
+            poll->max_fd = fd;
+        }
+    }
+
+    poll->slots[idx].fd = fd;
+    poll->slots[idx].ctx = ctx;
+    if ((uint32_t)idx >= poll->slot_hw) {
+        poll->slot_hw = idx + 1;
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Removes a socket from the poll set.
+ *
+ * @param handle Poll set.
+ * @param fd Socket, still open.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_del(TAL_NET_POLL_HANDLE handle, int fd)
+{
+    NET_POLL_T *poll = (NET_POLL_T *)handle;
+    uint32_t i = 0;
+    int idx = 0;
+
+    if (NULL == poll || fd < 0) {
+        return OPRT_INVALID_PARM;
+    }
+    idx = __poll_slot_find(poll, fd);
+    if (idx < 0) {
+        return OPRT_NOT_FOUND;
+    }
+
+#if defined(NET_POLL_USING_EPOLL) && (NET_POLL_USING_EPOLL == 1)
+    if (poll->epoll) {
+        epoll_ctl(poll->epfd, EPOLL_CTL_DEL, fd, NULL);
+    }
+#endif
+    if (!poll->epoll) {
+        tal_net_fd_clear(fd, &poll->rfds);
+        tal_net_fd_clear(fd, &poll->efds);
+    }
+
+    poll->slots[idx].fd = -1;
+    poll->slots[idx].ctx = NULL;
+    while (poll->slot_hw > 0 && poll->slots[poll->slot_hw - 1].fd < 0) {
+        poll->slot_hw--;
+    }
+    if (!poll->epoll && fd == poll->max_fd) {
+        poll->max_fd = -1;
+        for (i = 0; i < poll->slot_hw; i++) {
+            if (poll->slots[i].fd > poll->max_fd) {
+                poll->max_fd = poll->slots[i].fd;
+            }
+        }
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Waits for ready sockets.
+ *
+ * @param handle Poll set.
+ * @param events Receives the ready sockets.
+ * @param max_events Size of events.
+ * @param timeout_ms Longest wait.
+ *
+ * @return Number of ready sockets, 0 on timeout or wakeup, < 0 on error.
+ */
+int tal_net_poll_wait(TAL_NET_POLL_HANDLE handle, TAL_NET_POLL_EVENT_T *events, int max_events, uint32_t timeout_ms)
+{
+    NET_POLL_T *poll = (NET_POLL_T *)handle;
+    NET_POLL_SLOT_T *slot = NULL;
+    uint32_t i = 0;
+    int maxfd = 0;
+    int cnt = 0;
+    int ret = 0;
+
+    if (NULL == poll || NULL == events || max_events <= 0) {
+        return -1;
+    }
+
+#if defined(NET_POLL_USING_EPOLL) && (NET_POLL_USING_EPOLL == 1)
+    if (poll->epoll) {
+        int n = (max_events < (int)poll->max_fds) ? max_events + 1 : (int)poll->max_fds + 1;
+        ret = epoll_wait(poll->epfd, poll->ep_events, n, (int)timeout_ms);
+        if (ret < 0) {
+            return (EINTR == errno) ? 0 : ret;
+        }
+        for (i = 0; i < (uint32_t)ret; i++) {
+            struct epoll_event *ev = &poll->ep_events[i];
+            if (NET_POLL_WAKE_SLOT == ev->data.u32) {
+                uint64_t val = 0;
+                if (read(poll->evfd, &val, sizeof(val)) < 0) {
+                    // nothing pending, a racing wakeup already consumed it
+                }
+                continue;
+            }
+            slot = &poll->slots[ev->data.u32];
+            if (slot->fd < 0 || cnt >= max_events) {
+                continue;
+            }
+            events[cnt].fd = slot->fd;
+            events[cnt].ctx = slot->ctx;
+            events[cnt].events = 0;
+            if (ev->events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) {
+                events[cnt].events |= TAL_NET_POLL_IN;
+            }
+            if (ev->events & (EPOLLERR | EPOLLPRI)) {
+                events[cnt].events |= TAL_NET_POLL_ERR;
+            }
+            cnt++;
+        }
+        return cnt;
+    }
+#endif
+
+    memcpy(&poll->wait_rfds, &poll->rfds, sizeof(TUYA_FD_SET_T));
+    memcpy(&poll->wait_efds, &poll->efds, sizeof(TUYA_FD_SET_T));
+    maxfd = poll->max_fd;
+    if (poll->wake_fd >= 0) {
+        tal_net_fd_set(poll->wake_fd, &poll->wait_rfds);
+        if (poll->wake_fd > maxfd) {
+            maxfd = poll->wake_fd;
+        }
+    }
+    if (maxfd < 0) {
+        tal_system_sleep(timeout_ms);
+        return 0;
+    }
+
+    ret = tal_net_select(maxfd + 1, &poll->wait_rfds, NULL, &poll->wait_efds, timeout_ms);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (poll->wake_fd >= 0 && tal_net_fd_isset(poll->wake_fd, &poll->wait_rfds)) {
+        __poll_wake_sock_drain(poll);
+        ret--;
+    }
+
+    for (i = 0; i < poll->slot_hw && ret > 0 && cnt < max_events; i++) {
+        slot = &poll->slots[i];
+        if (slot->fd < 0) {
+            continue;
+        }
+        events[cnt].events = 0;
+        if (tal_net_fd_isset(slot->fd, &poll->wait_rfds)) {
+            events[cnt].events |= TAL_NET_POLL_IN;
+            ret--;
+        }
+        if (tal_net_fd_isset(slot->fd, &poll->wait_efds)) {
+            events[cnt].events |= TAL_NET_POLL_ERR;
+            ret--;
+        }
+        if (events[cnt].events) {
+            events[cnt].fd = slot->fd;
+            events[cnt].ctx = slot->ctx;
+            cnt++;
+        }
+    }
+
+    return cnt;
+}
+
+/**
+ * @brief Interrupts a pending or the next wait.
+ *
+ * @param handle Poll set.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_wakeup(TAL_NET_POLL_HANDLE handle)
+{
+    NET_POLL_T *poll = (NET_POLL_T *)handle;
+
+    if (NULL == poll) {
+        return OPRT_INVALID_PARM;
+    }
+
+#if defined(NET_POLL_USING_EPOLL) && (NET_POLL_USING_EPOLL == 1)
+    if (poll->epoll) {
+        uint64_t val = 1;
+        return (write(poll->evfd, &val, sizeof(val)) == sizeof(val)) ? OPRT_OK : OPRT_COM_ERROR;
+    }
+#endif
+
+    if (poll->wake_fd < 0) {
+        return OPRT_NOT_SUPPORTED;
+    }
+    // one datagram in flight is enough, the waiter drains the socket
+    if (__atomic_exchange_n(&poll->wake_pending, 1, __ATOMIC_ACQ_REL)) {
+        return OPRT_OK;
+    }
+    if (tal_net_send_to(poll->wake_fd, "w", 1, TY_IPADDR_LOOPBACK, poll->wake_port) < 0) {
+        __atomic_store_n(&poll->wake_pending, 0, __ATOMIC_RELEASE);
+        return OPRT_SEND_ERR;
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Releases the poll set.
+ *
+ * @param handle Poll set, the sockets in it are left open.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_poll_release(TAL_NET_POLL_HANDLE handle)
+{
+    NET_POLL_T *poll = (NET_POLL_T *)handle;
+
+    if (NULL == poll) {
+        return OPRT_INVALID_PARM;
+    }
+
+#if defined(NET_POLL_USING_EPOLL) && (NET_POLL_USING_EPOLL == 1)
+    if (poll->epfd >= 0) {
+        close(poll->epfd);
+    }
+    if (poll->evfd >= 0) {
+        close(poll->evfd);
+    }
+    if (poll->ep_events) {
+        tal_free(poll->ep_events);
+    }
+#endif
+    if (poll->wake_fd >= 0) {
+        tal_net_close(poll->wake_fd);
+    }
+    if (poll->slots) {
+        tal_free(poll->slots);
+    }
+    tal_free(poll);
+
+    return OPRT_OK;
+}
@@ -148,6 +148,21 @@ OPERATE_RET tal_log_print_secure(BOOL_T is_const_fmt, const TAL_LOG_LEVEL_E leve
 // prototype of log output function
 typedef void (*TAL_LOG_OUTPUT_CB)(const char *str);
 
+// prototype of binary log output function, one call per frame
+typedef void (*TAL_LOG_BIN_OUTPUT_CB)(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief statistics of the asynchronous log backend
+ */
+typedef struct {
+    uint32_t queued;    // logs captured into the ring
+    uint32_t dropped;   // logs lost because the ring was full
+    uint32_t sync;      // logs formatted in the caller, at or above the sync level or not deferrable
+    uint32_t drained;   // logs formatted by the drain thread
+    uint32_t ring_size; // ring bytes
+    uint32_t ring_peak; // highest ring usage in bytes
+} TAL_LOG_ASYNC_STAT_T;
+
 /***********************************************************************
  ********************* variable ****************************************
  **********************************************************************/
@@ -317,6 +332,55 @@ OPERATE_RET tal_log_print_escape(const TAL_LOG_LEVEL_E level, const char *file,
  */
 void tal_log_release(void);
 
+/**
+ * @brief switch the log to the asynchronous backend
+ *
+ * @param[in] ring_size, bytes of the record ring, a power of two in [1K, 64K]
+ * @param[in] sync_level, logs at or above this level are still printed in place
+ *
+ * @note PR_xxx logs with a constant format below sync_level are captured as
+ * format pointer plus raw arguments and formatted by a low priority drain
+ * thread. Strings are copied at capture time. When the ring is full the log is
+ * dropped and counted, the caller never waits for the output. A log printed
+ * in place outputs at most a few queued logs first, older ones may follow it.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_log_async_enable(uint32_t ring_size, TAL_LOG_LEVEL_E sync_level);
+
+/**
+ * @brief switch deferrable logs to compact binary frames
+ *
+ * @param[in] output, sink of the binary frames, NULL goes back to text
+ *
+ * @note PR_xxx logs with a constant format are encoded as a format id, a
+ * varint timestamp delta and the raw arguments. Decode the stream on the host
+ * with tools/log_decoder.py. Logs that cannot be encoded, raw prints and hex
+ * dumps keep going to the text output terminals.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_log_bin_output_set(const TAL_LOG_BIN_OUTPUT_CB output);
+
+/**
+ * @brief get the statistics of the asynchronous log backend
+ *
+ * @param[out] stat, statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_log_async_stat_get(TAL_LOG_ASYNC_STAT_T *stat);
+
+/**
+ * @brief output every queued log now, e.g. before reset
+ *
+ * @return NONE
+ */
+void tal_log_flush(void);
+
 /**
  * @brief print a buffer in hex format
  *
@@ -43,6 +43,9 @@ typedef enum {
     TAL_TIMER_CYCLE,
 } TIMER_TYPE;
 
+// lateness buckets, bucket 0 is on time, bucket n is late by [2^(n-1), 2^n) ms, the last one is open ended
+#define TAL_SW_TIMER_LATE_BUCKETS 12
+
 /***********************************************************************
  ********************* struct ******************************************
  **********************************************************************/
@@ -51,6 +54,16 @@ typedef void *TIMER_ID;
 
 typedef void (*TAL_TIMER_CB)(TIMER_ID timer_id, void *arg);
 
+/**
+ * @brief dispatch statistics of the software timer
+ */
+typedef struct {
+    uint32_t fired;       // callbacks run
+    uint32_t batches;     // expired batches, the timer lock is taken once per batch
+    uint32_t max_late_ms; // worst callback lateness
+    uint32_t late_hist[TAL_SW_TIMER_LATE_BUCKETS];
+} TAL_SW_TIMER_STAT_T;
+
 /***********************************************************************
  ********************* variable ****************************************
  **********************************************************************/
@@ -180,6 +193,19 @@ OPERATE_RET tal_sw_timer_release(void);
  */
 int tal_sw_timer_get_num(void);
 
+/**
+ * @brief Get the dispatch statistics of the software timer
+ *
+ * @param[out] stat: callbacks fired and their lateness histogram
+ *
+ * @note Counters are cumulative since init, callers diff two snapshots to
+ * measure an interval.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_stat_get(TAL_SW_TIMER_STAT_T *stat);
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,35 @@ typedef struct {
 } WORK_ITEM_T;
 typedef BOOL_T (*WORKQUEUE_TRAVERSE_CB)(WORK_ITEM_T *item, void *ctx);
 
+#ifndef TAL_WORKQUEUE_WORKER_MAX
+#define TAL_WORKQUEUE_WORKER_MAX 4
+#endif
+
+typedef struct {
+    uint16_t queue_len;      // items per lane, instant and normal work have a lane each
+    uint8_t worker_num;      // threads draining the queue, 1 keeps the strict FIFO order of the lane
+    THREAD_CFG_T thread_cfg; // shared by all workers, workers after the first get a "_n" name suffix
+} WORKQUEUE_CFG_T;
+
+typedef struct {
+    uint32_t scheduled;          // normal items accepted
+    uint32_t scheduled_instant;  // instant items accepted
+    uint32_t rejected;           // items refused because the lane was full
+    uint32_t done;               // callbacks run
+    uint32_t cancelled;          // items dequeued after tal_workqueue_cancel
+    uint16_t pending;            // normal items waiting
+    uint16_t pending_instant;    // instant items waiting
+    uint32_t wait_avg_ms;        // time from schedule to the callback start
+    uint32_t wait_max_ms;
+    uint32_t run_avg_ms;         // callback run time
+    uint32_t run_max_ms;
+    WORKQUEUE_CB run_max_cb;     // the slowest callback seen
+    uint8_t worker_num;
+    uint8_t busy;                // workers inside a callback now
+    uint32_t running_max_ms;     // the longest callback still running
+    WORKQUEUE_CB running_cb;
+} WORKQUEUE_STAT_T;
+
 /**
  * @brief create and initialize a workqueue which runs in thread context
  *
@@ -52,6 +81,21 @@ typedef BOOL_T (*WORKQUEUE_TRAVERSE_CB)(WORK_ITEM_T *item, void *ctx);
  */
 OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_cfg, WORKQUEUE_HANDLE *handle);
 
+/**
+ * @brief create and initialize a workqueue drained by several worker threads
+ *
+ * @param[in] cfg queue length, worker number and thread param
+ * @param[out] handle the workqueue handle
+ *
+ * @note All workers pull from the same lanes, so one slow callback only holds
+ * its own worker. With more than one worker, items may run concurrently and
+ * finish out of order.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_ex(const WORKQUEUE_CFG_T *cfg, WORKQUEUE_HANDLE *handle);
+
 /**
  * @brief put work task in workqueue
  *
@@ -109,6 +153,17 @@ OPERATE_RET tal_workqueue_traverse(WORKQUEUE_HANDLE handle, WORKQUEUE_TRAVERSE_C
  */
 uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle);
 
+/**
+ * @brief get the statistics of the workqueue
+ *
+ * @param[in] handle the workqueue handle
+ * @param[out] stat counters, queue-wait and run-time of the work items
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_stat_get(WORKQUEUE_HANDLE handle, WORKQUEUE_STAT_T *stat);
+
 /**
  * @brief release the workqueue
  *
@@ -124,10 +179,20 @@ OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle);
  *
  * @param[in] handle the workqueue handle
  *
- * @return thread handle
+ * @return thread handle of the first worker
  */
 THREAD_HANDLE tal_workqueue_get_thread(WORKQUEUE_HANDLE handle);
 
+/**
+ * @brief get thread handle of a worker of the workqueue
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] index worker index, below worker_num
+ *
+ * @return thread handle, NULL if there is no such worker
+ */
+THREAD_HANDLE tal_workqueue_get_worker_thread(WORKQUEUE_HANDLE handle, uint8_t index);
+
 typedef void *DELAYED_WORK_HANDLE;
 
 /**
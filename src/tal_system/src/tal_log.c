@@ -38,6 +38,8 @@
 #include "tal_system.h"
 #include "tal_time_service.h"
 #include "tal_memory.h"
+#include "tal_thread.h"
+#include "tal_semaphore.h"
 
 /***********************************************************
 *************************micro define***********************
@@ -62,6 +64,65 @@ typedef struct {
     LOG_TEXT_STYLE_S style[LOG_LEVEL_MAX + 1];
 } LOG_COLOR_S;
 
+#define DEF_OUTPUT_NAME "def_output"
+
+// async mode, records are 8 byte aligned in a power of two ring
+#define LOG_REC_ALIGN      8
+#define LOG_REC_MAX        512 // bigger records, e.g. long %s arguments, are printed in place
+#define LOG_SPEC_MAX       32
+#define LOG_STR_NULL       0xFFFF
+#define LOG_DRAIN_WAIT_MS  100
+#define LOG_SYNC_DRAIN_MAX 8 // queued records a log printed in place outputs first, the writer thread does the rest
+#define LOG_DRAIN_STACK    (4 * 1024)
+
+#define LOG_REC_PAD 0 // skip to the start of the ring
+#define LOG_REC_MSG 1
+
+typedef enum {
+    LOG_LEN_NONE,
+    LOG_LEN_HH,
+    LOG_LEN_H,
+    LOG_LEN_L,
+    LOG_LEN_LL,
+    LOG_LEN_J,
+    LOG_LEN_Z,
+    LOG_LEN_T,
+} LOG_LEN_E;
+
+// one conversion of a format string
+typedef struct {
+    uint8_t len;    // characters from the '%'
+    uint8_t star;   // '*' width and precision taken from the arguments
+    uint8_t length; // LOG_LEN_E
+    char conv;
+} LOG_SPEC_S;
+
+// a log captured at the call site, followed by its arguments
+typedef struct {
+    uint32_t seq; // ring position + 1 once the record is complete
+    uint16_t size;
+    uint8_t type;
+    uint8_t level;
+    uint32_t line;
+    uint32_t reserved;
+    SYS_TICK_T time_ms;
+    const char *file;
+    const char *fmt;
+} LOG_REC_S;
+
+typedef struct {
+    uint8_t *ring;
+    uint32_t ring_size;
+    uint32_t head; // next position to reserve, producers only
+    uint32_t tail; // next position to drain, consumer only
+    LOG_LEVEL sync_level;
+    BOOL_T drain_sleep;
+    THREAD_HANDLE thread;
+    SEM_HANDLE sem;
+    uint32_t dropped_reported;
+    TAL_LOG_ASYNC_STAT_T stat;
+} LOG_ASYNC_S;
+
 typedef struct {
     LOG_LEVEL curLogLevel;
     LIST_HEAD listHead;
@@ -73,13 +134,36 @@ typedef struct {
     int log_buf_len;
     BOOL_T ms_level;
     char *log_buf;
+
+    LOG_ASYNC_S *async;
+
+    TAL_LOG_BIN_OUTPUT_CB bin_out;
+    SYS_TIME_T bin_last_ms;
+    uint32_t bin_frames;
 } LOG_MANAGE, *P_LOG_MANAGE;
 
-#define DEF_OUTPUT_NAME "def_output"
+// binary mode, frame = sync byte, varint payload length, payload
+// payload = flags (level | abs time), varint time, u32 id, varint line, arguments
+#define LOG_BIN_SYNC       0xA5
+#define LOG_BIN_ABS_TIME   0x08
+#define LOG_BIN_ABS_PERIOD 256 // frames between absolute timestamps, so a reader can join late
+#define LOG_BIN_HEAD_MAX   24
+#define LOG_BIN_ID_CACHE   64
+
+#define LOG_ZIGZAG(v) (((uint64_t)(v) << 1) ^ (uint64_t)((int64_t)(v) >> 63))
+
+// ids of recent format strings, hashing them is the main cost of a binary log
+typedef struct {
+    const char *file;
+    const char *fmt;
+    uint32_t id;
+} LOG_BIN_ID_S;
 
 /***********************************************************
 *************************variable define********************
 ***********************************************************/
+static LOG_BIN_ID_S sg_log_bin_id[LOG_BIN_ID_CACHE];
+
 const char *sLevelStr[] = {"E", "W", "N", "I", "D", "T"};
 P_LOG_MANAGE pLogManage = NULL;
 
@@ -134,6 +218,10 @@ OPERATE_RET tal_log_init(const TAL_LOG_LEVEL_E level, const int buf_len, const T
         INIT_LIST_HEAD(&(tmp_log_mng->log_list));
         tmp_log_mng->curLogLevel = level;
         tmp_log_mng->ms_level = FALSE;
+        tmp_log_mng->async = NULL;
+        tmp_log_mng->bin_out = NULL;
+        tmp_log_mng->bin_last_ms = 0;
+        tmp_log_mng->bin_frames = 0;
         pLogManage = tmp_log_mng;
 
         // set default log style
@@ -407,67 +495,28 @@ OPERATE_RET tal_log_get_level(TAL_LOG_LEVEL_E *level)
     return OPRT_OK;
 }
 
-/**
- * @brief Prints a log message with the specified log level, file name, line
- * number, and format string.
- *
- * This function is used to print log messages with different log levels. It
- * takes the log level, file name, line number, format string, and a variable
- * argument list as parameters. The log level determines the severity of the log
- * message. The file name and line number indicate the location where the log
- * message is printed. The format string specifies the format of the log
- * message, and the variable argument list contains the values to be formatted
- * and printed.
- *
- * @param logLevel The log level of the message.
- * @param pFile The name of the source file where the log message is printed.
- * @param line The line number in the source file where the log message is
- * printed.
- * @param pFmt The format string for the log message.
- * @param ap The variable argument list for the format string.
- * @return The result of the log printing operation.
- *     - OPRT_OK if the log message was printed successfully.
- *     - OPRT_INVALID_PARM if the log level is invalid or the log manager is not
- * initialized.
- *     - OPRT_BASE_LOG_MNG_PRINT_LOG_LEVEL_HIGHER if the log level is higher
- * than the current log level.
- *     - OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED if there was an error formatting
- * the log message.
- */
-OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char *pFmt, va_list ap)
+static const char *__log_file_name(const char *pFile)
 {
-    int len = 0;
-    int cnt = 0;
+    int pos = 0;
 
-    if (!pLogManage) {
-        return OPRT_INVALID_PARM;
-    }
-    if (logLevel < LOG_LEVEL_MIN || logLevel > LOG_LEVEL_MAX) {
-        return OPRT_INVALID_PARM;
-    }
-    LOG_LEVEL tmpLogLevel = pLogManage->curLogLevel;
-    if (logLevel > tmpLogLevel) {
-        return OPRT_BASE_LOG_MNG_PRINT_LOG_LEVEL_HIGHER;
+    if (NULL == pFile) {
+        return "Null";
     }
-    const char *pTmpModuleName = "ty";
-    const char *pTmpFilename = NULL;
 
-    if (NULL == pFile) {
-        pTmpFilename = "Null";
-    } else {
-        int pos = 0;
-        pTmpFilename = pFile;
-        pos = tal_log_strrchr((char *)pFile, '/');
-        if (pos < 0) {
-            pos = tal_log_strrchr((char *)pFile, '\\');
-            if (pos >= 0) {
-                pTmpFilename = pFile + pos + 1;
-            }
-        } else {
-            pTmpFilename = pFile + pos + 1;
-        }
+    pos = tal_log_strrchr((char *)pFile, '/');
+    if (pos < 0) {
+        pos = tal_log_strrchr((char *)pFile, '\\');
     }
-    tal_mutex_lock(pLogManage->mutex);
+
+    return (pos >= 0) ? pFile + pos + 1 : pFile;
+}
+
+// color and "[time ty level][file:line] " into log_buf, time_ms 0 is now. Returns the length or -1
+static int __log_fmt_prefix(LOG_LEVEL logLevel, const char *pTmpFilename, uint32_t line, SYS_TICK_T time_ms)
+{
+    int len = 0;
+    int cnt = 0;
+    const char *pTmpModuleName = "ty";
 
     // color prefix
     if (pLogManage->log_color.enable_color) {
@@ -476,7 +525,7 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char
                        pLogManage->log_color.style[logLevel].font_color,
                        pLogManage->log_color.style[logLevel].background_color);
         if (cnt <= 0) {
-            goto ERR_EXIT;
+            return -1;
         }
         len += cnt;
     }
@@ -485,12 +534,14 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char
     memset(&tm, 0, sizeof(tm));
 
     if (pLogManage->ms_level == FALSE) {
-        tal_time_get_local_time_custom(0, &tm);
+        tal_time_get_local_time_custom((TIME_T)(time_ms / 1000), &tm);
         cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len,
                        "[%02d-%02d %02d:%02d:%02d %s %s][%s:%" PRIu32 "] ", tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
                        tm.tm_min, tm.tm_sec, pTmpModuleName, sLevelStr[logLevel], pTmpFilename, line);
     } else {
-        SYS_TICK_T time_ms = tal_time_get_posix_ms();
+        if (0 == time_ms) {
+            time_ms = tal_time_get_posix_ms();
+        }
         TIME_T sec = (TIME_T)(time_ms / 1000);
         uint32_t ms = (uint32_t)(time_ms % 1000);
         tal_time_get_local_time_custom(sec, &tm);
@@ -499,9 +550,778 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char
                        tm.tm_hour, tm.tm_min, tm.tm_sec, ms, pTmpModuleName, sLevelStr[logLevel], pTmpFilename, line);
     }
     if (cnt <= 0) {
-        goto ERR_EXIT;
+        return -1;
+    }
+
+    return len + cnt;
+}
+
+// color reset and line end behind the message in log_buf. Returns the length or -1
+static int __log_fmt_suffix(int len)
+{
+    int cnt = 0;
+
+    char *p_suffix = (pLogManage->log_color.enable_color) ? "\033[0m\r\n" : "\r\n";
+    if (len > (int)(pLogManage->log_buf_len - strlen(p_suffix) - 1)) { // 1 -> "\0"
+        len = pLogManage->log_buf_len - strlen(p_suffix) - 1;
+    }
+    cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, "%s", p_suffix);
+    if (cnt <= 0) {
+        return -1;
     }
     len += cnt;
+    pLogManage->log_buf[len] = '\0';
+
+    return len;
+}
+
+// parse the conversion at p ('%'), NULL when the async mode cannot defer it
+static const char *__log_spec_parse(const char *p, LOG_SPEC_S *spec, int *prec)
+{
+    const char *start = p++;
+
+    memset(spec, 0, sizeof(LOG_SPEC_S));
+    *prec = -1;
+
+    while (*p && (*p == ' ' || *p == '#' || *p == '+' || *p == '-' || *p == '0' || *p == '\'' || *p == 'I')) {
+        p++;
+    }
+    if (*p == '*') {
+        spec->star++;
+        p++;
+    }
+    while (*p && isdigit((unsigned char)(*p))) {
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        *prec = 0;
+        if (*p == '*') {
+            spec->star++;
+            *prec = -2; // taken from the arguments
+            p++;
+        }
+        while (*p && isdigit((unsigned char)(*p))) {
+            *prec = *prec * 10 + (*p++ - '0');
+        }
+    }
+
+    if (p[0] == 'h') {
+        spec->length = (p[1] == 'h') ? LOG_LEN_HH : LOG_LEN_H;
+        p += (p[1] == 'h') ? 2 : 1;
+    } else if (p[0] == 'l') {
+        spec->length = (p[1] == 'l') ? LOG_LEN_LL : LOG_LEN_L;
+        p += (p[1] == 'l') ? 2 : 1;
+    } else if (p[0] == 'j') {
+        spec->length = LOG_LEN_J;
+        p++;
+    } else if (p[0] == 'z') {
+        spec->length = LOG_LEN_Z;
+        p++;
+    } else if (p[0] == 't') {
+        spec->length = LOG_LEN_T;
+        p++;
+    }
+
+    spec->conv = *p;
+    if ('\0' == *p || p + 1 - start >= LOG_SPEC_MAX) {
+        return NULL;
+    }
+    p++;
+    spec->len = (uint8_t)(p - start);
+
+    return p;
+}
+
+/**
+ * @brief copy the arguments of fmt behind a record
+ *
+ * Integers are widened to 64 bits, strings are copied with their terminator.
+ * With dst NULL only the size is computed.
+ *
+ * @return bytes of the arguments, -1 when the format cannot be deferred
+ */
+static int __log_args_capture(const char *fmt, va_list ap, uint8_t *dst)
+{
+    LOG_SPEC_S spec;
+    int size = 0;
+    int prec = 0;
+    int32_t star = 0;
+    uint64_t val = 0;
+    double dval = 0;
+    const char *str = NULL;
+    uint16_t slen = 0;
+    uint8_t i = 0;
+
+    while (*fmt) {
+        if ('%' != *fmt) {
+            fmt++;
+            continue;
+        }
+        if ('%' == fmt[1]) {
+            fmt += 2;
+            continue;
+        }
+
+        fmt = __log_spec_parse(fmt, &spec, &prec);
+        if (NULL == fmt) {
+            return -1;
+        }
+        for (i = 0; i < spec.star; i++) {
+            star = va_arg(ap, int);
+            if (-2 == prec && i == spec.star - 1) {
+                prec = (star < 0) ? -1 : star;
+            }
+            if (dst) {
+                memcpy(dst + size, &star, sizeof(star));
+            }
+            size += sizeof(star);
+        }
+
+        switch (spec.conv) {
+        case 'd':
+        case 'i':
+            switch (spec.length) {
+            case LOG_LEN_L:
+                val = (uint64_t)(int64_t)va_arg(ap, long);
+                break;
+            case LOG_LEN_LL:
+                val = (uint64_t)va_arg(ap, long long);
+                break;
+            case LOG_LEN_J:
+                val = (uint64_t)va_arg(ap, intmax_t);
+                break;
+            case LOG_LEN_Z:
+                val = (uint64_t)va_arg(ap, size_t);
+                break;
+            case LOG_LEN_T:
+                val = (uint64_t)(int64_t)va_arg(ap, ptrdiff_t);
+                break;
+            default:
+                val = (uint64_t)(int64_t)va_arg(ap, int);
+                break;
+            }
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            switch (spec.length) {
+            case LOG_LEN_L:
+                val = (uint64_t)va_arg(ap, unsigned long);
+                break;
+            case LOG_LEN_LL:
+                val = (uint64_t)va_arg(ap, unsigned long long);
+                break;
+            case LOG_LEN_J:
+                val = (uint64_t)va_arg(ap, uintmax_t);
+                break;
+            case LOG_LEN_Z:
+                val = (uint64_t)va_arg(ap, size_t);
+                break;
+            case LOG_LEN_T:
+                val = (uint64_t)va_arg(ap, ptrdiff_t);
+                break;
+            default:
+                val = (uint64_t)va_arg(ap, unsigned int);
+                break;
+            }
+            break;
+        case 'c':
+            if (LOG_LEN_NONE != spec.length) {
+                return -1;
+            }
+            val = (uint64_t)va_arg(ap, int);
+            break;
+        case 'p':
+            val = (uint64_t)(uintptr_t)va_arg(ap, void *);
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (LOG_LEN_NONE != spec.length && LOG_LEN_L != spec.length) {
+                return -1;
+            }
+            dval = va_arg(ap, double);
+            if (dst) {
+                memcpy(dst + size, &dval, sizeof(dval));
+            }
+            size += sizeof(dval);
+            continue;
+        case 's':
+            if (LOG_LEN_NONE != spec.length) {
+                return -1;
+            }
+            str = va_arg(ap, const char *);
+            if (NULL == str) {
+                slen = LOG_STR_NULL;
+            } else {
+                // the precision may cut a buffer that is not terminated
+                size_t n = 0;
+                while ((prec < 0 || n < (size_t)prec) && str[n] && n < LOG_REC_MAX) {
+                    n++;
+                }
+                if (n >= LOG_REC_MAX) {
+                    return -1;
+                }
+                slen = (uint16_t)n;
+            }
+            if (dst) {
+                memcpy(dst + size, &slen, sizeof(slen));
+            }
+            size += sizeof(slen);
+            if (LOG_STR_NULL != slen) {
+                if (dst) {
+                    memcpy(dst + size, str, slen);
+                    dst[size + slen] = '\0';
+                }
+                size += slen + 1;
+            }
+            continue;
+        default:
+            return -1;
+        }
+
+        if (dst) {
+            memcpy(dst + size, &val, sizeof(val));
+        }
+        size += sizeof(val);
+    }
+
+    return size;
+}
+
+#define LOG_SNPRINTF(dst, rem, spec_buf, nstar, star, val)                                                             \
+    ((0 == (nstar))   ? snprintf(dst, rem, spec_buf, val)                                                              \
+     : (1 == (nstar)) ? snprintf(dst, rem, spec_buf, star[0], val)                                                     \
+                      : snprintf(dst, rem, spec_buf, star[0], star[1], val))
+
+// format a captured record, the counterpart of __log_args_capture. Returns the length written
+static int __log_args_format(const char *fmt, const uint8_t *args, char *dst, int dst_len)
+{
+    LOG_SPEC_S spec;
+    char spec_buf[LOG_SPEC_MAX];
+    const char *next = NULL;
+    int len = 0;
+    int cnt = 0;
+    int prec = 0;
+    int32_t star[2] = {0};
+    uint64_t val = 0;
+    double dval = 0;
+    uint16_t slen = 0;
+    uint8_t i = 0;
+
+    while (*fmt && len < dst_len - 1) {
+        if ('%' != *fmt) {
+            dst[len++] = *fmt++;
+            continue;
+        }
+        if ('%' == fmt[1]) {
+            dst[len++] = '%';
+            fmt += 2;
+            continue;
+        }
+
+        next = __log_spec_parse(fmt, &spec, &prec);
+        memcpy(spec_buf, fmt, spec.len);
+        spec_buf[spec.len] = '\0';
+        fmt = next;
+        for (i = 0; i < spec.star; i++) {
+            memcpy(&star[i], args, sizeof(int32_t));
+            args += sizeof(int32_t);
+        }
+
+        char *out = dst + len;
+        int rem = dst_len - len;
+        switch (spec.conv) {
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            memcpy(&dval, args, sizeof(dval));
+            args += sizeof(dval);
+            cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, dval);
+            break;
+        case 's':
+            memcpy(&slen, args, sizeof(slen));
+            args += sizeof(slen);
+            if (LOG_STR_NULL == slen) {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (const char *)NULL);
+            } else {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (const char *)args);
+                args += slen + 1;
+            }
+            break;
+        default:
+            memcpy(&val, args, sizeof(val));
+            args += sizeof(val);
+            if ('p' == spec.conv) {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (void *)(uintptr_t)val);
+            } else if ('c' == spec.conv) {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (int)val);
+            } else if (LOG_LEN_L == spec.length) {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (long)val);
+            } else if (LOG_LEN_LL == spec.length) {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (long long)val);
+            } else if (LOG_LEN_J == spec.length) {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (intmax_t)val);
+            } else if (LOG_LEN_Z == spec.length) {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (size_t)val);
+            } else if (LOG_LEN_T == spec.length) {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (ptrdiff_t)val);
+            } else {
+                cnt = LOG_SNPRINTF(out, rem, spec_buf, spec.star, star, (int)val);
+            }
+            break;
+        }
+
+        if (cnt < 0) {
+            break;
+        }
+        len += (cnt >= rem) ? rem - 1 : cnt;
+    }
+    dst[len] = '\0';
+
+    return len;
+}
+
+// FNV-1a of "file:fmt", tools/log_decoder.py computes the same over the sources
+static uint32_t __log_bin_id(const char *file, const char *fmt)
+{
+    LOG_BIN_ID_S *cache =
+        &sg_log_bin_id[(((uintptr_t)fmt >> 2) ^ ((uintptr_t)file >> 2)) & (LOG_BIN_ID_CACHE - 1)];
+    const char *p = NULL;
+    uint32_t id = 2166136261u;
+
+    if (cache->fmt == fmt && cache->file == file) {
+        return cache->id;
+    }
+
+    for (p = file; *p; p++) {
+        id = (id ^ (uint8_t)(*p)) * 16777619u;
+    }
+    id = (id ^ ':') * 16777619u;
+    for (p = fmt; *p; p++) {
+        id = (id ^ (uint8_t)(*p)) * 16777619u;
+    }
+
+    cache->file = file;
+    cache->fmt = fmt;
+    cache->id = id;
+
+    return id;
+}
+
+static int __log_bin_varint(uint8_t *dst, int pos, int len, uint64_t val)
+{
+    do {
+        if (pos >= len) {
+            return -1;
+        }
+        dst[pos++] = (uint8_t)((val & 0x7F) | ((val > 0x7F) ? 0x80 : 0));
+        val >>= 7;
+    } while (val);
+
+    return pos;
+}
+
+/**
+ * @brief encode a captured log as one binary frame
+ *
+ * @param[in] args, arguments in the layout of __log_args_capture
+ * @param[out] frame, start of the frame inside dst
+ *
+ * @return frame length, -1 when dst is too small
+ */
+static int __log_bin_encode(LOG_LEVEL logLevel, const char *file, uint32_t line, SYS_TIME_T time_ms, const char *fmt,
+                            const uint8_t *args, uint8_t *dst, int dst_len, uint8_t **frame)
+{
+    LOG_SPEC_S spec;
+    const char *next = NULL;
+    int pos = LOG_BIN_HEAD_MAX;
+    int prec = 0;
+    int32_t star = 0;
+    uint64_t val = 0;
+    uint16_t slen = 0;
+    uint32_t id = __log_bin_id(file, fmt);
+    uint8_t flags = (uint8_t)logLevel;
+    uint8_t i = 0;
+
+    if (dst_len <= LOG_BIN_HEAD_MAX + 4) {
+        return -1;
+    }
+
+    // the timestamp is a delta to the previous frame, absolute now and then
+    if (0 == pLogManage->bin_frames % LOG_BIN_ABS_PERIOD || time_ms < pLogManage->bin_last_ms) {
+        flags |= LOG_BIN_ABS_TIME;
+        val = time_ms;
+    } else {
+        val = time_ms - pLogManage->bin_last_ms;
+    }
+    dst[pos++] = flags;
+    pos = __log_bin_varint(dst, pos, dst_len, val);
+    if (pos < 0 || pos + 4 > dst_len) {
+        return -1;
+    }
+    memcpy(dst + pos, &id, sizeof(id));
+    pos += sizeof(id);
+    pos = __log_bin_varint(dst, pos, dst_len, line);
+
+    while (pos >= 0 && *fmt) {
+        if ('%' != *fmt) {
+            fmt++;
+            continue;
+        }
+        if ('%' == fmt[1]) {
+            fmt += 2;
+            continue;
+        }
+
+        next = __log_spec_parse(fmt, &spec, &prec);
+        fmt = next;
+        for (i = 0; i < spec.star && pos >= 0; i++) {
+            memcpy(&star, args, sizeof(star));
+            args += sizeof(star);
+            pos = __log_bin_varint(dst, pos, dst_len, LOG_ZIGZAG(star));
+        }
+        if (pos < 0) {
+            break;
+        }
+
+        switch (spec.conv) {
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            // raw IEEE 754 double, little endian on every supported chip
+            if (pos + 8 > dst_len) {
+                return -1;
+            }
+            memcpy(dst + pos, args, 8);
+            args += 8;
+            pos += 8;
+            break;
+        case 's':
+            memcpy(&slen, args, sizeof(slen));
+            args += sizeof(slen);
+            if (LOG_STR_NULL == slen) {
+                pos = __log_bin_varint(dst, pos, dst_len, 0);
+                break;
+            }
+            pos = __log_bin_varint(dst, pos, dst_len, (uint64_t)slen + 1);
+            if (pos < 0 || pos + slen > dst_len) {
+                return -1;
+            }
+            memcpy(dst + pos, args, slen);
+            args += slen + 1;
+            pos += slen;
+            break;
+        case 'd':
+        case 'i':
+            memcpy(&val, args, sizeof(val));
+            args += sizeof(val);
+            pos = __log_bin_varint(dst, pos, dst_len, LOG_ZIGZAG(val));
+            break;
+        default:
+            memcpy(&val, args, sizeof(val));
+            args += sizeof(val);
+            pos = __log_bin_varint(dst, pos, dst_len, val);
+            break;
+        }
+    }
+    if (pos < 0) {
+        return -1;
+    }
+
+    // sync byte and payload length right in front of the payload
+    uint8_t head[4];
+    int head_len = __log_bin_varint(head, 0, sizeof(head), pos - LOG_BIN_HEAD_MAX);
+    if (head_len < 0) {
+        return -1;
+    }
+    *frame = dst + LOG_BIN_HEAD_MAX - head_len - 1;
+    (*frame)[0] = LOG_BIN_SYNC;
+    memcpy(*frame + 1, head, head_len);
+
+    pLogManage->bin_last_ms = time_ms;
+    pLogManage->bin_frames++;
+
+    return pos - (int)(*frame - dst);
+}
+
+// binary output of a captured log, called with the log mutex held
+static OPERATE_RET __log_bin_output(LOG_LEVEL logLevel, const char *file, uint32_t line, SYS_TIME_T time_ms,
+                                    const char *fmt, const uint8_t *args, uint8_t *dst, int dst_len)
+{
+    uint8_t *frame = NULL;
+    int len = __log_bin_encode(logLevel, file, line, time_ms, fmt, args, dst, dst_len, &frame);
+
+    if (len < 0) {
+        return OPRT_NOT_SUPPORTED;
+    }
+    pLogManage->bin_out(frame, (uint32_t)len);
+
+    return OPRT_OK;
+}
+
+static BOOL_T __log_async_ready(LOG_ASYNC_S *async)
+{
+    uint32_t tail = __atomic_load_n(&async->tail, __ATOMIC_ACQUIRE);
+    LOG_REC_S *rec = (LOG_REC_S *)(async->ring + (tail & (async->ring_size - 1)));
+
+    return __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) == tail + 1;
+}
+
+static void __log_async_output(LOG_REC_S *rec)
+{
+    if (pLogManage->bin_out && OPRT_OK == __log_bin_output(rec->level, rec->file, rec->line, rec->time_ms, rec->fmt,
+                                                           (const uint8_t *)(rec + 1),
+                                                           (uint8_t *)pLogManage->log_buf, pLogManage->log_buf_len)) {
+        return;
+    }
+
+    int len = __log_fmt_prefix(rec->level, rec->file, rec->line, rec->time_ms);
+    if (len < 0) {
+        return;
+    }
+    len += __log_args_format(rec->fmt, (const uint8_t *)(rec + 1), pLogManage->log_buf + len,
+                             pLogManage->log_buf_len - len);
+    if (__log_fmt_suffix(len) > 0) {
+        __output_logManage_buf();
+    }
+}
+
+static void __log_async_wake(LOG_ASYNC_S *async)
+{
+    if (__atomic_exchange_n(&async->drain_sleep, FALSE, __ATOMIC_ACQ_REL)) {
+        tal_semaphore_post(async->sem);
+    }
+}
+
+// format and output up to max complete records, 0 for all, called with the log mutex held
+static void __log_async_drain(LOG_ASYNC_S *async, uint32_t max)
+{
+    LOG_REC_S *rec = NULL;
+    uint32_t tail = 0;
+    uint32_t size = 0;
+    uint32_t dropped = 0;
+    uint32_t cnt = 0;
+
+    if (NULL == async) {
+        return;
+    }
+
+    while (__log_async_ready(async)) {
+        if (max && cnt++ >= max) {
+            // a log printed in place goes ahead of the rest, the writer thread catches up
+            __log_async_wake(async);
+            break;
+        }
+        tail = __atomic_load_n(&async->tail, __ATOMIC_RELAXED);
+        rec = (LOG_REC_S *)(async->ring + (tail & (async->ring_size - 1)));
+        if (LOG_REC_MSG == rec->type) {
+            __log_async_output(rec);
+            async->stat.drained++;
+        }
+        // clear the record, its bytes must not pass for a complete one once a later record starts here
+        size = rec->size;
+        __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+        memset((uint8_t *)rec + sizeof(rec->seq), 0, size - sizeof(rec->seq));
+        __atomic_store_n(&async->tail, tail + size, __ATOMIC_RELEASE);
+    }
+
+    dropped = __atomic_load_n(&async->stat.dropped, __ATOMIC_RELAXED);
+    if (dropped != async->dropped_reported) {
+        int len = __log_fmt_prefix(TAL_LOG_LEVEL_WARN, __log_file_name(__FILE__), __LINE__, 0);
+        if (len >= 0) {
+            int cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, "%" PRIu32 " logs dropped",
+                               dropped - async->dropped_reported);
+            if (cnt > 0 && __log_fmt_suffix(len + cnt) > 0) {
+                __output_logManage_buf();
+            }
+        }
+        async->dropped_reported = dropped;
+    }
+}
+
+// binary output in the caller, log_buf holds the arguments in its upper half and the frame in the lower one
+static OPERATE_RET __log_bin_output_v(LOG_LEVEL logLevel, const char *file, uint32_t line, const char *fmt, va_list ap)
+{
+    OPERATE_RET rt = OPRT_OK;
+    va_list cp;
+    int half = pLogManage->log_buf_len / 2;
+    uint8_t *args = (uint8_t *)pLogManage->log_buf + half;
+
+    va_copy(cp, ap);
+    int args_len = __log_args_capture(fmt, cp, NULL);
+    va_end(cp);
+    if (args_len < 0 || args_len > half) {
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    tal_mutex_lock(pLogManage->mutex);
+    if (NULL == pLogManage->bin_out) {
+        tal_mutex_unlock(pLogManage->mutex);
+        return OPRT_NOT_SUPPORTED;
+    }
+    if (pLogManage->async) {
+        __log_async_drain(pLogManage->async, LOG_SYNC_DRAIN_MAX);
+    }
+    va_copy(cp, ap);
+    __log_args_capture(fmt, cp, args);
+    va_end(cp);
+    rt = __log_bin_output(logLevel, file, line, tal_time_get_posix_ms(), fmt, args, (uint8_t *)pLogManage->log_buf,
+                          half);
+    tal_mutex_unlock(pLogManage->mutex);
+
+    return rt;
+}
+
+/**
+ * @brief capture a log into the ring without formatting it
+ *
+ * @return OPRT_OK when queued, OPRT_EXCEED_UPPER_LIMIT when dropped because the
+ * ring is full, OPRT_NOT_SUPPORTED when the format must be printed in place
+ */
+static OPERATE_RET __log_async_push(LOG_ASYNC_S *async, LOG_LEVEL logLevel, const char *file, uint32_t line,
+                                    const char *pFmt, va_list ap)
+{
+    va_list cp;
+    int args_len = 0;
+    uint32_t size = 0;
+    uint32_t head = 0, tail = 0, off = 0, pad = 0, used = 0;
+    LOG_REC_S *rec = NULL;
+
+    va_copy(cp, ap);
+    args_len = __log_args_capture(pFmt, cp, NULL);
+    va_end(cp);
+    if (args_len < 0) {
+        return OPRT_NOT_SUPPORTED;
+    }
+    size = (sizeof(LOG_REC_S) + args_len + LOG_REC_ALIGN - 1) & ~(LOG_REC_ALIGN - 1);
+    if (size > LOG_REC_MAX) {
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    // reserve, a record never wraps so the rest of the ring is skipped with a pad record
+    head = __atomic_load_n(&async->head, __ATOMIC_RELAXED);
+    do {
+        tail = __atomic_load_n(&async->tail, __ATOMIC_ACQUIRE);
+        off = head & (async->ring_size - 1);
+        pad = (off + size > async->ring_size) ? async->ring_size - off : 0;
+        used = head + pad + size - tail;
+        if (used > async->ring_size) {
+            __atomic_fetch_add(&async->stat.dropped, 1, __ATOMIC_RELAXED);
+            return OPRT_EXCEED_UPPER_LIMIT;
+        }
+    } while (!__atomic_compare_exchange_n(&async->head, &head, head + pad + size, TRUE, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+
+    if (pad) {
+        rec = (LOG_REC_S *)(async->ring + off);
+        rec->size = (uint16_t)pad;
+        rec->type = LOG_REC_PAD;
+        __atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+        head += pad;
+    }
+
+    rec = (LOG_REC_S *)(async->ring + (head & (async->ring_size - 1)));
+    rec->size = (uint16_t)size;
+    rec->type = LOG_REC_MSG;
+    rec->level = (uint8_t)logLevel;
+    rec->line = line;
+    rec->time_ms = tal_time_get_posix_ms();
+    rec->file = file;
+    rec->fmt = pFmt;
+    va_copy(cp, ap);
+    __log_args_capture(pFmt, cp, (uint8_t *)(rec + 1));
+    va_end(cp);
+    __atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+
+    __atomic_fetch_add(&async->stat.queued, 1, __ATOMIC_RELAXED);
+    if (used > __atomic_load_n(&async->stat.ring_peak, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&async->stat.ring_peak, used, __ATOMIC_RELAXED);
+    }
+    __log_async_wake(async);
+
+    return OPRT_OK;
+}
+
+static void __log_drain_thread(void *arg)
+{
+    LOG_ASYNC_S *async = (LOG_ASYNC_S *)arg;
+
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(async->thread)) {
+        tal_mutex_lock(pLogManage->mutex);
+        __log_async_drain(async, 0);
+        tal_mutex_unlock(pLogManage->mutex);
+
+        // producers post only while the flag is set, check again after setting it so no record waits a full period
+        __atomic_store_n(&async->drain_sleep, TRUE, __ATOMIC_SEQ_CST);
+        if (!__log_async_ready(async)) {
+            tal_semaphore_wait(async->sem, LOG_DRAIN_WAIT_MS);
+        }
+        __atomic_store_n(&async->drain_sleep, FALSE, __ATOMIC_SEQ_CST);
+    }
+}
+
+static OPERATE_RET __print_log_v(LOG_LEVEL logLevel, const char *pFile, uint32_t line, const char *pFmt, va_list ap,
+                                 BOOL_T can_defer)
+{
+    int len = 0;
+    int cnt = 0;
+
+    if (!pLogManage) {
+        return OPRT_INVALID_PARM;
+    }
+    if (logLevel < LOG_LEVEL_MIN || logLevel > LOG_LEVEL_MAX) {
+        return OPRT_INVALID_PARM;
+    }
+    LOG_LEVEL tmpLogLevel = pLogManage->curLogLevel;
+    if (logLevel > tmpLogLevel) {
+        return OPRT_BASE_LOG_MNG_PRINT_LOG_LEVEL_HIGHER;
+    }
+    const char *pTmpFilename = __log_file_name(pFile);
+
+    // the format and file must outlive the call, which holds for the constant formats of the PR_xxx macros
+    LOG_ASYNC_S *async = __atomic_load_n(&pLogManage->async, __ATOMIC_ACQUIRE);
+    if (can_defer && async && logLevel > async->sync_level) {
+        OPERATE_RET op_ret = __log_async_push(async, logLevel, pTmpFilename, line, pFmt, ap);
+        if (OPRT_NOT_SUPPORTED != op_ret) {
+            return op_ret;
+        }
+    }
+    if (can_defer && pLogManage->bin_out) {
+        if (OPRT_OK == __log_bin_output_v(logLevel, pTmpFilename, line, pFmt, ap)) {
+            return OPRT_OK;
+        }
+    }
+
+    tal_mutex_lock(pLogManage->mutex);
+
+    // keep the order as far as a bounded drain goes, what was queued before this log mostly goes out first
+    if (async) {
+        __log_async_drain(async, LOG_SYNC_DRAIN_MAX);
+        async->stat.sync++;
+    }
+
+    len = __log_fmt_prefix(logLevel, pTmpFilename, line, 0);
+    if (len < 0) {
+        goto ERR_EXIT;
+    }
 
     // Check if there's enough space left for the formatted message
     int remaining = pLogManage->log_buf_len - len;
@@ -521,16 +1341,9 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char
     }
     len += cnt;
 
-    char *p_suffix = (pLogManage->log_color.enable_color) ? "\033[0m\r\n" : "\r\n";
-    if (len > (int)(pLogManage->log_buf_len - strlen(p_suffix) - 1)) { // 1 -> "\0"
-        len = pLogManage->log_buf_len - strlen(p_suffix) - 1;
-    }
-    cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, "%s", p_suffix);
-    if (cnt <= 0) {
+    if (__log_fmt_suffix(len) < 0) {
         goto ERR_EXIT;
     }
-    len += cnt;
-    pLogManage->log_buf[len] = '\0';
 
     __output_logManage_buf();
     tal_mutex_unlock(pLogManage->mutex);
@@ -542,6 +1355,51 @@ ERR_EXIT:
     return OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED;
 }
 
+/**
+ * @brief Prints a log message with the specified log level, file name, line
+ * number, and format string.
+ *
+ * This function is used to print log messages with different log levels. It
+ * takes the log level, file name, line number, format string, and a variable
+ * argument list as parameters. The log level determines the severity of the log
+ * message. The file name and line number indicate the location where the log
+ * message is printed. The format string specifies the format of the log
+ * message, and the variable argument list contains the values to be formatted
+ * and printed.
+ *
+ * @param logLevel The log level of the message.
+ * @param pFile The name of the source file where the log message is printed.
+ * @param line The line number in the source file where the log message is
+ * printed.
+ * @param pFmt The format string for the log message.
+ * @param ap The variable argument list for the format string.
+ * @return The result of the log printing operation.
+ *     - OPRT_OK if the log message was printed successfully.
+ *     - OPRT_INVALID_PARM if the log level is invalid or the log manager is not
+ * initialized.
+ *     - OPRT_BASE_LOG_MNG_PRINT_LOG_LEVEL_HIGHER if the log level is higher
+ * than the current log level.
+ *     - OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED if there was an error formatting
+ * the log message.
+ */
+OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char *pFmt, va_list ap)
+{
+    return __print_log_v(logLevel, pFile, line, pFmt, ap, FALSE);
+}
+
+static OPERATE_RET __log_print_const(const TAL_LOG_LEVEL_E level, const char *file, const int line, const char *fmt,
+                                     ...)
+{
+    OPERATE_RET opRet = 0;
+    va_list ap;
+
+    va_start(ap, fmt);
+    opRet = __print_log_v(level, file, line, fmt, ap, TRUE);
+    va_end(ap);
+
+    return opRet;
+}
+
 /**
  * @brief Prints a log message with the specified log level, file, line number,
  * and format string.
@@ -592,7 +1450,7 @@ OPERATE_RET tal_log_print_secure(BOOL_T is_const_fmt, const TAL_LOG_LEVEL_E leve
         }
         va_list ap;
         va_start(ap, fmt);
-        OPERATE_RET ret = PrintLogV(level, (char *)file, line, fmt, ap);
+        OPERATE_RET ret = __print_log_v(level, file, line, fmt, ap, TRUE);
         va_end(ap);
         return ret;
     }
@@ -640,6 +1498,7 @@ OPERATE_RET tal_log_print_raw(const char *pFmt, ...)
     va_list ap;
 
     tal_mutex_lock(pLogManage->mutex);
+    __log_async_drain(pLogManage->async, LOG_SYNC_DRAIN_MAX);
     va_start(ap, pFmt);
     opRet = __PrintLogVRaw(pFmt, ap);
     va_end(ap);
@@ -681,9 +1540,9 @@ OPERATE_RET tal_log_print_escape(const TAL_LOG_LEVEL_E level, const char *file,
 
     OPERATE_RET log_ret = OPRT_INVALID_PARM;
     if (prefix && prefix[0] != '\0') {
-        log_ret = tal_log_print(level, file, line, "%s%s", prefix, escaped);
+        log_ret = __log_print_const(level, file, line, "%s%s", prefix, escaped);
     } else {
-        log_ret = tal_log_print(level, file, line, "%s", escaped);
+        log_ret = __log_print_const(level, file, line, "%s", escaped);
     }
 
     tal_free(escaped);
@@ -704,6 +1563,20 @@ void tal_log_release(void)
         return;
     }
 
+    if (pLogManage->async) {
+        LOG_ASYNC_S *async = pLogManage->async;
+        tal_thread_delete(async->thread);
+        tal_semaphore_post(async->sem);
+        while (THREAD_STATE_DELETE != tal_thread_get_state(async->thread)) {
+            tal_system_sleep(10);
+        }
+        tal_log_flush();
+        pLogManage->async = NULL;
+        tal_semaphore_release(async->sem);
+        tal_free(async->ring);
+        tal_free(async);
+    }
+
     while (!tuya_list_empty(&(pLogManage->log_list))) {
         LOG_OUT_NODE_S *log_out_nd = NULL;
         log_out_nd = tuya_list_entry(&(pLogManage->log_list.next), LOG_OUT_NODE_S, node);
@@ -717,6 +1590,135 @@ void tal_log_release(void)
     pLogManage = NULL;
 }
 
+/**
+ * @brief Switches the log to the asynchronous backend.
+ *
+ * Deferrable logs below sync_level are captured into a lock-free ring as
+ * format pointer plus raw arguments, and formatted and output by a low
+ * priority drain thread.
+ *
+ * @param ring_size Bytes of the record ring, a power of two in [1K, 64K].
+ * @param sync_level Logs at or above this level are printed in place.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_log_async_enable(uint32_t ring_size, TAL_LOG_LEVEL_E sync_level)
+{
+    OPERATE_RET rt = OPRT_OK;
+    LOG_ASYNC_S *async = NULL;
+
+    if (!pLogManage) {
+        return OPRT_INVALID_PARM;
+    }
+    if (pLogManage->async) {
+        return OPRT_OK;
+    }
+    if (ring_size < 1024 || ring_size > 65536 || (ring_size & (ring_size - 1))) {
+        return OPRT_INVALID_PARM;
+    }
+
+    async = tal_malloc(sizeof(LOG_ASYNC_S));
+    TUYA_CHECK_NULL_RETURN(async, OPRT_MALLOC_FAILED);
+    memset(async, 0, sizeof(LOG_ASYNC_S));
+
+    async->ring = tal_malloc(ring_size);
+    TUYA_CHECK_NULL_GOTO(async->ring, __ERR);
+    // a zero seq never matches a position + 1, so the ring starts empty
+    memset(async->ring, 0, ring_size);
+    async->ring_size = ring_size;
+    async->stat.ring_size = ring_size;
+    async->sync_level = sync_level;
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&async->sem, 0, 1), __ERR);
+
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.stackDepth = LOG_DRAIN_STACK;
+    thrd_param.priority = THREAD_PRIO_5;
+    thrd_param.thrdname = "log_drain";
+    TUYA_CALL_ERR_GOTO(tal_thread_create_and_start(&async->thread, NULL, NULL, __log_drain_thread, async, &thrd_param),
+                       __ERR);
+
+    __atomic_store_n(&pLogManage->async, async, __ATOMIC_RELEASE);
+    return OPRT_OK;
+
+__ERR:
+    if (async->sem) {
+        tal_semaphore_release(async->sem);
+    }
+    if (async->ring) {
+        tal_free(async->ring);
+    }
+    tal_free(async);
+    return (OPRT_OK != rt) ? rt : OPRT_MALLOC_FAILED;
+}
+
+/**
+ * @brief Switches deferrable logs to compact binary frames.
+ *
+ * Logs with a constant format are emitted as a format id, a varint timestamp
+ * delta and the raw arguments instead of text, tools/log_decoder.py rebuilds
+ * the text from an id table generated from the sources. Other logs keep
+ * going to the text output terminals.
+ *
+ * @param output Sink of the binary frames, NULL goes back to text.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_log_bin_output_set(const TAL_LOG_BIN_OUTPUT_CB output)
+{
+    if (!pLogManage) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(pLogManage->mutex);
+    pLogManage->bin_out = output;
+    pLogManage->bin_frames = 0;
+    tal_mutex_unlock(pLogManage->mutex);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Gets the statistics of the asynchronous log backend.
+ *
+ * @param stat Statistics, all zero when the backend is not enabled.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_log_async_stat_get(TAL_LOG_ASYNC_STAT_T *stat)
+{
+    if (!pLogManage || NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    memset(stat, 0, sizeof(TAL_LOG_ASYNC_STAT_T));
+    if (pLogManage->async) {
+        tal_mutex_lock(pLogManage->mutex);
+        memcpy(stat, &pLogManage->async->stat, sizeof(TAL_LOG_ASYNC_STAT_T));
+        tal_mutex_unlock(pLogManage->mutex);
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Outputs every queued log in the calling thread.
+ *
+ * @return None.
+ */
+void tal_log_flush(void)
+{
+    if (!pLogManage || NULL == pLogManage->async) {
+        return;
+    }
+
+    tal_mutex_lock(pLogManage->mutex);
+    __log_async_drain(pLogManage->async, 0);
+    tal_mutex_unlock(pLogManage->mutex);
+}
+
 /**
  * @brief Logs a hexadecimal dump of a buffer.
  *
@@ -854,6 +1856,7 @@ OPERATE_RET tal_log_color_print_raw(TAL_LOG_DISPLAY_MODE_E display_mode, TAL_LOG
     }
 
     tal_mutex_lock(pLogManage->mutex);
+    __log_async_drain(pLogManage->async, LOG_SYNC_DRAIN_MAX);
     va_start(ap, pFmt);
     if (pLogManage->log_color.enable_color) {
         cnt = snprintf(pLogManage->log_buf, pLogManage->log_buf_len, "\033[%d;%d;%dm", display_mode, font_color,
@@ -12,6 +12,28 @@
 #define STACK_SIZE_TIMERQ (4 * 1024)
 #endif
 
+/*
+ * Active timers live in a hierarchical timing wheel with a 1 ms tick. Level 0
+ * holds timers due within the current 64 ms block, each level above covers 64
+ * times the span of the one below, and timers beyond the top level wait in the
+ * overflow list. A timer is moved one level down when the wheel reaches its
+ * slot, so it always fires on its exact tick. Start and stop are O(1), the
+ * dispatch thread jumps straight to the next occupied slot using the per level
+ * bitmaps and takes the mutex once per batch of expired timers.
+ */
+#ifndef TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_LEVELS 4
+#endif
+#define TIMER_WHEEL_BITS  6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK  (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_SPAN  (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)
+
+#define TIMER_LEVEL_NONE  0xFF // standby, pending or overflow
+#define TIMER_BATCH_MAX   16
+#define TIMER_TICK_NONE   ((uint64_t)-1)
+#define TIMER_WAIT_MAX    (60 * 60 * 1000) // re-evaluate at least hourly
+
 typedef struct {
     LIST_HEAD node;
 
@@ -23,57 +45,221 @@ typedef struct {
     BOOL_T is_running;
     TIMER_ID timer_id;
     TIMER_TYPE type;
+
+    uint8_t level; // wheel level of node, TIMER_LEVEL_NONE when not in a slot
+    uint8_t slot;
+    BOOL_T in_batch; // picked by the dispatch thread, freed by it when deleted meanwhile
+    BOOL_T deleted;
+    uint32_t fire_seq; // cleared by stop/delete/start/trigger to cancel a picked callback
 } TIMER_T;
 
 typedef struct {
-    LIST_HEAD list_active;
+    TIMER_T *timer;
+    TAL_TIMER_CB cb;
+    void *data;
+    uint64_t expire_time;
+    uint32_t fire_seq;
+} TIMER_FIRE_T;
+
+typedef struct {
+    LIST_HEAD wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t bitmap[TIMER_WHEEL_LEVELS]; // non-empty slots
+    LIST_HEAD list_overflow;
+    LIST_HEAD list_pending; // expired, waiting for the dispatch thread
+    uint64_t wheel_ms;      // last tick the wheel has processed
+
     LIST_HEAD list_standby;
     MUTEX_HANDLE mutex;
     uint16_t total_cnt;
     uint16_t running_cnt;
+    uint32_t fire_seq;
 
     BOOL_T inited;
     THREAD_HANDLE thread;
     SEM_HANDLE sem;
     TAL_TIMER_CB last_cb; // used to debug which cb is blocked
+
+    TAL_SW_TIMER_STAT_T stat; // only written by the dispatch thread
 } SW_TIMER_MGR_T;
 
 static SW_TIMER_MGR_T s_timer_mgr;
 
-static void __timer_attach(TIMER_T *timer)
+static uint64_t __timer_now_ms(void)
+{
+    TIME_S nowSecTime = 0;
+    TIME_MS nowMsTime = 0;
+
+    tal_time_get_system_time(&nowSecTime, &nowMsTime);
+    return (uint64_t)nowSecTime * 1000 + (uint64_t)nowMsTime;
+}
+
+static void __timer_detach(TIMER_T *timer)
 {
     tuya_list_del(&(timer->node));
+    if (TIMER_LEVEL_NONE != timer->level) {
+        if (tuya_list_empty(&(s_timer_mgr.wheel[timer->level][timer->slot]))) {
+            s_timer_mgr.bitmap[timer->level] &= ~(1ULL << timer->slot);
+        }
+        timer->level = TIMER_LEVEL_NONE;
+    }
+}
 
-    if (tuya_list_empty(&(s_timer_mgr.list_active))) {
-        tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_active));
-    } else {
-        TIMER_T *timer_tmp = NULL;
-        struct tuya_list_head *p = NULL;
-        tuya_list_for_each(p, &(s_timer_mgr.list_active))
-        {
-            timer_tmp = tuya_list_entry(p, TIMER_T, node);
-
-            if (timer_tmp->expire_time >= timer->expire_time) {
-                tuya_list_add(&(timer->node), (&(timer_tmp->node))->prev);
-                break;
+static void __timer_attach(TIMER_T *timer)
+{
+    uint64_t diff = 0;
+    uint8_t level = 0;
+
+    __timer_detach(timer);
+
+    if (timer->expire_time <= s_timer_mgr.wheel_ms) {
+        tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_pending));
+        return;
+    }
+
+    // lowest level where the expire tick shares every upper digit with the wheel
+    diff = timer->expire_time ^ s_timer_mgr.wheel_ms;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (0 == (diff >> (TIMER_WHEEL_BITS * (level + 1)))) {
+            break;
+        }
+    }
+    if (level >= TIMER_WHEEL_LEVELS) {
+        tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_overflow));
+        return;
+    }
+
+    timer->level = level;
+    timer->slot = (timer->expire_time >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    tuya_list_add_tail(&(timer->node), &(s_timer_mgr.wheel[level][timer->slot]));
+    s_timer_mgr.bitmap[level] |= 1ULL << timer->slot;
+}
+
+static void __timer_cascade(LIST_HEAD *list)
+{
+    LIST_HEAD cascade;
+    TIMER_T *timer = NULL;
+
+    // overflow timers may go straight back to the overflow list
+    INIT_LIST_HEAD(&cascade);
+    tuya_list_splice(list, &cascade);
+    INIT_LIST_HEAD(list);
+
+    while (!tuya_list_empty(&cascade)) {
+        timer = tuya_list_entry(cascade.next, TIMER_T, node);
+        __timer_attach(timer);
+    }
+}
+
+/**
+ * @brief first tick after wheel_ms that expires or cascades a timer
+ */
+static uint64_t __timer_wheel_next(void)
+{
+    uint64_t next = TIMER_TICK_NONE;
+    uint64_t tick = 0;
+    uint64_t pending = 0;
+    uint32_t shift = 0;
+    uint8_t level = 0;
+    uint8_t idx = 0;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        shift = TIMER_WHEEL_BITS * level;
+        idx = (s_timer_mgr.wheel_ms >> shift) & TIMER_WHEEL_MASK;
+        // slots at or before the wheel position are empty, upper digits only move on a cascade
+        pending = (TIMER_WHEEL_MASK == idx) ? 0 : s_timer_mgr.bitmap[level] & ~((2ULL << idx) - 1);
+        if (pending) {
+            tick = (s_timer_mgr.wheel_ms >> (shift + TIMER_WHEEL_BITS)) << (shift + TIMER_WHEEL_BITS);
+            tick += (uint64_t)__builtin_ctzll(pending) << shift;
+            if (tick < next) {
+                next = tick;
             }
         }
+    }
 
-        if (p == &(s_timer_mgr.list_active)) {
-            tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_active));
+    if (!tuya_list_empty(&(s_timer_mgr.list_overflow))) {
+        tick = ((s_timer_mgr.wheel_ms >> TIMER_WHEEL_SPAN) + 1) << TIMER_WHEEL_SPAN;
+        if (tick < next) {
+            next = tick;
         }
     }
+
+    return next;
 }
 
-static void __timer_dump(void)
+/**
+ * @brief move the wheel up to now, expired timers end up in list_pending
+ */
+static void __timer_wheel_advance(uint64_t now)
+{
+    uint64_t tick = 0;
+    int level = 0;
+
+    while (s_timer_mgr.wheel_ms < now) {
+        tick = __timer_wheel_next();
+        if (tick > now) {
+            // nothing in between, every occupied slot stays ahead of the new position
+            s_timer_mgr.wheel_ms = now;
+            break;
+        }
+
+        s_timer_mgr.wheel_ms = tick;
+        if (0 == (tick & ((1ULL << TIMER_WHEEL_SPAN) - 1))) {
+            __timer_cascade(&(s_timer_mgr.list_overflow));
+        }
+        for (level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            if (0 == (tick & ((1ULL << (TIMER_WHEEL_BITS * level)) - 1))) {
+                __timer_cascade(
+                    &(s_timer_mgr.wheel[level][(tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK]));
+            }
+        }
+        __timer_cascade(&(s_timer_mgr.wheel[0][tick & TIMER_WHEEL_MASK]));
+    }
+}
+
+static void __timer_late_record(uint64_t now, uint64_t expire_time)
+{
+    uint64_t late = (now > expire_time) ? now - expire_time : 0;
+    uint64_t rest = late;
+    uint32_t bucket = 0;
+
+    // bucket 0 on time, bucket n late by [2^(n-1), 2^n) ms, the last one is open ended
+    while (rest && bucket < TAL_SW_TIMER_LATE_BUCKETS - 1) {
+        rest >>= 1;
+        bucket++;
+    }
+    s_timer_mgr.stat.fired++;
+    s_timer_mgr.stat.late_hist[bucket]++;
+    if (late > s_timer_mgr.stat.max_late_ms) {
+        s_timer_mgr.stat.max_late_ms = (uint32_t)late;
+    }
+}
+
+static void __timer_dump_list(LIST_HEAD *list)
 {
     struct tuya_list_head *p = NULL;
     TIMER_T *timer = NULL;
     TAL_TIMER_CB *cb = NULL;
     TIMER_ID *timer_id = NULL;
 
+    tuya_list_for_each(p, list)
+    {
+        timer = tuya_list_entry(p, TIMER_T, node);
+        cb = &(timer->cb);
+        if (timer->data) {
+            timer_id = timer->data;
+            if (*timer_id == timer->timer_id) {
+                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
+            }
+        }
+        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
+    }
+}
+
+static void __timer_dump(void)
+{
     TIME_S nowSecTime = 0;
     TIME_MS nowMsTime = 0;
+    uint32_t level = 0, slot = 0, i = 0;
 
     tal_time_get_system_time(&nowSecTime, &nowMsTime);
 
@@ -86,87 +272,123 @@ static void __timer_dump(void)
     tal_mutex_lock(s_timer_mgr.mutex);
 
     PR_NOTICE("running timers count:%d", s_timer_mgr.running_cnt);
-    tuya_list_for_each(p, &(s_timer_mgr.list_active))
-    {
-        timer = tuya_list_entry(p, TIMER_T, node);
-        cb = &(timer->cb);
-        if (timer->data) {
-            timer_id = timer->data;
-            if (*timer_id == timer->timer_id) {
-                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
-            }
+    __timer_dump_list(&(s_timer_mgr.list_pending));
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            __timer_dump_list(&(s_timer_mgr.wheel[level][slot]));
         }
-        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
     }
+    __timer_dump_list(&(s_timer_mgr.list_overflow));
 
     PR_NOTICE("standby timers count:%d", s_timer_mgr.total_cnt - s_timer_mgr.running_cnt);
-    tuya_list_for_each(p, &(s_timer_mgr.list_standby))
-    {
-        timer = tuya_list_entry(p, TIMER_T, node);
-        cb = &(timer->cb);
-        if (timer->data) {
-            timer_id = timer->data;
-            if (*timer_id == timer->timer_id) {
-                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
-            }
+    __timer_dump_list(&(s_timer_mgr.list_standby));
+
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    PR_NOTICE("fired:%d batches:%d max late:%dms", s_timer_mgr.stat.fired, s_timer_mgr.stat.batches,
+              s_timer_mgr.stat.max_late_ms);
+    for (i = 0; i < TAL_SW_TIMER_LATE_BUCKETS; i++) {
+        if (s_timer_mgr.stat.late_hist[i]) {
+            PR_NOTICE("late <%dms: %d", 1 << i, s_timer_mgr.stat.late_hist[i]);
         }
-        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
     }
+}
 
-    tal_mutex_unlock(s_timer_mgr.mutex);
+/**
+ * @brief pick up to TIMER_BATCH_MAX expired timers and re-arm the cyclic ones, called with the mutex held
+ */
+static uint32_t __timer_collect(TIMER_FIRE_T *batch, uint64_t now)
+{
+    TIMER_T *timer = NULL;
+    uint32_t cnt = 0;
+
+    while (cnt < TIMER_BATCH_MAX && !tuya_list_empty(&(s_timer_mgr.list_pending))) {
+        timer = tuya_list_entry(s_timer_mgr.list_pending.next, TIMER_T, node);
+        if (timer->in_batch) {
+            // a zero interval cyclic timer expired again, it goes with the next batch
+            break;
+        }
+
+        if (0 == ++s_timer_mgr.fire_seq) {
+            s_timer_mgr.fire_seq = 1;
+        }
+        timer->fire_seq = s_timer_mgr.fire_seq;
+        timer->in_batch = TRUE;
+        batch[cnt].timer = timer;
+        batch[cnt].cb = timer->cb;
+        batch[cnt].data = timer->data;
+        batch[cnt].expire_time = timer->expire_time;
+        batch[cnt].fire_seq = timer->fire_seq;
+        cnt++;
+
+        if (TAL_TIMER_ONCE == timer->type) {
+            timer->is_running = FALSE;
+            s_timer_mgr.running_cnt--;
+            __timer_detach(timer);
+            tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
+        } else {
+            timer->expire_time = now + timer->interval;
+            __timer_attach(timer);
+        }
+    }
+
+    return cnt;
+}
+
+/**
+ * @brief hand the timers of the last batch back, called with the mutex held
+ */
+static void __timer_batch_release(TIMER_FIRE_T *batch, uint32_t cnt)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < cnt; i++) {
+        batch[i].timer->in_batch = FALSE;
+        if (batch[i].timer->deleted) {
+            tal_free(batch[i].timer);
+        }
+    }
 }
 
 static void __timer_dispatch(SYS_TIME_T *next_expired)
 {
-    TIME_S nowSecTime = 0;
-    TIME_MS nowMsTime = 0;
+    TIMER_FIRE_T batch[TIMER_BATCH_MAX];
+    uint32_t cnt = 0, i = 0;
     uint64_t nowMS = 0;
-    TIMER_T *timer = NULL;
-    TAL_TIMER_CB timer_cb = NULL;
-    struct tuya_list_head *p = NULL;
+    uint64_t next = 0;
 
     *next_expired = SEM_WAIT_FOREVER;
 
     do {
-        tal_time_get_system_time(&nowSecTime, &nowMsTime);
-        nowMS = (uint64_t)nowSecTime * 1000 + (uint64_t)nowMsTime;
+        nowMS = __timer_now_ms();
 
         tal_mutex_lock(s_timer_mgr.mutex);
-
-        timer_cb = NULL;
-        tuya_list_for_each(p, &(s_timer_mgr.list_active))
-        {
-            timer = tuya_list_entry(p, TIMER_T, node);
-
-            if (timer->expire_time > nowMS) {
-                p = &(s_timer_mgr.list_active);
-                *next_expired = timer->expire_time - nowMS;
-            } else {
-                timer_cb = timer->cb;
-
-                if (TAL_TIMER_ONCE == timer->type) {
-                    timer->is_running = FALSE;
-                    s_timer_mgr.running_cnt--;
-                    tuya_list_del(&(timer->node));
-                    tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
-                } else {
-                    timer->expire_time = nowMS + timer->interval;
-                    __timer_attach(timer);
-                }
+        __timer_batch_release(batch, cnt);
+        __timer_wheel_advance(nowMS);
+        cnt = __timer_collect(batch, nowMS);
+        if (0 == cnt) {
+            next = __timer_wheel_next();
+            if (TIMER_TICK_NONE != next) {
+                next -= nowMS;
+                *next_expired = (next > TIMER_WAIT_MAX) ? TIMER_WAIT_MAX : (SYS_TIME_T)next;
             }
-
-            break;
         }
-
         tal_mutex_unlock(s_timer_mgr.mutex);
 
-        if (timer_cb) {
-            s_timer_mgr.last_cb = timer_cb;
-            timer_cb(timer->timer_id, timer->data);
-            timer_cb = NULL;
+        if (cnt) {
+            s_timer_mgr.stat.batches++;
+        }
+        for (i = 0; i < cnt; i++) {
+            // stopped, deleted, restarted or triggered by an earlier callback of this batch
+            if (__atomic_load_n(&(batch[i].timer->fire_seq), __ATOMIC_RELAXED) != batch[i].fire_seq) {
+                continue;
+            }
+            __timer_late_record(__timer_now_ms(), batch[i].expire_time);
+            s_timer_mgr.last_cb = batch[i].cb;
+            batch[i].cb((TIMER_ID)batch[i].timer, batch[i].data);
             s_timer_mgr.last_cb = NULL;
         }
-    } while (p != &(s_timer_mgr.list_active));
+    } while (cnt);
 }
 
 static void __timer_thread_cb(void *data)
@@ -193,6 +415,7 @@ static void __timer_thread_cb(void *data)
 OPERATE_RET tal_sw_timer_init(void)
 {
     OPERATE_RET op_ret = OPRT_OK;
+    uint32_t level = 0, slot = 0;
 
     if (s_timer_mgr.inited) {
         return OPRT_OK;
@@ -201,8 +424,16 @@ OPERATE_RET tal_sw_timer_init(void)
     tal_mutex_create_init(&s_timer_mgr.mutex);
     tal_semaphore_create_init(&s_timer_mgr.sem, 0, 2);
 
-    INIT_LIST_HEAD(&(s_timer_mgr.list_active));
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            INIT_LIST_HEAD(&(s_timer_mgr.wheel[level][slot]));
+        }
+        s_timer_mgr.bitmap[level] = 0;
+    }
+    INIT_LIST_HEAD(&(s_timer_mgr.list_overflow));
+    INIT_LIST_HEAD(&(s_timer_mgr.list_pending));
     INIT_LIST_HEAD(&(s_timer_mgr.list_standby));
+    s_timer_mgr.wheel_ms = __timer_now_ms();
 
     THREAD_CFG_T thread_cfg = {.stackDepth = STACK_SIZE_TIMERQ, .priority = THREAD_PRIO_0, .thrdname = "sys_timer"};
 
@@ -240,6 +471,7 @@ OPERATE_RET tal_sw_timer_create(TAL_TIMER_CB func, void *arg, TIMER_ID *timer_id
     timer->cb = func;
     timer->data = arg;
     timer->timer_id = (TIMER_ID)timer;
+    timer->level = TIMER_LEVEL_NONE;
 
     tal_mutex_lock(s_timer_mgr.mutex);
     s_timer_mgr.total_cnt++;
@@ -268,16 +500,23 @@ OPERATE_RET tal_sw_timer_delete(TIMER_ID timer_id)
     }
 
     TIMER_T *timer = (TIMER_T *)timer_id;
+    BOOL_T in_batch = FALSE;
 
     tal_mutex_lock(s_timer_mgr.mutex);
-    tuya_list_del(&(timer->node));
+    __timer_detach(timer);
     s_timer_mgr.total_cnt--;
     if (timer->is_running) {
         s_timer_mgr.running_cnt--;
     }
+    __atomic_store_n(&(timer->fire_seq), 0, __ATOMIC_RELAXED);
+    // the dispatch thread still holds it, it frees the timer once the batch is done
+    in_batch = timer->in_batch;
+    timer->deleted = TRUE;
     tal_mutex_unlock(s_timer_mgr.mutex);
     tal_semaphore_post(s_timer_mgr.sem);
-    tal_free(timer);
+    if (!in_batch) {
+        tal_free(timer);
+    }
 
     return OPRT_OK;
 }
@@ -301,11 +540,12 @@ OPERATE_RET tal_sw_timer_stop(TIMER_ID timer_id)
     TIMER_T *timer = (TIMER_T *)timer_id;
 
     tal_mutex_lock(s_timer_mgr.mutex);
+    __atomic_store_n(&(timer->fire_seq), 0, __ATOMIC_RELAXED);
     if (timer->is_running) {
         timer->is_running = FALSE;
 
         s_timer_mgr.running_cnt--;
-        tuya_list_del(&(timer->node));
+        __timer_detach(timer);
         tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
     }
     tal_mutex_unlock(s_timer_mgr.mutex);
@@ -395,13 +635,12 @@ OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE ti
     }
 
     TIMER_T *timer = (TIMER_T *)timer_id;
-
-    TIME_S secTime = 0;
-    TIME_MS msTime = 0;
-    tal_time_get_system_time(&secTime, &msTime);
+    uint64_t nowMS = __timer_now_ms();
 
     tal_mutex_lock(s_timer_mgr.mutex);
 
+    // restarted by an earlier callback of the batch that picked it, it fires on the new time only
+    __atomic_store_n(&(timer->fire_seq), 0, __ATOMIC_RELAXED);
     if (!timer->is_running) {
         timer->is_running = TRUE;
         s_timer_mgr.running_cnt++;
@@ -412,7 +651,7 @@ OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE ti
     }
 
     timer->type = timer_type;
-    timer->expire_time = (uint64_t)secTime * 1000 + (uint64_t)msTime + timer->interval;
+    timer->expire_time = nowMS + timer->interval;
     __timer_attach(timer);
 
     tal_mutex_unlock(s_timer_mgr.mutex);
@@ -438,12 +677,15 @@ OPERATE_RET tal_sw_timer_trigger(TIMER_ID timer_id)
     }
 
     TIMER_T *timer = (TIMER_T *)timer_id;
+    uint64_t nowMS = __timer_now_ms();
 
     tal_mutex_lock(s_timer_mgr.mutex);
-    timer->expire_time = 0;
+    timer->expire_time = nowMS;
     if (timer->is_running) {
-        tuya_list_del(&(timer->node));
-        tuya_list_add(&(timer->node), &(s_timer_mgr.list_active));
+        // requeued, a callback picked in the current batch would fire it twice
+        __atomic_store_n(&(timer->fire_seq), 0, __ATOMIC_RELAXED);
+        __timer_detach(timer);
+        tuya_list_add(&(timer->node), &(s_timer_mgr.list_pending));
     }
     tal_mutex_unlock(s_timer_mgr.mutex);
     tal_semaphore_post(s_timer_mgr.sem);
@@ -486,6 +728,25 @@ int tal_sw_timer_get_num(void)
     return s_timer_mgr.running_cnt;
 }
 
+/**
+ * @brief Get the dispatch statistics of the software timer
+ *
+ * @param[out] stat: callbacks fired and their lateness histogram
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_stat_get(TAL_SW_TIMER_STAT_T *stat)
+{
+    if (NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    memcpy(stat, &(s_timer_mgr.stat), sizeof(TAL_SW_TIMER_STAT_T));
+
+    return OPRT_OK;
+}
+
 // used for debug
 void tal_sw_timer_dump(void)
 {
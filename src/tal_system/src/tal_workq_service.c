@@ -41,6 +41,12 @@
 #define MAX_NODE_NUM_MSG_QUEUE 100
 #endif
 
+// workers of the system workqueue, more than one lets a blocking item (flash write, TLS
+// handshake) run beside the rest of the queue but gives up the FIFO completion order
+#ifndef WORKER_NUM_WORK_QUEUE
+#define WORKER_NUM_WORK_QUEUE 1
+#endif
+
 #ifndef STACK_SIZE_WORK_QUEUE
 #define STACK_SIZE_WORK_QUEUE (5 * 1024)
 #endif
@@ -62,6 +68,7 @@ OPERATE_RET tal_workq_init(void)
 {
     OPERATE_RET rt = OPRT_OK;
     THREAD_CFG_T thread_cfg;
+    WORKQUEUE_CFG_T wq_cfg;
 
     if (wq_system) {
         return OPRT_OK;
@@ -73,7 +80,10 @@ OPERATE_RET tal_workq_init(void)
     thread_cfg.stackDepth += 1024;
 #endif
     thread_cfg.thrdname = "wq_system";
-    TUYA_CALL_ERR_GOTO(tal_workqueue_create(MAX_NODE_NUM_WORK_QUEUE, &thread_cfg, &wq_system), ERR_EXIT);
+    wq_cfg.queue_len = MAX_NODE_NUM_WORK_QUEUE;
+    wq_cfg.worker_num = WORKER_NUM_WORK_QUEUE;
+    wq_cfg.thread_cfg = thread_cfg;
+    TUYA_CALL_ERR_GOTO(tal_workqueue_create_ex(&wq_cfg, &wq_system), ERR_EXIT);
 
     thread_cfg.priority = THREAD_PRIO_1;
     thread_cfg.stackDepth = STACK_SIZE_MSG_QUEUE;
@@ -189,9 +199,24 @@ static BOOL_T _dump_cb(WORK_ITEM_T *item, void *ctx)
 
 void tal_workq_dump(WORKQ_SERVICE_E service)
 {
+    WORKQUEUE_HANDLE handle = tal_workq_get_handle(service);
+    WORKQUEUE_STAT_T stat;
+    uint8_t i = 0;
+
     PR_NOTICE("---------workq-%d dump begin---------", service);
-    tal_workqueue_traverse(tal_workq_get_handle(service), _dump_cb, NULL);
-    tal_thread_diagnose(tal_workqueue_get_thread(tal_workq_get_handle(service)));
+    tal_workqueue_traverse(handle, _dump_cb, NULL);
+    if (OPRT_OK == tal_workqueue_stat_get(handle, &stat)) {
+        PR_NOTICE("scheduled:%d instant:%d rejected:%d done:%d cancelled:%d pending:%d/%d", stat.scheduled,
+                  stat.scheduled_instant, stat.rejected, stat.done, stat.cancelled, stat.pending,
+                  stat.pending_instant);
+        PR_NOTICE("wait avg:%dms max:%dms, run avg:%dms max:%dms cb:%p", stat.wait_avg_ms, stat.wait_max_ms,
+                  stat.run_avg_ms, stat.run_max_ms, stat.run_max_cb);
+        PR_NOTICE("workers:%d busy:%d, longest running cb:%p %dms", stat.worker_num, stat.busy, stat.running_cb,
+                  stat.running_max_ms);
+        for (i = 0; i < stat.worker_num; i++) {
+            tal_thread_diagnose(tal_workqueue_get_worker_thread(handle, i));
+        }
+    }
     PR_NOTICE("---------workq-%d dump end---------", service);
 }
 
@@ -40,36 +40,105 @@
 #include "tal_workqueue.h"
 #include "tal_sw_timer.h"
 
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WORKQUEUE_WORKER_NAME_LEN
+#define WORKQUEUE_WORKER_NAME_LEN 16
+#endif
+
+// queued item, the public part comes first so traverse callbacks see a WORK_ITEM_T
+typedef struct {
+    WORK_ITEM_T item;
+    SYS_TIME_T enqueue_ms;
+} WORK_NODE_T;
+
+// one worker thread, the statistics are only written by the worker itself
 typedef struct {
-    TUYA_QUEUE_HANDLE queue;
     THREAD_HANDLE thread;
-    SEM_HANDLE sem;
-    WORKQUEUE_CB last_cb; // used to debug which cb is blocked
+    void *workqueue;
+    volatile WORKQUEUE_CB cur_cb; // used to debug which cb is blocked
+    volatile SYS_TIME_T cur_start_ms;
+    uint32_t done;
+    uint32_t cancelled;
+    uint64_t wait_total_ms;
+    uint32_t wait_max_ms;
+    uint64_t run_total_ms;
+    uint32_t run_max_ms;
+    WORKQUEUE_CB run_max_cb;
+    char name[WORKQUEUE_WORKER_NAME_LEN];
+} WORK_WORKER_T;
+
+typedef struct {
+    TUYA_QUEUE_HANDLE queue;         // normal lane
+    TUYA_QUEUE_HANDLE queue_instant; // instant lane, always drained first
+    SEM_HANDLE sem;                  // counts items of both lanes
+    uint32_t scheduled;
+    uint32_t scheduled_instant;
+    uint32_t rejected;
+    uint8_t worker_num;
+    WORK_WORKER_T worker[TAL_WORKQUEUE_WORKER_MAX];
 } TAL_WORKQUEUE_T;
 
+static OPERATE_RET __work_take(TAL_WORKQUEUE_T *workqueue, WORK_NODE_T *node)
+{
+    if (OPRT_OK == tuya_queue_output(workqueue->queue_instant, node)) {
+        return OPRT_OK;
+    }
+
+    return tuya_queue_output(workqueue->queue, node);
+}
+
+static void __work_run(WORK_WORKER_T *worker, WORK_NODE_T *node)
+{
+    SYS_TIME_T start_ms = tal_system_get_millisecond();
+    uint32_t wait_ms = (uint32_t)(start_ms - node->enqueue_ms);
+    uint32_t run_ms = 0;
+
+    worker->wait_total_ms += wait_ms;
+    if (wait_ms > worker->wait_max_ms) {
+        worker->wait_max_ms = wait_ms;
+    }
+
+    worker->cur_start_ms = start_ms;
+    worker->cur_cb = node->item.cb;
+    node->item.cb(node->item.data);
+    worker->cur_cb = NULL;
+
+    run_ms = (uint32_t)(tal_system_get_millisecond() - start_ms);
+    worker->run_total_ms += run_ms;
+    if (run_ms >= worker->run_max_ms) {
+        worker->run_max_ms = run_ms;
+        worker->run_max_cb = node->item.cb;
+    }
+    worker->done++;
+}
+
 static void __work_thread_cb(void *data)
 {
     OPERATE_RET op_ret = OPRT_OK;
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)data;
-    WORK_ITEM_T work_item = {0};
+    WORK_WORKER_T *worker = (WORK_WORKER_T *)data;
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)worker->workqueue;
+    WORK_NODE_T node = {0};
 
-    while (THREAD_STATE_RUNNING == tal_thread_get_state(workqueue->thread)) {
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(worker->thread)) {
         op_ret = tal_semaphore_wait(workqueue->sem, SEM_WAIT_FOREVER);
         if (OPRT_OK != op_ret) {
             tal_system_sleep(10);
             continue;
         }
 
-        op_ret = tuya_queue_output(workqueue->queue, &work_item);
+        // every worker pulls from the same lanes, so an idle worker always picks up
+        // what a busy one would otherwise block
+        op_ret = __work_take(workqueue, &node);
         if (OPRT_OK != op_ret) {
-            tal_system_sleep(10);
             continue;
         }
 
-        if (work_item.cb) {
-            workqueue->last_cb = work_item.cb;
-            work_item.cb(work_item.data);
-            workqueue->last_cb = NULL;
+        if (node.item.cb) {
+            __work_run(worker, &node);
+        } else {
+            worker->cancelled++;
         }
     }
 }
@@ -97,6 +166,59 @@ static BOOL_T __work_cancel_traverse(void *item, void *ctx)
     return TRUE;
 }
 
+static void __work_stop_workers(TAL_WORKQUEUE_T *workqueue)
+{
+    uint8_t i = 0;
+    uint32_t count = 1;
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        tal_thread_delete(workqueue->worker[i].thread);
+    }
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        tal_semaphore_post(workqueue->sem);
+    }
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        while (THREAD_STATE_DELETE != tal_thread_get_state(workqueue->worker[i].thread)) {
+            tal_system_sleep(10);
+            if ((count++) % 500 == 0) {
+                PR_NOTICE("%p still running", workqueue->worker[i].thread);
+            }
+        }
+    }
+}
+
+static void __work_free(TAL_WORKQUEUE_T *workqueue)
+{
+    if (workqueue->queue) {
+        tuya_queue_release(workqueue->queue);
+    }
+    if (workqueue->queue_instant) {
+        tuya_queue_release(workqueue->queue_instant);
+    }
+    if (workqueue->sem) {
+        tal_semaphore_release(workqueue->sem);
+    }
+    tal_free(workqueue);
+}
+
+static OPERATE_RET __work_schedule(TAL_WORKQUEUE_T *workqueue, BOOL_T instant, WORKQUEUE_CB cb, void *data)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    WORK_NODE_T node = {.item = {.cb = cb, .data = data}, .enqueue_ms = tal_system_get_millisecond()};
+
+    op_ret = tuya_queue_input(instant ? workqueue->queue_instant : workqueue->queue, &node);
+    if (OPRT_OK != op_ret) {
+        __atomic_fetch_add(&workqueue->rejected, 1, __ATOMIC_RELAXED);
+        return op_ret;
+    }
+
+    __atomic_fetch_add(instant ? &workqueue->scheduled_instant : &workqueue->scheduled, 1, __ATOMIC_RELAXED);
+
+    return tal_semaphore_post(workqueue->sem);
+}
+
 /**
  * @brief create and initialize a workqueue which runs in thread context
  *
@@ -109,11 +231,38 @@ static BOOL_T __work_cancel_traverse(void *item, void *ctx)
  * tuya_error_code.h
  */
 OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_cfg, WORKQUEUE_HANDLE *handle)
+{
+    WORKQUEUE_CFG_T cfg = {0};
+
+    if ((0 == queue_len) || (NULL == thread_cfg) || (NULL == handle)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    cfg.queue_len = queue_len;
+    cfg.worker_num = 1;
+    cfg.thread_cfg = *thread_cfg;
+
+    return tal_workqueue_create_ex(&cfg, handle);
+}
+
+/**
+ * @brief create and initialize a workqueue drained by several worker threads
+ *
+ * @param[in] cfg queue length, worker number and thread param
+ * @param[out] handle the workqueue handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_ex(const WORKQUEUE_CFG_T *cfg, WORKQUEUE_HANDLE *handle)
 {
     OPERATE_RET op_ret = OPRT_OK;
     TAL_WORKQUEUE_T *workqueue = NULL;
+    THREAD_CFG_T thread_cfg;
+    uint8_t i = 0;
 
-    if ((0 == queue_len) || (NULL == thread_cfg) || (NULL == handle)) {
+    if ((NULL == cfg) || (0 == cfg->queue_len) || (0 == cfg->worker_num) ||
+        (cfg->worker_num > TAL_WORKQUEUE_WORKER_MAX) || (NULL == handle)) {
         return OPRT_INVALID_PARM;
     }
 
@@ -122,29 +271,49 @@ OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_
         return OPRT_MALLOC_FAILED;
     }
 
-    op_ret = tuya_queue_create(queue_len, sizeof(WORK_ITEM_T), &workqueue->queue);
+    op_ret = tuya_queue_create(cfg->queue_len, sizeof(WORK_NODE_T), &workqueue->queue);
     if (OPRT_OK != op_ret) {
-        tal_free(workqueue);
+        __work_free(workqueue);
         return op_ret;
     }
 
-    op_ret = tal_semaphore_create_init(&workqueue->sem, 0, queue_len);
+    op_ret = tuya_queue_create(cfg->queue_len, sizeof(WORK_NODE_T), &workqueue->queue_instant);
     if (OPRT_OK != op_ret) {
-        tuya_queue_release(workqueue->queue);
-        tal_free(workqueue);
+        __work_free(workqueue);
         return op_ret;
     }
 
-    op_ret = tal_thread_create_and_start(&workqueue->thread, NULL, NULL, __work_thread_cb, workqueue, thread_cfg);
+    op_ret = tal_semaphore_create_init(&workqueue->sem, 0, 2 * cfg->queue_len);
     if (OPRT_OK != op_ret) {
-        tal_semaphore_release(workqueue->sem);
-        tuya_queue_release(workqueue->queue);
-        tal_free(workqueue);
-    } else {
-        *handle = workqueue;
+        __work_free(workqueue);
+        return op_ret;
+    }
+
+    thread_cfg = cfg->thread_cfg;
+    for (i = 0; i < cfg->worker_num; i++) {
+        WORK_WORKER_T *worker = &workqueue->worker[i];
+
+        worker->workqueue = workqueue;
+        if (0 == i) {
+            snprintf(worker->name, sizeof(worker->name), "%s", cfg->thread_cfg.thrdname ? cfg->thread_cfg.thrdname : "");
+        } else {
+            snprintf(worker->name, sizeof(worker->name), "%.*s_%d", WORKQUEUE_WORKER_NAME_LEN - 4,
+                     cfg->thread_cfg.thrdname ? cfg->thread_cfg.thrdname : "wq", i);
+        }
+        thread_cfg.thrdname = worker->name;
+
+        op_ret = tal_thread_create_and_start(&worker->thread, NULL, NULL, __work_thread_cb, worker, &thread_cfg);
+        if (OPRT_OK != op_ret) {
+            __work_stop_workers(workqueue);
+            __work_free(workqueue);
+            return op_ret;
+        }
+        workqueue->worker_num++;
     }
 
-    return op_ret;
+    *handle = workqueue;
+
+    return OPRT_OK;
 }
 
 /**
@@ -159,21 +328,11 @@ OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_
  */
 OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-
     if ((NULL == handle) || (NULL == cb)) {
         return OPRT_INVALID_PARM;
     }
 
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
-
-    op_ret = tuya_queue_input(workqueue->queue, &work_item);
-    if (OPRT_OK == op_ret) {
-        op_ret = tal_semaphore_post(workqueue->sem);
-    }
-
-    return op_ret;
+    return __work_schedule((TAL_WORKQUEUE_T *)handle, FALSE, cb, data);
 }
 
 /**
@@ -188,21 +347,11 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
  */
 OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-
     if ((NULL == handle) || (NULL == cb)) {
         return OPRT_INVALID_PARM;
     }
 
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
-
-    op_ret = tuya_queue_input_instant(workqueue->queue, &work_item);
-    if (OPRT_OK == op_ret) {
-        op_ret = tal_semaphore_post(workqueue->sem);
-    }
-
-    return op_ret;
+    return __work_schedule((TAL_WORKQUEUE_T *)handle, TRUE, cb, data);
 }
 
 /**
@@ -224,6 +373,7 @@ OPERATE_RET tal_workqueue_cancel(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
     WORK_ITEM_T work_item = {.cb = cb, .data = data};
 
+    tuya_queue_traverse(workqueue->queue_instant, __work_cancel_traverse, &work_item);
     return tuya_queue_traverse(workqueue->queue, __work_cancel_traverse, &work_item);
 }
 
@@ -244,6 +394,7 @@ OPERATE_RET tal_workqueue_traverse(WORKQUEUE_HANDLE handle, WORKQUEUE_TRAVERSE_C
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    tuya_queue_traverse(workqueue->queue_instant, (TRAVERSE_CB)cb, ctx);
     return tuya_queue_traverse(workqueue->queue, (TRAVERSE_CB)cb, ctx);
 }
 
@@ -261,49 +412,99 @@ uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    WORKQUEUE_CB cur_cb = NULL;
+    uint8_t i = 0;
 
-    if (workqueue->last_cb) {
-        PR_NOTICE("%p:last_cb %p", workqueue->thread, workqueue->last_cb);
+    for (i = 0; i < workqueue->worker_num; i++) {
+        cur_cb = workqueue->worker[i].cur_cb;
+        if (cur_cb) {
+            PR_NOTICE("%p:last_cb %p", workqueue->worker[i].thread, cur_cb);
+        }
     }
 
-    return tuya_queue_get_used_num(workqueue->queue);
+    return tuya_queue_get_used_num(workqueue->queue) + tuya_queue_get_used_num(workqueue->queue_instant);
 }
 
 /**
- * @brief release the workqueue
+ * @brief get the statistics of the workqueue
  *
  * @param[in] handle the workqueue handle
+ * @param[out] stat counters, queue-wait and run-time of the work items
  *
  * @return OPRT_OK on success. Others on error, please refer to
  * tuya_error_code.h
  */
-OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
+OPERATE_RET tal_workqueue_stat_get(WORKQUEUE_HANDLE handle, WORKQUEUE_STAT_T *stat)
 {
-    if (NULL == handle) {
+    if (NULL == handle || NULL == stat) {
         return OPRT_INVALID_PARM;
     }
 
-    OPERATE_RET op_ret = OPRT_OK;
-    uint32_t count = 1;
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    SYS_TIME_T now_ms = tal_system_get_millisecond();
+    uint64_t wait_total_ms = 0, run_total_ms = 0;
+    uint32_t running_ms = 0;
+    uint8_t i = 0;
+
+    memset(stat, 0, sizeof(WORKQUEUE_STAT_T));
+    stat->worker_num = workqueue->worker_num;
+    stat->scheduled = workqueue->scheduled;
+    stat->scheduled_instant = workqueue->scheduled_instant;
+    stat->rejected = workqueue->rejected;
+    stat->pending = tuya_queue_get_used_num(workqueue->queue);
+    stat->pending_instant = tuya_queue_get_used_num(workqueue->queue_instant);
+
+    // the workers update their own counters without a lock, a snapshot may be off by the item in flight
+    for (i = 0; i < workqueue->worker_num; i++) {
+        WORK_WORKER_T *worker = &workqueue->worker[i];
+
+        stat->done += worker->done;
+        stat->cancelled += worker->cancelled;
+        wait_total_ms += worker->wait_total_ms;
+        run_total_ms += worker->run_total_ms;
+        if (worker->wait_max_ms > stat->wait_max_ms) {
+            stat->wait_max_ms = worker->wait_max_ms;
+        }
+        if (worker->run_max_ms >= stat->run_max_ms && worker->run_max_cb) {
+            stat->run_max_ms = worker->run_max_ms;
+            stat->run_max_cb = worker->run_max_cb;
+        }
+        if (worker->cur_cb) {
+            stat->busy++;
+            running_ms = (uint32_t)(now_ms - worker->cur_start_ms);
+            if (running_ms >= stat->running_max_ms) {
+                stat->running_max_ms = running_ms;
+                stat->running_cb = worker->cur_cb;
+            }
+        }
+    }
 
-    op_ret = tal_thread_delete(workqueue->thread);
-    if (OPRT_OK != op_ret) {
-        return op_ret;
+    if (stat->done) {
+        stat->wait_avg_ms = (uint32_t)(wait_total_ms / stat->done);
+        stat->run_avg_ms = (uint32_t)(run_total_ms / stat->done);
     }
 
-    tal_semaphore_post(workqueue->sem);
+    return OPRT_OK;
+}
 
-    while (THREAD_STATE_DELETE != tal_thread_get_state(workqueue->thread)) {
-        tal_system_sleep(10);
-        if ((count++) % 500 == 0) {
-            PR_NOTICE("%p still running", workqueue->thread);
-        }
+/**
+ * @brief release the workqueue
+ *
+ * @param[in] handle the workqueue handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
+{
+    if (NULL == handle) {
+        return OPRT_INVALID_PARM;
     }
 
-    tuya_queue_release(workqueue->queue);
-    tal_semaphore_release(workqueue->sem);
-    tal_free(workqueue);
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+
+    __work_stop_workers(workqueue);
+    __work_free(workqueue);
 
     return OPRT_OK;
 }
@@ -313,7 +514,7 @@ OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
  *
  * @param[in] handle the workqueue handle
  *
- * @return thread handle
+ * @return thread handle of the first worker
  */
 THREAD_HANDLE tal_workqueue_get_thread(WORKQUEUE_HANDLE handle)
 {
@@ -322,7 +523,25 @@ THREAD_HANDLE tal_workqueue_get_thread(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    return workqueue->thread;
+    return workqueue->worker[0].thread;
+}
+
+/**
+ * @brief get thread handle of a worker of the workqueue
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] index worker index, below worker_num
+ *
+ * @return thread handle, NULL if there is no such worker
+ */
+THREAD_HANDLE tal_workqueue_get_worker_thread(WORKQUEUE_HANDLE handle, uint8_t index)
+{
+    if (NULL == handle) {
+        return NULL;
+    }
+
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    return (index < workqueue->worker_num) ? workqueue->worker[index].thread : NULL;
 }
 
 typedef struct {
@@ -28,6 +28,7 @@
 #include "tuya_ai_event.h"
 #include "tuya_ai_input.h"
 #include "tuya_ai_output.h"
+#include "tuya_ai_encoder.h"
 
 #define AI_AGENT_SCODE_DEFAULT ""
 #define AI_AGENT_SCODE_ALERT "device_alert"
@@ -208,6 +209,18 @@ BOOL_T tuya_ai_agent_is_internal_scode(VOID);
  */
 AI_AGENT_SESSION_T* tuya_ai_agent_get_session(CHAR_T *scode);
 
+/**
+ * @brief get the parameters of the audio upload encoder
+ *
+ * The encoder adapts its bitrate to the AI channel while a stream uploads,
+ * the counters cover the current stream and restart at its end.
+ *
+ * @param[out] params encoder parameters and counters
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_agent_get_encoder_params(AI_ENCODER_PARAMS_T *params);
+
 /**
  * @brief server vad control
  *
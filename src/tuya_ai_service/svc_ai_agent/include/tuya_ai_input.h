@@ -43,6 +43,59 @@ typedef enum {
     AI_INPUT_STOP
 } AI_INPUT_STATE_E;
 
+typedef enum {
+    /** reject the incoming frame when the input ring is full */
+    AI_INPUT_DROP_NEWEST,
+    /** evict the oldest queued frames until the incoming one fits */
+    AI_INPUT_DROP_OLDEST,
+    /** like drop oldest, and a queued frame is skipped once a newer one of the type is queued */
+    AI_INPUT_KEEP_LATEST,
+    /** block the producer until there is room, queued frames of the type are never evicted */
+    AI_INPUT_NEVER_DROP,
+} AI_INPUT_DROP_POLICY_E;
+
+typedef enum {
+    /** ring usage reached the high watermark */
+    AI_INPUT_WATERMARK_HIGH_REACHED,
+    /** ring usage fell back to the low watermark */
+    AI_INPUT_WATERMARK_LOW_REACHED,
+} AI_INPUT_WATERMARK_E;
+
+/**
+ * @brief input ring watermark callback, called from the producer or the upload thread
+ *
+ * @param[in] mark watermark reached
+ * @param[in] used ring bytes in use
+ * @param[in] size ring size
+ */
+typedef VOID (*AI_INPUT_WATERMARK_CB)(AI_INPUT_WATERMARK_E mark, UINT_T used, UINT_T size);
+
+/* video, audio, image, file, text, indexed by packet type - AI_PT_VIDEO */
+#define AI_INPUT_PT_NUM 5
+
+typedef struct {
+    /** frames queued */
+    UINT_T frames;
+    /** bytes queued */
+    UINT_T bytes;
+    /** frames dropped by the overload policy */
+    UINT_T drop_frames;
+    /** bytes dropped by the overload policy */
+    UINT_T drop_bytes;
+} AI_INPUT_PT_STAT_T;
+
+typedef struct {
+    AI_INPUT_PT_STAT_T pt[AI_INPUT_PT_NUM];
+    /** ring size */
+    UINT_T ring_size;
+    /** ring bytes in use */
+    UINT_T ring_used;
+    /** ring peak bytes in use */
+    UINT_T ring_peak;
+    /** times the high watermark was reached */
+    UINT_T high_cnt;
+} AI_INPUT_STAT_T;
+
 typedef struct {
     /** video attr */
     AI_VIDEO_ATTR_BASE_T video;
@@ -127,6 +180,31 @@ OPERATE_RET tuya_ai_audio_input_direct(UINT64_T timestamp, UINT64_T pts, BYTE_T
  */
 OPERATE_RET tuya_ai_audio_input(UINT64_T timestamp, UINT64_T pts, BYTE_T *data, UINT_T len, UINT_T total_len);
 
+/**
+ * @brief reserve space for one audio frame in the input ring
+ *
+ * @param[in] len max frame length
+ * @param[out] data frame buffer, encode straight into it and then commit
+ *
+ * @return OPRT_OK on success, OPRT_RESOURCE_NOT_READY when the ring is full.
+ *         Others on error, please refer to tuya_error_code.h
+ *
+ * @note the other inputs wait from reserve to commit, so a thread must not call them in between
+ */
+OPERATE_RET tuya_ai_audio_input_reserve(UINT_T len, BYTE_T **data);
+
+/**
+ * @brief publish the reserved audio frame to the upload thread
+ *
+ * @param[in] timestamp audio timestamp
+ * @param[in] pts audio pts
+ * @param[in] len used frame length, 0 to give up the reservation
+ * @param[in] total_len audio total length
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_audio_input_commit(UINT64_T timestamp, UINT64_T pts, UINT_T len, UINT_T total_len);
+
 /**
  * @brief ai image input
  *
@@ -179,6 +257,59 @@ typedef VOID_T(*AI_ALERT_FB_CB)(AI_CLOUD_ALERT_TYPE_E type);
  */
 OPERATE_RET tuya_ai_input_alert(AI_CLOUD_ALERT_TYPE_E type, AI_ALERT_FB_CB cb);
 
+/**
+ * @brief set the overload policy of a packet type
+ *
+ * defaults: video drop newest, audio drop oldest, image keep latest, file and text never drop.
+ * applies to the frames of tuya_ai_input_write and of the video, audio, image, text and
+ * file inputs that go through the input ring; tuya_ai_audio_input_direct is uploaded
+ * directly. a chunk larger than half the ring is uploaded directly once the queued
+ * chunks of its type are out: drop newest drops it instead of waiting, keep latest
+ * drops the queued whole frames it replaces.
+ *
+ * @param[in] type AI_PT_VIDEO ... AI_PT_TEXT
+ * @param[in] policy overload policy
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_input_set_drop_policy(AI_PACKET_PT type, AI_INPUT_DROP_POLICY_E policy);
+
+/**
+ * @brief set the input ring watermarks
+ *
+ * @param[in] high high watermark, percent of the ring
+ * @param[in] low low watermark, percent of the ring, below high
+ * @param[in] cb watermark callback, NULL for none
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_input_set_watermark(UINT8_T high, UINT8_T low, AI_INPUT_WATERMARK_CB cb);
+
+/**
+ * @brief get ai input counters
+ *
+ * @param[out] stat counters
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_input_get_stat(AI_INPUT_STAT_T *stat);
+
+/**
+ * @brief reset ai input counters
+ *
+ */
+VOID tuya_ai_input_reset_stat(VOID);
+
+/**
+ * @brief format ai input counters as text
+ *
+ * @param[out] buf text buffer
+ * @param[in] len buffer length
+ *
+ * @return text length
+ */
+INT_T tuya_ai_input_stat_to_str(CHAR_T *buf, UINT_T len);
+
 /**
  * @brief check ai input is started
  *
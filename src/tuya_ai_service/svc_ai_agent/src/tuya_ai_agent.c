@@ -31,6 +31,7 @@
 #include "http_inf.h"
 #include "http_manager.h"
 #include "tal_workq_service.h"
+#include "tal_system.h"
 #include "tuya_ai_mqtt.h"
 #include "tuya_ai_http.h"
 #include "smart_frame.h"
@@ -44,9 +45,14 @@
 #if defined(ENABLE_TUYA_CODEC_SPEEX) && (ENABLE_TUYA_CODEC_SPEEX == 1)
 #include "tuya_ai_encoder_speex.h"
 #endif
+#if defined(ENABLE_TUYA_CODEC_PIPELINE) && (ENABLE_TUYA_CODEC_PIPELINE == 1)
+#include "tuya_ai_encoder_pipeline.h"
+#endif
 #include "tuya_ai_protocol.h"
 
 #define INTTERUPT_TIME_MAX  16
+#define ENCODER_FEEDBACK_INTERVAL_MS    1000
+#define ENCODER_FLUSH_TIMEOUT_MS        3000
 
 typedef struct {
     CHAR_T scode[AI_SOLUTION_CODE_LEN];
@@ -58,6 +64,11 @@ typedef struct {
     BOOL_T codec_enable;
     TUYA_AI_ENCODER_T *encoder;             // encoder handle
     TUYA_AI_ENCODER_INFO_T encoder_info;    // encoder info
+    SYS_TIME_T encoder_feedback_time;       // last link feedback to the encoder
+    UINT_T encoder_partial_writes;          // send stat partial_writes at that feedback
+#if defined(ENABLE_TUYA_CODEC_PIPELINE) && (ENABLE_TUYA_CODEC_PIPELINE == 1)
+    AI_ENCODER_PIPELINE_T encoder_pipeline; // encodes and uploads on its own thread
+#endif
     AI_AGENT_TTS_CFG_T tts_cfg;
     CHAR_T last_intr_time[INTTERUPT_TIME_MAX];  // last chat break time
     BOOL_T enable_crt_session_ext; // enable crt session external
@@ -71,6 +82,7 @@ STATIC AI_AGENT_CTX_T ai_agent_ctx;
 
 STATIC OPERATE_RET __mcp_handle(CHAR_T *data);
 STATIC AI_SESSION_ID __ai_agent_get_eid(CHAR_T *scode);
+STATIC OPERATE_RET __upload_data_cb(AI_AUDIO_CODEC_TYPE codec_type, UCHAR_T *data, UINT_T len, void *usr_data);
 
 STATIC OPERATE_RET __parse_attr_time(BYTE_T *data, UINT_T len, CHAR_T *time_str)
 {
@@ -954,6 +966,12 @@ STATIC OPERATE_RET  __ai_devos_state_evt(VOID *data)
 
 STATIC VOID __ai_agent_destroy_encoder(VOID)
 {
+#if defined(ENABLE_TUYA_CODEC_PIPELINE) && (ENABLE_TUYA_CODEC_PIPELINE == 1)
+    if (ai_agent_ctx.encoder_pipeline) {
+        tuya_ai_encoder_pipeline_destroy(ai_agent_ctx.encoder_pipeline);
+        ai_agent_ctx.encoder_pipeline = NULL;
+    }
+#endif
     if (ai_agent_ctx.encoder && ai_agent_ctx.encoder->handle) {
         ai_agent_ctx.encoder->destroy(ai_agent_ctx.encoder->handle);
         ai_agent_ctx.encoder->handle = NULL;
@@ -961,6 +979,45 @@ STATIC VOID __ai_agent_destroy_encoder(VOID)
     return;
 }
 
+STATIC VOID __ai_agent_encoder_feedback(VOID)
+{
+    AI_PROTO_SEND_STAT_T stat = {0};
+    AI_ENCODER_NET_FEEDBACK_T feedback = {0};
+    SYS_TIME_T now = tal_system_get_millisecond();
+
+    if (NULL == ai_agent_ctx.encoder->ctrl || now - ai_agent_ctx.encoder_feedback_time < ENCODER_FEEDBACK_INTERVAL_MS) {
+        return;
+    }
+    ai_agent_ctx.encoder_feedback_time = now;
+    if (OPRT_OK != tuya_ai_basic_get_send_stat(&stat)) {
+        return;
+    }
+
+    feedback.rtt_ms = stat.rtt_ms;
+    feedback.write_ms = stat.last_write_ms;
+    feedback.stalls = stat.partial_writes - ai_agent_ctx.encoder_partial_writes;
+    // the channel is TCP, retransmission hides the loss from the encoder
+    feedback.loss_perc = 0;
+    ai_agent_ctx.encoder_partial_writes = stat.partial_writes;
+    ai_agent_ctx.encoder->ctrl(ai_agent_ctx.encoder->handle, AI_ENCODER_CTRL_NET_FEEDBACK, &feedback);
+}
+
+STATIC VOID __ai_agent_encoder_report(VOID)
+{
+    AI_ENCODER_PARAMS_T params = {0};
+
+    if (NULL == ai_agent_ctx.encoder->ctrl) {
+        return;
+    }
+    if ((OPRT_OK == ai_agent_ctx.encoder->ctrl(ai_agent_ctx.encoder->handle, AI_ENCODER_CTRL_GET_PARAMS, &params)) &&
+        params.frames) {
+        PR_NOTICE("audio upload %d bps %d Hz, vbr %d, dtx %d, fec %d(%d%%), frames %d, silent %d, bytes %d, adjusts %d",
+                  params.bitrate, params.bandwidth, params.vbr, params.dtx, params.fec, params.loss_perc,
+                  params.frames, params.dtx_frames, params.bytes, params.adjusts);
+    }
+    ai_agent_ctx.encoder->ctrl(ai_agent_ctx.encoder->handle, AI_ENCODER_CTRL_RESET_STAT, NULL);
+}
+
 STATIC VOID __ai_agent_set_audio_encoder(AI_AUDIO_ATTR_BASE_T *attr)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -978,6 +1035,22 @@ STATIC VOID __ai_agent_set_audio_encoder(AI_AUDIO_ATTR_BASE_T *attr)
                 ai_agent_ctx.encoder = NULL;
             } else {
                 PR_DEBUG("create audio encoder success %p", ai_agent_ctx.encoder->handle);
+                AI_PROTO_SEND_STAT_T stat = {0};
+                tuya_ai_basic_get_send_stat(&stat);
+                ai_agent_ctx.encoder_partial_writes = stat.partial_writes;
+#if defined(ENABLE_TUYA_CODEC_PIPELINE) && (ENABLE_TUYA_CODEC_PIPELINE == 1)
+                AI_ENCODER_PIPELINE_CFG_T pipe_cfg = {
+                    .encoder = ai_agent_ctx.encoder,
+                    .cb = __upload_data_cb,
+                    .tag_size = SIZEOF(AI_BIZ_HD_T),
+                    .queue_size = TUYA_CODEC_PIPELINE_QUEUE_SIZE,
+                    .batch_frames = TUYA_CODEC_PIPELINE_BATCH,
+                };
+                if (OPRT_OK != tuya_ai_encoder_pipeline_create(&pipe_cfg, &ai_agent_ctx.encoder_pipeline)) {
+                    PR_ERR("create encoder pipeline failed, encode inline");
+                    ai_agent_ctx.encoder_pipeline = NULL;
+                }
+#endif
             }
         }
     }
@@ -1223,6 +1296,12 @@ STATIC OPERATE_RET __ai_upload_stream(AI_PACKET_PT ptype, AI_BIZ_HD_T *biz, CHAR
 
 STATIC OPERATE_RET __upload_data_cb(AI_AUDIO_CODEC_TYPE codec_type, UCHAR_T *data, UINT_T len, void *usr_data)
 {
+    if (NULL == data) {
+        // end mark of the encoder pipeline, every packet of the stream is out
+        __ai_agent_encoder_report();
+        return __ai_upload_stream(AI_PT_AUDIO, (AI_BIZ_HD_T *)usr_data, NULL, 0, 0);
+    }
+    __ai_agent_encoder_feedback();
     return __ai_upload_stream(AI_PT_AUDIO, (AI_BIZ_HD_T *)usr_data, (CHAR_T *)data, len, len);
 }
 
@@ -1236,6 +1315,15 @@ OPERATE_RET tuya_ai_agent_upload_stream(AI_PACKET_PT ptype, AI_BIZ_HD_T *biz, CH
             PR_ERR("audio stream len not match, len:%d, total_len:%d", len, total_len);
             return OPRT_INVALID_PARM;
         }
+#if defined(ENABLE_TUYA_CODEC_PIPELINE) && (ENABLE_TUYA_CODEC_PIPELINE == 1)
+        if (ai_agent_ctx.encoder_pipeline) {
+            if (data && len > 0) {
+                return tuya_ai_encoder_pipeline_write(ai_agent_ctx.encoder_pipeline, (UCHAR_T *)data, len, biz);
+            }
+            // the end goes out on the pipeline thread behind the last packet
+            return tuya_ai_encoder_pipeline_flush(ai_agent_ctx.encoder_pipeline, biz, ENCODER_FLUSH_TIMEOUT_MS);
+        }
+#endif
         if (data && len > 0) {
             // encode data
             OPERATE_RET rt = ai_agent_ctx.encoder->encode(ai_agent_ctx.encoder->handle, (UCHAR_T *)data, len, __upload_data_cb, (VOID *)biz);
@@ -1245,6 +1333,7 @@ OPERATE_RET tuya_ai_agent_upload_stream(AI_PACKET_PT ptype, AI_BIZ_HD_T *biz, CH
             }
             return rt;
         } else {
+            __ai_agent_encoder_report();
             return __ai_upload_stream(ptype, biz, data, len, total_len);
         }
     } else {
@@ -1252,6 +1341,18 @@ OPERATE_RET tuya_ai_agent_upload_stream(AI_PACKET_PT ptype, AI_BIZ_HD_T *biz, CH
     }
 }
 
+OPERATE_RET tuya_ai_agent_get_encoder_params(AI_ENCODER_PARAMS_T *params)
+{
+    TUYA_CHECK_NULL_RETURN(params, OPRT_INVALID_PARM);
+    if (NULL == ai_agent_ctx.encoder || NULL == ai_agent_ctx.encoder->handle) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    if (NULL == ai_agent_ctx.encoder->ctrl) {
+        return OPRT_NOT_SUPPORTED;
+    }
+    return ai_agent_ctx.encoder->ctrl(ai_agent_ctx.encoder->handle, AI_ENCODER_CTRL_GET_PARAMS, params);
+}
+
 VOID tuya_ai_agent_server_vad_ctrl(BOOL_T flag)
 {
     ai_agent_ctx.enable_serv_vad = flag;
@@ -20,7 +20,7 @@
 #include "tal_thread.h"
 #include "tal_system.h"
 #include "tal_mutex.h"
-#include "tuya_ringbuf.h"
+#include "tal_semaphore.h"
 #include "uni_log.h"
 #include "tuya_ai_agent.h"
 #include "tuya_ai_biz.h"
@@ -28,9 +28,12 @@
 #include "base_event.h"
 #include "tuya_ai_internal.h"
 #include "tuya_ai_input.h"
+#include "tuya_ai_ring.h"
 #include "tal_queue.h"
 #include "tal_sw_timer.h"
 #include "tal_workq_service.h"
+#include "tal_cli.h"
+#include <stdio.h>
 
 #ifndef AI_INPUT_STACK_SIZE
 #define AI_INPUT_STACK_SIZE (4608)
@@ -42,8 +45,25 @@
 #define AI_INPUT_BUF_SIZE (6 * 1024)
 #endif
 
+#ifndef AI_INPUT_WATERMARK_HIGH
+#define AI_INPUT_WATERMARK_HIGH (80) // percent of the ring
+#endif
+#ifndef AI_INPUT_WATERMARK_LOW
+#define AI_INPUT_WATERMARK_LOW (40)
+#endif
+
 #define AI_INPUT_TASK_DELAY (80)
 
+#define AI_INPUT_BLOCK_WAIT    (100)       // ms, the input state is checked again after each wait
+#define AI_INPUT_BLOCK_TIMEOUT (10 * 1000) // ms
+#define AI_INPUT_DROP_WAIT     (10)        // ms, for the room of records dropped behind the one being sent
+
+#define AI_INPUT_PT_VALID(type) (((type) >= AI_PT_VIDEO) && ((type) < AI_PT_VIDEO + AI_INPUT_PT_NUM))
+#define AI_INPUT_PT_IDX(type)   ((type) - AI_PT_VIDEO)
+
+/* counters are bumped by the producer and the upload thread */
+#define AI_INPUT_STAT_ADD(v, n) __atomic_fetch_add(&(v), (n), __ATOMIC_RELAXED)
+
 #define AI_ALERT_DEFAULT_TIMEOUT (1500) // ms
 
 typedef enum {
@@ -65,100 +85,414 @@ typedef struct {
 typedef struct {
     THREAD_HANDLE thread;
     AI_INPUT_STATE_E state;
-    TUYA_RINGBUFF_T ringbuf;
+    AI_RING_T ring;
+    UINT8_T *ring_buf;
+    AI_RINGBUF_HEAD_T *rsv_rec;
     UINT32_T lazy_input;
     MUTEX_HANDLE mutex;
+    /* serializes the producers, a record is reserved, filled and committed under it */
+    MUTEX_HANDLE write_mutex;
+    /* posted whenever the upload thread gives room back */
+    SEM_HANDLE room_sem;
     QUEUE_HANDLE queue;
-    CHAR_T *input_buf;
     BOOL_T terminate;
     BOOL_T queue_sync;
     AI_ALERT_CTX_T alert;
+    AI_INPUT_DROP_POLICY_E policy[AI_INPUT_PT_NUM];
+    UINT_T latest_seq[AI_INPUT_PT_NUM];
+    /* seq of the last record queued per type and of the last one the upload thread is done with */
+    UINT_T queued_seq[AI_INPUT_PT_NUM];
+    UINT_T done_seq;
+    UINT_T seq;
+    UINT_T wm_high;
+    UINT_T wm_low;
+    BOOL_T wm_above;
+    AI_INPUT_WATERMARK_CB wm_cb;
+    AI_INPUT_STAT_T stat;
 } AI_INPUT_CTX_T;
 STATIC AI_INPUT_CTX_T ai_input_ctx;
+STATIC BOOL_T ai_input_cli_registered = FALSE;
+
+STATIC CONST CHAR_T *sc_ai_input_pt_name[AI_INPUT_PT_NUM] = {"video", "audio", "image", "file", "text"};
 
 STATIC VOID_T __alert_timeout_cb(TIMER_ID timer_id, VOID_T *arg);
+STATIC VOID __ai_input_cli(INT_T argc, CHAR_T *argv[]);
+
+STATIC CONST cli_cmd_t sc_ai_input_cli_cmd[] = {
+    {.name = "ai_input", .help = "ai input stat, ai_input [reset]", .func = __ai_input_cli},
+};
+
+STATIC BOOL_T __ai_input_is_writable(VOID)
+{
+    return (ai_input_ctx.state == AI_INPUT_PROC) || (ai_input_ctx.state == AI_INPUT_STOPPING);
+}
+
+STATIC AI_INPUT_DROP_POLICY_E __ai_input_policy(AI_PACKET_PT type)
+{
+    return AI_INPUT_PT_VALID(type) ? ai_input_ctx.policy[AI_INPUT_PT_IDX(type)] : AI_INPUT_DROP_NEWEST;
+}
+
+STATIC VOID __ai_input_count_drop(AI_PACKET_PT type, UINT_T len)
+{
+    if (!AI_INPUT_PT_VALID(type)) {
+        return;
+    }
+    AI_INPUT_STAT_ADD(ai_input_ctx.stat.pt[AI_INPUT_PT_IDX(type)].drop_frames, 1);
+    AI_INPUT_STAT_ADD(ai_input_ctx.stat.pt[AI_INPUT_PT_IDX(type)].drop_bytes, len);
+}
+
+STATIC BOOL_T __ai_input_can_drop(void *data, uint32_t len)
+{
+    AI_RINGBUF_HEAD_T *rec = (AI_RINGBUF_HEAD_T *)data;
+
+    // an empty record ends a stream
+    return rec->len && __ai_input_policy(rec->type) != AI_INPUT_NEVER_DROP;
+}
+
+/**
+ * @brief a whole frame of a keep-latest type is stale once a newer one is queued
+ */
+STATIC BOOL_T __ai_input_is_superseded(AI_RINGBUF_HEAD_T *rec)
+{
+    if (__ai_input_policy(rec->type) != AI_INPUT_KEEP_LATEST || 0 == rec->len || rec->len != rec->total_len) {
+        return FALSE;
+    }
+    return rec->seq != __atomic_load_n(&ai_input_ctx.latest_seq[AI_INPUT_PT_IDX(rec->type)], __ATOMIC_ACQUIRE);
+}
+
+STATIC VOID __ai_input_watermark_check(VOID)
+{
+    AI_INPUT_WATERMARK_CB cb = ai_input_ctx.wm_cb;
+    UINT_T used = tuya_ai_ring_used(&ai_input_ctx.ring);
+
+    if (used >= ai_input_ctx.wm_high) {
+        if (!__atomic_exchange_n(&ai_input_ctx.wm_above, TRUE, __ATOMIC_ACQ_REL)) {
+            AI_INPUT_STAT_ADD(ai_input_ctx.stat.high_cnt, 1);
+            if (cb) {
+                cb(AI_INPUT_WATERMARK_HIGH_REACHED, used, ai_input_ctx.ring.size);
+            }
+        }
+    } else if (used <= ai_input_ctx.wm_low) {
+        if (__atomic_exchange_n(&ai_input_ctx.wm_above, FALSE, __ATOMIC_ACQ_REL)) {
+            if (cb) {
+                cb(AI_INPUT_WATERMARK_LOW_REACHED, used, ai_input_ctx.ring.size);
+            }
+        }
+    }
+}
+
+STATIC VOID __ai_input_release(AI_RINGBUF_HEAD_T *rec)
+{
+    // records leave the ring in seq order
+    __atomic_store_n(&ai_input_ctx.done_seq, rec->seq, __ATOMIC_RELEASE);
+    tuya_ai_ring_release(&ai_input_ctx.ring);
+    tal_semaphore_post(ai_input_ctx.room_sem);
+}
+
+/**
+ * @brief a record of up to half the ring always fits once the ring is empty, wherever its head is
+ */
+STATIC BOOL_T __ai_input_fits_ring(UINT_T len)
+{
+    return SIZEOF(AI_RINGBUF_HEAD_T) + len + 2 * 8 <= AI_INPUT_RINGBUF_SIZE / 2;
+}
+
+/**
+ * @brief reserve a record, applying the overload policy of the type when the ring is full
+ */
+STATIC OPERATE_RET __ai_input_reserve(AI_PACKET_PT type, UINT_T len, AI_RINGBUF_HEAD_T **rec)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_INPUT_DROP_POLICY_E policy = len ? __ai_input_policy(type) : AI_INPUT_NEVER_DROP;
+    AI_RINGBUF_HEAD_T *old = NULL;
+    uint32_t old_len = 0;
+    UINT_T pending = 0;
+    BOOL_T deferred = FALSE;
+    SYS_TIME_T start = tal_system_get_millisecond();
+
+    for (;;) {
+        rt = tuya_ai_ring_reserve(&ai_input_ctx.ring, SIZEOF(AI_RINGBUF_HEAD_T) + len, (VOID **)rec);
+        if (OPRT_OK == rt) {
+            return rt;
+        }
+
+        if (policy == AI_INPUT_DROP_OLDEST || policy == AI_INPUT_KEEP_LATEST) {
+            // records behind the one the upload thread is sending free their room when it is done
+            if (pending < SIZEOF(AI_RINGBUF_HEAD_T) + len &&
+                OPRT_OK == tuya_ai_ring_drop_oldest(&ai_input_ctx.ring, __ai_input_can_drop, (VOID **)&old,
+                                                    &old_len, &deferred)) {
+                if (old) {
+                    __ai_input_count_drop(old->type, old->len);
+                }
+                if (deferred) {
+                    pending += old_len;
+                }
+                continue;
+            }
+            if (pending && OPRT_OK == tal_semaphore_wait(ai_input_ctx.room_sem, AI_INPUT_DROP_WAIT)) {
+                pending = 0;
+                continue;
+            }
+        } else if (policy == AI_INPUT_NEVER_DROP) {
+            if (__ai_input_is_writable() && tal_system_get_millisecond() - start < AI_INPUT_BLOCK_TIMEOUT) {
+                tal_semaphore_wait(ai_input_ctx.room_sem, AI_INPUT_BLOCK_WAIT);
+                continue;
+            }
+            PR_ERR("input type:%d blocked too long, len:%d", type, len);
+        }
+        break;
+    }
+
+    __ai_input_count_drop(type, len);
+    return rt;
+}
+
+// called with write_mutex held
+STATIC OPERATE_RET __ai_input_commit(AI_RINGBUF_HEAD_T *rec)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    rec->seq = ++ai_input_ctx.seq;
+    if (AI_INPUT_PT_VALID(rec->type)) {
+        ai_input_ctx.queued_seq[AI_INPUT_PT_IDX(rec->type)] = rec->seq;
+    }
+    if (AI_INPUT_PT_VALID(rec->type) && rec->len) {
+        // published before the record, so the newest frame is never seen as superseded
+        __atomic_store_n(&ai_input_ctx.latest_seq[AI_INPUT_PT_IDX(rec->type)], rec->seq, __ATOMIC_RELEASE);
+        AI_INPUT_STAT_ADD(ai_input_ctx.stat.pt[AI_INPUT_PT_IDX(rec->type)].frames, 1);
+        AI_INPUT_STAT_ADD(ai_input_ctx.stat.pt[AI_INPUT_PT_IDX(rec->type)].bytes, rec->len);
+    }
+    rt = tuya_ai_ring_commit(&ai_input_ctx.ring, SIZEOF(AI_RINGBUF_HEAD_T) + rec->len);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+
+    UINT_T used = tuya_ai_ring_used(&ai_input_ctx.ring);
+    if (used > ai_input_ctx.stat.ring_peak) {
+        ai_input_ctx.stat.ring_peak = used;
+    }
+    __ai_input_watermark_check();
+    return rt;
+}
 
 OPERATE_RET tuya_ai_input_write(AI_RINGBUF_HEAD_T *head, BYTE_T *data)
 {
-    UINT_T rt = 0;
-    if ((ai_input_ctx.state != AI_INPUT_PROC) && (ai_input_ctx.state != AI_INPUT_STOPPING)) {
+    OPERATE_RET rt = OPRT_OK;
+    AI_RINGBUF_HEAD_T *rec = NULL;
+
+    if (!__ai_input_is_writable()) {
         return OPRT_OK;
     }
 
     if (data == NULL || head->len == 0) {
         return OPRT_OK;
     }
-    if (head->len > AI_INPUT_BUF_SIZE) {
+    if (!__ai_input_fits_ring(head->len)) {
         PR_ERR("input data len is too long %d, type:%d", head->len, head->type);
         return OPRT_INVALID_PARM;
     }
 
-    tal_mutex_lock(ai_input_ctx.mutex);
-    UINT_T free_size = tuya_ring_buff_free_size_get(ai_input_ctx.ringbuf);
-    if (free_size < (SIZEOF(AI_RINGBUF_HEAD_T) + head->len)) {
-        tal_mutex_unlock(ai_input_ctx.mutex);
-        return OPRT_RESOURCE_NOT_READY;
-    }
-    rt = tuya_ring_buff_write(ai_input_ctx.ringbuf, (VOID_T *)head, SIZEOF(AI_RINGBUF_HEAD_T));
-    if (rt != SIZEOF(AI_RINGBUF_HEAD_T)) {
-        PR_ERR("input ring buf write head failed %d %d", rt, SIZEOF(AI_RINGBUF_HEAD_T));
-        goto EXIT;
-    }
-    rt = tuya_ring_buff_write(ai_input_ctx.ringbuf, data, head->len);
-    if (rt != head->len) {
-        PR_ERR("ring buf write pbuf failed %d %d", rt, head->len);
-        goto EXIT;
+    tal_mutex_lock(ai_input_ctx.write_mutex);
+    rt = __ai_input_reserve(head->type, head->len, &rec);
+    if (OPRT_OK == rt) {
+        memcpy(rec, head, SIZEOF(AI_RINGBUF_HEAD_T));
+        memcpy(rec + 1, data, head->len);
+        rt = __ai_input_commit(rec);
     }
-    tal_mutex_unlock(ai_input_ctx.mutex);
-    return OPRT_OK;
-
-EXIT:
-    tuya_ring_buff_reset(ai_input_ctx.ringbuf);
-    ai_input_ctx.state = AI_INPUT_STOP;
-    tal_mutex_unlock(ai_input_ctx.mutex);
-    return OPRT_COM_ERROR;
+    tal_mutex_unlock(ai_input_ctx.write_mutex);
+    return rt;
 }
 
 OPERATE_RET tuya_ai_input_read(AI_RINGBUF_HEAD_T *head, CHAR_T *buf)
 {
-    OPERATE_RET rt = OPRT_OK;
-    UINT_T read_len = 0, total_len = 0;
+    AI_RINGBUF_HEAD_T *rec = NULL;
+    uint32_t rec_len = 0;
+    UINT_T total_len = 0;
 
-    if (ai_input_ctx.ringbuf == NULL) {
+    if (ai_input_ctx.ring_buf == NULL) {
         PR_ERR("ring buffer is not initialized");
         return OPRT_COM_ERROR;
     }
 
-    tal_mutex_lock(ai_input_ctx.mutex);
     while (total_len < AI_INPUT_BUF_SIZE) {
         if (ai_input_ctx.state == AI_INPUT_STOP) {
             break;
         }
-        read_len = tuya_ring_buff_peek(ai_input_ctx.ringbuf, (VOID_T *)head, SIZEOF(AI_RINGBUF_HEAD_T));
-        if (read_len != SIZEOF(AI_RINGBUF_HEAD_T)) {
+        if (OPRT_OK != tuya_ai_ring_peek(&ai_input_ctx.ring, (VOID **)&rec, &rec_len)) {
             break;
         }
-        if (head->len + total_len > AI_INPUT_BUF_SIZE) {
-            break;
+        if (__ai_input_is_superseded(rec)) {
+            __ai_input_count_drop(rec->type, rec->len);
+            __ai_input_release(rec);
+            continue;
         }
-        read_len = tuya_ring_buff_read(ai_input_ctx.ringbuf, head, SIZEOF(AI_RINGBUF_HEAD_T));
-        if (read_len != SIZEOF(AI_RINGBUF_HEAD_T)) {
-            break;
+        if (rec->len > AI_INPUT_BUF_SIZE) {
+            // never fits the copy buffer, only the upload thread sends it
+            __ai_input_count_drop(rec->type, rec->len);
+            __ai_input_release(rec);
+            continue;
         }
-        read_len = tuya_ring_buff_read(ai_input_ctx.ringbuf, buf + total_len, head->len);
-        if (read_len != head->len) {
-            PR_ERR("ring buf read pbuf failed %d %d", read_len, head->len);
-            rt = OPRT_COM_ERROR;
+        if (rec->len + total_len > AI_INPUT_BUF_SIZE) {
+            tuya_ai_ring_unpeek(&ai_input_ctx.ring);
             break;
         }
-        total_len += read_len;
+        memcpy(head, rec, SIZEOF(AI_RINGBUF_HEAD_T));
+        memcpy(buf + total_len, rec + 1, rec->len);
+        total_len += rec->len;
+        __ai_input_release(rec);
     }
     head->len = total_len;
     head->total_len = total_len;
-    tal_mutex_unlock(ai_input_ctx.mutex);
+    __ai_input_watermark_check();
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_audio_input_reserve(UINT_T len, BYTE_T **data)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_RINGBUF_HEAD_T *rec = NULL;
+
+    TUYA_CHECK_NULL_RETURN(data, OPRT_INVALID_PARM);
+    if (!__ai_input_is_writable()) {
+        return OPRT_COM_ERROR;
+    }
+    if (len == 0 || len > AI_INPUT_BUF_SIZE) {
+        PR_ERR("input data len is invalid %d", len);
+        return OPRT_INVALID_PARM;
+    }
+
+    // held until the commit, the other producers wait for the frame
+    tal_mutex_lock(ai_input_ctx.write_mutex);
+    rt = __ai_input_reserve(AI_PT_AUDIO, len, &rec);
+    if (OPRT_OK != rt) {
+        tal_mutex_unlock(ai_input_ctx.write_mutex);
+        return rt;
+    }
+    ai_input_ctx.rsv_rec = rec;
+    *data = (BYTE_T *)(rec + 1);
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_audio_input_commit(UINT64_T timestamp, UINT64_T pts, UINT_T len, UINT_T total_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_RINGBUF_HEAD_T *rec = ai_input_ctx.rsv_rec;
+
+    if (rec == NULL) {
+        PR_ERR("audio input commit without reserve");
+        return OPRT_COM_ERROR;
+    }
+    ai_input_ctx.rsv_rec = NULL;
+    // nothing encoded, the next reserve reuses the space
+    if (len != 0) {
+        memset(rec, 0, SIZEOF(AI_RINGBUF_HEAD_T));
+        rec->type = AI_PT_AUDIO;
+        rec->len = len;
+        rec->total_len = total_len;
+        rec->biz.audio.timestamp = timestamp;
+        rec->biz.audio.pts = pts;
+        rt = __ai_input_commit(rec);
+    }
+    tal_mutex_unlock(ai_input_ctx.write_mutex);
     return rt;
 }
 
+/**
+ * @brief upload records straight from the ring, the payload is never copied
+ *
+ * @return uploaded bytes
+ */
+STATIC UINT_T __ai_input_upload(VOID)
+{
+    AI_RINGBUF_HEAD_T *rec = NULL;
+    uint32_t rec_len = 0;
+    UINT_T total_len = 0;
+
+    while (total_len < AI_INPUT_BUF_SIZE) {
+        if (ai_input_ctx.state == AI_INPUT_STOP) {
+            break;
+        }
+        if (OPRT_OK != tuya_ai_ring_peek(&ai_input_ctx.ring, (VOID **)&rec, &rec_len)) {
+            break;
+        }
+        if (__ai_input_is_superseded(rec)) {
+            __ai_input_count_drop(rec->type, rec->len);
+            __ai_input_release(rec);
+            continue;
+        }
+        tuya_ai_agent_upload_stream(rec->type, &rec->biz, (CHAR_T *)(rec + 1), rec->len, rec->total_len);
+        total_len += rec->len;
+        __ai_input_release(rec);
+        __ai_input_watermark_check();
+    }
+    return total_len;
+}
+
+OPERATE_RET tuya_ai_input_set_drop_policy(AI_PACKET_PT type, AI_INPUT_DROP_POLICY_E policy)
+{
+    if (!AI_INPUT_PT_VALID(type) || policy > AI_INPUT_NEVER_DROP) {
+        return OPRT_INVALID_PARM;
+    }
+    ai_input_ctx.policy[AI_INPUT_PT_IDX(type)] = policy;
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_input_set_watermark(UINT8_T high, UINT8_T low, AI_INPUT_WATERMARK_CB cb)
+{
+    if (high > 100 || low >= high) {
+        return OPRT_INVALID_PARM;
+    }
+    ai_input_ctx.wm_high = AI_INPUT_RINGBUF_SIZE / 100 * high;
+    ai_input_ctx.wm_low = AI_INPUT_RINGBUF_SIZE / 100 * low;
+    ai_input_ctx.wm_cb = cb;
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_input_get_stat(AI_INPUT_STAT_T *stat)
+{
+    TUYA_CHECK_NULL_RETURN(stat, OPRT_INVALID_PARM);
+    memcpy(stat, &ai_input_ctx.stat, SIZEOF(AI_INPUT_STAT_T));
+    stat->ring_size = ai_input_ctx.ring.size;
+    stat->ring_used = ai_input_ctx.ring_buf ? tuya_ai_ring_used(&ai_input_ctx.ring) : 0;
+    return OPRT_OK;
+}
+
+VOID tuya_ai_input_reset_stat(VOID)
+{
+    memset(&ai_input_ctx.stat, 0, SIZEOF(AI_INPUT_STAT_T));
+}
+
+INT_T tuya_ai_input_stat_to_str(CHAR_T *buf, UINT_T len)
+{
+    AI_INPUT_STAT_T stat = {0};
+    INT_T offset = 0, i = 0;
+
+    if (buf == NULL || len == 0) {
+        return 0;
+    }
+    tuya_ai_input_get_stat(&stat);
+    offset = snprintf(buf, len, "ring used %u/%u peak %u high %u\n", stat.ring_used, stat.ring_size, stat.ring_peak,
+                      stat.high_cnt);
+    for (i = 0; i < AI_INPUT_PT_NUM && offset < (INT_T)len; i++) {
+        offset += snprintf(buf + offset, len - offset, "%-5s frames %u bytes %u drop %u/%u\n", sc_ai_input_pt_name[i],
+                           stat.pt[i].frames, stat.pt[i].bytes, stat.pt[i].drop_frames, stat.pt[i].drop_bytes);
+    }
+    return (offset < (INT_T)len) ? offset : (INT_T)len - 1;
+}
+
+STATIC VOID __ai_input_cli(INT_T argc, CHAR_T *argv[])
+{
+    CHAR_T buf[320];
+
+    if (argc > 1 && 0 == strcmp(argv[1], "reset")) {
+        tuya_ai_input_reset_stat();
+        tal_cli_echo("ai input stat reset");
+        return;
+    }
+    tuya_ai_input_stat_to_str(buf, SIZEOF(buf));
+    tal_cli_echo(buf);
+}
+
 BOOL_T tuya_ai_input_is_started(VOID)
 {
     UINT_T cnt = 0;
@@ -172,15 +506,101 @@ BOOL_T tuya_ai_input_is_started(VOID)
     return TRUE;
 }
 
-OPERATE_RET tuya_ai_video_input(UINT64_T timestamp, UINT64_T pts, BYTE_T *data, UINT_T len, UINT_T total_len)
+/**
+ * @brief upload a chunk too large for the ring once the chunks queued before it are out
+ *
+ * with a backlog of its type, drop newest drops the chunk, keep latest drops the
+ * whole frames it replaces and waits, the others wait.
+ */
+STATIC OPERATE_RET __ai_input_upload_direct(AI_PACKET_PT type, AI_BIZ_HD_T *biz, BYTE_T *data, UINT_T len,
+                                            UINT_T total_len)
 {
+    OPERATE_RET rt = OPRT_OK;
+    AI_INPUT_DROP_POLICY_E policy = __ai_input_policy(type);
+    UINT_T queued = 0;
+    SYS_TIME_T start = tal_system_get_millisecond();
+
+    if (!__ai_input_is_writable()) {
+        return OPRT_OK;
+    }
+    if (!AI_INPUT_PT_VALID(type)) {
+        return tuya_ai_agent_upload_stream(type, biz, (CHAR_T *)data, len, total_len);
+    }
+
+    tal_mutex_lock(ai_input_ctx.write_mutex);
+    queued = ai_input_ctx.queued_seq[AI_INPUT_PT_IDX(type)];
+    if (policy == AI_INPUT_KEEP_LATEST) {
+        __atomic_store_n(&ai_input_ctx.latest_seq[AI_INPUT_PT_IDX(type)], ++ai_input_ctx.seq, __ATOMIC_RELEASE);
+    }
+    tal_mutex_unlock(ai_input_ctx.write_mutex);
+
+    // an empty ring also covers chunks that were dropped instead of uploaded
+    while ((INT_T)(queued - __atomic_load_n(&ai_input_ctx.done_seq, __ATOMIC_ACQUIRE)) > 0 &&
+           tuya_ai_ring_used(&ai_input_ctx.ring)) {
+        if (policy == AI_INPUT_DROP_NEWEST || !__ai_input_is_writable() ||
+            tal_system_get_millisecond() - start >= AI_INPUT_BLOCK_TIMEOUT) {
+            PR_ERR("input type:%d chunk dropped behind its queue, len:%d", type, len);
+            __ai_input_count_drop(type, len);
+            return OPRT_RESOURCE_NOT_READY;
+        }
+        tal_semaphore_wait(ai_input_ctx.room_sem, AI_INPUT_BLOCK_WAIT);
+    }
+
+    rt = tuya_ai_agent_upload_stream(type, biz, (CHAR_T *)data, len, total_len);
+    AI_INPUT_STAT_ADD(ai_input_ctx.stat.pt[AI_INPUT_PT_IDX(type)].frames, 1);
+    AI_INPUT_STAT_ADD(ai_input_ctx.stat.pt[AI_INPUT_PT_IDX(type)].bytes, len);
+    return rt;
+}
+
+/**
+ * @brief queue a frame so the overload policy of its type applies
+ *
+ * a chunk too large for the ring is uploaded directly behind the queued chunks
+ * of its type, an empty one ends the stream and is queued behind its chunks, it
+ * is never dropped.
+ */
+STATIC OPERATE_RET __ai_input_queue(AI_PACKET_PT type, AI_BIZ_HD_T *biz, BYTE_T *data, UINT_T len, UINT_T total_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_RINGBUF_HEAD_T head = {0};
+    AI_RINGBUF_HEAD_T *rec = NULL;
+
     if (!tuya_ai_input_is_started()) {
         return OPRT_RESOURCE_NOT_READY;
     }
+    if (data == NULL || len == 0) {
+        if (!__ai_input_is_writable()) {
+            return OPRT_OK;
+        }
+        tal_mutex_lock(ai_input_ctx.write_mutex);
+        rt = __ai_input_reserve(type, 0, &rec);
+        if (OPRT_OK == rt) {
+            memset(rec, 0, SIZEOF(AI_RINGBUF_HEAD_T));
+            rec->type = type;
+            rec->total_len = total_len;
+            rt = __ai_input_commit(rec);
+        }
+        tal_mutex_unlock(ai_input_ctx.write_mutex);
+        return rt;
+    }
+    if (!__ai_input_fits_ring(len)) {
+        return __ai_input_upload_direct(type, biz, data, len, total_len);
+    }
+    head.type = type;
+    head.len = len;
+    head.total_len = total_len;
+    if (biz) {
+        head.biz = *biz;
+    }
+    return tuya_ai_input_write(&head, data);
+}
+
+OPERATE_RET tuya_ai_video_input(UINT64_T timestamp, UINT64_T pts, BYTE_T *data, UINT_T len, UINT_T total_len)
+{
     AI_BIZ_HD_T biz = {0};
     biz.video.timestamp = timestamp;
     biz.video.pts = pts;
-    return tuya_ai_agent_upload_stream(AI_PT_VIDEO, &biz, (CHAR_T *)data, len, total_len);
+    return __ai_input_queue(AI_PT_VIDEO, &biz, data, len, total_len);
 }
 
 OPERATE_RET tuya_ai_audio_input_direct(UINT64_T timestamp, UINT64_T pts, BYTE_T *data, UINT_T len, UINT_T total_len)
@@ -196,50 +616,30 @@ OPERATE_RET tuya_ai_audio_input_direct(UINT64_T timestamp, UINT64_T pts, BYTE_T
 
 OPERATE_RET tuya_ai_audio_input(UINT64_T timestamp, UINT64_T pts, BYTE_T *data, UINT_T len, UINT_T total_len)
 {
-    OPERATE_RET rt = OPRT_OK;
-    UINT_T cnt = 0;
     AI_RINGBUF_HEAD_T head = {0};
     head.type = AI_PT_AUDIO;
     head.len = len;
     head.total_len = total_len;
     head.biz.audio.timestamp = timestamp;
     head.biz.audio.pts = pts;
-    rt = tuya_ai_input_write(&head, data);
-    while (rt == OPRT_RESOURCE_NOT_READY) {
-        tal_system_sleep(10);
-        rt = tuya_ai_input_write(&head, data);
-        if (cnt++ > 1000) {
-            PR_ERR("audio input failed %d", rt);
-            break;
-        }
-    }
-    return rt;
+    return tuya_ai_input_write(&head, data);
 }
 
 OPERATE_RET tuya_ai_image_input(UINT64_T timestamp, BYTE_T *data, UINT_T len, UINT_T total_len)
 {
-    if (!tuya_ai_input_is_started()) {
-        return OPRT_RESOURCE_NOT_READY;
-    }
     AI_BIZ_HD_T biz = {0};
     biz.image.timestamp = timestamp;
-    return tuya_ai_agent_upload_stream(AI_PT_IMAGE, &biz, (CHAR_T *)data, len, total_len);
+    return __ai_input_queue(AI_PT_IMAGE, &biz, data, len, total_len);
 }
 
 OPERATE_RET tuya_ai_text_input(BYTE_T *data, UINT_T len, UINT_T total_len)
 {
-    if (!tuya_ai_input_is_started()) {
-        return OPRT_RESOURCE_NOT_READY;
-    }
-    return tuya_ai_agent_upload_stream(AI_PT_TEXT, NULL, (CHAR_T *)data, len, total_len);
+    return __ai_input_queue(AI_PT_TEXT, NULL, data, len, total_len);
 }
 
 OPERATE_RET tuya_ai_file_input(BYTE_T *data, UINT_T len, UINT_T total_len)
 {
-    if (!tuya_ai_input_is_started()) {
-        return OPRT_RESOURCE_NOT_READY;
-    }
-    return tuya_ai_agent_upload_stream(AI_PT_FILE, NULL, (CHAR_T *)data, len, total_len);
+    return __ai_input_queue(AI_PT_FILE, NULL, data, len, total_len);
 }
 
 VOID tuya_ai_input_start(BOOL_T force)
@@ -308,18 +708,22 @@ STATIC VOID __ai_input_free(VOID)
         tal_thread_delete(ai_input_ctx.thread);
         ai_input_ctx.thread = NULL;
     }
-    if (ai_input_ctx.ringbuf) {
-        tuya_ring_buff_free(ai_input_ctx.ringbuf);
-        ai_input_ctx.ringbuf = NULL;
-    }
-    if (ai_input_ctx.input_buf) {
-        Free(ai_input_ctx.input_buf);
-        ai_input_ctx.input_buf = NULL;
+    if (ai_input_ctx.ring_buf) {
+        Free(ai_input_ctx.ring_buf);
+        ai_input_ctx.ring_buf = NULL;
     }
     if (ai_input_ctx.mutex) {
         tal_mutex_release(ai_input_ctx.mutex);
         ai_input_ctx.mutex = NULL;
     }
+    if (ai_input_ctx.write_mutex) {
+        tal_mutex_release(ai_input_ctx.write_mutex);
+        ai_input_ctx.write_mutex = NULL;
+    }
+    if (ai_input_ctx.room_sem) {
+        tal_semaphore_release(ai_input_ctx.room_sem);
+        ai_input_ctx.room_sem = NULL;
+    }
     if (ai_input_ctx.queue) {
         tal_queue_free(ai_input_ctx.queue);
         ai_input_ctx.queue = NULL;
@@ -336,7 +740,6 @@ STATIC VOID __ai_input_thread(VOID *arg)
 {
     OPERATE_RET rt = OPRT_OK;
     AI_INPUT_STATE_E queue_state = AI_INPUT_IDLE;
-    AI_RINGBUF_HEAD_T head = {0};
 
     while (!ai_input_ctx.terminate && tal_thread_get_state(ai_input_ctx.thread) == THREAD_STATE_RUNNING) {
         queue_state = ai_input_ctx.state;
@@ -375,20 +778,14 @@ STATIC VOID __ai_input_thread(VOID *arg)
             ai_input_ctx.queue_sync = TRUE;
         } break;
         case AI_INPUT_PROC: {
-            tal_mutex_lock(ai_input_ctx.mutex);
-            rt = tuya_ai_input_read(&head, ai_input_ctx.input_buf);
-            tal_mutex_unlock(ai_input_ctx.mutex);
-            if ((rt == OPRT_OK) && (head.len > 0)) {
-                tuya_ai_agent_upload_stream(head.type, &head.biz, ai_input_ctx.input_buf, head.len, head.total_len);
+            // a full batch leaves more queued, go on without the task delay
+            if (__ai_input_upload() >= AI_INPUT_BUF_SIZE) {
+                continue;
             }
         } break;
         case AI_INPUT_STOPPING: {
             if (ai_input_ctx.lazy_input++ < 30) {
-                tal_mutex_lock(ai_input_ctx.mutex);
-                rt = tuya_ai_input_read(&head, ai_input_ctx.input_buf);
-                tal_mutex_unlock(ai_input_ctx.mutex);
-                if ((rt == OPRT_OK) && (head.len > 0)) {
-                    tuya_ai_agent_upload_stream(head.type, &head.biz, ai_input_ctx.input_buf, head.len, head.total_len);
+                if (__ai_input_upload() > 0) {
                     ai_input_ctx.state = AI_INPUT_STOPPING;
                 } else {
                     ai_input_ctx.state = AI_INPUT_STOP;
@@ -400,9 +797,8 @@ STATIC VOID __ai_input_thread(VOID *arg)
         } break;
         case AI_INPUT_STOP: {
             tuya_ai_agent_end();
-            tal_mutex_lock(ai_input_ctx.mutex);
-            tuya_ring_buff_reset(ai_input_ctx.ringbuf);
-            tal_mutex_unlock(ai_input_ctx.mutex);
+            tuya_ai_ring_drain(&ai_input_ctx.ring);
+            tal_semaphore_post(ai_input_ctx.room_sem);
             ai_input_ctx.state = AI_INPUT_IDLE;
         } break;
         case AI_INPUT_IDLE:
@@ -426,20 +822,27 @@ OPERATE_RET tuya_ai_input_init(VOID)
     memset(&ai_input_ctx, 0, SIZEOF(ai_input_ctx));
 
     TUYA_CALL_ERR_RETURN(tal_mutex_create_init(&ai_input_ctx.mutex));
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ai_input_ctx.write_mutex), EXIT);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ai_input_ctx.room_sem, 0, 1), EXIT);
     TUYA_CALL_ERR_GOTO(tal_queue_create_init(&ai_input_ctx.queue, SIZEOF(AI_INPUT_STATE_E), 3), EXIT);
     TUYA_CALL_ERR_GOTO(tal_sw_timer_create(__alert_timeout_cb, NULL, &ai_input_ctx.alert.timer), EXIT);
 #if defined(ENABLE_EXT_RAM) && (ENABLE_EXT_RAM == 1)
-    ai_input_ctx.input_buf = tal_psram_malloc(AI_INPUT_BUF_SIZE);
+    ai_input_ctx.ring_buf = tal_psram_malloc(AI_INPUT_RINGBUF_SIZE);
 #else
-    ai_input_ctx.input_buf = Malloc(AI_INPUT_BUF_SIZE);
-#endif
-    TUYA_CHECK_NULL_GOTO(ai_input_ctx.input_buf, EXIT);
-#if defined(ENABLE_EXT_RAM) && (ENABLE_EXT_RAM == 1)
-    TUYA_CALL_ERR_GOTO(tuya_ring_buff_create(AI_INPUT_RINGBUF_SIZE, OVERFLOW_PSRAM_STOP_TYPE, &ai_input_ctx.ringbuf),
-                       EXIT);
-#else
-    TUYA_CALL_ERR_GOTO(tuya_ring_buff_create(AI_INPUT_RINGBUF_SIZE, OVERFLOW_STOP_TYPE, &ai_input_ctx.ringbuf), EXIT);
+    ai_input_ctx.ring_buf = Malloc(AI_INPUT_RINGBUF_SIZE);
 #endif
+    TUYA_CHECK_NULL_GOTO(ai_input_ctx.ring_buf, EXIT);
+    TUYA_CALL_ERR_GOTO(tuya_ai_ring_init(&ai_input_ctx.ring, ai_input_ctx.ring_buf, AI_INPUT_RINGBUF_SIZE), EXIT);
+
+    ai_input_ctx.policy[AI_INPUT_PT_IDX(AI_PT_VIDEO)] = AI_INPUT_DROP_NEWEST;
+    ai_input_ctx.policy[AI_INPUT_PT_IDX(AI_PT_AUDIO)] = AI_INPUT_DROP_OLDEST;
+    ai_input_ctx.policy[AI_INPUT_PT_IDX(AI_PT_IMAGE)] = AI_INPUT_KEEP_LATEST;
+    ai_input_ctx.policy[AI_INPUT_PT_IDX(AI_PT_FILE)] = AI_INPUT_NEVER_DROP;
+    ai_input_ctx.policy[AI_INPUT_PT_IDX(AI_PT_TEXT)] = AI_INPUT_NEVER_DROP;
+    tuya_ai_input_set_watermark(AI_INPUT_WATERMARK_HIGH, AI_INPUT_WATERMARK_LOW, NULL);
+    if (!ai_input_cli_registered) {
+        ai_input_cli_registered = (OPRT_OK == tal_cli_cmd_register(sc_ai_input_cli_cmd, CNTSOF(sc_ai_input_cli_cmd)));
+    }
 
     THREAD_CFG_T thrd_param = {0};
     thrd_param.priority = THREAD_PRIO_1;
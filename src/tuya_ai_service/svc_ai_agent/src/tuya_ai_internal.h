@@ -32,6 +32,7 @@ typedef struct {
     AI_BIZ_HD_T biz;
     UINT_T len;
     UINT_T total_len;
+    UINT_T seq;
 } AI_RINGBUF_HEAD_T;
 
 /**
@@ -0,0 +1,115 @@
+/**
+ * @file tuya_ai_crypto.h
+ * @author tuya
+ * @brief ai packet crypto stage
+ * @version 0.1
+ * @date 2025-06-10
+ *
+ * @copyright Copyright (c) 2023 Tuya Inc. All Rights Reserved.
+ *
+ * Permission is hereby granted, to any person obtaining a copy of this software and
+ * associated documentation files (the "Software"), Under the premise of complying
+ * with the license of the third-party open source software contained in the software,
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software.
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ */
+#ifndef __TUYA_AI_CRYPTO_H__
+#define __TUYA_AI_CRYPTO_H__
+
+#include "tuya_cloud_types.h"
+#include "tuya_ai_protocol.h"
+#include "tal_hash.h"
+#include "tal_symmetry.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/chacha20.h"
+
+/**
+ * @brief keyed crypto contexts of one connection
+ *
+ * key schedules are computed once per key and reused by every packet,
+ * nothing is allocated on the seal/sign path.
+ */
+typedef struct {
+    mbedtls_gcm_context gcm;            // SL4 and client hello body
+    mbedtls_chacha20_context chacha;    // SL2
+    TKL_SYMMETRY_HANDLE aes;            // SL3
+    tal_hash_mac_context_t hmac;        // packet signature
+    UCHAR_T sign_key[AI_KEY_LEN];
+    BOOL_T keyed;
+} AI_CRYPTO_CTX_T;
+
+/**
+ * @brief init crypto contexts
+ *
+ * @param[in] ctx crypto context
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_crypto_init(AI_CRYPTO_CTX_T *ctx);
+
+/**
+ * @brief free crypto contexts
+ *
+ * @param[in] ctx crypto context
+ */
+VOID tuya_ai_crypto_deinit(AI_CRYPTO_CTX_T *ctx);
+
+/**
+ * @brief set encrypt key, runs the key schedule of every cipher once
+ *
+ * @param[in] ctx crypto context
+ * @param[in] key crypt key, AI_KEY_LEN bytes
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_crypto_set_crypt_key(AI_CRYPTO_CTX_T *ctx, CONST UCHAR_T *key);
+
+/**
+ * @brief set sign key
+ *
+ * @param[in] ctx crypto context
+ * @param[in] key sign key, AI_KEY_LEN bytes
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_crypto_set_sign_key(AI_CRYPTO_CTX_T *ctx, CONST UCHAR_T *key);
+
+/**
+ * @brief encrypt buffer in place
+ *
+ * @param[in] ctx crypto context
+ * @param[in] sl security level, AI_PACKET_SL2/SL3/SL4
+ * @param[inout] iv iv or nonce, updated by CBC chaining
+ * @param[inout] buf data, SL3 data must be padded to the block size
+ * @param[in] len data length
+ * @param[out] tag gcm tag for SL4, AI_GCM_TAG_LEN bytes, may follow the data in buf
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_crypto_seal(AI_CRYPTO_CTX_T *ctx, AI_PACKET_SL sl, UCHAR_T *iv,
+                                UCHAR_T *buf, UINT_T len, UCHAR_T *tag);
+
+/**
+ * @brief sign packet
+ *
+ * HMAC-SHA256 over the first 32 bytes of the packet and the last 32 bytes of
+ * the payload, or over the whole packet when it is not longer than 64 bytes.
+ * The payload ends where the length field says: before the signature for
+ * AI_VERSION 1, after the zeroed signature slot for AI_VERSION 2.
+ *
+ * @param[in] ctx crypto context
+ * @param[in] pkt packet start
+ * @param[in] head_len packet head length, payload follows the head
+ * @param[in] payload_len signed payload length
+ * @param[out] signature AI_SIGN_LEN bytes, may be the signature slot in pkt
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_crypto_sign(AI_CRYPTO_CTX_T *ctx, CONST UCHAR_T *pkt, UINT_T head_len,
+                                UINT_T payload_len, UCHAR_T *signature);
+
+#endif
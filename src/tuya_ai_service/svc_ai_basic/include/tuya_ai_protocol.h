@@ -371,6 +371,17 @@ typedef struct ai_send_packet_t {
     AI_PACKET_WRITER_T *writer;
 } AI_SEND_PACKET_T;
 
+typedef struct {
+    UINT_T packets;                     // packets written from the send arena
+    UINT_T payload_bytes;               // caller data bytes carried by those packets
+    UINT_T copy_bytes;                  // caller data bytes copied on the send path
+    UINT_T last_payload_bytes;          // caller data bytes of the last packet
+    UINT_T last_copy_bytes;             // bytes copied for the last packet, equals last_payload_bytes on a one-copy path
+    UINT_T partial_writes;              // socket writes that found the send buffer full
+    UINT_T last_write_ms;               // time the last packet took to reach the socket
+    UINT_T rtt_ms;                      // round trip of the last ping, 0 before the first pong
+} AI_PROTO_SEND_STAT_T;
+
 typedef struct {
     UINT_T biz_code;
     UINT64_T biz_tag;
@@ -857,4 +868,13 @@ UINT_T tuya_ai_basic_get_var_seq(AI_PACKET_PT type, CHAR_T *buffer);
  * @param[in] type packet type
  */
 VOID tuya_ai_basic_update_var_seq(AI_PACKET_PT type);
+
+/**
+ * @brief get send path statistics
+ *
+ * @param[out] stat send statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_basic_get_send_stat(AI_PROTO_SEND_STAT_T *stat);
 #endif
\ No newline at end of file
@@ -0,0 +1,145 @@
+/**
+ * @file tuya_ai_ring.h
+ * @brief single producer / single consumer record ring
+ * @version 0.1
+ * @date 2025-06-12
+ *
+ * @copyright Copyright (c) 2025 Tuya Inc. All Rights Reserved.
+ *
+ * Permission is hereby granted, to any person obtaining a copy of this software and
+ * associated documentation files (the "Software"), Under the premise of complying
+ * with the license of the third-party open source software contained in the software,
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software.
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ */
+
+#ifndef __TUYA_AI_RING_H__
+#define __TUYA_AI_RING_H__
+
+#include "tuya_cloud_types.h"
+
+/**
+ * records are length prefixed and always contiguous in memory, a record that
+ * does not fit before the end of the buffer is placed at offset 0 and the gap
+ * is marked as padding. Only the producer moves head, tail is moved by the
+ * consumer and by the producer dropping records the consumer does not hold, so
+ * no lock is needed as long as there is exactly one of each.
+ */
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t head;
+    uint32_t tail;
+    /* producer private, pending reservation */
+    uint32_t rsv_off;
+    uint32_t rsv_len;
+} AI_RING_T;
+
+/**
+ * @brief tell whether the oldest record may be dropped
+ *
+ * @param[in] data record data
+ * @param[in] len record length
+ *
+ * @return TRUE to drop
+ */
+typedef BOOL_T (*AI_RING_DROP_CB)(void *data, uint32_t len);
+
+/**
+ * @brief init ring on a caller owned buffer
+ *
+ * @param[in] ring ring
+ * @param[in] buf buffer, 8 bytes aligned
+ * @param[in] size buffer size, rounded down to 8 bytes
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_ring_init(AI_RING_T *ring, void *buf, uint32_t size);
+
+/**
+ * @brief reserve a contiguous record, producer side
+ *
+ * @param[in] ring ring
+ * @param[in] len record length
+ * @param[out] data record data, valid until commit
+ *
+ * @return OPRT_OK on success, OPRT_RESOURCE_NOT_READY when the ring is full
+ */
+OPERATE_RET tuya_ai_ring_reserve(AI_RING_T *ring, uint32_t len, void **data);
+
+/**
+ * @brief publish the reserved record to the consumer
+ *
+ * @param[in] ring ring
+ * @param[in] len used length, not larger than the reserved one
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_ring_commit(AI_RING_T *ring, uint32_t len);
+
+/**
+ * @brief get the oldest record without removing it, consumer side
+ *
+ * @param[in] ring ring
+ * @param[out] data record data, valid until release
+ * @param[out] len record length
+ *
+ * @return OPRT_OK on success, OPRT_RESOURCE_NOT_READY when the ring is empty
+ */
+OPERATE_RET tuya_ai_ring_peek(AI_RING_T *ring, void **data, uint32_t *len);
+
+/**
+ * @brief remove the record returned by peek, consumer side
+ *
+ * @param[in] ring ring
+ */
+void tuya_ai_ring_release(AI_RING_T *ring);
+
+/**
+ * @brief give back the record returned by peek without removing it, consumer side
+ *
+ * @param[in] ring ring
+ */
+void tuya_ai_ring_unpeek(AI_RING_T *ring);
+
+/**
+ * @brief drop every published record, consumer side
+ *
+ * @param[in] ring ring
+ */
+void tuya_ai_ring_drain(AI_RING_T *ring);
+
+/**
+ * @brief drop the oldest record to make room, producer side
+ *
+ * the record the consumer holds between peek and release is never dropped, the
+ * oldest one after it is dropped instead and its room comes back once the held
+ * record is released.
+ *
+ * @param[in] ring ring
+ * @param[in] can_drop filter, NULL drops any record
+ * @param[out] data dropped record data, valid until the next commit, NULL when
+ *             only the room of a record dropped before was given back
+ * @param[out] len dropped record length
+ * @param[out] deferred TRUE when the room comes back at release
+ *
+ * @return OPRT_OK on success, OPRT_RESOURCE_NOT_READY when nothing can be dropped,
+ *         OPRT_NOT_SUPPORTED when the filter keeps the oldest record
+ */
+OPERATE_RET tuya_ai_ring_drop_oldest(AI_RING_T *ring, AI_RING_DROP_CB can_drop, void **data, uint32_t *len,
+                                     BOOL_T *deferred);
+
+/**
+ * @brief bytes in use, records plus headers and padding
+ *
+ * @param[in] ring ring
+ *
+ * @return used bytes, approximate when called concurrently
+ */
+uint32_t tuya_ai_ring_used(AI_RING_T *ring);
+
+#endif // __TUYA_AI_RING_H__
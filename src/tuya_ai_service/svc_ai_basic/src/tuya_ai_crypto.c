@@ -0,0 +1,175 @@
+/**
+ * @file tuya_ai_crypto.c
+ * @author tuya
+ * @brief ai packet crypto stage
+ * @version 0.1
+ * @date 2025-06-10
+ *
+ * @copyright Copyright (c) 2023 Tuya Inc. All Rights Reserved.
+ *
+ * Permission is hereby granted, to any person obtaining a copy of this software and
+ * associated documentation files (the "Software"), Under the premise of complying
+ * with the license of the third-party open source software contained in the software,
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software.
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ */
+#include "uni_log.h"
+#include "tuya_ai_crypto.h"
+
+#define AI_SIGN_WINDOW_LEN 64
+#define AI_SIGN_HALF_LEN   32
+
+OPERATE_RET tuya_ai_crypto_init(AI_CRYPTO_CTX_T *ctx)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TUYA_CHECK_NULL_RETURN(ctx, OPRT_INVALID_PARM);
+
+    memset(ctx, 0, SIZEOF(AI_CRYPTO_CTX_T));
+    mbedtls_gcm_init(&ctx->gcm);
+    mbedtls_chacha20_init(&ctx->chacha);
+    TUYA_CALL_ERR_GOTO(tal_aes_create_init(&ctx->aes), EXIT);
+    TUYA_CALL_ERR_GOTO(tal_sha256_mac_create_init(&ctx->hmac), EXIT);
+    return rt;
+
+EXIT:
+    PR_ERR("ai crypto init failed, rt:%d", rt);
+    tuya_ai_crypto_deinit(ctx);
+    return rt;
+}
+
+VOID tuya_ai_crypto_deinit(AI_CRYPTO_CTX_T *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+    mbedtls_gcm_free(&ctx->gcm);
+    mbedtls_chacha20_free(&ctx->chacha);
+    if (ctx->aes) {
+        tal_aes_free(ctx->aes);
+        ctx->aes = NULL;
+    }
+    if (ctx->hmac.ctx) {
+        tal_sha256_mac_free(&ctx->hmac);
+    }
+    memset(ctx->sign_key, 0, SIZEOF(ctx->sign_key));
+    ctx->keyed = FALSE;
+}
+
+OPERATE_RET tuya_ai_crypto_set_crypt_key(AI_CRYPTO_CTX_T *ctx, CONST UCHAR_T *key)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TUYA_CHECK_NULL_RETURN(ctx, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(key, OPRT_INVALID_PARM);
+
+    ctx->keyed = FALSE;
+    rt = mbedtls_gcm_setkey(&ctx->gcm, MBEDTLS_CIPHER_ID_AES, key, AI_KEY_LEN * 8);
+    if (OPRT_OK != rt) {
+        PR_ERR("gcm setkey failed, rt:%x", rt);
+        return rt;
+    }
+    rt = mbedtls_chacha20_setkey(&ctx->chacha, key);
+    if (OPRT_OK != rt) {
+        PR_ERR("chacha20 setkey failed, rt:%x", rt);
+        return rt;
+    }
+    rt = tal_aes_setkey_enc(ctx->aes, (UCHAR_T *)key, AI_KEY_LEN * 8);
+    if (OPRT_OK != rt) {
+        PR_ERR("aes setkey failed, rt:%d", rt);
+        return rt;
+    }
+    ctx->keyed = TRUE;
+    return rt;
+}
+
+OPERATE_RET tuya_ai_crypto_set_sign_key(AI_CRYPTO_CTX_T *ctx, CONST UCHAR_T *key)
+{
+    TUYA_CHECK_NULL_RETURN(ctx, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(key, OPRT_INVALID_PARM);
+    memcpy(ctx->sign_key, key, AI_KEY_LEN);
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_crypto_seal(AI_CRYPTO_CTX_T *ctx, AI_PACKET_SL sl, UCHAR_T *iv,
+                                UCHAR_T *buf, UINT_T len, UCHAR_T *tag)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TUYA_CHECK_NULL_RETURN(ctx, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(iv, OPRT_INVALID_PARM);
+    if (!ctx->keyed) {
+        PR_ERR("ai crypto not keyed");
+        return OPRT_COM_ERROR;
+    }
+
+    switch (sl) {
+    case AI_PACKET_SL2:
+        // chacha20 nonce is the first 12 bytes of the iv, block counter starts at 0
+        rt = mbedtls_chacha20_starts(&ctx->chacha, iv, 0);
+        if (OPRT_OK == rt) {
+            rt = mbedtls_chacha20_update(&ctx->chacha, len, buf, buf);
+        }
+        if (OPRT_OK != rt) {
+            PR_ERR("chacha20_crypt error:%d", rt);
+        }
+        break;
+
+    case AI_PACKET_SL3:
+        rt = tal_aes_crypt_cbc(ctx->aes, SYMMETRY_ENCRYPT, len, iv, buf, buf);
+        if (OPRT_OK != rt) {
+            PR_ERR("aes256_cbc_encode error:%d", rt);
+        }
+        break;
+
+    case AI_PACKET_SL4:
+        TUYA_CHECK_NULL_RETURN(tag, OPRT_INVALID_PARM);
+        rt = mbedtls_gcm_crypt_and_tag(&ctx->gcm, MBEDTLS_GCM_ENCRYPT, len,
+                                       iv, AI_IV_LEN, NULL, 0,
+                                       buf, buf, AI_GCM_TAG_LEN, tag);
+        if (OPRT_OK != rt) {
+            PR_ERR("aes256_gcm_encode error:%x", rt);
+        }
+        break;
+
+    default:
+        PR_ERR("sl:%d err", sl);
+        rt = OPRT_INVALID_PARM;
+        break;
+    }
+
+    return rt;
+}
+
+OPERATE_RET tuya_ai_crypto_sign(AI_CRYPTO_CTX_T *ctx, CONST UCHAR_T *pkt, UINT_T head_len,
+                                UINT_T payload_len, UCHAR_T *signature)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TUYA_CHECK_NULL_RETURN(ctx, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(pkt, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(signature, OPRT_INVALID_PARM);
+
+    TUYA_CALL_ERR_RETURN(tal_sha256_mac_starts(&ctx->hmac, ctx->sign_key, AI_KEY_LEN));
+
+    // the window is fed straight from the packet, it is never gathered into a scratch buffer
+    if (head_len + payload_len <= AI_SIGN_WINDOW_LEN) {
+        TUYA_CALL_ERR_RETURN(tal_sha256_mac_update(&ctx->hmac, pkt, head_len + payload_len));
+    } else {
+        CONST UCHAR_T *payload = pkt + head_len;
+        UINT_T tail_len = (payload_len > AI_SIGN_HALF_LEN) ? AI_SIGN_HALF_LEN : payload_len;
+        UCHAR_T zero[AI_SIGN_HALF_LEN] = {0};
+
+        TUYA_CALL_ERR_RETURN(tal_sha256_mac_update(&ctx->hmac, pkt, AI_SIGN_HALF_LEN));
+        TUYA_CALL_ERR_RETURN(tal_sha256_mac_update(&ctx->hmac, payload + payload_len - tail_len, tail_len));
+        if (tail_len < AI_SIGN_HALF_LEN) {
+            TUYA_CALL_ERR_RETURN(tal_sha256_mac_update(&ctx->hmac, zero, AI_SIGN_HALF_LEN - tail_len));
+        }
+    }
+
+    rt = tal_sha256_mac_finish(&ctx->hmac, signature);
+    if (OPRT_OK != rt) {
+        PR_ERR("sign packet failed, rt:%d", rt);
+    }
+    return rt;
+}
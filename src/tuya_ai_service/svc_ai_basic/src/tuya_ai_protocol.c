@@ -32,6 +32,7 @@
 #include "mqc_app.h"
 #include "tuya_svc_netmgr_linkage.h"
 #include "tuya_ai_protocol.h"
+#include "tuya_ai_crypto.h"
 #include "tuya_ai_private.h"
 #include <mbedtls/pk.h>
 #include <mbedtls/rsa.h>
@@ -91,6 +92,9 @@ typedef struct {
     AI_SEND_FRAG_MNG_T send_frag_mng[5];
     BOOL_T frag_flag;
     CHAR_T recv_buf[AI_MAX_FRAGMENT_LENGTH + AI_ADD_PKT_LEN];
+    CHAR_T send_buf[AI_MAX_FRAGMENT_LENGTH + AI_ADD_PKT_LEN];
+    AI_CRYPTO_CTX_T crypto;
+    AI_PROTO_SEND_STAT_T send_stat;
     CHAR_T *rsa_public_key;
     UINT_T file_seq;
     UINT_T text_seq;
@@ -208,10 +212,14 @@ STATIC OPERATE_RET __ai_generate_crypt_key()
                       (const unsigned char *)ikm, ikm_len,
                       (const unsigned char *)info, info_len,
                       (unsigned char *)ai_basic_proto->crypt_key, AI_KEY_LEN);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
     memcpy(ai_basic_proto->iv_mask, ai_basic_proto->crypt_key, AI_IV_LEN);
     // tuya_debug_hex_dump("iv_mask ", 64, (UCHAR_T *)ai_basic_proto->crypt_key, AI_IV_LEN);
 
-    return rt;
+    // key schedule is done once per key, packets are sealed in place with it
+    return tuya_ai_crypto_set_crypt_key(&ai_basic_proto->crypto, (UCHAR_T *)ai_basic_proto->crypt_key);
 }
 
 STATIC CHAR_T *__ai_get_crypt_key(VOID)
@@ -239,7 +247,10 @@ STATIC OPERATE_RET __ai_generate_sign_key()
                       (const unsigned char *)ikm, ikm_len,
                       (const unsigned char *)info, info_len,
                       (unsigned char *)ai_basic_proto->sign_key, AI_KEY_LEN);
-    return rt;
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+    return tuya_ai_crypto_set_sign_key(&ai_basic_proto->crypto, (UCHAR_T *)ai_basic_proto->sign_key);
 }
 
 STATIC CHAR_T *__ai_get_sign_key(VOID)
@@ -284,6 +295,7 @@ STATIC VOID __ai_basic_proto_deinit(VOID)
             OS_FREE(ai_basic_proto->connection_id);
             ai_basic_proto->connection_id = NULL;
         }
+        tuya_ai_crypto_deinit(&ai_basic_proto->crypto);
         OS_FREE(ai_basic_proto);
         ai_basic_proto = NULL;
         PR_NOTICE("ai proto deinit success");
@@ -331,6 +343,7 @@ STATIC OPERATE_RET __ai_basic_proto_init(VOID)
         ai_basic_proto = OS_MALLOC(SIZEOF(AI_BASIC_PROTO_T));
         TUYA_CHECK_NULL_RETURN(ai_basic_proto, OPRT_MALLOC_FAILED);
         memset(ai_basic_proto, 0, SIZEOF(AI_BASIC_PROTO_T));
+        TUYA_CALL_ERR_GOTO(tuya_ai_crypto_init(&ai_basic_proto->crypto), EXIT);
         TUYA_CALL_ERR_GOTO(__ai_generate_crypt_key(), EXIT);
         TUYA_CALL_ERR_GOTO(__ai_generate_sign_key(), EXIT);
         TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&(ai_basic_proto->mutex)), EXIT);
@@ -601,6 +614,11 @@ STATIC OPERATE_RET __ai_rsa_encrypt_info(CHAR_T *key, CHAR_T *out, UINT_T *outle
         goto end;
     }
 
+    if (olen > *outlen) {
+        PR_ERR("rsa output too long, olen:%d, max:%d", olen, *outlen);
+        ret = OPRT_BUFFER_NOT_ENOUGH;
+        goto end;
+    }
     *outlen = olen;
     memcpy(out, output, olen);
 
@@ -616,9 +634,7 @@ STATIC OPERATE_RET __ai_encrypt_clint_hello_info(CHAR_T *pubkey, CHAR_T *out, UI
 {
     //client hello RSA(AES KEY) + IV + AES(BODY + TAG)
     OPERATE_RET rt = OPRT_OK;
-    UINT_T en_len = 0;
-    UINT_T positon = 0;
-    BYTE_T tag[AI_GCM_TAG_LEN] = {0};
+    UINT_T positon = AI_RSA_PKT_LEN;
     UCHAR_T iv[AI_IV_LEN] = {0};
     CHAR_T *aes_p = NULL;
     CHAR_T *key = __ai_get_crypt_key();
@@ -638,36 +654,29 @@ STATIC OPERATE_RET __ai_encrypt_clint_hello_info(CHAR_T *pubkey, CHAR_T *out, UI
     positon += AI_IV_LEN;
     // tuya_debug_hex_dump("RSA +iv ", 64, (UCHAR_T *)out, positon);
 
+    // body is normally packed right behind RSA + IV already, only a short RSA block moves it
     aes_p = out + positon;
-    memcpy(aes_p, data, len);
-
-    rt = mbedtls_cipher_auth_encrypt_wrapper(
-    &(CONST cipher_params_t) {
-        .cipher_type = MBEDTLS_CIPHER_AES_256_GCM,
-        .key = (unsigned char *)key,
-        .key_len = AI_KEY_LEN,
-        .nonce = (UCHAR_T *)iv,
-        .nonce_len = AI_IV_LEN,
-        .ad = NULL,
-        .ad_len = 0,
-        .data = (UCHAR_T *)aes_p,
-        .data_len = len
-    },
-    (UCHAR_T *)aes_p, (size_t *)&en_len,
-    tag, SIZEOF(tag));
-    if (rt != OPRT_OK) {
-        PR_ERR("aes128_gcm_encode error:%x", rt);
+    if (aes_p != data) {
+        memmove(aes_p, data, len);
+        ai_basic_proto->send_stat.last_copy_bytes += len;
     }
-    memcpy(aes_p + en_len, tag, SIZEOF(tag));
-    en_len += SIZEOF(tag);
 
-    *outlen = en_len + positon;
+    rt = tuya_ai_crypto_seal(&ai_basic_proto->crypto, AI_PACKET_SL4, iv, (UCHAR_T *)aes_p, len, (UCHAR_T *)aes_p + len);
+
+    *outlen = positon + len + AI_GCM_TAG_LEN;
 
     // tuya_debug_hex_dump("encrypt_data", 64, (UCHAR_T *)out, *outlen);
 
     return rt;
 }
 
+/**
+ * @brief seal the payload inside the send arena
+ *
+ * symmetric levels encrypt in place, data must be equal to output. the RSA
+ * client hello writes RSA(key) + IV in front of the body, so data sits
+ * AI_RSA_PKT_LEN + AI_IV_LEN behind output.
+ */
 STATIC OPERATE_RET __ai_encrypt_packet(AI_SEND_PACKET_T *info, CHAR_T *data, UINT_T len, CHAR_T *output, UINT_T *en_len, USHORT_T sequence)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -678,24 +687,18 @@ STATIC OPERATE_RET __ai_encrypt_packet(AI_SEND_PACKET_T *info, CHAR_T *data, UIN
     AI_PACKET_SL sl = __ai_get_sl(info, FALSE);
     if (sl == AI_PACKET_SL2) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
-        memcpy(output, data, len);
         data_out_len = __ai_encrypt_add_pkcs(output, len);
-        CHAR_T nonce[12] = {0};
-        memcpy(nonce, ai_basic_proto->encrypt_iv, SIZEOF(nonce));
-        rt = mbedtls_chacha20_crypt((UCHAR_T *)key, (UCHAR_T *)nonce, 0, len, (UCHAR_T *)data, (UCHAR_T *)output);
+        rt = tuya_ai_crypto_seal(&ai_basic_proto->crypto, sl, (UCHAR_T *)ai_basic_proto->encrypt_iv, (UCHAR_T *)output, len, NULL);
         if (OPRT_OK != rt) {
-            PR_ERR("chacha20_crypt error:%d", rt);
             return rt;
         }
         *en_len = data_out_len;
 #endif
     } else if (sl == AI_PACKET_SL3) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
-        memcpy(output, data, len);
         data_out_len = tal_pkcs7padding_buffer((UCHAR_T *)output, len);
-        rt = tal_aes256_cbc_encode_raw((BYTE_T *)output, data_out_len, (UCHAR_T *)key, (UCHAR_T *)ai_basic_proto->encrypt_iv, (UCHAR_T *)output);
+        rt = tuya_ai_crypto_seal(&ai_basic_proto->crypto, sl, (UCHAR_T *)ai_basic_proto->encrypt_iv, (UCHAR_T *)output, data_out_len, NULL);
         if (OPRT_OK != rt) {
-            PR_ERR("aes128_cbc_encode error:%d", rt);
             return rt;
         }
         *en_len = data_out_len;
@@ -709,41 +712,18 @@ STATIC OPERATE_RET __ai_encrypt_packet(AI_SEND_PACKET_T *info, CHAR_T *data, UIN
         xor_ivmask_with_sequence(iv, sequence);
 #endif
 
-        BYTE_T tag[AI_GCM_TAG_LEN] = {0};
-        memcpy(output, data, len);
 #if defined(AI_VERSION) && (0x01 == AI_VERSION)
         data_out_len = __ai_encrypt_add_pkcs(output, len);
+        UCHAR_T *iv = (UCHAR_T *)ai_basic_proto->encrypt_iv;
 #else
         data_out_len = len;
 #endif
-        rt = mbedtls_cipher_auth_encrypt_wrapper(
-        &(CONST cipher_params_t) {
-            .cipher_type = MBEDTLS_CIPHER_AES_256_GCM,
-            .key = (unsigned char *)key,
-            .key_len = AI_KEY_LEN,
-#if defined(AI_VERSION) && (0x01 == AI_VERSION)
-            .nonce = (UCHAR_T *)ai_basic_proto->encrypt_iv,
-#else
-            .nonce = (UCHAR_T *)iv,
-#endif
-            .nonce_len = AI_IV_LEN,
-            .ad = NULL,
-            .ad_len = 0,
-            .data = (UCHAR_T *)output,
-            .data_len = data_out_len
-        },
-        (UCHAR_T *)output, (size_t *)en_len,
-        tag, SIZEOF(tag));
-        if (rt != OPRT_OK) {
-            PR_ERR("aes128_gcm_encode error:%x", rt);
-        }
-        memcpy(output + *en_len, tag, SIZEOF(tag));
-        *en_len += SIZEOF(tag);
+        rt = tuya_ai_crypto_seal(&ai_basic_proto->crypto, sl, iv, (UCHAR_T *)output, data_out_len, (UCHAR_T *)output + data_out_len);
+        *en_len = data_out_len + AI_GCM_TAG_LEN;
         // tuya_debug_hex_dump("encrypt_data", 64, (UCHAR_T *)output, *en_len);
 #endif
     } else if (sl == AI_PACKET_SL0) {
         AI_PROTO_D("sl:%d do not need crypt", sl);
-        memcpy(output, data, len);
         *en_len = len;
     } else if (sl == AI_PACKET_RSA) {
         rt = __ai_encrypt_clint_hello_info(ai_basic_proto->rsa_public_key, output, en_len, data, len);
@@ -839,6 +819,15 @@ STATIC OPERATE_RET __ai_decrypt_packet(CHAR_T *data, UINT_T len, CHAR_T *output,
     return rt;
 }
 
+STATIC UINT_T __ai_get_payload_reserve(AI_SEND_PACKET_T *info)
+{
+    // client hello ciphertext starts with RSA(key) + IV, pack the body behind them
+    if (__ai_get_sl(info, FALSE) == AI_PACKET_RSA) {
+        return AI_RSA_PKT_LEN + AI_IV_LEN;
+    }
+    return 0;
+}
+
 STATIC OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, CHAR_T *payload_buf, UINT_T *payload_len, AI_FRAG_FLAG frag, UINT_T origin_len, USHORT_T sequence)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -847,9 +836,8 @@ STATIC OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, CHAR_T *payload_buf
     TUYA_CHECK_NULL_RETURN(info, OPRT_INVALID_PARM);
     packet_len = __ai_get_send_payload_len(info, frag);
 
-    CHAR_T *buf = OS_MALLOC(packet_len);
-    TUYA_CHECK_NULL_RETURN(buf, OPRT_MALLOC_FAILED);
-    memset(buf, 0, packet_len);
+    // serialize the plain payload straight into the send arena, it is encrypted in place below
+    CHAR_T *buf = payload_buf + __ai_get_payload_reserve(info);
 
     if (tuya_ai_is_need_attr(frag)) {
         AI_PAYLOAD_HEAD_T payload_head = {0};
@@ -898,7 +886,6 @@ STATIC OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, CHAR_T *payload_buf
                     memcpy(buf + offset, info->attrs[idx]->value.str, attr_idx_len);
                 } else {
                     PR_ERR("unknow payload type:%d", payload_type);
-                    OS_FREE(buf);
                     return OPRT_COM_ERROR;
                 }
                 offset += attr_idx_len;
@@ -914,7 +901,9 @@ STATIC OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, CHAR_T *payload_buf
 #endif
     }
 
+    // the only copy of the caller data on the send path
     memcpy(buf + offset, info->data, info->len);
+    ai_basic_proto->send_stat.last_copy_bytes += info->len;
     offset += info->len;
     AI_PROTO_D("payload len:%d, offset:%d", packet_len, offset);
 
@@ -924,7 +913,6 @@ STATIC OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, CHAR_T *payload_buf
         PR_ERR("encrypt packet failed, rt:%d", rt);
     }
 
-    OS_FREE(buf);
     return rt;
 }
 
@@ -1064,7 +1052,6 @@ STATIC OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
     OPERATE_RET rt = OPRT_OK;
     UINT_T payload_len = 0, offset = 0;
     AI_PACKET_SL sl = __ai_get_sl(info, FALSE);
-    UCHAR_T signature[AI_SIGN_LEN] = {0};
     USHORT_T sequence;
     if (info->writer && info->writer->update) {
         rt = info->writer->update(AI_STAGE_PRE_WRITE, NULL, info);
@@ -1086,9 +1073,9 @@ STATIC OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
         PR_ERR("send packet too long, len: %d", uncrypt_len);
         return OPRT_COM_ERROR;
     }
-    CHAR_T *send_pkt_buf = OS_MALLOC(uncrypt_len);
-    TUYA_CHECK_NULL_RETURN(send_pkt_buf, OPRT_MALLOC_FAILED);
-    memset(send_pkt_buf, 0, uncrypt_len);
+    // header, iv, length, ciphertext and signature are all laid out in the preallocated arena
+    CHAR_T *send_pkt_buf = ai_basic_proto->send_buf;
+    ai_basic_proto->send_stat.last_copy_bytes = 0;
 
 #if defined(AI_VERSION) && (0x01 == AI_VERSION)
     UINT_T head_len = SIZEOF(AI_PACKET_HEAD_T);
@@ -1128,7 +1115,7 @@ STATIC OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
 
     rt = __ai_pack_payload(info, send_pkt_buf + offset, &payload_len, frag, origin_len, sequence);
     if (OPRT_OK != rt) {
-        goto EXIT;
+        return rt;
     }
 #if defined(AI_VERSION) && (0x01 == AI_VERSION)
     length = UNI_HTONL(payload_len + AI_SIGN_LEN);
@@ -1139,26 +1126,27 @@ STATIC OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
         memcpy(send_pkt_buf + head_len, &length, SIZEOF(length));
     }
 
-    rt = __ai_packet_sign(send_pkt_buf, signature);
+    // sign right behind the seal while the tail of the ciphertext is still hot
+    rt = tuya_ai_crypto_sign(&ai_basic_proto->crypto, (UCHAR_T *)send_pkt_buf, offset, payload_len,
+                             (UCHAR_T *)send_pkt_buf + offset + payload_len);
     if (OPRT_OK != rt) {
-        goto EXIT;
+        return rt;
     }
-    offset += payload_len;
-    memcpy(send_pkt_buf + offset, signature, AI_SIGN_LEN);
-    offset += AI_SIGN_LEN;
+    offset += payload_len + AI_SIGN_LEN;
 #else
 
     if (AI_PACKET_SL4 != sl && AI_PACKET_RSA != sl) {
         length = UNI_HTONS((payload_len + AI_SIGN_LEN));
         memcpy(send_pkt_buf + head_len, &length, SIZEOF(length));
+        // the signature slot is signed as zeros, clear what the last packet left in the arena
+        memset(send_pkt_buf + offset + payload_len, 0, AI_SIGN_LEN);
 
-        rt = __ai_packet_sign(send_pkt_buf, signature);
+        rt = tuya_ai_crypto_sign(&ai_basic_proto->crypto, (UCHAR_T *)send_pkt_buf, offset, payload_len + AI_SIGN_LEN,
+                                 (UCHAR_T *)send_pkt_buf + offset + payload_len);
         if (OPRT_OK != rt) {
-            goto EXIT;
+            return rt;
         }
-        offset += payload_len;
-        memcpy(send_pkt_buf + offset, signature, AI_SIGN_LEN);
-        offset += AI_SIGN_LEN;
+        offset += payload_len + AI_SIGN_LEN;
     } else {
         length = UNI_HTONS(payload_len);
         memcpy(send_pkt_buf + head_len, &length, SIZEOF(length));
@@ -1180,14 +1168,18 @@ STATIC OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
         writer = &s_default_packet_writer;
         writer->user_data = ai_basic_proto->transporter;
     }
+    SYS_TIME_T write_start = tal_system_get_millisecond();
     rt = writer->write(writer, send_pkt_buf, offset);
     if (OPRT_OK != rt) {
         PR_ERR("write packet failed, rt:%d", rt);
-        goto EXIT;
+        return rt;
     }
+    ai_basic_proto->send_stat.last_write_ms = (UINT_T)(tal_system_get_millisecond() - write_start);
 
-EXIT:
-    OS_FREE(send_pkt_buf);
+    ai_basic_proto->send_stat.packets++;
+    ai_basic_proto->send_stat.payload_bytes += info->len;
+    ai_basic_proto->send_stat.copy_bytes += ai_basic_proto->send_stat.last_copy_bytes;
+    ai_basic_proto->send_stat.last_payload_bytes = info->len;
     return rt;
 }
 
@@ -1639,6 +1631,13 @@ OPERATE_RET tuya_ai_pong(CHAR_T *data, UINT_T len)
     }
 
     AI_PROTO_D("client ts:%llu, server ts:%llu", client_ts, server_ts);
+    // the pong echoes the ts of our ping
+    UINT64_T now = tal_time_get_posix_ms();
+    if (ai_basic_proto && client_ts && now >= client_ts) {
+        tal_mutex_lock(ai_basic_proto->mutex);
+        ai_basic_proto->send_stat.rtt_ms = (UINT_T)(now - client_ts);
+        tal_mutex_unlock(ai_basic_proto->mutex);
+    }
     return rt;
 }
 
@@ -2719,6 +2718,18 @@ VOID tuya_ai_basic_update_var_seq(AI_PACKET_PT type)
     }
 }
 
+OPERATE_RET tuya_ai_basic_get_send_stat(AI_PROTO_SEND_STAT_T *stat)
+{
+    TUYA_CHECK_NULL_RETURN(stat, OPRT_INVALID_PARM);
+    if (!ai_basic_proto) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    tal_mutex_lock(ai_basic_proto->mutex);
+    memcpy(stat, &ai_basic_proto->send_stat, SIZEOF(AI_PROTO_SEND_STAT_T));
+    tal_mutex_unlock(ai_basic_proto->mutex);
+    return OPRT_OK;
+}
+
 //such as f47ac10b-58cc-42d5-0136-4067a8e7d6b3
 OPERATE_RET tuya_ai_basic_uuid_v4(CHAR_T *uuid_str)
 {
@@ -2776,6 +2787,7 @@ STATIC OPERATE_RET __default_write(AI_PACKET_WRITER_T *writer, VOID *buf, UINT_T
             current_buf_ptr += rt;
             remaining_len -= rt;
             if (remaining_len > 0) {
+                ai_basic_proto->send_stat.partial_writes++;
                 PR_DEBUG("partial send, sent:%d, total_sent:%d, remaining:%d, err:%d", rt, bytes_sent, remaining_len, tal_net_get_errno());
                 tal_system_sleep(100);
             }
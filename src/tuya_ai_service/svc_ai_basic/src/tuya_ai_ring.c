@@ -0,0 +1,272 @@
+/**
+ * @file tuya_ai_ring.c
+ * @brief single producer / single consumer record ring
+ * @version 0.1
+ * @date 2025-06-12
+ *
+ * @copyright Copyright (c) 2025 Tuya Inc. All Rights Reserved.
+ *
+ * Permission is hereby granted, to any person obtaining a copy of this software and
+ * associated documentation files (the "Software"), Under the premise of complying
+ * with the license of the third-party open source software contained in the software,
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software.
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ */
+#include "uni_log.h"
+#include "tuya_ai_ring.h"
+
+#define AI_RING_ALIGN(x) (((x) + 7) & ~7U)
+#define AI_RING_PAD      (0x1)
+/* claimed by the consumer at peek, or by the producer dropping a record behind the held one */
+#define AI_RING_TAKEN   (0x2)
+#define AI_RING_DROPPED (0x4)
+
+/* records are 8 bytes aligned, bit 0 of tail tells the consumer holds the oldest record */
+#define AI_RING_HOLD (0x1U)
+
+/* head is published by the producer, tail by the consumer or by the producer dropping records */
+#define AI_RING_LOAD(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define AI_RING_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define AI_RING_CAS(p, e, v)                                                                                           \
+    __atomic_compare_exchange_n((p), (e), (v), FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+typedef struct {
+    uint32_t len;
+    uint32_t flag;
+} AI_RING_REC_T;
+
+#define AI_RING_REC(ring, off) ((AI_RING_REC_T *)((ring)->buf + (off)))
+
+OPERATE_RET tuya_ai_ring_init(AI_RING_T *ring, void *buf, uint32_t size)
+{
+    TUYA_CHECK_NULL_RETURN(ring, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(buf, OPRT_INVALID_PARM);
+    if (((uintptr_t)buf & 7) || size < 2 * SIZEOF(AI_RING_REC_T)) {
+        PR_ERR("ai ring buf %p size %d invalid", buf, size);
+        return OPRT_INVALID_PARM;
+    }
+
+    memset(ring, 0, SIZEOF(AI_RING_T));
+    ring->buf = buf;
+    ring->size = size & ~7U;
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_ring_reserve(AI_RING_T *ring, uint32_t len, void **data)
+{
+    uint32_t need = AI_RING_ALIGN(SIZEOF(AI_RING_REC_T) + len);
+    uint32_t head = ring->head;
+    uint32_t tail = AI_RING_LOAD(&ring->tail) & ~AI_RING_HOLD;
+    uint32_t off = 0;
+
+    // head never catches up with tail, head == tail always means empty
+    if (head >= tail) {
+        uint32_t end = ring->size - head;
+        if (need < end || (need == end && tail != 0)) {
+            off = head;
+        } else if (need < tail) {
+            off = 0;
+        } else {
+            return OPRT_RESOURCE_NOT_READY;
+        }
+    } else {
+        if (need >= tail - head) {
+            return OPRT_RESOURCE_NOT_READY;
+        }
+        off = head;
+    }
+
+    ring->rsv_off = off;
+    ring->rsv_len = need;
+    *data = ring->buf + off + SIZEOF(AI_RING_REC_T);
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_ring_commit(AI_RING_T *ring, uint32_t len)
+{
+    uint32_t head = ring->head;
+    uint32_t need = AI_RING_ALIGN(SIZEOF(AI_RING_REC_T) + len);
+
+    if (ring->rsv_len == 0 || need > ring->rsv_len) {
+        PR_ERR("ai ring commit %d without reservation %d", len, ring->rsv_len);
+        return OPRT_INVALID_PARM;
+    }
+
+    AI_RING_REC(ring, ring->rsv_off)->len = len;
+    AI_RING_REC(ring, ring->rsv_off)->flag = 0;
+    if (ring->rsv_off != head) {
+        // wrapped, the consumer skips the tail gap
+        AI_RING_REC(ring, head)->len = 0;
+        AI_RING_REC(ring, head)->flag = AI_RING_PAD;
+    }
+
+    head = ring->rsv_off + need;
+    if (head == ring->size) {
+        head = 0;
+    }
+    ring->rsv_len = 0;
+    AI_RING_STORE(&ring->head, head);
+    return OPRT_OK;
+}
+
+STATIC uint32_t __ai_ring_next(AI_RING_T *ring, uint32_t off)
+{
+    off += AI_RING_ALIGN(SIZEOF(AI_RING_REC_T) + AI_RING_REC(ring, off)->len);
+    return (off == ring->size) ? 0 : off;
+}
+
+OPERATE_RET tuya_ai_ring_peek(AI_RING_T *ring, void **data, uint32_t *len)
+{
+    uint32_t tail = 0, base = 0, flag = 0;
+
+    for (;;) {
+        tail = AI_RING_LOAD(&ring->tail);
+        base = tail & ~AI_RING_HOLD;
+        if (base == AI_RING_LOAD(&ring->head)) {
+            return OPRT_RESOURCE_NOT_READY;
+        }
+        // take the hold first, the producer may have dropped the record meanwhile
+        if (!(tail & AI_RING_HOLD) && !AI_RING_CAS(&ring->tail, &tail, base | AI_RING_HOLD)) {
+            continue;
+        }
+        if (AI_RING_REC(ring, base)->flag & AI_RING_PAD) {
+            AI_RING_STORE(&ring->tail, 0);
+            continue;
+        }
+        // the producer may drop a record while the one before it is held, one of both claims it
+        flag = 0;
+        if (!AI_RING_CAS(&AI_RING_REC(ring, base)->flag, &flag, AI_RING_TAKEN) && !(flag & AI_RING_TAKEN)) {
+            AI_RING_STORE(&ring->tail, __ai_ring_next(ring, base));
+            continue;
+        }
+        break;
+    }
+
+    *data = ring->buf + base + SIZEOF(AI_RING_REC_T);
+    *len = AI_RING_REC(ring, base)->len;
+    return OPRT_OK;
+}
+
+void tuya_ai_ring_release(AI_RING_T *ring)
+{
+    uint32_t tail = AI_RING_LOAD(&ring->tail);
+
+    if (!(tail & AI_RING_HOLD)) {
+        return;
+    }
+    AI_RING_STORE(&ring->tail, __ai_ring_next(ring, tail & ~AI_RING_HOLD));
+}
+
+void tuya_ai_ring_unpeek(AI_RING_T *ring)
+{
+    uint32_t tail = AI_RING_LOAD(&ring->tail);
+
+    if (tail & AI_RING_HOLD) {
+        AI_RING_STORE(&AI_RING_REC(ring, tail & ~AI_RING_HOLD)->flag, 0);
+        AI_RING_STORE(&ring->tail, tail & ~AI_RING_HOLD);
+    }
+}
+
+void tuya_ai_ring_drain(AI_RING_T *ring)
+{
+    AI_RING_STORE(&ring->tail, AI_RING_LOAD(&ring->head));
+}
+
+/**
+ * @brief drop the first record after the held one, its room comes back at release
+ *
+ * @return OPRT_COM_ERROR when the consumer moved on meanwhile, others as tuya_ai_ring_drop_oldest
+ */
+STATIC OPERATE_RET __ai_ring_drop_behind(AI_RING_T *ring, uint32_t base, AI_RING_DROP_CB can_drop, uint32_t *off)
+{
+    uint32_t cur = __ai_ring_next(ring, base);
+    uint32_t flag = 0;
+
+    while (cur != ring->head) {
+        if (AI_RING_REC(ring, cur)->flag & AI_RING_PAD) {
+            cur = 0;
+            continue;
+        }
+        flag = AI_RING_LOAD(&AI_RING_REC(ring, cur)->flag);
+        if (flag & AI_RING_DROPPED) {
+            cur = __ai_ring_next(ring, cur);
+            continue;
+        }
+        if (flag & AI_RING_TAKEN) {
+            return OPRT_COM_ERROR;
+        }
+        if (can_drop && !can_drop(ring->buf + cur + SIZEOF(AI_RING_REC_T), AI_RING_REC(ring, cur)->len)) {
+            return OPRT_NOT_SUPPORTED;
+        }
+        if (!AI_RING_CAS(&AI_RING_REC(ring, cur)->flag, &flag, AI_RING_DROPPED)) {
+            return OPRT_COM_ERROR;
+        }
+        *off = cur;
+        return OPRT_OK;
+    }
+    return OPRT_RESOURCE_NOT_READY;
+}
+
+OPERATE_RET tuya_ai_ring_drop_oldest(AI_RING_T *ring, AI_RING_DROP_CB can_drop, void **data, uint32_t *len,
+                                     BOOL_T *deferred)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t tail = 0;
+
+    *deferred = FALSE;
+    for (;;) {
+        tail = AI_RING_LOAD(&ring->tail);
+        if (tail & AI_RING_HOLD) {
+            rt = __ai_ring_drop_behind(ring, tail & ~AI_RING_HOLD, can_drop, &tail);
+            if (OPRT_COM_ERROR == rt) {
+                // start over from the tail of the consumer
+                continue;
+            }
+            if (OPRT_OK != rt) {
+                return rt;
+            }
+            *deferred = TRUE;
+            break;
+        }
+        if (tail == ring->head) {
+            return OPRT_RESOURCE_NOT_READY;
+        }
+        if (AI_RING_REC(ring, tail)->flag & AI_RING_PAD) {
+            AI_RING_CAS(&ring->tail, &tail, 0);
+            continue;
+        }
+        if (AI_RING_LOAD(&AI_RING_REC(ring, tail)->flag) & AI_RING_DROPPED) {
+            // dropped behind an earlier hold, only its room is given back
+            if (AI_RING_CAS(&ring->tail, &tail, __ai_ring_next(ring, tail))) {
+                *data = NULL;
+                *len = 0;
+                return OPRT_OK;
+            }
+            continue;
+        }
+        if (can_drop && !can_drop(ring->buf + tail + SIZEOF(AI_RING_REC_T), AI_RING_REC(ring, tail)->len)) {
+            return OPRT_NOT_SUPPORTED;
+        }
+        // fails when the consumer took the hold, the record after it is dropped instead
+        if (AI_RING_CAS(&ring->tail, &tail, __ai_ring_next(ring, tail))) {
+            break;
+        }
+    }
+
+    // only the producer writes records, the dropped one stays readable until the next commit
+    *data = ring->buf + tail + SIZEOF(AI_RING_REC_T);
+    *len = AI_RING_REC(ring, tail)->len;
+    return OPRT_OK;
+}
+
+uint32_t tuya_ai_ring_used(AI_RING_T *ring)
+{
+    uint32_t head = AI_RING_LOAD(&ring->head);
+    uint32_t tail = AI_RING_LOAD(&ring->tail) & ~AI_RING_HOLD;
+
+    return (head >= tail) ? (head - tail) : (ring->size - tail + head);
+}
@@ -22,10 +22,45 @@ typedef struct {
 // Encoder handle type
 typedef VOID *AI_ENCODE_HANDLE_T;
 
+// Encoder control commands
+typedef enum {
+    AI_ENCODER_CTRL_NET_FEEDBACK,       // arg: AI_ENCODER_NET_FEEDBACK_T *, adapt to the upload link
+    AI_ENCODER_CTRL_GET_PARAMS,         // arg: AI_ENCODER_PARAMS_T *, current parameters and counters
+    AI_ENCODER_CTRL_RESET_STAT,         // arg: NULL, clear the counters, e.g. at a new session
+    AI_ENCODER_CTRL_SET_BATCH,          // arg: UINT_T *, frames per output packet, set while no frame is held
+} AI_ENCODER_CTRL_E;
+
+// Upload link feedback
+typedef struct {
+    UINT_T rtt_ms;                      // round trip of the channel, 0 when unknown
+    UINT_T write_ms;                    // time the last packet waited on the socket
+    UINT_T stalls;                      // partial socket writes since the last feedback
+    UINT_T loss_perc;                   // expected packet loss, 0 on a reliable transport
+} AI_ENCODER_NET_FEEDBACK_T;
+
+// Encoder parameters and counters
+typedef struct {
+    UINT_T bitrate;                     // target bitrate, bps
+    UINT_T bandwidth;                   // audio bandwidth, Hz
+    BOOL_T vbr;
+    BOOL_T dtx;                         // discontinuous transmission in silence
+    BOOL_T fec;                         // in-band forward error correction
+    UINT_T loss_perc;                   // loss the encoder protects against
+    UINT_T frames;                      // frames encoded
+    UINT_T dtx_frames;                  // frames sent as silence
+    UINT_T bytes;                       // encoded bytes
+    UINT_T adjusts;                     // bitrate changes
+} AI_ENCODER_PARAMS_T;
+
 // Encoder data output callback function type
 typedef OPERATE_RET (*AI_ENCODER_DATA_OUT_CB)(AI_AUDIO_CODEC_TYPE codec_type, UCHAR_T *data, UINT_T len, void *usr_data);
 
-// Encoder interface structure
+/**
+ * Encoder interface structure
+ *
+ * encode with in_len 0 flushes the frames held for a batch through cb, in_buf
+ * may then be NULL.
+ */
 typedef struct {
     AI_ENCODE_HANDLE_T handle;
     CHAR_T *name;
@@ -33,6 +68,7 @@ typedef struct {
     OPERATE_RET (*create)(AI_ENCODE_HANDLE_T *handle, TUYA_AI_ENCODER_INFO_T *info);
     OPERATE_RET (*destroy)(AI_ENCODE_HANDLE_T handle);
     OPERATE_RET (*encode)(AI_ENCODE_HANDLE_T handle, UCHAR_T *in_buf, UINT_T in_len, AI_ENCODER_DATA_OUT_CB cb, void *usr_data);
+    OPERATE_RET (*ctrl)(AI_ENCODE_HANDLE_T handle, AI_ENCODER_CTRL_E cmd, VOID *arg);   // optional
 } TUYA_AI_ENCODER_T;
 
 /**
@@ -0,0 +1,112 @@
+#ifndef __TUYA_AI_ENCODER_PIPELINE_H__
+#define __TUYA_AI_ENCODER_PIPELINE_H__
+
+#include "tuya_ai_types.h"
+
+#include "tuya_cloud_types.h"
+#include "tuya_ai_encoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Encoder pipeline
+ *
+ * Moves encoding and the output callback off the thread that produces PCM.
+ * PCM goes through a single producer / single consumer ring to a dedicated
+ * thread that runs the encoder, a write never blocks and drops the PCM when
+ * the ring is full. Each write carries a tag of tag_size bytes which the
+ * output callback gets as usr_data, e.g. the biz head of the upload.
+ */
+
+// Encoder pipeline handle type
+typedef VOID *AI_ENCODER_PIPELINE_T;
+
+// Encoder pipeline configuration
+typedef struct {
+    TUYA_AI_ENCODER_T *encoder;         // created encoder, stays owned by the caller
+    AI_ENCODER_DATA_OUT_CB cb;          // encoded packets, on the pipeline thread
+    UINT_T tag_size;                    // bytes of the tag copied with each write
+    UINT_T queue_size;                  // ring bytes, 0 for the default
+    UINT_T batch_frames;                // frames per output packet, 0 or 1 without batching
+    UINT_T stack_size;                  // 0 for the default
+    UINT_T priority;                    // THREAD_PRIO_E, 0 for the default
+} AI_ENCODER_PIPELINE_CFG_T;
+
+// Encoder pipeline statistics
+typedef struct {
+    UINT_T in_bytes;                    // PCM bytes queued
+    UINT_T drop_bytes;                  // PCM bytes dropped on a full ring
+    UINT_T queue_size;                  // ring bytes
+    UINT_T queue_used;                  // ring bytes in use now
+    UINT_T queue_peak;                  // highest ring use
+    UINT_T encode_cnt;                  // encode calls
+    UINT_T encode_ms;                   // time spent in the encoder, output callback excluded
+    UINT_T encode_max_ms;               // longest encode call
+    UINT_T out_cnt;                     // packets given to the output callback
+    UINT_T out_ms;                      // time spent in the output callback
+    UINT_T out_max_ms;                  // longest output callback
+} AI_ENCODER_PIPELINE_STAT_T;
+
+/**
+ * @brief create an encoder pipeline and start its thread
+ *
+ * @param[in] cfg pipeline configuration
+ * @param[out] pipeline pipeline handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_encoder_pipeline_create(AI_ENCODER_PIPELINE_CFG_T *cfg, AI_ENCODER_PIPELINE_T *pipeline);
+
+/**
+ * @brief stop the thread and free the pipeline, queued PCM is dropped
+ *
+ * @param[in] pipeline pipeline handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_encoder_pipeline_destroy(AI_ENCODER_PIPELINE_T pipeline);
+
+/**
+ * @brief queue PCM for encoding, from one producer thread
+ *
+ * @param[in] pipeline pipeline handle
+ * @param[in] pcm PCM data
+ * @param[in] len PCM length
+ * @param[in] tag tag_size bytes handed to the output callback, may be NULL
+ *
+ * @return OPRT_OK on success, OPRT_EXCEED_UPPER_LIMIT when dropped on a full ring
+ */
+OPERATE_RET tuya_ai_encoder_pipeline_write(AI_ENCODER_PIPELINE_T pipeline, CONST UCHAR_T *pcm, UINT_T len, CONST VOID *tag);
+
+/**
+ * @brief end a stream, from the producer thread
+ *
+ * Waits until everything queued before is encoded, then the encoder flushes
+ * the frames it holds for a batch and the output callback is called once
+ * more with data NULL and len 0 to mark the end.
+ *
+ * @param[in] pipeline pipeline handle
+ * @param[in] tag tag of the end mark, may be NULL
+ * @param[in] timeout_ms longest wait
+ *
+ * @return OPRT_OK on success, OPRT_TIMEOUT when the pipeline did not get there in time
+ */
+OPERATE_RET tuya_ai_encoder_pipeline_flush(AI_ENCODER_PIPELINE_T pipeline, CONST VOID *tag, UINT_T timeout_ms);
+
+/**
+ * @brief get pipeline statistics
+ *
+ * @param[in] pipeline pipeline handle
+ * @param[out] stat statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_encoder_pipeline_stat_get(AI_ENCODER_PIPELINE_T pipeline, AI_ENCODER_PIPELINE_STAT_T *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TUYA_AI_ENCODER_PIPELINE_H__
@@ -14,6 +14,34 @@
 #define OPUS_ENCODE_MAX_PACKET     (1500)
 #define OPUS_ENCODE_BYTES_MAX      (1500)
 
+// A frame of at most this size carries no audio, DTX or comfort noise
+#define OPUS_DTX_FRAME_BYTES       (2)
+
+// Link feedback thresholds of the bitrate control
+#define OPUS_CONGEST_WRITE_MS      (100)
+#define OPUS_CONGEST_RTT_MS        (800)
+#define OPUS_RAISE_FEEDBACKS       (5)      // clean feedbacks in a row before a step up
+#define OPUS_LOSS_PERC_MAX         (30)
+
+// Batched frames share one packet of at most 120 ms and OPUS_ENCODE_MAX_PACKET bytes
+#define OPUS_BATCH_MAX_MS          (120)
+#define OPUS_BATCH_HEAD_BYTES      (2)      // TOC and frame count of a multi-frame packet
+#define OPUS_BATCH_LEN_BYTES       (2)      // length of each frame but the last
+
+typedef struct {
+    opus_int32 bitrate;
+    opus_int32 bandwidth;
+    UINT_T bandwidth_hz;
+} OPUS_RATE_STEP_T;
+
+STATIC CONST OPUS_RATE_STEP_T s_opus_rate_steps[] = {
+    {8000,  OPUS_BANDWIDTH_NARROWBAND, 4000},
+    {12000, OPUS_BANDWIDTH_MEDIUMBAND, 6000},
+    {16000, OPUS_BANDWIDTH_MEDIUMBAND, 6000},
+    {24000, OPUS_BANDWIDTH_WIDEBAND,   8000},
+};
+#define OPUS_RATE_STEP_DEFAULT     (2)
+
 // Opus encoder context
 typedef struct {
     OpusEncoder *codec;             // Opus encoder handle
@@ -23,8 +51,160 @@ typedef struct {
     UINT_T in_buf_size;             // Input buffer size
     BYTE_T *out_buf;                // Encoded output data buffer
     UINT_T out_buf_size;            // Encoded output data buffer size
+    UINT_T rate_step;               // Index into s_opus_rate_steps
+    UINT_T clean_feedbacks;         // Uncongested feedbacks since the last change
+    AI_ENCODER_PARAMS_T params;     // Current parameters and counters
+    UINT_T frame_ms;                // Frame duration
+    OpusRepacketizer *rp;           // Merges the frames of a batch into one packet
+    UINT_T batch_frames;            // Frames per output packet, 1 without batching
+    UINT_T batch_count;             // Frames held in batch_buf
+    UINT_T batch_used;              // Bytes held in batch_buf
+    UINT_T batch_frame_bytes;       // Size limit of each batched frame
+    BYTE_T *batch_buf;              // Encoded frames of the pending batch
 } TUYA_AI_OPUS_CONTEXT_T;
 
+STATIC VOID __opus_apply_rate_step(TUYA_AI_OPUS_CONTEXT_T *opus, UINT_T step)
+{
+    CONST OPUS_RATE_STEP_T *rate = &s_opus_rate_steps[step];
+
+    opus_encoder_ctl(opus->codec, OPUS_SET_BITRATE(rate->bitrate));
+    opus_encoder_ctl(opus->codec, OPUS_SET_BANDWIDTH(rate->bandwidth));
+    opus->rate_step = step;
+    opus->clean_feedbacks = 0;
+    opus->params.bitrate = rate->bitrate;
+    opus->params.bandwidth = rate->bandwidth_hz;
+}
+
+STATIC VOID __opus_apply_loss(TUYA_AI_OPUS_CONTEXT_T *opus, UINT_T loss_perc)
+{
+    if (loss_perc > OPUS_LOSS_PERC_MAX) {
+        loss_perc = OPUS_LOSS_PERC_MAX;
+    }
+    if (loss_perc == opus->params.loss_perc) {
+        return;
+    }
+    // in-band FEC only pays off when packets actually get lost
+    opus_encoder_ctl(opus->codec, OPUS_SET_INBAND_FEC(loss_perc ? 1 : 0));
+    opus_encoder_ctl(opus->codec, OPUS_SET_PACKET_LOSS_PERC(loss_perc));
+    opus->params.fec = loss_perc ? TRUE : FALSE;
+    opus->params.loss_perc = loss_perc;
+    ENC_PR_D("opus loss %d%%, fec %d", loss_perc, opus->params.fec);
+}
+
+/**
+ * @brief adapt the bitrate to the upload link
+ *
+ * One step down on any sign of congestion, one step up after a run of clean
+ * feedbacks, so a short burst does not make the rate oscillate.
+ */
+STATIC VOID __opus_net_feedback(TUYA_AI_OPUS_CONTEXT_T *opus, CONST AI_ENCODER_NET_FEEDBACK_T *fb)
+{
+    BOOL_T congested = (fb->stalls > 0) || (fb->write_ms >= OPUS_CONGEST_WRITE_MS) ||
+                       (fb->rtt_ms >= OPUS_CONGEST_RTT_MS);
+    UINT_T step = opus->rate_step;
+
+    __opus_apply_loss(opus, fb->loss_perc);
+
+    if (congested) {
+        opus->clean_feedbacks = 0;
+        if (step > 0) {
+            step--;
+        }
+    } else if (++opus->clean_feedbacks >= OPUS_RAISE_FEEDBACKS && step + 1 < CNTSOF(s_opus_rate_steps)) {
+        step++;
+    }
+    if (step != opus->rate_step) {
+        ENC_PR_D("opus bitrate %d -> %d, rtt %d ms, write %d ms, stalls %d", opus->params.bitrate,
+                 s_opus_rate_steps[step].bitrate, fb->rtt_ms, fb->write_ms, fb->stalls);
+        __opus_apply_rate_step(opus, step);
+        opus->params.adjusts++;
+    }
+}
+
+STATIC OPERATE_RET __opus_batch_flush(TUYA_AI_OPUS_CONTEXT_T *opus, AI_ENCODER_DATA_OUT_CB cb, void *usr_data)
+{
+    opus_int32 len = 0;
+
+    if (opus->batch_count == 0) {
+        return OPRT_OK;
+    }
+    len = opus_repacketizer_out(opus->rp, opus->out_buf, opus->out_buf_size);
+    opus_repacketizer_init(opus->rp);
+    opus->batch_count = 0;
+    opus->batch_used = 0;
+    if (len < 0) {
+        ENC_PR_D("opus repacketize failed: %s", opus_strerror(len));
+        return OPRT_COM_ERROR;
+    }
+    return cb(AUDIO_CODEC_OPUS, opus->out_buf, len, usr_data);
+}
+
+/**
+ * @brief merge the next encoded frame into the pending batch
+ *
+ * The frame is encoded straight into batch_buf, the repacketizer keeps
+ * pointers to it until the batch goes out.
+ */
+STATIC OPERATE_RET __opus_batch_add(TUYA_AI_OPUS_CONTEXT_T *opus, opus_int32 len, AI_ENCODER_DATA_OUT_CB cb, void *usr_data)
+{
+    OPERATE_RET rt = OPRT_OK;
+    BYTE_T *frame = opus->batch_buf + opus->batch_used;
+
+    if (OPUS_OK != opus_repacketizer_cat(opus->rp, frame, len)) {
+        // the bandwidth or mode changed, a packet carries only frames of one configuration
+        TUYA_CALL_ERR_RETURN(__opus_batch_flush(opus, cb, usr_data));
+        memmove(opus->batch_buf, frame, len);
+        frame = opus->batch_buf;
+        if (OPUS_OK != opus_repacketizer_cat(opus->rp, frame, len)) {
+            return OPRT_COM_ERROR;
+        }
+    }
+    opus->batch_used += len;
+    opus->batch_count++;
+
+    if (opus->batch_count >= opus->batch_frames) {
+        return __opus_batch_flush(opus, cb, usr_data);
+    }
+    return OPRT_OK;
+}
+
+STATIC OPERATE_RET __opus_set_batch(TUYA_AI_OPUS_CONTEXT_T *opus, UINT_T frames)
+{
+    UINT_T max_frames = OPUS_BATCH_MAX_MS / opus->frame_ms;
+
+    if (opus->batch_count) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    if (frames == 0 || frames > max_frames) {
+        ENC_PR_D("opus batch %d frames of %d ms exceeds %d ms", frames, opus->frame_ms, OPUS_BATCH_MAX_MS);
+        return OPRT_INVALID_PARM;
+    }
+
+    if (opus->batch_buf) {
+        OS_Free(opus->batch_buf);
+        opus->batch_buf = NULL;
+    }
+    opus->batch_frames = 1;
+    if (frames == 1) {
+        return OPRT_OK;
+    }
+
+    if (NULL == opus->rp) {
+        opus->rp = opus_repacketizer_create();
+        if (NULL == opus->rp) {
+            return OPRT_MALLOC_FAILED;
+        }
+    }
+    opus->batch_buf = (BYTE_T *)OS_Malloc(OPUS_ENCODE_MAX_PACKET);
+    if (NULL == opus->batch_buf) {
+        return OPRT_MALLOC_FAILED;
+    }
+    // the merged packet must still fit out_buf
+    opus->batch_frame_bytes = (OPUS_ENCODE_MAX_PACKET - OPUS_BATCH_HEAD_BYTES) / frames - OPUS_BATCH_LEN_BYTES;
+    opus->batch_frames = frames;
+    return OPRT_OK;
+}
+
 STATIC OPERATE_RET _encoder_opus_create(AI_ENCODE_HANDLE_T *handle, TUYA_AI_ENCODER_INFO_T *info)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -76,14 +256,14 @@ STATIC OPERATE_RET _encoder_opus_create(AI_ENCODE_HANDLE_T *handle, TUYA_AI_ENCO
         goto FAILURE_EXIT;
     }
     opus_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
-    opus_encoder_ctl(enc, OPUS_SET_BITRATE(16000));
-    opus_encoder_ctl(enc, OPUS_SET_BANDWIDTH(OPUS_BANDWIDTH_MEDIUMBAND));
-    opus_encoder_ctl(enc, OPUS_SET_VBR(0));
-    opus_encoder_ctl(enc, OPUS_SET_VBR_CONSTRAINT(0));
+    // constrained VBR, silent and simple frames cost less than speech
+    opus_encoder_ctl(enc, OPUS_SET_VBR(1));
+    opus_encoder_ctl(enc, OPUS_SET_VBR_CONSTRAINT(1));
     opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(0));
     opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(0));
     opus_encoder_ctl(enc, OPUS_SET_FORCE_CHANNELS(1));
-    opus_encoder_ctl(enc, OPUS_SET_DTX(0));
+    // silence goes out as 1 byte frames, the decoder fills in comfort noise
+    opus_encoder_ctl(enc, OPUS_SET_DTX(1));
     opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(0));
     opus_encoder_ctl(enc, OPUS_SET_LSB_DEPTH(16));
     opus_encoder_ctl(enc, OPUS_SET_PREDICTION_DISABLED(1));
@@ -91,6 +271,11 @@ STATIC OPERATE_RET _encoder_opus_create(AI_ENCODE_HANDLE_T *handle, TUYA_AI_ENCO
 
     opus->codec = enc;
     opus->frame_size = frame_size;
+    opus->frame_ms = frame_size_ms;
+    opus->batch_frames = 1;
+    opus->params.vbr = TRUE;
+    opus->params.dtx = TRUE;
+    __opus_apply_rate_step(opus, OPUS_RATE_STEP_DEFAULT);
     opus->in_buf_size = frame_size * channels * sizeof(opus_int16);
     opus->in_buf = (BYTE_T *)OS_Malloc(opus->in_buf_size);
     if (NULL == opus->in_buf) {
@@ -119,7 +304,9 @@ FAILURE_EXIT:
         opus_encoder_destroy(opus->codec);
         opus->codec = NULL;
     }
-    OS_Free(opus);
+    if (opus) {
+        OS_Free(opus);
+    }
     return rt;
 }
 
@@ -142,6 +329,14 @@ STATIC OPERATE_RET _encoder_opus_destroy(AI_ENCODE_HANDLE_T handle)
         opus_encoder_destroy(opus->codec);
         opus->codec = NULL;
     }
+    if (opus->batch_buf) {
+        OS_Free(opus->batch_buf);
+        opus->batch_buf = NULL;
+    }
+    if (opus->rp) {
+        opus_repacketizer_destroy(opus->rp);
+        opus->rp = NULL;
+    }
     OS_Free(opus);
     return OPRT_OK;
 }
@@ -150,12 +345,16 @@ STATIC OPERATE_RET _encoder_opus_encode(AI_ENCODE_HANDLE_T handle, UCHAR_T *in_b
 {
     TUYA_AI_OPUS_CONTEXT_T *opus = (TUYA_AI_OPUS_CONTEXT_T *)handle;
 
-    if (opus == NULL || opus->codec == NULL || in_buf == NULL || cb == NULL) {
+    if (opus == NULL || opus->codec == NULL || (in_buf == NULL && in_len > 0) || cb == NULL) {
         return OPRT_INVALID_PARM;
     }
     OpusEncoder *enc = opus->codec;
     UINT_T frame_size = opus->frame_size;
 
+    if (in_len == 0) {
+        return __opus_batch_flush(opus, cb, usr_data);
+    }
+
     while (in_len > 0) {
         UINT_T copy_size = opus->buf_offset + in_len > opus->in_buf_size ? opus->in_buf_size - opus->buf_offset : in_len;
         memcpy(opus->in_buf + opus->buf_offset, in_buf, copy_size);
@@ -173,7 +372,12 @@ STATIC OPERATE_RET _encoder_opus_encode(AI_ENCODE_HANDLE_T handle, UCHAR_T *in_b
 #if ENCODER_TIMESTAMP_PR
         SYS_TIME_T start = tal_system_get_millisecond();
 #endif
-        opus_int32 len = opus_encode(enc, input, frame_size, opus->out_buf, out_len);
+        BYTE_T *out_buf = opus->out_buf;
+        if (opus->batch_frames > 1) {
+            out_buf = opus->batch_buf + opus->batch_used;
+            out_len = opus->batch_frame_bytes;
+        }
+        opus_int32 len = opus_encode(enc, input, frame_size, out_buf, out_len);
 #if ENCODER_TIMESTAMP_PR
         SYS_TIME_T end = tal_system_get_millisecond();
         SYS_TIME_T delta = end - start;
@@ -185,8 +389,62 @@ STATIC OPERATE_RET _encoder_opus_encode(AI_ENCODE_HANDLE_T handle, UCHAR_T *in_b
         if (len < 0) {
             return OPRT_COM_ERROR;
         }
-        cb(AUDIO_CODEC_OPUS, opus->out_buf, len, usr_data);
+        opus->params.frames++;
+        opus->params.bytes += len;
+        if (len <= OPUS_DTX_FRAME_BYTES) {
+            opus->params.dtx_frames++;
+        }
         opus->buf_offset = 0;
+        if (opus->batch_frames > 1) {
+            OPERATE_RET rt = __opus_batch_add(opus, len, cb, usr_data);
+            if (rt != OPRT_OK) {
+                return rt;
+            }
+        } else {
+            cb(AUDIO_CODEC_OPUS, opus->out_buf, len, usr_data);
+        }
+    }
+    return OPRT_OK;
+}
+
+STATIC OPERATE_RET _encoder_opus_ctrl(AI_ENCODE_HANDLE_T handle, AI_ENCODER_CTRL_E cmd, VOID *arg)
+{
+    TUYA_AI_OPUS_CONTEXT_T *opus = (TUYA_AI_OPUS_CONTEXT_T *)handle;
+
+    if (opus == NULL || opus->codec == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    switch (cmd) {
+    case AI_ENCODER_CTRL_NET_FEEDBACK:
+        if (arg == NULL) {
+            return OPRT_INVALID_PARM;
+        }
+        __opus_net_feedback(opus, (AI_ENCODER_NET_FEEDBACK_T *)arg);
+        break;
+
+    case AI_ENCODER_CTRL_GET_PARAMS:
+        if (arg == NULL) {
+            return OPRT_INVALID_PARM;
+        }
+        memcpy(arg, &opus->params, sizeof(AI_ENCODER_PARAMS_T));
+        break;
+
+    case AI_ENCODER_CTRL_SET_BATCH:
+        if (arg == NULL) {
+            return OPRT_INVALID_PARM;
+        }
+        return __opus_set_batch(opus, *(UINT_T *)arg);
+
+    case AI_ENCODER_CTRL_RESET_STAT:
+        opus->params.frames = 0;
+        opus->params.dtx_frames = 0;
+        opus->params.bytes = 0;
+        opus->params.adjusts = 0;
+        break;
+
+    default:
+        return OPRT_NOT_SUPPORTED;
     }
     return OPRT_OK;
 }
@@ -199,4 +457,5 @@ TUYA_AI_ENCODER_T g_tuya_ai_encoder_opus = {
     .create = _encoder_opus_create,
     .destroy = _encoder_opus_destroy,
     .encode = _encoder_opus_encode,
+    .ctrl = _encoder_opus_ctrl,
 };
@@ -0,0 +1,331 @@
+#include "tuya_ai_encoder_pipeline.h"
+#include "tuya_ai_ring.h"
+#include "tuya_error_code.h"
+#include "tal_log.h"
+#include "tal_memory.h"
+#include "tal_system.h"
+#include "tal_thread.h"
+#include "tal_semaphore.h"
+
+#if defined(ENABLE_EXT_RAM) && (ENABLE_EXT_RAM == 1)
+#define OS_Malloc(req_size) tal_psram_malloc(req_size)
+#define OS_Free(ptr) tal_psram_free(ptr)
+#else
+#define OS_Malloc(req_size) tal_malloc(req_size)
+#define OS_Free(ptr) tal_free(ptr)
+#endif
+
+#define PIPE_DEFAULT_QUEUE_SIZE    (8 * 1024)
+#define PIPE_DEFAULT_STACK_SIZE    (4608)
+#define PIPE_IDLE_WAIT_MS          (100)
+#define PIPE_FULL_WAIT_MS          (10)     // flush retry period while the ring is full
+
+#define PIPE_ALIGN(x) (((x) + 7) & ~7U)
+
+typedef enum {
+    PIPE_REC_PCM = 0,
+    PIPE_REC_FLUSH,
+} PIPE_REC_TYPE_E;
+
+// Ring record, the tag and the PCM follow
+typedef struct {
+    UINT_T type;
+    UINT_T len;                     // PCM bytes
+    UINT_T seq;                     // flush sequence
+    UINT_T reserved;
+} PIPE_REC_T;
+
+typedef struct {
+    AI_ENCODER_PIPELINE_CFG_T cfg;
+    UINT_T tag_len;                 // tag_size rounded up, the PCM stays aligned
+    AI_RING_T ring;
+    UINT8_T *ring_buf;
+    THREAD_HANDLE thread;
+    SEM_HANDLE wake_sem;            // posted by the producer while the thread sleeps
+    SEM_HANDLE done_sem;            // posted by the thread after each flush
+    BOOL_T sleeping;
+    UINT_T flush_seq;               // last flush queued, producer only
+    UINT_T done_seq;                // last flush done, pipeline thread only
+    AI_ENCODER_PIPELINE_STAT_T stat;
+} AI_ENCODER_PIPELINE_CTX_T;
+
+// usr_data of the encoder, wraps the tag of the record being encoded
+typedef struct {
+    AI_ENCODER_PIPELINE_CTX_T *pipe;
+    VOID *tag;
+    UINT_T out_ms;
+} PIPE_OUT_T;
+
+STATIC OPERATE_RET __pipeline_out(AI_AUDIO_CODEC_TYPE codec_type, UCHAR_T *data, UINT_T len, void *usr_data)
+{
+    PIPE_OUT_T *out = (PIPE_OUT_T *)usr_data;
+    AI_ENCODER_PIPELINE_CTX_T *pipe = out->pipe;
+    SYS_TIME_T start = tal_system_get_millisecond();
+    OPERATE_RET rt = pipe->cfg.cb(codec_type, data, len, out->tag);
+    UINT_T cost = (UINT_T)(tal_system_get_millisecond() - start);
+
+    out->out_ms += cost;
+    pipe->stat.out_ms += cost;
+    if (cost > pipe->stat.out_max_ms) {
+        pipe->stat.out_max_ms = cost;
+    }
+    if (data && len) {
+        pipe->stat.out_cnt++;
+    }
+    return rt;
+}
+
+STATIC VOID __pipeline_encode(AI_ENCODER_PIPELINE_CTX_T *pipe, PIPE_REC_T *rec)
+{
+    TUYA_AI_ENCODER_T *encoder = pipe->cfg.encoder;
+    PIPE_OUT_T out = {
+        .pipe = pipe,
+        .tag = pipe->tag_len ? (VOID *)(rec + 1) : NULL,
+    };
+    UCHAR_T *pcm = (UCHAR_T *)(rec + 1) + pipe->tag_len;
+    SYS_TIME_T start = tal_system_get_millisecond();
+    OPERATE_RET rt = encoder->encode(encoder->handle, rec->len ? pcm : NULL, rec->len, __pipeline_out, &out);
+    UINT_T cost = (UINT_T)(tal_system_get_millisecond() - start) - out.out_ms;
+
+    if (OPRT_OK != rt && rec->len) {
+        PR_ERR("pipeline encode failed, rt:%d", rt);
+    }
+    pipe->stat.encode_cnt++;
+    pipe->stat.encode_ms += cost;
+    if (cost > pipe->stat.encode_max_ms) {
+        pipe->stat.encode_max_ms = cost;
+    }
+
+    if (PIPE_REC_FLUSH == rec->type) {
+        // the batch went out above, now mark the end
+        __pipeline_out(encoder->codec_type, NULL, 0, &out);
+        __atomic_store_n(&pipe->done_seq, rec->seq, __ATOMIC_RELEASE);
+        tal_semaphore_post(pipe->done_sem);
+    }
+}
+
+STATIC VOID __pipeline_thread(VOID *arg)
+{
+    AI_ENCODER_PIPELINE_CTX_T *pipe = (AI_ENCODER_PIPELINE_CTX_T *)arg;
+    PIPE_REC_T *rec = NULL;
+    uint32_t rec_len = 0;
+
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(pipe->thread)) {
+        if (OPRT_OK == tuya_ai_ring_peek(&pipe->ring, (VOID **)&rec, &rec_len)) {
+            __pipeline_encode(pipe, rec);
+            tuya_ai_ring_release(&pipe->ring);
+            continue;
+        }
+
+        // the producer posts only while the flag is set, check again after setting it
+        __atomic_store_n(&pipe->sleeping, TRUE, __ATOMIC_SEQ_CST);
+        if (0 == tuya_ai_ring_used(&pipe->ring)) {
+            tal_semaphore_wait(pipe->wake_sem, PIPE_IDLE_WAIT_MS);
+        }
+        __atomic_store_n(&pipe->sleeping, FALSE, __ATOMIC_SEQ_CST);
+    }
+}
+
+STATIC VOID __pipeline_wake(AI_ENCODER_PIPELINE_CTX_T *pipe)
+{
+    UINT_T used = tuya_ai_ring_used(&pipe->ring);
+
+    if (used > pipe->stat.queue_peak) {
+        pipe->stat.queue_peak = used;
+    }
+    if (__atomic_exchange_n(&pipe->sleeping, FALSE, __ATOMIC_ACQ_REL)) {
+        tal_semaphore_post(pipe->wake_sem);
+    }
+}
+
+STATIC VOID __pipeline_free(AI_ENCODER_PIPELINE_CTX_T *pipe)
+{
+    if (pipe->wake_sem) {
+        tal_semaphore_release(pipe->wake_sem);
+    }
+    if (pipe->done_sem) {
+        tal_semaphore_release(pipe->done_sem);
+    }
+    if (pipe->ring_buf) {
+        OS_Free(pipe->ring_buf);
+    }
+    tal_free(pipe);
+}
+
+OPERATE_RET tuya_ai_encoder_pipeline_create(AI_ENCODER_PIPELINE_CFG_T *cfg, AI_ENCODER_PIPELINE_T *pipeline)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_ENCODER_PIPELINE_CTX_T *pipe = NULL;
+    UINT_T batch = 0;
+
+    TUYA_CHECK_NULL_RETURN(cfg, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(pipeline, OPRT_INVALID_PARM);
+    if (NULL == cfg->encoder || NULL == cfg->encoder->handle || NULL == cfg->cb) {
+        return OPRT_INVALID_PARM;
+    }
+
+    pipe = (AI_ENCODER_PIPELINE_CTX_T *)tal_malloc(sizeof(AI_ENCODER_PIPELINE_CTX_T));
+    TUYA_CHECK_NULL_RETURN(pipe, OPRT_MALLOC_FAILED);
+    memset(pipe, 0, sizeof(AI_ENCODER_PIPELINE_CTX_T));
+    memcpy(&pipe->cfg, cfg, sizeof(AI_ENCODER_PIPELINE_CFG_T));
+    if (0 == pipe->cfg.queue_size) {
+        pipe->cfg.queue_size = PIPE_DEFAULT_QUEUE_SIZE;
+    }
+    if (0 == pipe->cfg.stack_size) {
+        pipe->cfg.stack_size = PIPE_DEFAULT_STACK_SIZE;
+    }
+    if (0 == pipe->cfg.priority) {
+        pipe->cfg.priority = THREAD_PRIO_1;
+    }
+    pipe->tag_len = PIPE_ALIGN(pipe->cfg.tag_size);
+    if (0 == pipe->cfg.batch_frames) {
+        pipe->cfg.batch_frames = 1;
+    }
+
+    if (pipe->cfg.batch_frames > 1) {
+        batch = pipe->cfg.batch_frames;
+        if (NULL == cfg->encoder->ctrl ||
+            OPRT_OK != cfg->encoder->ctrl(cfg->encoder->handle, AI_ENCODER_CTRL_SET_BATCH, &batch)) {
+            PR_WARN("encoder %s can't batch %d frames, one frame per packet", cfg->encoder->name, batch);
+            pipe->cfg.batch_frames = 1;
+        }
+    }
+
+    pipe->ring_buf = (UINT8_T *)OS_Malloc(pipe->cfg.queue_size);
+    TUYA_CHECK_NULL_GOTO(pipe->ring_buf, EXIT);
+    TUYA_CALL_ERR_GOTO(tuya_ai_ring_init(&pipe->ring, pipe->ring_buf, pipe->cfg.queue_size), EXIT);
+    pipe->stat.queue_size = pipe->ring.size;
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&pipe->wake_sem, 0, 1), EXIT);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&pipe->done_sem, 0, 1), EXIT);
+
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.priority = pipe->cfg.priority;
+    thrd_param.thrdname = "ai_encoder";
+    thrd_param.stackDepth = pipe->cfg.stack_size;
+#if defined(ENABLE_EXT_RAM) && (ENABLE_EXT_RAM == 1)
+    thrd_param.psram_mode = 1;
+#endif
+    TUYA_CALL_ERR_GOTO(tal_thread_create_and_start(&pipe->thread, NULL, NULL, __pipeline_thread, pipe, &thrd_param),
+                       EXIT);
+
+    PR_DEBUG("encoder pipeline %s, queue %d, batch %d", cfg->encoder->name, pipe->ring.size, pipe->cfg.batch_frames);
+    *pipeline = (AI_ENCODER_PIPELINE_T)pipe;
+    return OPRT_OK;
+
+EXIT:
+    if (pipe->cfg.batch_frames > 1) {
+        batch = 1;
+        cfg->encoder->ctrl(cfg->encoder->handle, AI_ENCODER_CTRL_SET_BATCH, &batch);
+    }
+    __pipeline_free(pipe);
+    return (OPRT_OK != rt) ? rt : OPRT_MALLOC_FAILED;
+}
+
+OPERATE_RET tuya_ai_encoder_pipeline_destroy(AI_ENCODER_PIPELINE_T pipeline)
+{
+    AI_ENCODER_PIPELINE_CTX_T *pipe = (AI_ENCODER_PIPELINE_CTX_T *)pipeline;
+    UINT_T batch = 1;
+
+    TUYA_CHECK_NULL_RETURN(pipe, OPRT_INVALID_PARM);
+
+    tal_thread_delete(pipe->thread);
+    tal_semaphore_post(pipe->wake_sem);
+    while (THREAD_STATE_DELETE != tal_thread_get_state(pipe->thread)) {
+        tal_system_sleep(10);
+    }
+
+    // leave the encoder as it was handed over
+    if (pipe->cfg.batch_frames > 1) {
+        pipe->cfg.encoder->ctrl(pipe->cfg.encoder->handle, AI_ENCODER_CTRL_SET_BATCH, &batch);
+    }
+    __pipeline_free(pipe);
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_encoder_pipeline_write(AI_ENCODER_PIPELINE_T pipeline, CONST UCHAR_T *pcm, UINT_T len, CONST VOID *tag)
+{
+    AI_ENCODER_PIPELINE_CTX_T *pipe = (AI_ENCODER_PIPELINE_CTX_T *)pipeline;
+    PIPE_REC_T *rec = NULL;
+
+    TUYA_CHECK_NULL_RETURN(pipe, OPRT_INVALID_PARM);
+    if (NULL == pcm || 0 == len) {
+        return OPRT_INVALID_PARM;
+    }
+
+    // never wait here, a late frame is worth less than the capture behind it
+    if (OPRT_OK != tuya_ai_ring_reserve(&pipe->ring, SIZEOF(PIPE_REC_T) + pipe->tag_len + len, (VOID **)&rec)) {
+        pipe->stat.drop_bytes += len;
+        __pipeline_wake(pipe);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    rec->type = PIPE_REC_PCM;
+    rec->len = len;
+    rec->seq = 0;
+    if (pipe->tag_len) {
+        if (tag) {
+            memcpy(rec + 1, tag, pipe->cfg.tag_size);
+        } else {
+            memset(rec + 1, 0, pipe->cfg.tag_size);
+        }
+    }
+    memcpy((UCHAR_T *)(rec + 1) + pipe->tag_len, pcm, len);
+    tuya_ai_ring_commit(&pipe->ring, SIZEOF(PIPE_REC_T) + pipe->tag_len + len);
+    pipe->stat.in_bytes += len;
+
+    __pipeline_wake(pipe);
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_encoder_pipeline_flush(AI_ENCODER_PIPELINE_T pipeline, CONST VOID *tag, UINT_T timeout_ms)
+{
+    AI_ENCODER_PIPELINE_CTX_T *pipe = (AI_ENCODER_PIPELINE_CTX_T *)pipeline;
+    PIPE_REC_T *rec = NULL;
+    SYS_TIME_T start = tal_system_get_millisecond();
+    UINT_T waited = 0;
+
+    TUYA_CHECK_NULL_RETURN(pipe, OPRT_INVALID_PARM);
+
+    // the end mark must not get lost, wait for room
+    while (OPRT_OK != tuya_ai_ring_reserve(&pipe->ring, SIZEOF(PIPE_REC_T) + pipe->tag_len, (VOID **)&rec)) {
+        __pipeline_wake(pipe);
+        if (tal_system_get_millisecond() - start >= timeout_ms) {
+            return OPRT_TIMEOUT;
+        }
+        tal_system_sleep(PIPE_FULL_WAIT_MS);
+    }
+    rec->type = PIPE_REC_FLUSH;
+    rec->len = 0;
+    rec->seq = ++pipe->flush_seq;
+    if (pipe->tag_len) {
+        if (tag) {
+            memcpy(rec + 1, tag, pipe->cfg.tag_size);
+        } else {
+            memset(rec + 1, 0, pipe->cfg.tag_size);
+        }
+    }
+    tuya_ai_ring_commit(&pipe->ring, SIZEOF(PIPE_REC_T) + pipe->tag_len);
+    __pipeline_wake(pipe);
+
+    // a flush that timed out before may still post, go by the sequence
+    while ((INT_T)(__atomic_load_n(&pipe->done_seq, __ATOMIC_ACQUIRE) - pipe->flush_seq) < 0) {
+        waited = (UINT_T)(tal_system_get_millisecond() - start);
+        if (waited >= timeout_ms) {
+            PR_WARN("encoder pipeline flush timeout, %d bytes queued", tuya_ai_ring_used(&pipe->ring));
+            return OPRT_TIMEOUT;
+        }
+        tal_semaphore_wait(pipe->done_sem, timeout_ms - waited);
+    }
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_encoder_pipeline_stat_get(AI_ENCODER_PIPELINE_T pipeline, AI_ENCODER_PIPELINE_STAT_T *stat)
+{
+    AI_ENCODER_PIPELINE_CTX_T *pipe = (AI_ENCODER_PIPELINE_CTX_T *)pipeline;
+
+    TUYA_CHECK_NULL_RETURN(pipe, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(stat, OPRT_INVALID_PARM);
+
+    memcpy(stat, &pipe->stat, sizeof(AI_ENCODER_PIPELINE_STAT_T));
+    stat->queue_used = tuya_ai_ring_used(&pipe->ring);
+    return OPRT_OK;
+}
@@ -25,6 +25,7 @@ extern "C" {
 
 #define AI_EVENT_MONITOR_FILTER     0xF000  // Filter for AI event monitor type filtering
 #define AI_EVENT_MONITOR_ALG_CTRL   0xF001  // Filter for AI event monitor algorithm control
+#define AI_EVENT_MONITOR_INPUT_STAT 0xF002  // Query AI input counters, answered as text stream
 #define AI_EVENT_MONITOR_INVALID    0xFFFF  // Invalid event monitor type
 
 /**
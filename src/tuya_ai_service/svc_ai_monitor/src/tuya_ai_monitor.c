@@ -15,6 +15,7 @@
 #include "tuya_svc_netmgr.h"
 #include "tuya_svc_devos.h"
 #include "tuya_ai_biz.h"
+#include "tuya_ai_agent.h"
 #include "lan_sock.h"
 #include "gw_intf.h"
 #include "uni_random.h"
@@ -333,6 +334,14 @@ STATIC OPERATE_RET __handle_event_alg_ctrl(ai_monitor_client_t *client, AI_EVENT
     return OPRT_NOT_SUPPORTED; // Not implemented yet, return not supported
 }
 
+STATIC OPERATE_RET __handle_event_input_stat(ai_monitor_client_t *client, AI_EVENT_ATTR_T *event)
+{
+    CHAR_T buf[320];
+    INT_T len = tuya_ai_input_stat_to_str(buf, SIZEOF(buf));
+
+    return tuya_ai_monitor_broadcast_text(buf, len);
+}
+
 STATIC OPERATE_RET __handle_event(ai_monitor_client_t *client, AI_EVENT_ATTR_T *event, CHAR_T *payload)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -348,6 +357,9 @@ STATIC OPERATE_RET __handle_event(ai_monitor_client_t *client, AI_EVENT_ATTR_T *
     } else if (event_type == AI_EVENT_MONITOR_ALG_CTRL) {
         // Handle algorithm control event
         rt = __handle_event_alg_ctrl(client, event);
+    } else if (event_type == AI_EVENT_MONITOR_INPUT_STAT) {
+        // Handle ai input counters query
+        rt = __handle_event_input_stat(client, event);
     } else {
         // Unsupported event type
         PR_ERR("Unsupported event type: %d", event_type);
@@ -1175,6 +1187,10 @@ VOID tuya_ai_monitor_dump_status(VOID)
                     g_ai_monitor_server.clients[i].addr, g_ai_monitor_server.clients[i].last_ping_time);
         }
     }
+
+    CHAR_T input_stat[320];
+    tuya_ai_input_stat_to_str(input_stat, SIZEOF(input_stat));
+    PR_INFO("AI input:\n%s", input_stat);
     PR_INFO("========================");
 }
 
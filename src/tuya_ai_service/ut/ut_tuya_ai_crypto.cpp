@@ -0,0 +1,106 @@
+/**
+ * @file ut_tuya_ai_crypto.cpp
+ * @brief Unit tests of the AI packet signature.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+extern "C" {
+#include "tuya_ai_crypto.h"
+}
+
+static const UINT_T sg_payload_len[] = {0, 1, 7, 31, 32, 33, 40, 64, 100, 1000};
+
+/**
+ * @brief __ai_packet_sign as the protocol used to sign packets
+ *
+ * @param[in] payload_len the length field, less AI_SIGN_LEN for AI_VERSION 1
+ */
+static OPERATE_RET __baseline_sign(CONST UCHAR_T *key, CONST UCHAR_T *buf, UINT_T head_len, UINT_T payload_len,
+                                   UCHAR_T *signature)
+{
+    UCHAR_T sign_data[64] = {0};
+    UINT_T sign_len = 0;
+
+    if (head_len + payload_len <= SIZEOF(sign_data)) {
+        memcpy(sign_data, buf, head_len + payload_len);
+        sign_len = head_len + payload_len;
+    } else {
+        memcpy(sign_data, buf, 32);
+        CONST UCHAR_T *payload = buf + head_len;
+        UINT_T offset = (payload_len > 32) ? payload_len - 32 : 0;
+        UINT_T copy_len = (payload_len > 32) ? 32 : payload_len;
+        memcpy(sign_data + 32, payload + offset, copy_len);
+        sign_len = SIZEOF(sign_data);
+    }
+
+    return tal_sha256_mac(key, AI_KEY_LEN, sign_data, sign_len, signature);
+}
+
+class AiCryptoSignTest : public ::testing::Test {
+  protected:
+    AI_CRYPTO_CTX_T ctx;
+    UCHAR_T key[AI_KEY_LEN];
+    UCHAR_T pkt[SIZEOF(AI_PACKET_HEAD_T) + AI_IV_LEN + SIZEOF(UINT_T) + 1000 + AI_SIGN_LEN];
+
+    void SetUp() override
+    {
+        UINT_T i = 0;
+
+        for (i = 0; i < SIZEOF(key); i++) {
+            key[i] = (UCHAR_T)(0xA5 ^ i);
+        }
+        for (i = 0; i < SIZEOF(pkt); i++) {
+            pkt[i] = (UCHAR_T)(i * 7 + 3);
+        }
+        ASSERT_EQ(OPRT_OK, tuya_ai_crypto_init(&ctx));
+        ASSERT_EQ(OPRT_OK, tuya_ai_crypto_set_sign_key(&ctx, key));
+    }
+
+    void TearDown() override
+    {
+        tuya_ai_crypto_deinit(&ctx);
+    }
+};
+
+// version 1: head, iv, 4 byte length, the signature follows the signed payload
+TEST_F(AiCryptoSignTest, Version1MatchesBaseline)
+{
+    UINT_T head_len = SIZEOF(AI_PACKET_HEAD_T) + AI_IV_LEN + SIZEOF(UINT_T);
+    UCHAR_T expect[AI_SIGN_LEN];
+    UCHAR_T sign[AI_SIGN_LEN];
+
+    for (UINT_T payload_len : sg_payload_len) {
+        UINT_T length = UNI_HTONL(payload_len + AI_SIGN_LEN);
+        memcpy(pkt + head_len - SIZEOF(length), &length, SIZEOF(length));
+
+        ASSERT_EQ(OPRT_OK, __baseline_sign(key, pkt, head_len, UNI_NTOHL(length) - AI_SIGN_LEN, expect));
+        ASSERT_EQ(OPRT_OK, tuya_ai_crypto_sign(&ctx, pkt, head_len, payload_len, sign));
+        EXPECT_EQ(0, memcmp(expect, sign, AI_SIGN_LEN)) << "payload_len " << payload_len;
+    }
+}
+
+// version 2: head, 2 byte length, the length and so the signed range include
+// the signature slot, which is signed as zeros
+TEST_F(AiCryptoSignTest, Version2MatchesBaseline)
+{
+    UINT_T head_len = SIZEOF(AI_PACKET_HEAD_T_V2) + SIZEOF(USHORT_T);
+    UCHAR_T expect[AI_SIGN_LEN];
+
+    for (UINT_T payload_len : sg_payload_len) {
+        USHORT_T length = UNI_HTONS((USHORT_T)(payload_len + AI_SIGN_LEN));
+        UCHAR_T *slot = pkt + head_len + payload_len;
+        memcpy(pkt + SIZEOF(AI_PACKET_HEAD_T_V2), &length, SIZEOF(length));
+
+        memset(slot, 0, AI_SIGN_LEN);
+        ASSERT_EQ(OPRT_OK, __baseline_sign(key, pkt, head_len, UNI_NTOHS(length), expect));
+
+        // like the send path, the cleared slot is signed and receives the signature
+        ASSERT_EQ(OPRT_OK, tuya_ai_crypto_sign(&ctx, pkt, head_len, payload_len + AI_SIGN_LEN, slot));
+        EXPECT_EQ(0, memcmp(expect, slot, AI_SIGN_LEN)) << "payload_len " << payload_len;
+    }
+}
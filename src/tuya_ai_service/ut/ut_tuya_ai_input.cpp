@@ -0,0 +1,106 @@
+/**
+ * @file ut_tuya_ai_input.cpp
+ * @brief Unit tests of the AI input ring ordering.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <mockcpp/mockcpp.hpp>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include "tal_system.h"
+#include "tuya_ai_agent.h"
+#include "tuya_ai_internal.h"
+}
+
+/* 1K and 8K chunks go through the ring, 12K and 30K ones are too large for it */
+static const UINT_T sg_chunk_len[] = {1024, 8192, 1024, 12 * 1024, 1024, 30 * 1024, 1024};
+
+#define UT_CHUNK_NUM  (CNTSOF(sg_chunk_len))
+#define UT_WAIT_MS    (5 * 1000)
+
+static std::mutex sg_sent_lock;
+static std::vector<UINT_T> sg_sent;
+
+static OPERATE_RET __ut_upload_stream(AI_PACKET_PT type, AI_BIZ_HD_T *biz, CHAR_T *data, UINT_T len, UINT_T total_len)
+{
+    std::lock_guard<std::mutex> lock(sg_sent_lock);
+
+    // the first byte of a chunk is its index in the stream, the end has no data
+    if (type == AI_PT_VIDEO && len) {
+        sg_sent.push_back((UCHAR_T)data[0]);
+    }
+    return OPRT_OK;
+}
+
+class AiInputTest : public ::testing::Test {
+  protected:
+    void SetUp() override
+    {
+        sg_sent.clear();
+        MOCKER(tuya_ai_client_is_ready).stubs().will(returnValue((BOOL_T)TRUE));
+        MOCKER(tuya_ai_agent_start).stubs().will(returnValue(OPRT_OK));
+        MOCKER(tuya_ai_agent_end).stubs().will(returnValue(OPRT_OK));
+        MOCKER(tuya_ai_agent_event).stubs().will(returnValue(OPRT_OK));
+        MOCKER(tuya_ai_output_stop).stubs().will(returnValue(OPRT_OK));
+        MOCKER(tuya_ai_agent_upload_stream).stubs().will(invoke(__ut_upload_stream));
+        ASSERT_EQ(OPRT_OK, tuya_ai_input_init());
+    }
+
+    void TearDown() override
+    {
+        tuya_ai_input_deinit();
+        // the input thread frees the context on its way out
+        tal_system_sleep(500);
+        GlobalMockObject::verify();
+        GlobalMockObject::reset();
+    }
+
+    size_t sent_num(VOID)
+    {
+        std::lock_guard<std::mutex> lock(sg_sent_lock);
+        return sg_sent.size();
+    }
+};
+
+// a chunk too large for the ring must not overtake the queued chunks of its
+// stream, nor be overtaken by the chunks queued after it
+TEST_F(AiInputTest, SmallAndLargeChunksKeepTheirOrder)
+{
+    std::vector<UCHAR_T> buf(30 * 1024);
+    AI_INPUT_STAT_T stat;
+    UINT_T total_len = 0;
+    UINT_T i = 0;
+    SYS_TIME_T start = 0;
+
+    for (i = 0; i < UT_CHUNK_NUM; i++) {
+        total_len += sg_chunk_len[i];
+    }
+    // waits for the queue instead of dropping the large chunks
+    ASSERT_EQ(OPRT_OK, tuya_ai_input_set_drop_policy(AI_PT_VIDEO, AI_INPUT_NEVER_DROP));
+    tuya_ai_input_start(TRUE);
+
+    for (i = 0; i < UT_CHUNK_NUM; i++) {
+        buf[0] = (UCHAR_T)i;
+        EXPECT_EQ(OPRT_OK, tuya_ai_video_input(0, 0, buf.data(), sg_chunk_len[i], total_len));
+    }
+    tuya_ai_input_stop();
+
+    start = tal_system_get_millisecond();
+    while (sent_num() < UT_CHUNK_NUM && tal_system_get_millisecond() - start < UT_WAIT_MS) {
+        tal_system_sleep(10);
+    }
+
+    ASSERT_EQ(UT_CHUNK_NUM, sg_sent.size());
+    for (i = 0; i < UT_CHUNK_NUM; i++) {
+        EXPECT_EQ(i, sg_sent[i]);
+    }
+    ASSERT_EQ(OPRT_OK, tuya_ai_input_get_stat(&stat));
+    EXPECT_EQ(UT_CHUNK_NUM, stat.pt[0].frames);
+    EXPECT_EQ(0u, stat.pt[0].drop_frames);
+}
@@ -478,7 +478,8 @@ int atop_base_request(const atop_base_request_t *request, atop_base_response_t *
                                                                      .headers_count = headers_count,
                                                                      .body = body_buffer,
                                                                      .body_length = body_length,
-                                                                     .timeout_ms = HTTP_TIMEOUT_MS_DEFAULT},
+                                                                     .timeout_ms = HTTP_TIMEOUT_MS_DEFAULT,
+                                                                     .keep_alive = true},
                                       &http_response);
 
     /* Release http buffer */
@@ -126,6 +126,7 @@ static int iotdns_base_request(char *body, char *path, http_client_response_t *h
             .body = (const uint8_t *)body,
             .body_length = strlen(body),
             .timeout_ms = HTTP_TIMEOUT_MS_DEFAULT,
+            .keep_alive = true,
         },
         http_response);
 
@@ -212,6 +213,7 @@ int iotdns_cloud_endpoint_get(const char *region, const char *env, tuya_endpoint
             .body = (const uint8_t *)body_buffer,
             .body_length = body_length,
             .timeout_ms = HTTP_TIMEOUT_MS_DEFAULT,
+            .keep_alive = true,
         },
         &http_response);
 
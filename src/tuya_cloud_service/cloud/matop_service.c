@@ -261,6 +261,30 @@ int matop_serice_yield(matop_context_t *context)
     return OPRT_OK;
 }
 
+/**
+ * @brief Gets the time until matop_serice_yield() has a request to time out.
+ *
+ * @param context The MATOP context.
+ * @return Milliseconds, 0 if due, UINT32_MAX if no request is pending.
+ */
+uint32_t matop_serice_next_timeout(matop_context_t *context)
+{
+    uint32_t next = UINT32_MAX;
+
+    if (context == NULL) {
+        return next;
+    }
+
+    /* matop_serice_yield() fires once the clock is past the timeout */
+    SYS_TIME_T now = tal_system_get_millisecond();
+    mqtt_atop_message_t *entry;
+    for (entry = context->message_list; entry; entry = entry->next) {
+        uint32_t left = entry->timeout >= now ? (uint32_t)(entry->timeout - now) + 1 : 0;
+        next = MIN(next, left);
+    }
+    return next;
+}
+
 /**
  * @brief Destroys the matop service context.
  *
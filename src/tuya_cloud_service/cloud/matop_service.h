@@ -80,6 +80,14 @@ int matop_serice_init(matop_context_t *context, const matop_config_t *config);
  */
 int matop_serice_yield(matop_context_t *context);
 
+/**
+ * @brief Gets the time until matop_serice_yield() has a request to time out.
+ *
+ * @param context Pointer to the matop context.
+ * @return Milliseconds, 0 if due, UINT32_MAX if no request is pending.
+ */
+uint32_t matop_serice_next_timeout(matop_context_t *context);
+
 /**
  * @brief Destroys the matop service context.
  *
@@ -37,6 +37,9 @@
 
 static void on_subscribe_message_default(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata);
 
+// retry interval of queued publishes in nowait mode
+#define MQTT_PUBLISH_RETRY_MS (100U)
+
 typedef struct {
     uint32_t sequence;
     uint32_t source;
@@ -336,26 +339,166 @@ static void mqtt_client_subscribed_cb(void *client, uint16_t msgid, void *userda
     PR_DEBUG("Subscribe successed ID:%d", msgid);
 }
 
+static void mqtt_publish_heap_set(tuya_mqtt_context_t *context, uint16_t idx, mqtt_publish_handle_t *entry)
+{
+    context->publish_heap[idx] = entry;
+    entry->heap_idx = idx;
+}
+
+static void mqtt_publish_heap_up(tuya_mqtt_context_t *context, uint16_t idx)
+{
+    mqtt_publish_handle_t *entry = context->publish_heap[idx];
+
+    while (idx > 0) {
+        uint16_t parent = (idx - 1) / 2;
+        if (context->publish_heap[parent]->timeout <= entry->timeout) {
+            break;
+        }
+        mqtt_publish_heap_set(context, idx, context->publish_heap[parent]);
+        idx = parent;
+    }
+    mqtt_publish_heap_set(context, idx, entry);
+}
+
+static void mqtt_publish_heap_down(tuya_mqtt_context_t *context, uint16_t idx)
+{
+    mqtt_publish_handle_t *entry = context->publish_heap[idx];
+
+    for (;;) {
+        uint32_t child = 2 * (uint32_t)idx + 1;
+        if (child >= context->publish_heap_num) {
+            break;
+        }
+        if (child + 1 < context->publish_heap_num &&
+            context->publish_heap[child + 1]->timeout < context->publish_heap[child]->timeout) {
+            child++;
+        }
+        if (entry->timeout <= context->publish_heap[child]->timeout) {
+            break;
+        }
+        mqtt_publish_heap_set(context, idx, context->publish_heap[child]);
+        idx = child;
+    }
+    mqtt_publish_heap_set(context, idx, entry);
+}
+
+static int mqtt_publish_heap_push(tuya_mqtt_context_t *context, mqtt_publish_handle_t *entry)
+{
+    if (context->publish_heap_num == context->publish_heap_size) {
+        uint32_t size = context->publish_heap_size ? 2 * (uint32_t)context->publish_heap_size : 16;
+        if (size > UINT16_MAX) {
+            return OPRT_EXCEED_UPPER_LIMIT;
+        }
+        mqtt_publish_handle_t **heap = tal_realloc(context->publish_heap, size * sizeof(mqtt_publish_handle_t *));
+        TUYA_CHECK_NULL_RETURN(heap, OPRT_MALLOC_FAILED);
+        context->publish_heap = heap;
+        context->publish_heap_size = size;
+    }
+
+    context->publish_heap[context->publish_heap_num] = entry;
+    mqtt_publish_heap_up(context, context->publish_heap_num++);
+
+    return OPRT_OK;
+}
+
+static void mqtt_publish_heap_remove(tuya_mqtt_context_t *context, mqtt_publish_handle_t *entry)
+{
+    uint16_t idx = entry->heap_idx;
+    mqtt_publish_handle_t *last = context->publish_heap[--context->publish_heap_num];
+
+    if (last == entry) {
+        return;
+    }
+    mqtt_publish_heap_set(context, idx, last);
+    mqtt_publish_heap_up(context, idx);
+    mqtt_publish_heap_down(context, last->heap_idx);
+}
+
+static void mqtt_publish_inflight_add(tuya_mqtt_context_t *context, mqtt_publish_handle_t *entry)
+{
+    mqtt_publish_handle_t **bucket = &context->publish_inflight[entry->msgid & (TUYA_MQTT_INFLIGHT_BUCKETS - 1)];
+
+    entry->next = *bucket;
+    *bucket = entry;
+    context->publish_stat.inflight++;
+    if (context->publish_stat.inflight > context->publish_stat.inflight_peak) {
+        context->publish_stat.inflight_peak = context->publish_stat.inflight;
+    }
+}
+
+static mqtt_publish_handle_t *mqtt_publish_inflight_take(tuya_mqtt_context_t *context, uint16_t msgid)
+{
+    mqtt_publish_handle_t **link = &context->publish_inflight[msgid & (TUYA_MQTT_INFLIGHT_BUCKETS - 1)];
+
+    for (; *link; link = &(*link)->next) {
+        mqtt_publish_handle_t *entry = *link;
+        if (entry->msgid == msgid) {
+            *link = entry->next;
+            context->publish_stat.inflight--;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void mqtt_publish_queue_add(tuya_mqtt_context_t *context, mqtt_publish_handle_t *entry)
+{
+    if (NULL == context->publish_queue) {
+        context->publish_queue_tail = &context->publish_queue;
+    }
+    entry->next = NULL;
+    *context->publish_queue_tail = entry;
+    context->publish_queue_tail = &entry->next;
+    context->publish_stat.queued++;
+}
+
+static void mqtt_publish_queue_remove(tuya_mqtt_context_t *context, mqtt_publish_handle_t *entry)
+{
+    mqtt_publish_handle_t **link = &context->publish_queue;
+
+    for (; *link; link = &(*link)->next) {
+        if (*link == entry) {
+            *link = entry->next;
+            if (context->publish_queue_tail == &entry->next) {
+                context->publish_queue_tail = link;
+            }
+            context->publish_stat.queued--;
+            return;
+        }
+    }
+}
+
+static void mqtt_publish_entry_free(mqtt_publish_handle_t *entry, int result)
+{
+    entry->cb(result, entry->user_data);
+    tal_free(entry->payload);
+    tal_free(entry);
+}
+
 static void mqtt_client_puback_cb(void *client, uint16_t msgid, void *userdata)
 {
     client = client;
     tuya_mqtt_context_t *context = (tuya_mqtt_context_t *)userdata;
     PR_DEBUG("PUBACK ID:%d", msgid);
 
-    /* LOCK */
-    /* publish async process */
-    mqtt_publish_handle_t **next_handle = &context->publish_list;
-    for (; *next_handle; next_handle = &(*next_handle)->next) {
-        mqtt_publish_handle_t *entry = *next_handle;
-        if (msgid == entry->msgid) {
-            entry->cb(OPRT_OK, entry->user_data);
-            *next_handle = entry->next;
-            tal_free(entry->payload);
-            tal_free(entry);
-            break;
+    tal_mutex_lock(context->publish_mutex);
+    mqtt_publish_handle_t *entry = mqtt_publish_inflight_take(context, msgid);
+    if (entry) {
+        uint32_t ack_ms = (uint32_t)(tal_system_get_millisecond() - entry->sent_ms);
+
+        mqtt_publish_heap_remove(context, entry);
+        context->publish_stat.acked++;
+        context->publish_stat.ack_ms_last = ack_ms;
+        context->publish_stat.ack_ms_total += ack_ms;
+        if (ack_ms > context->publish_stat.ack_ms_max) {
+            context->publish_stat.ack_ms_max = ack_ms;
         }
     }
-    /* UNLOCK */
+    tal_mutex_unlock(context->publish_mutex);
+
+    if (entry) {
+        mqtt_publish_entry_free(entry, OPRT_OK);
+    }
 }
 
 /**
@@ -376,7 +519,14 @@ int tuya_mqtt_init(tuya_mqtt_context_t *context, const tuya_mqtt_config_t *confi
     /* Clean to zero */
     memset(context, 0, sizeof(tuya_mqtt_context_t));
 
+    rt = tal_mutex_create_init(&context->publish_mutex);
+    if (OPRT_OK != rt) {
+        PR_ERR("mqtt publish mutex create error:%d", rt);
+        return rt;
+    }
+
     /* configuration */
+    context->nowait = config->nowait;
     context->user_data = config->user_data;
     context->on_unbind = config->on_unbind;
     context->on_connected = config->on_connected;
@@ -439,6 +589,16 @@ int tuya_mqtt_init(tuya_mqtt_context_t *context, const tuya_mqtt_config_t *confi
     return OPRT_OK;
 }
 
+static void mqtt_retry_after(tuya_mqtt_context_t *context, uint32_t delay_ms)
+{
+    if (context->nowait) {
+        // the event loop waits for tuya_mqtt_next_timeout() instead
+        context->retry_ms = tal_system_get_millisecond() + delay_ms;
+        return;
+    }
+    tal_system_sleep(delay_ms);
+}
+
 /**
  * @brief Starts the MQTT service.
  *
@@ -455,6 +615,10 @@ int tuya_mqtt_start(tuya_mqtt_context_t *context)
         return OPRT_INVALID_PARM;
     }
 
+    if (context->nowait && tal_system_get_millisecond() < context->retry_ms) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
     PR_INFO("clientid:%s", context->signature.clientid);
     PR_INFO("username:%s", context->signature.username);
     PR_DEBUG("password:%s", context->signature.password);
@@ -484,7 +648,7 @@ int tuya_mqtt_start(tuya_mqtt_context_t *context)
             PR_WARN("Connection to the MQTT server failed. Retrying "
                     "connection after %hu ms backoff.",
                     (unsigned short)nextRetryBackOff);
-            tal_system_sleep(nextRetryBackOff + 10000);
+            mqtt_retry_after(context, nextRetryBackOff + 10000);
         }
         return OPRT_COM_ERROR;
     }
@@ -659,12 +823,14 @@ int tuya_mqtt_client_publish_common(tuya_mqtt_context_t *context, const char *to
         return OPRT_OK;
     }
 
+    int rt = OPRT_OK;
     mqtt_publish_handle_t *handle = tal_malloc(sizeof(mqtt_publish_handle_t));
     TUYA_CHECK_NULL_RETURN(handle, OPRT_MALLOC_FAILED);
     handle->next = NULL;
     handle->msgid = 0;
     handle->topic = (char *)topic;
-    handle->timeout = tal_time_get_posix() + timeout_ms;
+    handle->sent_ms = tal_system_get_millisecond();
+    handle->timeout = handle->sent_ms + timeout_ms;
     handle->cb = cb;
     handle->user_data = user_data;
     handle->payload_length = payload_length;
@@ -679,21 +845,25 @@ int tuya_mqtt_client_publish_common(tuya_mqtt_context_t *context, const char *to
         handle->payload = NULL;
     }
 
+    // the PUBACK callback waits for the entry to be in the in-flight table
+    tal_mutex_lock(context->publish_mutex);
+    rt = mqtt_publish_heap_push(context, handle);
+    if (OPRT_OK != rt) {
+        tal_mutex_unlock(context->publish_mutex);
+        tal_free(handle->payload);
+        tal_free(handle);
+        return rt;
+    }
     if (async == false) {
         handle->msgid = mqtt_client_publish(context->mqtt_client, handle->topic, handle->payload,
                                             handle->payload_length, MQTT_QOS_1);
     }
-
-    if (context->publish_list == NULL) {
-        context->publish_list = handle;
-        return OPRT_OK;
-    }
-
-    mqtt_publish_handle_t *last = context->publish_list;
-    while (last->next != NULL) {
-        last = last->next;
+    if (handle->msgid) {
+        mqtt_publish_inflight_add(context, handle);
+    } else {
+        mqtt_publish_queue_add(context, handle);
     }
-    last->next = handle;
+    tal_mutex_unlock(context->publish_mutex);
 
     return OPRT_OK;
 }
@@ -840,6 +1010,9 @@ int tuya_mqtt_loop(tuya_mqtt_context_t *context)
 
     /* reconnect */
     if (context->is_connected == false) {
+        if (context->nowait && tal_system_get_millisecond() < context->retry_ms) {
+            return rt;
+        }
         mqtt_status = mqtt_client_connect(context->mqtt_client);
         if (mqtt_status == MQTT_STATUS_NOT_AUTHORIZED) {
             if (context->on_unbind) {
@@ -854,36 +1027,57 @@ int tuya_mqtt_loop(tuya_mqtt_context_t *context)
                 PR_WARN("Connection to the MQTT server failed. Retrying "
                         "connection after %hu ms backoff.",
                         (unsigned short)nextRetryBackOff);
-                tal_system_sleep(nextRetryBackOff);
+                mqtt_retry_after(context, nextRetryBackOff);
                 return rt;
             }
         }
         return rt;
     }
 
-    /* LOCK */
-    /* publish async process */
-    mqtt_publish_handle_t **next_handle = &context->publish_list;
-    for (; *next_handle; next_handle = &(*next_handle)->next) {
-        mqtt_publish_handle_t *entry = *next_handle;
-
-        if (entry->timeout <= tal_time_get_posix()) {
-            entry->cb(OPRT_TIMEOUT, entry->user_data);
-            *next_handle = entry->next;
-            tal_free(entry->payload);
-            tal_free(entry);
-            continue;
+    /* publish async process, only the expired and the queued entries are visited */
+    SYS_TIME_T now = tal_system_get_millisecond();
+    mqtt_publish_handle_t *expired = NULL;
+    mqtt_publish_handle_t *entry = NULL;
+
+    tal_mutex_lock(context->publish_mutex);
+    while (context->publish_heap_num && context->publish_heap[0]->timeout <= now) {
+        entry = context->publish_heap[0];
+        mqtt_publish_heap_remove(context, entry);
+        if (entry->msgid) {
+            mqtt_publish_inflight_take(context, entry->msgid);
+        } else {
+            mqtt_publish_queue_remove(context, entry);
         }
+        context->publish_stat.timeout++;
+        entry->next = expired;
+        expired = entry;
+    }
 
-        if (entry->msgid <= 0) {
-            entry->msgid =
-                mqtt_client_publish(context->mqtt_client, entry->topic, entry->payload, entry->payload_length, 1);
+    while ((entry = context->publish_queue)) {
+        entry->msgid =
+            mqtt_client_publish(context->mqtt_client, entry->topic, entry->payload, entry->payload_length, MQTT_QOS_1);
+        if (0 == entry->msgid) {
+            break;
         }
+        context->publish_queue = entry->next;
+        context->publish_stat.queued--;
+        entry->sent_ms = now;
+        mqtt_publish_inflight_add(context, entry);
+    }
+    tal_mutex_unlock(context->publish_mutex);
+
+    while ((entry = expired)) {
+        expired = entry->next;
+        PR_DEBUG("publish ID:%d timeout", entry->msgid);
+        mqtt_publish_entry_free(entry, OPRT_TIMEOUT);
     }
-    /* UNLOCK */
 
     /* yield */
-    mqtt_client_yield(context->mqtt_client);
+    if (context->nowait) {
+        mqtt_client_yield_nowait(context->mqtt_client, MQTT_NOWAIT_RECV_WINDOW_MS);
+    } else {
+        mqtt_client_yield(context->mqtt_client);
+    }
 
     return rt;
 }
@@ -904,6 +1098,26 @@ int tuya_mqtt_destory(tuya_mqtt_context_t *context)
     }
 
     tuya_mqtt_protocol_unregister_all(context);
+
+    /* fail what is still waiting, every entry is in the heap */
+    tal_mutex_lock(context->publish_mutex);
+    uint16_t num = context->publish_heap_num;
+    mqtt_publish_handle_t **heap = context->publish_heap;
+    context->publish_heap = NULL;
+    context->publish_heap_num = 0;
+    context->publish_heap_size = 0;
+    context->publish_queue = NULL;
+    memset(context->publish_inflight, 0, sizeof(context->publish_inflight));
+    context->publish_stat.queued = 0;
+    context->publish_stat.inflight = 0;
+    tal_mutex_unlock(context->publish_mutex);
+    for (uint16_t i = 0; i < num; i++) {
+        mqtt_publish_entry_free(heap[i], OPRT_COM_ERROR);
+    }
+    tal_free(heap);
+    tal_mutex_release(context->publish_mutex);
+    context->publish_mutex = NULL;
+
     if (context->mqtt_client) {
         mqtt_client_status_t mqtt_status = mqtt_client_deinit(context->mqtt_client);
         mqtt_client_free(context->mqtt_client);
@@ -933,6 +1147,77 @@ bool tuya_mqtt_connected(tuya_mqtt_context_t *context)
     return context->is_connected;
 }
 
+/**
+ * @brief Gets the socket of the MQTT connection.
+ *
+ * @param context The MQTT context.
+ * @return The socket, or -1 if not connected.
+ */
+int tuya_mqtt_socket_get(tuya_mqtt_context_t *context)
+{
+    if (context == NULL || context->mqtt_client == NULL || context->is_connected == false) {
+        return -1;
+    }
+    return mqtt_client_socket_get(context->mqtt_client);
+}
+
+/**
+ * @brief Gets the time until tuya_mqtt_loop() has work that is not announced
+ * by the socket.
+ *
+ * @param context The MQTT context.
+ * @return Milliseconds, 0 if due, UINT32_MAX if nothing is pending.
+ */
+uint32_t tuya_mqtt_next_timeout(tuya_mqtt_context_t *context)
+{
+    uint32_t next = UINT32_MAX;
+    SYS_TIME_T now = tal_system_get_millisecond();
+
+    if (context == NULL || context->is_inited != true) {
+        return next;
+    }
+
+    if (context->is_connected == false) {
+        if (context->retry_ms > now) {
+            return (uint32_t)(context->retry_ms - now);
+        }
+        return context->manual_disconnect ? next : 0;
+    }
+    next = mqtt_client_keepalive_remaining(context->mqtt_client);
+
+    tal_mutex_lock(context->publish_mutex);
+    if (context->publish_heap_num) {
+        SYS_TIME_T deadline = context->publish_heap[0]->timeout;
+        next = MIN(next, deadline > now ? (uint32_t)(deadline - now) : 0);
+    }
+    if (context->publish_queue) {
+        next = MIN(next, MQTT_PUBLISH_RETRY_MS);
+    }
+    tal_mutex_unlock(context->publish_mutex);
+
+    return next;
+}
+
+/**
+ * @brief Gets the statistics of the QoS1 publishes with a callback.
+ *
+ * @param context The MQTT context.
+ * @param stat The in-flight depth, the PUBACK latency and the outcomes.
+ * @return Returns 0 on success, or a negative error code on failure.
+ */
+int tuya_mqtt_publish_stat_get(tuya_mqtt_context_t *context, tuya_mqtt_publish_stat_t *stat)
+{
+    if (context == NULL || stat == NULL || context->is_inited != true) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(context->publish_mutex);
+    *stat = context->publish_stat;
+    tal_mutex_unlock(context->publish_mutex);
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Reports the progress of an upgrade operation over MQTT.
  *
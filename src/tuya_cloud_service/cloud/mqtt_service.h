@@ -30,6 +30,8 @@ extern "C" {
 #include "cJSON.h"
 #include "mqtt_client_interface.h"
 #include "backoff_algorithm.h"
+#include "tuya_cloud_types.h"
+#include "tal_mutex.h"
 
 // data max len
 #define TUYA_MQTT_CLIENTID_MAXLEN   (32U)
@@ -41,6 +43,9 @@ extern "C" {
 #define TUYA_MQTT_TOPIC_MAXLEN      (64U)
 #define TUYA_MQTT_TOPIC_MAXLEN      (64U)
 
+// msgid buckets of the QoS1 in-flight table, power of 2
+#define TUYA_MQTT_INFLIGHT_BUCKETS (16U)
+
 // Tuya mqtt protocol
 #define PRO_DATA_PUSH            4  /* device -> cloud push dp data */
 #define PRO_CMD                  5  /* cloud -> device send dp data */
@@ -109,6 +114,8 @@ typedef struct {
     const char *seckey;
     const char *localkey;
     void *user_data;
+    /** event loop mode: never sleep, see tuya_mqtt_next_timeout() */
+    bool nowait;
     void (*on_connected)(void *context, void *user_data);
     void (*on_disconnect)(void *context, void *user_data);
     void (*on_unbind)(void *context, void *user_data);
@@ -154,9 +161,14 @@ typedef struct mqtt_subscribe_handle {
 typedef void (*mqtt_publish_notify_cb_t)(int result, void *user_data);
 
 typedef struct mqtt_publish_handle {
+    /** send queue while msgid is 0, then the msgid bucket */
     struct mqtt_publish_handle *next;
     uint16_t msgid;
-    int timeout;
+    /** position in the expiry heap */
+    uint16_t heap_idx;
+    /** deadline and publish time, ms */
+    SYS_TIME_T timeout;
+    SYS_TIME_T sent_ms;
     char *topic;
     uint8_t *payload;
     size_t payload_length;
@@ -164,18 +176,44 @@ typedef struct mqtt_publish_handle {
     void *user_data;
 } mqtt_publish_handle_t;
 
+typedef struct {
+    /** publishes waiting for a msgid */
+    uint32_t queued;
+    /** publishes waiting for their PUBACK */
+    uint32_t inflight;
+    uint32_t inflight_peak;
+    uint32_t acked;
+    uint32_t timeout;
+    /** PUBACK latency, ms */
+    uint32_t ack_ms_last;
+    uint32_t ack_ms_max;
+    uint64_t ack_ms_total;
+} tuya_mqtt_publish_stat_t;
+
 typedef struct {
     void *mqtt_client;
     tuya_mqtt_access_t signature;
     tuya_protocol_handle_t *protocol_list;
     mqtt_subscribe_handle_t *subscribe_list;
-    mqtt_publish_handle_t *publish_list;
+    /** QoS1 publishes with a callback: send queue, in-flight table by msgid
+        and expiry min-heap over both */
+    mqtt_publish_handle_t *publish_queue;
+    mqtt_publish_handle_t **publish_queue_tail;
+    mqtt_publish_handle_t *publish_inflight[TUYA_MQTT_INFLIGHT_BUCKETS];
+    mqtt_publish_handle_t **publish_heap;
+    uint16_t publish_heap_num;
+    uint16_t publish_heap_size;
+    MUTEX_HANDLE publish_mutex;
+    tuya_mqtt_publish_stat_t publish_stat;
     BackoffAlgorithmContext_t backoff_algorithm;
     uint32_t sequence_in;
     uint32_t sequence_out;
     bool manual_disconnect;
     bool is_inited;
     bool is_connected;
+    bool nowait;
+    /** earliest connect retry after a failure in nowait mode, ms */
+    SYS_TIME_T retry_ms;
     void *user_data;
     void (*on_connected)(void *context, void *user_data);
     void (*on_disconnect)(void *context, void *user_data);
@@ -247,6 +285,35 @@ int tuya_mqtt_destory(tuya_mqtt_context_t *context);
  */
 bool tuya_mqtt_connected(tuya_mqtt_context_t *context);
 
+/**
+ * @brief Gets the socket of the MQTT connection.
+ *
+ * An event loop waits for it to be readable before calling tuya_mqtt_loop().
+ *
+ * @param context The MQTT context.
+ * @return The socket, or -1 if not connected.
+ */
+int tuya_mqtt_socket_get(tuya_mqtt_context_t *context);
+
+/**
+ * @brief Gets the time until tuya_mqtt_loop() has work that is not announced
+ * by the socket: keep alive, publish timeouts, queued publishes and connect
+ * retries.
+ *
+ * @param context The MQTT context.
+ * @return Milliseconds, 0 if due, UINT32_MAX if nothing is pending.
+ */
+uint32_t tuya_mqtt_next_timeout(tuya_mqtt_context_t *context);
+
+/**
+ * @brief Gets the statistics of the QoS1 publishes with a callback.
+ *
+ * @param context The MQTT context.
+ * @param stat The in-flight depth, the PUBACK latency and the outcomes.
+ * @return Returns 0 on success, or a negative error code on failure.
+ */
+int tuya_mqtt_publish_stat_get(tuya_mqtt_context_t *context, tuya_mqtt_publish_stat_t *stat);
+
 /**
  * @brief Registers a MQTT protocol with the given context.
  *
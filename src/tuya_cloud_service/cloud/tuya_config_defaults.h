@@ -20,6 +20,8 @@
 #ifndef TUYA_CONFIG_DEFAULTS_H_
 #define TUYA_CONFIG_DEFAULTS_H_
 
+#include "tuya_cloud_types.h"
+
 /**
  * @brief The buffer pre-allocated during activation,
  * the more function points, the larger the buffer needed.
@@ -37,6 +39,15 @@
 #define MQTT_RECV_BLOCK_TIME_MS (2000U)
 #endif
 
+/**
+ * @brief MQTT receive window of the event loop mode, a packet that started
+ * arriving has this long to complete.
+ *
+ */
+#ifndef MQTT_NOWAIT_RECV_WINDOW_MS
+#define MQTT_NOWAIT_RECV_WINDOW_MS (100U)
+#endif
+
 /**
  * @brief MQTT keep alive period.
  *
@@ -53,6 +64,32 @@
 #define AUTO_UPGRADE_CHECK_INTERVAL (1000U * 60 * 60 * 24) // 24 hours
 #endif
 
+/**
+ * @brief Concurrent range connections of the OTA download, 0 downloads the
+ * firmware over a single connection.
+ *
+ */
+#ifndef OTA_DOWNLOAD_CONNECTIONS
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+#define OTA_DOWNLOAD_CONNECTIONS (2)
+#else
+#define OTA_DOWNLOAD_CONNECTIONS (0)
+#endif
+#endif
+
+/**
+ * @brief OTA download buffer, also the length of each range request of the
+ * parallel download, which holds OTA_DOWNLOAD_CONNECTIONS + 1 of them.
+ *
+ */
+#ifndef OTA_DOWNLOAD_RANGE_SIZE
+#if OTA_DOWNLOAD_CONNECTIONS
+#define OTA_DOWNLOAD_RANGE_SIZE (16 * 1024)
+#else
+#define OTA_DOWNLOAD_RANGE_SIZE (4096)
+#endif
+#endif
+
 /**
  * @brief The maximum number of retries for connecting to server.
  */
@@ -31,6 +31,10 @@
 #include "tuya_tls.h"
 #include "netmgr.h"
 #include "tuya_health.h"
+#include "tal_net_poll.h"
+
+// longest wait of tuya_iot_run without any deadline
+#define IOT_RUN_WAIT_MAX_MS (60 * 1000)
 typedef enum {
     STATE_IDLE,
     STATE_START,
@@ -66,6 +70,29 @@ static int iot_dispatch_event(tuya_iot_client_t *client)
     return OPRT_OK;
 }
 
+/* Delay the next state machine step. tuya_iot_run waits on its poll set so
+ * that events cut the delay short, tuya_iot_yield just sleeps. */
+static void iot_sleep(tuya_iot_client_t *client, uint32_t ms)
+{
+    if (client->poll) {
+        client->wait_ms = ms;
+        return;
+    }
+    tal_system_sleep(ms);
+}
+
+static void iot_wakeup(tuya_iot_client_t *client)
+{
+    if (client == NULL || client->poll_mutex == NULL) {
+        return;
+    }
+    tal_mutex_lock(client->poll_mutex);
+    if (client->poll) {
+        tal_net_poll_wakeup(client->poll);
+    }
+    tal_mutex_unlock(client->poll_mutex);
+}
+
 /* -------------------------------------------------------------------------- */
 /*                            Activate data process                           */
 /* -------------------------------------------------------------------------- */
@@ -482,6 +509,7 @@ static int run_state_startup_update(tuya_iot_client_t *client)
                                             .localkey = client->activate.localkey,
                                             .timeout = MQTT_RECV_BLOCK_TIME_MS,
                                             .user_data = client,
+                                            .nowait = (client->poll != NULL),
                                             .on_connected = mqtt_client_connected_on,
                                             .on_disconnect = mqtt_client_disconnect_on,
                                             .on_unbind = mqtt_client_unbind_on,
@@ -494,7 +522,13 @@ static int run_state_mqtt_connect_start(tuya_iot_client_t *client)
 {
     int rt = tuya_mqtt_start(&client->mqctx);
     if (OPRT_OK != rt) {
-        PR_ERR("tuya mqtt start error:%d", rt);
+        // OPRT_RESOURCE_NOT_READY: nowait mode, the connect backoff is not over
+        if (OPRT_RESOURCE_NOT_READY != rt) {
+            PR_ERR("tuya mqtt start error:%d", rt);
+        }
+        if (client->poll) {
+            iot_sleep(client, tuya_mqtt_next_timeout(&client->mqctx));
+        }
         return rt;
     }
 
@@ -536,6 +570,16 @@ static int run_state_reset(tuya_iot_client_t *client)
     return tuya_iot_activated_data_remove(client);
 }
 
+/* Pooled HTTP connections do not survive the link, whichever loop drives the client */
+static OPERATE_RET __tuya_iot_http_pool_link_cb(void *data)
+{
+    if (NETMGR_LINK_DOWN == (netmgr_status_e)data) {
+        http_client_pool_flush();
+    }
+
+    return OPRT_OK;
+}
+
 /* -------------------------------------------------------------------------- */
 /*                                Tuya IoT API                                */
 /* -------------------------------------------------------------------------- */
@@ -584,6 +628,8 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
     }
     /* Software timer Init */
     tuya_tls_init();
+    http_client_pool_init();
+    tal_event_subscribe(EVENT_LINK_STATUS_CHG, "iot.http", __tuya_iot_http_pool_link_cb, SUBSCRIBE_TYPE_NORMAL);
     tuya_register_center_init();
     /* Load Tuya cloud endpoint config */
     tuya_endpoint_init();
@@ -594,11 +640,13 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
             client->is_activated = true;
         }
     }
-    tuya_ota_config_t ota_config;
+    tuya_ota_config_t ota_config = {0};
 
     ota_config.client = client;
-    ota_config.range_size = 4096;
+    ota_config.range_size = OTA_DOWNLOAD_RANGE_SIZE;
     ota_config.timeout_ms = 5000;
+    ota_config.connections = OTA_DOWNLOAD_CONNECTIONS;
+    ota_config.resume = client->config.ota_resume;
     ota_config.event_cb = client->config.ota_handler;
 
     tuya_ota_init(&ota_config);
@@ -610,6 +658,10 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
     if (OPRT_OK != ret) {
         return ret;
     }
+    ret = tal_mutex_create_init(&client->poll_mutex);
+    if (OPRT_OK != ret) {
+        return ret;
+    }
     s_iot_client_solo = client;
 
     client->state = STATE_IDLE;
@@ -634,6 +686,7 @@ int tuya_iot_start(tuya_iot_client_t *client)
         return OPRT_COM_ERROR;
     }
     client->nextstate = STATE_START;
+    iot_wakeup(client);
     return OPRT_OK;
 }
 
@@ -648,6 +701,7 @@ int tuya_iot_start(tuya_iot_client_t *client)
 int tuya_iot_stop(tuya_iot_client_t *client)
 {
     client->nextstate = STATE_STOP;
+    iot_wakeup(client);
     return OPRT_OK;
 }
 
@@ -668,6 +722,7 @@ int tuya_iot_reconnect(tuya_iot_client_t *client)
         return OPRT_COM_ERROR;
     }
     client->nextstate = STATE_MQTT_RECONNECT;
+    iot_wakeup(client);
     return OPRT_OK;
 }
 
@@ -702,6 +757,7 @@ int tuya_iot_reset(tuya_iot_client_t *client)
     client->event.value.asInteger = TUYA_RESET_TYPE_FACTORY;
     iot_dispatch_event(client);
     client->nextstate = STATE_RESET;
+    iot_wakeup(client);
 
     if (client->state == STATE_TOKEN_PENDING) {
         client->token_get.result = OPRT_COM_ERROR;
@@ -777,6 +833,31 @@ static OPERATE_RET __tuya_iot_link_type_change_cb(void *data)
     return rt;
 }
 
+static OPERATE_RET __tuya_iot_link_status_change_cb(void *data)
+{
+    /* the network check of the state machine can go on at once */
+    iot_wakeup(tuya_iot_client_get());
+
+    return OPRT_OK;
+}
+
+/* Keep the MQTT socket of the current connection, if any, in the poll set */
+static void iot_poll_sync(tuya_iot_client_t *client)
+{
+    int fd = tuya_mqtt_socket_get(&client->mqctx);
+
+    if (fd == client->poll_fd) {
+        return;
+    }
+    if (client->poll_fd >= 0) {
+        tal_net_poll_del(client->poll, client->poll_fd);
+        client->poll_fd = -1;
+    }
+    if (fd >= 0 && OPRT_OK == tal_net_poll_add(client->poll, fd, client)) {
+        client->poll_fd = fd;
+    }
+}
+
 /**
  * @brief Yields control to the Tuya IoT client for processing incoming messages
  * and events.
@@ -802,10 +883,14 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_MQTT_YIELD:
         tuya_mqtt_loop(&client->mqctx);
         matop_serice_yield(&client->matop);
+        if (client->poll) {
+            iot_sleep(client,
+                      MIN(tuya_mqtt_next_timeout(&client->mqctx), matop_serice_next_timeout(&client->matop)));
+        }
         break;
 
     case STATE_IDLE:
-        tal_system_sleep(500);
+        iot_sleep(client, 500);
         break;
 
     case STATE_START:
@@ -874,7 +959,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
             client->status = TUYA_STATUS_WIFI_CONNECTED;
             client->nextstate = client->is_activated ? STATE_ENDPOINT_GET : STATE_ENDPOINT_UPDATE;
         } else {
-            tal_system_sleep(1000);
+            iot_sleep(client, 1000);
         }
         break;
 
@@ -892,7 +977,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_ENDPOINT_UPDATE:
         rt = tuya_endpoint_update();
         if (rt != OPRT_OK) {
-            tal_system_sleep(1000);
+            iot_sleep(client, 1000);
             break;
         }
         if (client->is_activated) {
@@ -910,7 +995,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_ACTIVATING:
         rt = client_activate_process(client, client->binding->token);
         if (rt != OPRT_OK) {
-            tal_system_sleep(1000);
+            iot_sleep(client, 1000);
             break;
         }
 
@@ -982,7 +1067,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
             client->status = TUYA_STATUS_WIFI_CONNECTED;
             client->nextstate = STATE_MQTT_CONNECT_START;
         } else {
-            tal_system_sleep(1000);
+            iot_sleep(client, 1000);
         }
         break;
 
@@ -1009,6 +1094,74 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     return rt;
 }
 
+/**
+ * @brief Runs the Tuya IoT client in the calling thread until it is stopped.
+ *
+ * Each step of the state machine tells how long it has nothing to do: the
+ * retry delay of a failed step, or the next MQTT/MATOP deadline once
+ * connected. The thread then waits on a poll set holding the MQTT socket, so
+ * incoming data, the deadline or a wakeup from the client API ends the wait,
+ * whichever comes first.
+ *
+ * @param client Pointer to the Tuya IoT client structure.
+ * @return Returns OPRT_OK once the client went back to idle, or a negative
+ * error code on failure.
+ */
+int tuya_iot_run(tuya_iot_client_t *client)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TAL_NET_POLL_EVENT_T events[2];
+    TAL_NET_POLL_HANDLE poll = NULL;
+
+    if (client == NULL || client->poll_mutex == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+    if (client->poll) {
+        return OPRT_COM_ERROR;
+    }
+
+    TUYA_CALL_ERR_RETURN(tal_net_poll_create(1, &poll));
+    client->poll_fd = -1;
+    tal_mutex_lock(client->poll_mutex);
+    client->poll = poll;
+    tal_mutex_unlock(client->poll_mutex);
+    TUYA_CALL_ERR_LOG(tal_event_subscribe(EVENT_LINK_STATUS_CHG, "iot.run", __tuya_iot_link_status_change_cb,
+                                          SUBSCRIBE_TYPE_NORMAL));
+
+    /* The MQTT context of a started client was set up for tuya_iot_yield */
+    client->mqctx.nowait = true;
+
+    for (;;) {
+        if (client->nextstate == STATE_IDLE) {
+            client->state = STATE_IDLE;
+            break;
+        }
+
+        client->wait_ms = 0;
+        tuya_iot_yield(client);
+        iot_poll_sync(client);
+
+        /* a transition runs the next step at once */
+        if (client->wait_ms == 0 || client->nextstate != client->state) {
+            continue;
+        }
+        tal_net_poll_wait(client->poll, events, CNTSOF(events), MIN(client->wait_ms, IOT_RUN_WAIT_MAX_MS));
+    }
+
+    tal_event_unsubscribe(EVENT_LINK_STATUS_CHG, "iot.run", __tuya_iot_link_status_change_cb);
+    if (client->poll_fd >= 0) {
+        tal_net_poll_del(client->poll, client->poll_fd);
+        client->poll_fd = -1;
+    }
+    /* no wakeup may use the poll set once it is released */
+    tal_mutex_lock(client->poll_mutex);
+    client->poll = NULL;
+    tal_mutex_unlock(client->poll_mutex);
+    tal_net_poll_release(poll);
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Checks if the Tuya IoT client is activated.
  *
@@ -1043,10 +1196,12 @@ int tuya_iot_activated_data_remove(tuya_iot_client_t *client)
     }
 
     /* Clean client local data */
+    tuya_iot_dp_coalesce_clear();
     dp_schema_delete(client->activate.devid);
     tal_kv_del((const char *)(client->activate.schemaId));
     tal_kv_del((const char *)(client->config.storage_namespace));
     tuya_endpoint_remove();
+    tuya_tls_session_cache_clear();
     client->is_activated = false;
     PR_INFO("Activated data remove successed");
 
@@ -32,6 +32,7 @@ extern "C" {
 #include "dp_schema.h"
 #include "tuya_ota.h"
 #include "tal_api.h"
+#include "tal_net_poll.h"
 
 /**
  * @brief SDK Version info
@@ -188,6 +189,7 @@ typedef struct {
     event_handle_cb_t event_handler;
     network_check_cb_t network_check;
     tuya_ota_event_cb_t ota_handler;
+    bool ota_resume; // ota_handler writes from the TUYA_OTA_EVENT_START offset
 } tuya_iot_config_t;
 
 typedef struct {
@@ -232,6 +234,12 @@ struct tuya_iot_client_handle {
     bool is_activated;
     /** device manage */
     dp_schema_t *schema;
+    /** event loop of tuya_iot_run(), NULL with tuya_iot_yield() */
+    TAL_NET_POLL_HANDLE poll;
+    int poll_fd;
+    uint32_t wait_ms;
+    /** guards poll against the wakeups of other threads while it is released */
+    MUTEX_HANDLE poll_mutex;
 };
 
 /**
@@ -299,6 +307,19 @@ int tuya_iot_destroy(tuya_iot_client_t *client);
  */
 int tuya_iot_yield(tuya_iot_client_t *client);
 
+/**
+ * @brief Run the Tuya client in the calling thread until it is stopped.
+ *
+ * Replaces the tuya_iot_yield() loop. The thread sleeps in a single wait on
+ * the MQTT socket, the next protocol deadline (keep alive, publish and request
+ * timeouts, retries) and the client events (start/stop/reset/reconnect, link
+ * status), instead of the fixed sleeps and receive windows of the yield loop.
+ *
+ * @param client - The Tuya client context, started with tuya_iot_start().
+ * @return int - OPRT_OK once tuya_iot_stop() completed, or error code.
+ */
+int tuya_iot_run(tuya_iot_client_t *client);
+
 /**
  * @brief Report Tuya data point(DP) services to the cloud.
  *
@@ -21,6 +21,8 @@
 #include "iotdns.h"
 #include "mix_method.h"
 
+#define OTA_DOWNLOAD_CHECKPOINT_KEY "ota_dl_ckpt"
+
 typedef struct {
     tuya_ota_config_t config;
     tuya_ota_msg_t msg;
@@ -28,7 +30,20 @@ typedef struct {
     uint8_t channel;
     uint8_t progress_percent;
     THREAD_HANDLE upgrade_thrd;
+
+    /* whole image, sha256 for the hmac, md5 when the manifest has no hmac */
     TKL_HASH_HANDLE sha256;
+    TKL_HASH_HANDLE md5;
+    /* optional slice hashes of the manifest, checked as each slice completes */
+    TKL_HASH_HANDLE slice_sha256;
+    uint32_t slice_size;
+    uint32_t slice_num;
+    uint8_t *slice_hash;
+    /* image bytes hashed so far */
+    size_t file_size;
+    size_t verified;
+    bool resumed;
+    bool verify_failed;
 } tuya_ota_t;
 
 int tuya_ota_upgrade_status_report(tuya_ota_t *handle, int status);
@@ -36,38 +51,235 @@ int tuya_ota_upgrade_progress_report(tuya_ota_t *handle, int percent);
 
 static tuya_ota_t *s_ota_ctx;
 
-static void file_download_event_cb(http_download_event_id_t id, http_download_event_t *event)
+static void ota_verify_deinit(tuya_ota_t *ota)
+{
+    if (ota->sha256) {
+        tal_sha256_free(ota->sha256);
+        ota->sha256 = NULL;
+    }
+    if (ota->md5) {
+        tal_md5_free(ota->md5);
+        ota->md5 = NULL;
+    }
+    if (ota->slice_sha256) {
+        tal_sha256_free(ota->slice_sha256);
+        ota->slice_sha256 = NULL;
+    }
+}
+
+static void ota_slice_hash_free(tuya_ota_t *ota)
+{
+    if (ota->slice_hash) {
+        tal_free(ota->slice_hash);
+        ota->slice_hash = NULL;
+    }
+    ota->slice_size = 0;
+    ota->slice_num = 0;
+}
+
+static int ota_verify_init(tuya_ota_t *ota)
+{
+    int rt = OPRT_OK;
+
+    ota->verified = 0;
+    ota->resumed = false;
+    ota->verify_failed = false;
+    if (ota->msg.fw_hmac[0]) {
+        TUYA_CALL_ERR_RETURN(tal_sha256_create_init(&ota->sha256));
+        tal_sha256_starts_ret(ota->sha256, 0);
+    } else if (ota->msg.fw_md5[0]) {
+        TUYA_CALL_ERR_RETURN(tal_md5_create_init(&ota->md5));
+        tal_md5_starts_ret(ota->md5);
+    }
+    if (ota->slice_num) {
+        TUYA_CALL_ERR_RETURN(tal_sha256_create_init(&ota->slice_sha256));
+        tal_sha256_starts_ret(ota->slice_sha256, 0);
+    }
+
+    return rt;
+}
+
+/**
+ * @brief offset the download may resume from, the start of the slice the
+ * checkpoint is in. Without slice hashes the bytes before it can not be
+ * verified, so the download restarts.
+ */
+static size_t ota_verify_resume(tuya_ota_t *ota, size_t offset)
+{
+    if (0 == offset || 0 == ota->slice_num || offset >= ota->file_size) {
+        return 0;
+    }
+
+    offset -= offset % ota->slice_size;
+    if (offset) {
+        /* the slices before were checked by the interrupted download */
+        ota->verified = offset;
+        ota->resumed = true;
+        if (ota->sha256) {
+            tal_sha256_free(ota->sha256);
+            ota->sha256 = NULL;
+        }
+        if (ota->md5) {
+            tal_md5_free(ota->md5);
+            ota->md5 = NULL;
+        }
+        PR_NOTICE("ota resume at slice %d", (int)(offset / ota->slice_size));
+    }
+
+    return offset;
+}
+
+/**
+ * @brief hash the bytes of a data event that were not hashed yet, before they
+ * are written. Bytes left in remain_len come back in front of the next event
+ * and are skipped then.
+ */
+static int ota_verify_update(tuya_ota_t *ota, const uint8_t *data, size_t offset, size_t len)
+{
+    uint8_t digest[32];
+    size_t slice_end = 0;
+    size_t n = 0;
+    uint32_t slice = 0;
+
+    if (offset > ota->verified) {
+        PR_ERR("ota data at %d, verified %d", (int)offset, (int)ota->verified);
+        return OPRT_COM_ERROR;
+    }
+    if (offset + len <= ota->verified) {
+        return OPRT_OK;
+    }
+    data += ota->verified - offset;
+    len -= ota->verified - offset;
+
+    while (len) {
+        n = len;
+        if (ota->slice_num) {
+            slice = ota->verified / ota->slice_size;
+            slice_end = (slice + 1) * (size_t)ota->slice_size;
+            if (slice_end > ota->file_size) {
+                slice_end = ota->file_size;
+            }
+            if (n > slice_end - ota->verified) {
+                n = slice_end - ota->verified;
+            }
+            tal_sha256_update_ret(ota->slice_sha256, data, n);
+        }
+        if (ota->sha256) {
+            tal_sha256_update_ret(ota->sha256, data, n);
+        }
+        if (ota->md5) {
+            tal_md5_update_ret(ota->md5, data, n);
+        }
+        ota->verified += n;
+        data += n;
+        len -= n;
+
+        if (ota->slice_num && ota->verified == slice_end) {
+            tal_sha256_finish_ret(ota->slice_sha256, digest);
+            tal_sha256_starts_ret(ota->slice_sha256, 0);
+            if (slice >= ota->slice_num || memcmp(digest, ota->slice_hash + slice * 32, 32)) {
+                PR_ERR("ota slice %d sha256 mismatch", slice);
+                return OPRT_COM_ERROR;
+            }
+        }
+    }
+
+    return OPRT_OK;
+}
+
+static int ota_verify_finish(tuya_ota_t *ota)
 {
-    tuya_ota_t *ota = (tuya_ota_t *)event->user_data;
-    tuya_ota_event_cb_t event_cb = ota->config.event_cb;
     tuya_iot_client_t *client = ota->config.client;
     uint8_t file_hmac[32];
     uint8_t self_hmac[32];
     uint8_t file_sha256[32 * 2 + 1] = {0};
 
+    if (ota->verified != ota->file_size) {
+        PR_ERR("ota verified %d of %d bytes", (int)ota->verified, (int)ota->file_size);
+        return OPRT_COM_ERROR;
+    }
+
+    if (ota->sha256) {
+        tal_sha256_finish_ret(ota->sha256, file_hmac);
+        hex2str((uint8_t *)file_sha256, file_hmac, 32);
+        tal_sha256_mac((const uint8_t *)client->activate.seckey, strlen(client->activate.seckey), file_sha256,
+                       32 * 2, file_hmac);
+        ascs2hex(self_hmac, (uint8_t *)(ota->msg.fw_hmac), FW_HMAC_LEN);
+        if (memcmp(self_hmac, file_hmac, 32)) {
+            PR_ERR("file hmac check fail");
+            return OPRT_COM_ERROR;
+        }
+        PR_DEBUG("file hmac check success");
+    } else if (ota->md5) {
+        tal_md5_finish_ret(ota->md5, file_hmac);
+        ascs2hex(self_hmac, (uint8_t *)(ota->msg.fw_md5), 32);
+        if (memcmp(self_hmac, file_hmac, 16)) {
+            PR_ERR("file md5 check fail");
+            return OPRT_COM_ERROR;
+        }
+        PR_DEBUG("file md5 check success");
+    } else if (0 == ota->slice_num) {
+        PR_ERR("ota image without hash");
+        return OPRT_COM_ERROR;
+    }
+
+    return OPRT_OK;
+}
+
+static void file_download_event_cb(http_download_event_id_t id, http_download_event_t *event)
+{
+    tuya_ota_t *ota = (tuya_ota_t *)event->user_data;
+    tuya_ota_event_cb_t event_cb = ota->config.event_cb;
+
     switch (id) {
     case DL_EVENT_START:
         PR_DEBUG("DL_EVENT_START");
         tuya_ota_upgrade_status_report(ota, TUS_UPGRDING);
-        tal_sha256_create_init(&ota->sha256);
-        tal_sha256_starts_ret(ota->sha256, 0);
+        event->result = ota_verify_init(ota);
         break;
 
     case DL_EVENT_ON_FILESIZE:
-        PR_DEBUG("DL_EVENT_ON_FILESIZE");
+        PR_DEBUG("DL_EVENT_ON_FILESIZE, resume offset %d", event->offset);
+        if (OPRT_OK != event->result) {
+            break;
+        }
+        ota->file_size = event->file_size;
+        if (ota->slice_num && ota->slice_num != (event->file_size + ota->slice_size - 1) / ota->slice_size) {
+            PR_ERR("ota %d slice hashes for %d bytes", ota->slice_num, (int)event->file_size);
+            ota->verify_failed = true;
+            event->result = OPRT_COM_ERROR;
+            break;
+        }
         if (0 == ota->channel) {
+            /* the platform OTA restarts at start notify */
+            event->offset = 0;
             tal_ota_start_notify(event->file_size, TUYA_OTA_FULL, TUYA_OTA_PATH_AIR);
         } else if (event_cb) {
             ota->event.id = TUYA_OTA_EVENT_START;
             ota->event.file_size = event->file_size;
+            ota->event.offset = ota->config.resume ? ota_verify_resume(ota, event->offset) : 0;
             ota->event.user_data = ota->config.user_data;
             event_cb(&ota->msg, &ota->event);
+            if (ota->event.offset != ota->verified) {
+                /* the application restarts, or picked an offset not on a slice */
+                ota_verify_deinit(ota);
+                event->result = ota_verify_init(ota);
+                ota->event.offset = 0;
+            }
+            event->offset = ota->event.offset;
+        } else {
+            event->offset = 0;
         }
         break;
 
     case DL_EVENT_ON_DATA: {
         PR_DEBUG("DL_EVENT_ON_DATA:%d", event->data_len);
         PR_DEBUG("event->file_size %d, offset:%d, last remain %d", event->file_size, event->offset, event->remain_len);
+        if (OPRT_OK != ota_verify_update(ota, event->data, event->offset, event->data_len)) {
+            ota->verify_failed = true;
+            event->result = OPRT_COM_ERROR;
+            break;
+        }
         if (0 == ota->channel) {
             TUYA_OTA_DATA_T ota_pack;
 
@@ -77,17 +289,15 @@ static void file_download_event_cb(http_download_event_id_t id, http_download_ev
             ota_pack.len = event->data_len;
             ota_pack.pri_data = NULL;
             tal_ota_data_process(&ota_pack, (uint32_t *)&event->remain_len);
-            if (event->remain_len) {
-                tal_sha256_update_ret(ota->sha256, event->data, event->data_len - event->remain_len);
-            } else {
-                tal_sha256_update_ret(ota->sha256, event->data, event->data_len);
+        } else {
+            if (event_cb) {
+                ota->event.id = TUYA_OTA_EVENT_ON_DATA;
+                ota->event.data = event->data;
+                ota->event.data_len = event->data_len;
+                ota->event.offset = event->offset;
+                event_cb(&ota->msg, &ota->event);
             }
-        } else if (event_cb) {
-            ota->event.id = TUYA_OTA_EVENT_ON_DATA;
-            ota->event.data = event->data;
-            ota->event.data_len = event->data_len;
-            ota->event.offset = event->offset;
-            event_cb(&ota->msg, &ota->event);
+            event->remain_len = 0;
         }
         uint8_t percent = event->offset * 100 / event->file_size;
         if (percent - ota->progress_percent > 5) {
@@ -101,14 +311,7 @@ static void file_download_event_cb(http_download_event_id_t id, http_download_ev
     case DL_EVENT_FINISH:
         PR_DEBUG("DL_EVENT_FINISH");
         PR_DEBUG("File Download Percent: %d%%", 100);
-        tal_sha256_finish_ret(ota->sha256, file_hmac);
-        tal_sha256_free(ota->sha256);
-        hex2str((uint8_t *)file_sha256, file_hmac, 32);
-        tal_sha256_mac((const uint8_t *)client->activate.seckey, strlen(client->activate.seckey), file_sha256, 32 * 2,
-                       file_hmac);
-        ascs2hex(self_hmac, (uint8_t *)(ota->msg.fw_hmac), FW_HMAC_LEN);
-        if ((memcmp(self_hmac, file_hmac, 32) == 0)) {
-            PR_DEBUG("file hmac check success");
+        if (OPRT_OK == ota_verify_finish(ota)) {
             tuya_ota_upgrade_progress_report(ota, 100);
             tuya_ota_upgrade_status_report(ota, TUS_UPGRD_FINI);
             if (0 == ota->channel) {
@@ -117,16 +320,26 @@ static void file_download_event_cb(http_download_event_id_t id, http_download_ev
                 ota->event.id = TUYA_OTA_EVENT_FINISH;
                 event_cb(&ota->msg, &ota->event);
             }
+        } else {
+            tuya_ota_upgrade_status_report(ota, TUS_DOWNLOAD_ERROR_HMAC);
+            if (event_cb) {
+                ota->event.id = TUYA_OTA_EVENT_FAULT;
+                event_cb(&ota->msg, &ota->event);
+            }
         }
+        ota_verify_deinit(ota);
+        ota_slice_hash_free(ota);
         break;
 
     case DL_EVENT_FAULT:
         PR_DEBUG("DL_EVENT_FAULT");
-        tuya_ota_upgrade_status_report(ota, TUS_UPGRD_EXEC);
+        tuya_ota_upgrade_status_report(ota, ota->verify_failed ? TUS_DOWNLOAD_ERROR_HMAC : TUS_UPGRD_EXEC);
         if (event_cb) {
             ota->event.id = TUYA_OTA_EVENT_FAULT;
             event_cb(&ota->msg, &ota->event);
         }
+        ota_verify_deinit(ota);
+        ota_slice_hash_free(ota);
         break;
 
     default:
@@ -169,7 +382,7 @@ static void ota_process_thread_func(void *arg)
 
     tuya_iotdns_query_domain_certs(ota->msg.fw_url, &cert, &cert_len);
 
-    http_download_config_t download_cfg;
+    http_download_config_t download_cfg = {0};
     download_cfg.file_size = ota->msg.file_size;
     download_cfg.range_length = ota->config.range_size;
     download_cfg.timeout_ms = ota->config.timeout_ms;
@@ -178,11 +391,54 @@ static void ota_process_thread_func(void *arg)
     download_cfg.url = ota->msg.fw_url;
     download_cfg.event_handler = file_download_event_cb;
     download_cfg.user_data = ota;
+    download_cfg.connections = ota->config.connections;
+    /* the signed url changes between upgrade notifications, the hmac does not */
+    if (ota->config.resume && 0 != ota->channel) {
+        download_cfg.checkpoint_key = OTA_DOWNLOAD_CHECKPOINT_KEY;
+        download_cfg.checkpoint_id = ota->msg.fw_hmac;
+    }
 
     http_file_download(&download_cfg);
     tal_free(cert);
 }
 
+/**
+ * @brief optional slice hashes of the upgrade manifest, "sliceSize" bytes per
+ * slice and "sliceSha256" the hex SHA-256 of each slice in order
+ */
+static void ota_slice_hash_parse(tuya_ota_t *ota, cJSON *upgrade)
+{
+    cJSON *size = cJSON_GetObjectItem(upgrade, "sliceSize");
+    cJSON *hashes = cJSON_GetObjectItem(upgrade, "sliceSha256");
+    cJSON *item = NULL;
+    uint32_t num = 0;
+
+    ota_slice_hash_free(ota);
+    if (!cJSON_IsNumber(size) || size->valueint <= 0 || !cJSON_IsArray(hashes)) {
+        return;
+    }
+
+    num = cJSON_GetArraySize(hashes);
+    ota->slice_hash = tal_malloc(num * 32);
+    if (NULL == ota->slice_hash) {
+        return;
+    }
+    num = 0;
+    cJSON_ArrayForEach(item, hashes)
+    {
+        if (!cJSON_IsString(item) || strlen(item->valuestring) != 32 * 2) {
+            PR_WARN("ota slice %d hash invalid, slices not checked", num);
+            ota_slice_hash_free(ota);
+            return;
+        }
+        ascs2hex(ota->slice_hash + num * 32, (uint8_t *)item->valuestring, 32 * 2);
+        num++;
+    }
+    ota->slice_size = size->valueint;
+    ota->slice_num = num;
+    PR_DEBUG("ota %d slices of %d bytes", ota->slice_num, ota->slice_size);
+}
+
 /**
  * @brief Starts the OTA (Over-The-Air) upgrade process.
  *
@@ -209,6 +465,7 @@ int tuya_ota_start(cJSON *upgrade)
     ota->msg.fw_hmac[sizeof(ota->msg.fw_hmac) - 1] = '\0';
     strncpy(ota->msg.fw_md5, cJSON_GetObjectItem(upgrade, "md5")->valuestring, sizeof(ota->msg.fw_md5) - 1);
     ota->msg.fw_md5[sizeof(ota->msg.fw_md5) - 1] = '\0';
+    ota_slice_hash_parse(ota, upgrade);
 
     THREAD_CFG_T thrd_param;
     thrd_param.priority = THREAD_PRIO_3;
@@ -55,6 +55,9 @@ typedef struct {
     tuya_ota_event_id_t id;
     void *data;
     size_t data_len;
+    /** TUYA_OTA_EVENT_START: offset the interrupted download resumes from when
+     * tuya_ota_config_t.resume is set, 0 otherwise. Set it to 0 to download the
+     * whole firmware again */
     size_t offset;
     size_t file_size;
     void *user_data;
@@ -86,6 +89,11 @@ typedef struct {
     size_t range_size;
     uint32_t timeout_ms;
     void *user_data;
+    /** concurrent range connections of the download, 0 for a single one */
+    uint8_t connections;
+    /** keep a checkpoint and resume an interrupted download of a non-zero
+     * channel, the event handler must honor the TUYA_OTA_EVENT_START offset */
+    bool resume;
 } tuya_ota_config_t;
 
 /**
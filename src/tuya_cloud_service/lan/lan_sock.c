@@ -6,8 +6,9 @@
  * The mechanism is designed to manage multiple socket readers, handle socket
  * events efficiently, and provide a clean shutdown process.
  *
- * The implementation utilizes a select-based approach to monitor and react to
- * socket events across multiple sockets. It supports operations such as adding
+ * The implementation waits on a tal_net_poll set (epoll on Linux, select
+ * elsewhere) and dispatches only the sockets that are ready. Registrations are
+ * queued and wake the loop right away. It supports operations such as adding
  * a new socket reader, updating existing readers, and removing readers. Error
  * handling and socket event detection are integral parts of the loop to ensure
  * robust operation.
@@ -29,6 +30,7 @@
 #include "tal_api.h"
 #include "tal_network.h"
 #include "tuya_lan.h"
+#include "tal_net_poll.h"
 
 #pragma pack(1)
 
@@ -40,11 +42,17 @@ typedef struct LAN_SLOOP_S {
     sloop_sock_t *readers;
     BOOL_T terminate;
     QUEUE_HANDLE queue;
+    TAL_NET_POLL_HANDLE poll;
+    uint32_t loops;  // poll waits
+    uint32_t events; // sockets dispatched
 } LAN_SLOOP_S, *P_LAN_SLOOP_S;
 #pragma pack()
 
 static P_LAN_SLOOP_S g_sloop = NULL;
 #define LAN_QUEUE_NUM 6
+// pre_select hooks, e.g. the LAN session timeouts, run at least this often
+#define LAN_LOOP_WAIT_MS 1000
+#define LAN_EVENT_NUM    8
 
 #ifndef STACK_SIZE_LAN
 #define STACK_SIZE_LAN (4 * 1024)
@@ -55,17 +63,6 @@ static uint32_t __ty_sock_get_reader_num(void)
     return (LAN_UDP_READER_CNT + tuya_lan_get_client_num());
 }
 
-static void __sock_table_set_fds(TUYA_FD_SET_T *rfds, TUYA_FD_SET_T *efds)
-{
-    int idx;
-    for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-        if (g_sloop->readers[idx].sock >= 0) {
-            tal_net_fd_set(g_sloop->readers[idx].sock, rfds);
-            tal_net_fd_set(g_sloop->readers[idx].sock, efds);
-        }
-    }
-}
-
 static void __sock_select_err_handle()
 {
     int idx;
@@ -105,6 +102,9 @@ void __ty_sock_loop_deinit(void)
     if (g_sloop->queue) {
         tal_queue_free(g_sloop->queue);
     }
+    if (g_sloop->poll) {
+        tal_net_poll_release(g_sloop->poll);
+    }
     if (g_sloop->thread) {
         tal_thread_delete(g_sloop->thread);
     }
@@ -120,9 +120,10 @@ void __ty_add_sock_reader(sloop_sock_t sock_info)
         g_sloop->max_sock = sock_info.sock;
     }
 
+    // a socket is polled once, registering it again replaces its handlers
     uint8_t idx = 0;
     for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-        if ((sock_info.sock == g_sloop->readers[idx].sock) && (g_sloop->readers[idx].read == sock_info.read)) {
+        if (sock_info.sock == g_sloop->readers[idx].sock) {
             PR_DEBUG("update lan sock %d,read:%p", sock_info.sock, sock_info.read);
             memset(&g_sloop->readers[idx], 0, sizeof(sloop_sock_t));
             memcpy(&g_sloop->readers[idx], &sock_info, sizeof(sloop_sock_t));
@@ -134,6 +135,10 @@ void __ty_add_sock_reader(sloop_sock_t sock_info)
         for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
             if (-1 == g_sloop->readers[idx].sock) {
                 PR_DEBUG("reg lan sock %d,read:%p", sock_info.sock, sock_info.read);
+                if (OPRT_OK != tal_net_poll_add(g_sloop->poll, sock_info.sock, &g_sloop->readers[idx])) {
+                    PR_ERR("poll add sock %d err", sock_info.sock);
+                    return;
+                }
                 memset(&g_sloop->readers[idx], 0, sizeof(sloop_sock_t));
                 memcpy(&g_sloop->readers[idx], &sock_info, sizeof(sloop_sock_t));
                 g_sloop->cnt++;
@@ -156,6 +161,7 @@ void __ty_del_sock_reader(int sock)
     for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
         if (g_sloop->readers[idx].sock == sock) {
             PR_DEBUG("unreg lan sock %d and close it", sock);
+            tal_net_poll_del(g_sloop->poll, sock);
             tal_net_close(g_sloop->readers[idx].sock);
             g_sloop->readers[idx].sock = -1;
             // g_sloop->readers[idx].pre_select = NULL;
@@ -179,83 +185,52 @@ void tuya_sock_loop_run(void *data)
 {
     int actv_cnt = 0;
     int idx = 0;
-    TUYA_FD_SET_T *rfds, *efds;
+    sloop_sock_t *reader = NULL;
     sloop_sock_t queue_data = {0};
-
-    rfds = tal_malloc(sizeof(TUYA_FD_SET_T));
-    efds = tal_malloc(sizeof(TUYA_FD_SET_T));
-    if (rfds == NULL || efds == NULL) {
-        PR_ERR("malloc err");
-        goto Err;
-    }
-    memset(rfds, 0, sizeof(TUYA_FD_SET_T));
-    memset(efds, 0, sizeof(TUYA_FD_SET_T));
+    TAL_NET_POLL_EVENT_T events[LAN_EVENT_NUM];
 
     // while (tuya_get_sock_loop_terminate() &&
     // tal_thread_get_state(g_sloop->thread) == THREAD_STATE_RUNNING) {
     while (tuya_get_sock_loop_terminate()) {
+        // apply every queued registration, posting one wakes the poll wait
         memset(&queue_data, 0, sizeof(sloop_sock_t));
-        if (tal_queue_fetch(g_sloop->queue, &queue_data, 0) == 0) {
+        while (tal_queue_fetch(g_sloop->queue, &queue_data, 0) == 0) {
             if (queue_data.read) {
                 __ty_add_sock_reader(queue_data);
             } else {
                 __ty_del_sock_reader(queue_data.sock);
             }
+            memset(&queue_data, 0, sizeof(sloop_sock_t));
         }
         for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
             if (g_sloop->readers[idx].pre_select) {
                 g_sloop->readers[idx].pre_select();
             }
         }
-        if (g_sloop->cnt == 0) {
-            tal_system_sleep(2000);
-            continue;
-        }
 
-        tal_net_fd_zero(rfds);
-        tal_net_fd_zero(efds);
-        __sock_table_set_fds(rfds, efds);
-        actv_cnt = tal_net_select(g_sloop->max_sock + 1, rfds, NULL, efds, 1 * 1000);
+        actv_cnt = tal_net_poll_wait(g_sloop->poll, events, LAN_EVENT_NUM, LAN_LOOP_WAIT_MS);
+        g_sloop->loops++;
         if (actv_cnt < 0) {
             PR_ERR("errno:%d", tal_net_get_errno());
             __sock_select_err_handle();
             tal_system_sleep(1000);
             continue;
-        } else if (actv_cnt == 0) {
-            continue;
-        } else {
-            for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-                if (g_sloop->readers[idx].sock >= 0) {
-                    if (0 == tal_net_fd_isset(g_sloop->readers[idx].sock, efds)) {
-                        continue;
-                    }
-                    if (g_sloop->readers[idx].err) {
-                        PR_ERR("socket err:%d, sock:%d, idx:%d", tal_net_get_errno(), g_sloop->readers[idx].sock, idx);
-                        g_sloop->readers[idx].err(g_sloop->readers[idx].sock);
-                    }
-                    actv_cnt--;
-                    if (0 == actv_cnt) {
-                        break;
-                    }
-                }
-            }
-        }
-
-        if (0 == actv_cnt) {
-            continue;
         }
 
-        for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-            if (g_sloop->readers[idx].sock >= 0) {
-                if (tal_net_fd_isset(g_sloop->readers[idx].sock, rfds)) {
-                    if (g_sloop->readers[idx].read) {
-                        g_sloop->readers[idx].read(g_sloop->readers[idx].sock);
-                        actv_cnt--;
-                        if (0 == actv_cnt) {
-                            break;
-                        }
-                    }
-                }
+        // only the ready sockets, the context is the reader slot
+        for (idx = 0; idx < actv_cnt; idx++) {
+            reader = (sloop_sock_t *)events[idx].ctx;
+            if (reader->sock != events[idx].fd) {
+                continue;
+            }
+            g_sloop->events++;
+            if ((events[idx].events & TAL_NET_POLL_ERR) && reader->err) {
+                PR_ERR("socket err:%d, sock:%d, idx:%d", tal_net_get_errno(), reader->sock,
+                       (int)(reader - g_sloop->readers));
+                reader->err(reader->sock);
+            }
+            if ((events[idx].events & TAL_NET_POLL_IN) && reader->sock == events[idx].fd && reader->read) {
+                reader->read(reader->sock);
             }
         }
     }
@@ -266,14 +241,6 @@ void tuya_sock_loop_run(void *data)
         }
     }
 
-Err:
-    if (rfds) {
-        tal_free(rfds);
-    }
-    if (efds) {
-        tal_free(efds);
-    }
-
     tuya_lan_exit();
     __ty_sock_loop_deinit();
 
@@ -313,6 +280,12 @@ OPERATE_RET tuya_sock_loop_init(void)
         goto Err;
     }
 
+    op_ret = tal_net_poll_create(__ty_sock_get_reader_num(), &g_sloop->poll);
+    if (OPRT_OK != op_ret) {
+        PR_ERR("init poll err");
+        goto Err;
+    }
+
     uint32_t readers_len = __ty_sock_get_reader_num() * sizeof(sloop_sock_t);
     g_sloop->readers = tal_malloc(readers_len);
     if (NULL == g_sloop->readers) {
@@ -360,6 +333,7 @@ OPERATE_RET tuya_reg_lan_sock(sloop_sock_t sock_info)
         PR_ERR("queue post err");
         return op_ret;
     }
+    tal_net_poll_wakeup(g_sloop->poll);
     PR_DEBUG("reg post queue %d", sock_info.sock);
     return OPRT_OK;
 }
@@ -385,6 +359,7 @@ OPERATE_RET tuya_unreg_lan_sock(int sock)
         PR_ERR("queue post err");
         return op_ret;
     }
+    tal_net_poll_wakeup(g_sloop->poll);
     PR_DEBUG("unreg post queue %d", sock);
     return OPRT_OK;
 }
@@ -402,6 +377,7 @@ void tuya_sock_loop_disable(void)
     }
 
     g_sloop->terminate = FALSE;
+    tal_net_poll_wakeup(g_sloop->poll);
 }
 
 /**
@@ -439,6 +415,7 @@ void tuya_dump_lan_sock_reader(void)
     PR_DEBUG("sock cnt:%d", g_sloop->cnt);
     PR_DEBUG("terminate:%d", g_sloop->terminate);
     PR_DEBUG("max_sock:%d", g_sloop->max_sock);
+    PR_DEBUG("loops:%u, events:%u", g_sloop->loops, g_sloop->events);
     for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
         if (g_sloop->readers[idx].read) {
             PR_DEBUG("***** sock:%d *****", g_sloop->readers[idx].sock);
@@ -24,16 +24,29 @@
 
 #define MAX_TRANS_TYPE_NUM (DTT_SCT_SCENE + 1)
 
+// raise for gateways that keep the schemas of their sub-devices
+#ifndef DP_SCHEMA_NUM_MAX
 #define DP_SCHEMA_NUM_MAX 1
+#endif
+
+// devid hash buckets, power of 2
+#define DP_SCHEMA_HASH_SIZE 16
 
 typedef struct {
     // DELAYED_WORK_HANDLE tmm_dp_sync;
     uint16_t serial_no;
     MUTEX_HANDLE mutex;
     uint8_t schema_num;
-    dp_schema_t *schema_list[DP_SCHEMA_NUM_MAX];
+    dp_schema_t *schema_hash[DP_SCHEMA_HASH_SIZE];
+    char rept_arena[DP_REPT_ARENA_SIZE];
 } dp_schema_mgr_t;
 
+typedef struct {
+    char *buf;
+    uint32_t size; // bytes buf can take
+    uint32_t len;  // bytes needed so far, may pass size
+} dp_stream_t;
+
 static dp_schema_mgr_t s_dsmgr = {0};
 
 static bool dp_snprintf_append(char *buf, size_t buf_len, size_t *offset, const char *fmt, ...)
@@ -143,16 +156,21 @@ __err_exit:
  */
 dp_node_t *dp_node_find(dp_schema_t *schema, int id)
 {
-    int i;
-    dp_node_t *dpnode = NULL;
+    if (id < 0 || id > DP_ID_MAX || 0 == schema->node_index[id]) {
+        return NULL;
+    }
 
-    for (i = 0; i < schema->num; i++) {
-        if (schema->node[i].desc.id == id) {
-            dpnode = &schema->node[i];
-            break;
-        }
+    return &schema->node[schema->node_index[id] - 1];
+}
+
+static uint32_t dp_devid_hash(const char *devid)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*devid) {
+        hash = (hash ^ (uint8_t)*devid++) * 16777619u;
     }
-    return dpnode;
+    return hash;
 }
 
 /**
@@ -163,19 +181,16 @@ dp_node_t *dp_node_find(dp_schema_t *schema, int id)
  */
 dp_schema_t *dp_schema_find(const char *devid)
 {
-    int i = 0;
+    uint32_t hash = dp_devid_hash(devid);
+    dp_schema_t *schema = s_dsmgr.schema_hash[hash & (DP_SCHEMA_HASH_SIZE - 1)];
 
     PR_TRACE("try to find schema devid %s", devid);
-    dp_schema_mgr_t *dsmgr = &s_dsmgr;
-    for (i = 0; i < DP_SCHEMA_NUM_MAX; i++) {
-        if (NULL == dsmgr->schema_list[i]) {
-            continue;
-        }
-        if (0 == strcmp(devid, dsmgr->schema_list[i]->devid)) {
-            return dsmgr->schema_list[i];
+    for (; schema; schema = schema->hash_next) {
+        if (schema->devid_hash == hash && 0 == strcmp(devid, schema->devid)) {
+            return schema;
         }
 
-        PR_TRACE("find schema devid %s, not match!", dsmgr->schema_list[i]->devid);
+        PR_TRACE("find schema devid %s, not match!", schema->devid);
     }
 
     return NULL;
@@ -193,20 +208,12 @@ dp_schema_t *dp_schema_find(const char *devid)
  */
 dp_node_t *dp_node_find_by_devid(char *devid, int id)
 {
-    int i;
-    dp_node_t *dpnode = NULL;
-
     dp_schema_t *schema = dp_schema_find(devid);
     if (NULL == schema) {
         return NULL;
     }
-    for (i = 0; i < schema->num; i++) {
-        if (schema->node[i].desc.id == id) {
-            dpnode = &schema->node[i];
-            break;
-        }
-    }
-    return dpnode;
+
+    return dp_node_find(schema, id);
 }
 
 static __attribute__((unused)) OPERATE_RET dp_obj_equal_resp(dp_schema_t *schema, uint8_t *dpid, uint8_t num,
@@ -1029,6 +1036,221 @@ __err_exit:
     return op_ret;
 }
 
+static void dp_stream_put(dp_stream_t *s, const char *data, uint32_t len)
+{
+    if (s->len + len <= s->size) {
+        memcpy(s->buf + s->len, data, len);
+    }
+    s->len += len;
+}
+
+static void dp_stream_put_uint(dp_stream_t *s, uint32_t val)
+{
+    char tmp[10];
+    uint32_t n = 0;
+
+    do {
+        tmp[sizeof(tmp) - ++n] = '0' + val % 10;
+        val /= 10;
+    } while (val);
+    dp_stream_put(s, tmp + sizeof(tmp) - n, n);
+}
+
+static void dp_stream_put_int(dp_stream_t *s, int val)
+{
+    if (val < 0) {
+        dp_stream_put(s, "-", 1);
+        dp_stream_put_uint(s, 0u - (uint32_t)val);
+    } else {
+        dp_stream_put_uint(s, (uint32_t)val);
+    }
+}
+
+// quoted and escaped the way cJSON prints strings
+static void dp_stream_put_str(dp_stream_t *s, const char *str)
+{
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *p = (const unsigned char *)str;
+    const unsigned char *run = p;
+    char esc[6] = {'\\', 'u', '0', '0'};
+
+    dp_stream_put(s, "\"", 1);
+    for (; p && *p; p++) {
+        if (*p > 31 && *p != '\"' && *p != '\\') {
+            continue;
+        }
+        dp_stream_put(s, (const char *)run, p - run);
+        run = p + 1;
+        switch (*p) {
+        case '\"':
+        case '\\':
+            esc[1] = *p;
+            break;
+        case '\b':
+            esc[1] = 'b';
+            break;
+        case '\f':
+            esc[1] = 'f';
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        default:
+            esc[1] = 'u';
+            esc[4] = hex[*p >> 4];
+            esc[5] = hex[*p & 0x0f];
+            dp_stream_put(s, esc, 6);
+            continue;
+        }
+        dp_stream_put(s, esc, 2);
+    }
+    if (p) {
+        dp_stream_put(s, (const char *)run, p - run);
+    }
+    dp_stream_put(s, "\"", 1);
+}
+
+/**
+ * @brief Streams the JSON of an object DP report straight into a buffer.
+ *
+ * Produces the dps object of dp_rept_json_output() between prefix and suffix
+ * in a single pass, with no heap allocation and no cJSON tree. The length the
+ * report needs is counted past the end of buf, like snprintf does.
+ *
+ * @param schema Pointer to the DP schema structure.
+ * @param dpin Pointer to the input data structure.
+ * @param dpvalid Pointer to the validation information structure.
+ * @param prefix Text before the dps object, may be NULL.
+ * @param suffix Text after the dps object, may be NULL.
+ * @param buf The output buffer.
+ * @param buf_len The size of buf.
+ * @param out_len The length of the report, without the NUL.
+ * @return Integer value indicating the success or failure of the operation.
+ */
+int dp_rept_stream_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, const char *prefix,
+                          const char *suffix, char *buf, uint32_t buf_len, uint32_t *out_len)
+{
+    uint16_t i, j = 0;
+    dp_stream_t stream;
+
+    if (NULL == schema || NULL == dpin || NULL == dpvalid || NULL == out_len || (NULL == buf && buf_len)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    // keep a byte for the NUL
+    stream.buf = buf;
+    stream.size = buf_len ? buf_len - 1 : 0;
+    stream.len = 0;
+
+    if (prefix) {
+        dp_stream_put(&stream, prefix, strlen(prefix));
+    }
+    dp_stream_put(&stream, "{", 1);
+    for (i = 0; i < dpvalid->num; i++) {
+        // dpvalid keeps the ids in input order, the dp is at or after the previous one
+        while (j < dpin->dpscnt && dpin->dps[j].id != dpvalid->dpid[i]) {
+            j++;
+        }
+        if (j >= dpin->dpscnt) {
+            PR_DEBUG("dp not found");
+            return OPRT_SVC_DP_ID_NOT_FOUND;
+        }
+        dp_obj_t *dp = &dpin->dps[j++];
+        dp_node_t *dpnode = dp_node_find(schema, dp->id);
+        if (NULL == dpnode) {
+            PR_DEBUG("dp->id = %d not found", dp->id);
+            return OPRT_SVC_DP_ID_NOT_FOUND;
+        }
+        if (dp->type != dpnode->desc.prop_tp) {
+            return OPRT_SVC_DP_TP_NOT_MATCH;
+        }
+
+        dp_stream_put(&stream, i ? ",\"" : "\"", i ? 2 : 1);
+        dp_stream_put_uint(&stream, dp->id);
+        dp_stream_put(&stream, "\":", 2);
+
+        switch (dp->type) {
+        case PROP_BOOL:
+            if (TRUE == dp->value.dp_bool) {
+                dp_stream_put(&stream, "true", 4);
+            } else {
+                dp_stream_put(&stream, "false", 5);
+            }
+            break;
+
+        case PROP_VALUE:
+            dp_stream_put_int(&stream, dp->value.dp_value);
+            break;
+
+        case PROP_BITMAP:
+            dp_stream_put_uint(&stream, dp->value.dp_bitmap);
+            break;
+
+        case PROP_STR:
+            dp_stream_put_str(&stream, dp->value.dp_str);
+            break;
+
+        case PROP_ENUM:
+            dp_stream_put_str(&stream, dpnode->prop.prop_enum.pp_enum[dp->value.dp_enum]);
+            break;
+
+        default:
+            PR_ERR("dp %d type invalid %d", dp->id, dp->type);
+            return OPRT_COM_ERROR;
+        }
+    }
+    dp_stream_put(&stream, "}", 1);
+    if (suffix) {
+        dp_stream_put(&stream, suffix, strlen(suffix));
+    }
+
+    *out_len = stream.len;
+    if (stream.len > stream.size) {
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+    buf[stream.len] = '\0';
+
+    PR_DEBUG("dp rept out: %s", buf);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Takes the scratch buffer shared by the report paths.
+ *
+ * @param size Receives the size of the buffer.
+ * @return The buffer, or NULL before the first schema is created.
+ */
+char *dp_rept_arena_acquire(uint32_t *size)
+{
+    if (NULL == s_dsmgr.mutex) {
+        return NULL;
+    }
+
+    tal_mutex_lock(s_dsmgr.mutex);
+    if (size) {
+        *size = sizeof(s_dsmgr.rept_arena);
+    }
+
+    return s_dsmgr.rept_arena;
+}
+
+/**
+ * @brief Gives back the buffer taken by dp_rept_arena_acquire().
+ */
+void dp_rept_arena_release(void)
+{
+    if (s_dsmgr.mutex) {
+        tal_mutex_unlock(s_dsmgr.mutex);
+    }
+}
+
 // int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin,
 // dp_rept_out_t *dpout)
 // {
@@ -1598,6 +1820,14 @@ int dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_schema_out
     dp_node_pos_t *nodepos = NULL;
     int nodenum;
 
+    if (NULL == s_dsmgr.mutex) {
+        op_ret = tal_mutex_create_init(&s_dsmgr.mutex);
+        if (OPRT_OK != op_ret) {
+            PR_ERR("mutex create fail:%d", op_ret);
+            return op_ret;
+        }
+    }
+
     nodepos = tal_malloc(sizeof(dp_node_pos_t) * 255);
     if (NULL == nodepos) {
         PR_ERR("malloc fail");
@@ -1634,14 +1864,23 @@ int dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_schema_out
         PR_ERR("dp_node_parse fail:%d", op_ret);
         goto __exit;
     }
+    // the first node of an id wins, as with a scan
+    for (int i = 0; i < nodenum; i++) {
+        if (0 == dp_schema->node_index[dp_schema->node[i].desc.id]) {
+            dp_schema->node_index[dp_schema->node[i].desc.id] = i + 1;
+        }
+    }
     dp_schema->actv.preprocess = other_attr.preprocess;
     dp_schema->actv.attach_dp_if = TRUE;
     strncpy(dp_schema->devid, devid, DEV_ID_LEN);
+    dp_schema->devid_hash = dp_devid_hash(dp_schema->devid);
     if (dp_schema_out) {
         *dp_schema_out = dp_schema;
     }
     if (s_dsmgr.schema_num < DP_SCHEMA_NUM_MAX) {
-        s_dsmgr.schema_list[s_dsmgr.schema_num] = dp_schema;
+        dp_schema_t **bucket = &s_dsmgr.schema_hash[dp_schema->devid_hash & (DP_SCHEMA_HASH_SIZE - 1)];
+        dp_schema->hash_next = *bucket;
+        *bucket = dp_schema;
         s_dsmgr.schema_num++;
     }
     PR_DEBUG("create dp_schema Success ");
@@ -1668,20 +1907,18 @@ __exit:
  */
 int dp_schema_delete(char *devid)
 {
-    int i = 0;
+    uint32_t hash = dp_devid_hash(devid);
+    dp_schema_t **link = &s_dsmgr.schema_hash[hash & (DP_SCHEMA_HASH_SIZE - 1)];
 
     PR_TRACE("try to delete schema devid %s", devid);
-    dp_schema_mgr_t *dsmgr = &s_dsmgr;
-    for (i = 0; i < DP_SCHEMA_NUM_MAX; i++) {
-        if (NULL == dsmgr->schema_list[i]) {
-            continue;
-        }
-
-        if (0 == strcmp(devid, dsmgr->schema_list[i]->devid)) {
-            tal_mutex_release(dsmgr->schema_list[i]->mutex);
-            tal_free(dsmgr->schema_list[i]);
-            dsmgr->schema_list[i] = NULL;
-            dsmgr->schema_num--;
+    for (; *link; link = &(*link)->hash_next) {
+        dp_schema_t *schema = *link;
+
+        if (schema->devid_hash == hash && 0 == strcmp(devid, schema->devid)) {
+            *link = schema->hash_next;
+            s_dsmgr.schema_num--;
+            tal_mutex_release(schema->mutex);
+            tal_free(schema);
             return OPRT_OK;
         }
     }
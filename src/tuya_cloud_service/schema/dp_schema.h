@@ -26,6 +26,7 @@ extern "C" {
 #include "tal_mutex.h"
 
 #define DEV_ID_LEN 25
+#define DP_ID_MAX  255
 
 /**
  * @brief  Definition of dp property type
@@ -322,13 +323,18 @@ typedef struct {
 
 // typedef struct dev_cntl_n_s {
 
-typedef struct {
+typedef struct dp_schema_s {
     /** virtual id */
     char devid[DEV_ID_LEN + 1];
     /** device attribute, see DEV_ACTV_ATTR_S */
     dp_prop_actv_t actv;
     /** exclusive access to dp */
     MUTEX_HANDLE mutex;
+    /** hash of devid and next schema in the same bucket */
+    uint32_t devid_hash;
+    struct dp_schema_s *hash_next;
+    /** node index + 1 of each dp id, 0 when there is no such dp */
+    uint8_t node_index[DP_ID_MAX + 1];
     /** count of dp */
     uint8_t num;
     /** dp info */
@@ -348,6 +354,12 @@ typedef struct {
 #define DP_REPT_NO_FILTER_FLAG  (1 << 0)
 #define DP_DUMP_STAT_LOCAL_FLAG (1 << 1)
 #define DP_APPEND_HEADER_FLAG   (1 << 2)
+#define DP_REPT_IMMEDIATE_FLAG  (1 << 3) // skip the coalescing window, see tuya_iot_dp_coalesce_set
+
+/** size of the shared scratch buffer object reports are encoded in */
+#ifndef DP_REPT_ARENA_SIZE
+#define DP_REPT_ARENA_SIZE 1024
+#endif
 
 typedef struct {
     char *devid;
@@ -485,6 +497,45 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
  */
 int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, dp_rept_out_t *dpout);
 
+/**
+ * @brief Streams the JSON of an object DP report straight into a buffer.
+ *
+ * Same output as dp_rept_json_output(), wrapped in prefix and suffix, but the
+ * values are written in one pass without heap allocations or a cJSON tree. As
+ * with snprintf, out_len receives the length the report needs even when it
+ * does not fit, so a too small buffer can be retried with out_len + 1 bytes.
+ *
+ * @param schema The DP schema the report was checked against.
+ * @param dpin The input data for the DP report.
+ * @param dpvalid The result of dp_rept_valid_check() for dpin.
+ * @param prefix Text written before the dps object, may be NULL.
+ * @param suffix Text written after the dps object, may be NULL.
+ * @param buf The output buffer, NUL terminated on success.
+ * @param buf_len The size of buf.
+ * @param out_len The length of the report, without the NUL.
+ * @return OPRT_OK on success, OPRT_BUFFER_NOT_ENOUGH when buf is too small, or
+ * another error code on failure.
+ */
+int dp_rept_stream_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, const char *prefix,
+                          const char *suffix, char *buf, uint32_t buf_len, uint32_t *out_len);
+
+/**
+ * @brief Takes the scratch buffer shared by the report paths.
+ *
+ * The buffer is DP_REPT_ARENA_SIZE bytes and is owned by the caller until
+ * dp_rept_arena_release(). It is shared by all reporting threads, so hold it
+ * only while encoding and never across network I/O.
+ *
+ * @param size Receives the size of the buffer.
+ * @return The buffer, or NULL before the first schema is created.
+ */
+char *dp_rept_arena_acquire(uint32_t *size);
+
+/**
+ * @brief Gives back the buffer taken by dp_rept_arena_acquire().
+ */
+void dp_rept_arena_release(void);
+
 /**
  * Appends a JSON string to the given data point schema.
  *
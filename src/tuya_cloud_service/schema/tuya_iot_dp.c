@@ -30,7 +30,44 @@
 #include "ble_dp.h"
 #endif
 
+// retry period of a coalesced report that could not be sent
+#define DP_COALESCE_RETRY_MS 5000
+
+typedef struct {
+    /** dp id of the slot */
+    uint8_t id;
+    /** value waiting for the flush */
+    bool pending;
+    dp_obj_t dp;
+    tuya_iot_dp_coalesce_stat_t stat;
+} dp_coalesce_slot_t;
+
+typedef struct {
+    /** users of the window, the one that drops the last reference frees it */
+    uint16_t ref;
+    MUTEX_HANDLE mutex;
+    /** NULL once the window is detached */
+    DELAYED_WORK_HANDLE work;
+    tuya_iot_client_t *client;
+    char devid[DEV_ID_LEN + 1];
+    uint32_t window_ms;
+    SYS_TIME_T last_flush_ms;
+    /** the flush work is started */
+    bool scheduled;
+    /** or of the flags of the merged reports */
+    int flags;
+    uint8_t pend_num;
+    uint8_t slot_num;
+    uint8_t slot_max;
+    /** slot index + 1 of each dp id */
+    uint8_t slot_index[DP_ID_MAX + 1];
+    dp_coalesce_slot_t slot[0];
+} dp_coalesce_t;
+
 static DELAYED_WORK_HANDLE s_tmm_dp_sync = NULL;
+static dp_coalesce_t *s_dp_coalesce = NULL;
+/** guards s_dp_coalesce and the references to it */
+static MUTEX_HANDLE s_dp_coalesce_mutex = NULL;
 
 int tuya_iot_dp_sync_start(tuya_iot_client_t *client, uint32_t timeout_s);
 
@@ -199,34 +236,97 @@ int tuya_iot_dp_parse(tuya_iot_client_t *client, dp_cmd_type_t cmd_tp, cJSON *cm
 }
 
 /**
- * @brief Reports device object data to the Tuya IoT cloud service.
+ * @brief Encodes an object report with its channel envelope and sends it.
  *
- * This function is used to report the device object data to the Tuya IoT cloud
- * service.
+ * The report is streamed into the shared report arena, which also gives its
+ * exact length, and copied out to the heap before it is handed to the channel,
+ * so the arena is not held across network I/O. On the MQTT channel dpvalid
+ * becomes the user data of dp_sync_cb once the publish is queued.
  *
  * @param client The Tuya IoT client instance.
- * @param devid The device ID.
- * @param dps An array of device object data.
- * @param dpscnt The number of device object data elements in the array.
- * @param flags Additional flags for the report.
+ * @param schema The schema of the reporting device.
+ * @param dpin The report.
+ * @param dpvalid The valid dps of the report.
+ * @param is_lan Send on the LAN instead of MQTT.
  *
- * @return The result of the operation. Returns 0 on success, or a negative
- * error code on failure.
+ * @return OPRT_OK on success, or a negative error code on failure.
  */
-int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_t *dps, uint16_t dpscnt, int flags)
+static int dp_obj_rept_send(tuya_iot_client_t *client, dp_schema_t *schema, dp_rept_in_t *dpin,
+                            dp_rept_valid_t *dpvalid, bool is_lan)
 {
     int ret = OPRT_OK;
+    char prefix[48];
+    char suffix[48];
+    char *data = NULL;
+    uint32_t size = 0;
+    uint32_t len = 0;
+
+    if (is_lan) {
+        snprintf(prefix, sizeof(prefix), "{\"dps\":");
+        snprintf(suffix, sizeof(suffix), ",\"devId\":\"%s\"}", schema->devid);
+    } else {
+        snprintf(prefix, sizeof(prefix), "{\"devId\":\"%s\",\"dps\":", client->activate.devid);
+        snprintf(suffix, sizeof(suffix), "}");
+    }
 
-    if (!client->is_activated) {
-        PR_DEBUG("client no active");
-        return OPRT_COM_ERROR;
+    char *buf = dp_rept_arena_acquire(&size);
+    ret = dp_rept_stream_output(schema, dpin, dpvalid, prefix, suffix, buf, size, &len);
+    if (OPRT_OK != ret && OPRT_BUFFER_NOT_ENOUGH != ret) {
+        dp_rept_arena_release();
+        PR_DEBUG("dp rept stream output error %d", ret);
+        return ret;
     }
-    if (NULL == dps || 0 == dpscnt) {
-        return OPRT_INVALID_PARM;
+    data = tal_malloc(len + 1);
+    if (data && OPRT_OK == ret) {
+        memcpy(data, buf, len + 1);
+    }
+    dp_rept_arena_release();
+    TUYA_CHECK_NULL_RETURN(data, OPRT_MALLOC_FAILED);
+
+    if (OPRT_BUFFER_NOT_ENOUGH == ret) {
+        PR_DEBUG("dp rept %d bytes, out of arena", len);
+        ret = dp_rept_stream_output(schema, dpin, dpvalid, prefix, suffix, data, len + 1, &len);
+    }
+    if (OPRT_OK != ret) {
+        PR_DEBUG("dp rept stream output error %d", ret);
+        goto __exit;
+    }
+
+    if (is_lan) {
+        ret = tuya_lan_dp_report(data);
+    } else {
+        ret = tuya_mqtt_protocol_data_publish_common(&client->mqctx, PRO_DATA_PUSH, (const uint8_t *)data,
+                                                     (uint16_t)len, dp_sync_cb, dpvalid, 5000, false);
     }
 
+__exit:
+    tal_free(data);
+
+    return ret;
+}
+
+/**
+ * @brief Validates and sends an object dp report on the connected channel.
+ *
+ * @param client The IoT client.
+ * @param devid The device ID.
+ * @param dps An array of device object data.
+ * @param dpscnt The number of device object data elements in the array.
+ * @param flags Additional flags for the report.
+ * @param rejected Set to true when the report failed the checks, e.g. no dp
+ * changed, so sending it again cannot succeed. May be NULL.
+ * @return The result of the report.
+ */
+static int dp_obj_report_now(tuya_iot_client_t *client, const char *devid, dp_obj_t *dps, uint16_t dpscnt, int flags,
+                             bool *rejected)
+{
+    int ret = OPRT_OK;
+
     dp_schema_t *schema = dp_schema_find(devid);
     if (NULL == schema) {
+        if (rejected) {
+            *rejected = true;
+        }
         return OPRT_INVALID_PARM;
     }
 
@@ -234,7 +334,7 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
     if (NULL == dpvalid) {
         return OPRT_MALLOC_FAILED;
     }
-    memset(dpvalid, 0, sizeof(sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpscnt));
+    memset(dpvalid, 0, sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpscnt);
 
     PR_DEBUG("dp report: devid %s, dps 0x%08x, dpscnt %d, flags %d", devid ? devid : "null", dps, dpscnt, flags);
 
@@ -247,6 +347,9 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
 
     ret = dp_rept_valid_check(schema, &dpin, dpvalid);
     if (OPRT_OK != ret) {
+        if (rejected) {
+            *rejected = true;
+        }
         tal_free(dpvalid);
         return ret;
     }
@@ -285,37 +388,495 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
     }
 #endif
 
-    dp_rept_out_t dpout;
-
-    memset(&dpout, 0, sizeof(dpout));
-
-    ret = dp_rept_json_output(schema, &dpin, dpvalid, &dpout);
-    if (OPRT_OK != ret) {
-        PR_DEBUG("dp rept json output error %d", ret);
-        return ret;
-    }
-
     if (tuya_lan_is_connected()) {
-        char *out = NULL;
         PR_DEBUG("lan channel report");
-        dp_rept_json_append(schema, dpout.dpsjson, NULL, NULL, 0, &out);
-        ret = tuya_lan_dp_report(out);
-        tal_free(out);
+        ret = dp_obj_rept_send(client, schema, &dpin, dpvalid, true);
         tal_free(dpvalid);
         tuya_iot_dp_sync_start(client, 5);
     } else if (tuya_iot_is_connected()) {
         PR_DEBUG("mqtt channel report");
-        ret = tuya_iot_dp_report_json_with_notify(client, dpout.dpsjson, NULL, dp_sync_cb, dpvalid, 5000);
+        ret = dp_obj_rept_send(client, schema, &dpin, dpvalid, false);
+        if (OPRT_OK != ret) {
+            // dp_sync_cb only runs for a queued publish
+            tal_free(dpvalid);
+        }
     } else {
         PR_ERR("no channel for connect");
+        tal_free(dpvalid);
     }
 
-    if (dpout.dpsjson) {
-        tal_free(dpout.dpsjson);
+    return ret;
+}
+
+static dp_coalesce_t *dp_coalesce_get(void)
+{
+    dp_coalesce_t *co = NULL;
+
+    if (NULL == s_dp_coalesce_mutex) {
+        return NULL;
+    }
+
+    tal_mutex_lock(s_dp_coalesce_mutex);
+    co = s_dp_coalesce;
+    if (co) {
+        co->ref++;
+    }
+    tal_mutex_unlock(s_dp_coalesce_mutex);
+
+    return co;
+}
+
+static void dp_coalesce_unref(dp_coalesce_t *co)
+{
+    uint16_t i;
+    bool last = false;
+
+    tal_mutex_lock(s_dp_coalesce_mutex);
+    last = (0 == --co->ref);
+    tal_mutex_unlock(s_dp_coalesce_mutex);
+    if (!last) {
+        return;
+    }
+
+    for (i = 0; i < co->slot_num; i++) {
+        if (co->slot[i].pending && PROP_STR == co->slot[i].dp.type) {
+            tal_free(co->slot[i].dp.value.dp_str);
+        }
+    }
+    if (co->pend_num) {
+        PR_WARN("dp coalesce off, %d dps not reported", co->pend_num);
+    }
+    tal_mutex_release(co->mutex);
+    tal_free(co);
+}
+
+/**
+ * @brief Takes the window out of use and stops its work.
+ *
+ * @return The window with the reference of s_dp_coalesce, NULL when off.
+ */
+static dp_coalesce_t *dp_coalesce_detach(void)
+{
+    dp_coalesce_t *co = NULL;
+
+    if (NULL == s_dp_coalesce_mutex) {
+        return NULL;
+    }
+
+    tal_mutex_lock(s_dp_coalesce_mutex);
+    co = s_dp_coalesce;
+    s_dp_coalesce = NULL;
+    tal_mutex_unlock(s_dp_coalesce_mutex);
+    if (NULL == co) {
+        return NULL;
+    }
+
+    // a flush that still holds a reference must not start the work again
+    tal_mutex_lock(co->mutex);
+    tal_workq_cancel_delayed(co->work);
+    co->work = NULL;
+    co->scheduled = false;
+    tal_mutex_unlock(co->mutex);
+
+    return co;
+}
+
+static bool dp_coalesce_channel_ready(void)
+{
+#ifdef ENABLE_BLUETOOTH
+    if (tuya_ble_is_connected()) {
+        return true;
+    }
+#endif
+    return tuya_lan_is_connected() || tuya_iot_is_connected();
+}
+
+// start the retry of values that are kept in the window, called with co->mutex held
+static void dp_coalesce_retry_schedule(dp_coalesce_t *co)
+{
+    if (co->scheduled || NULL == co->work) {
+        return;
+    }
+
+    co->scheduled = true;
+    tal_workq_start_delayed(co->work, co->window_ms > DP_COALESCE_RETRY_MS ? co->window_ms : DP_COALESCE_RETRY_MS,
+                            LOOP_ONCE);
+}
+
+/**
+ * @brief Puts the values of a failed flush back into the window.
+ *
+ * A value that a newer one of the same dp replaced in the meantime is dropped.
+ *
+ * @param co The coalescing window.
+ * @param dps The values of the flush, their strings move back to the window.
+ * @param num The number of values.
+ * @param flags The flags of the flush.
+ */
+static void dp_coalesce_requeue(dp_coalesce_t *co, dp_obj_t *dps, uint16_t num, int flags)
+{
+    uint16_t i;
+
+    tal_mutex_lock(co->mutex);
+    for (i = 0; i < num; i++) {
+        dp_coalesce_slot_t *slot = &co->slot[co->slot_index[dps[i].id] - 1];
+
+        slot->stat.flushed--;
+        if (slot->pending) {
+            if (PROP_STR == dps[i].type) {
+                tal_free(dps[i].value.dp_str);
+            }
+            continue;
+        }
+        slot->dp = dps[i];
+        slot->pending = true;
+        co->pend_num++;
+    }
+    co->flags |= flags;
+    dp_coalesce_retry_schedule(co);
+    tal_mutex_unlock(co->mutex);
+}
+
+/**
+ * @brief Sends the values merged in the coalescing window as one report.
+ *
+ * Values that cannot be sent, e.g. while no channel is connected, stay in the
+ * window and are retried. A batch the checks reject, e.g. because no value
+ * changed, is dropped.
+ *
+ * @param co The coalescing window, the caller holds a reference.
+ * @return The result of the report, OPRT_OK when nothing was pending.
+ */
+static int dp_coalesce_flush(dp_coalesce_t *co)
+{
+    int ret = OPRT_OK;
+    int flags = 0;
+    bool rejected = false;
+    uint16_t i, num = 0;
+    dp_obj_t *dps = NULL;
+
+    tal_mutex_lock(co->mutex);
+    co->scheduled = false;
+    if (0 == co->pend_num) {
+        tal_mutex_unlock(co->mutex);
+        return OPRT_OK;
     }
-    if (dpout.timejson) {
-        tal_free(dpout.timejson);
+    if (!dp_coalesce_channel_ready()) {
+        dp_coalesce_retry_schedule(co);
+        tal_mutex_unlock(co->mutex);
+        return OPRT_OK;
+    }
+    dps = tal_malloc(sizeof(dp_obj_t) * co->pend_num);
+    if (NULL == dps) {
+        // keep the values, the next report or window retries
+        dp_coalesce_retry_schedule(co);
+        tal_mutex_unlock(co->mutex);
+        return OPRT_MALLOC_FAILED;
+    }
+    // the string copies move to dps
+    for (i = 0; i < co->slot_num; i++) {
+        if (co->slot[i].pending) {
+            dps[num++] = co->slot[i].dp;
+            co->slot[i].pending = false;
+            co->slot[i].stat.flushed++;
+        }
+    }
+    flags = co->flags & ~DP_REPT_IMMEDIATE_FLAG;
+    co->flags = 0;
+    co->pend_num = 0;
+    co->last_flush_ms = tal_system_get_millisecond();
+    tal_mutex_unlock(co->mutex);
+
+    PR_DEBUG("dp coalesce flush %d dps", num);
+    ret = dp_obj_report_now(co->client, co->devid, dps, num, flags, &rejected);
+    if (rejected) {
+        if (OPRT_SVC_DP_ID_NOT_FOUND == ret) {
+            // every value equals the reported one, nothing to send
+            PR_DEBUG("dp coalesce flush %d dps unchanged", num);
+            ret = OPRT_OK;
+        } else {
+            PR_WARN("dp coalesce flush rejected %d, %d dps dropped", ret, num);
+        }
+    } else if (OPRT_OK != ret) {
+        PR_WARN("dp coalesce flush failed %d, %d dps kept", ret, num);
+        dp_coalesce_requeue(co, dps, num, flags);
+        tal_free(dps);
+        return ret;
+    }
+
+    for (i = 0; i < num; i++) {
+        if (PROP_STR == dps[i].type) {
+            tal_free(dps[i].value.dp_str);
+        }
+    }
+    tal_free(dps);
+
+    return ret;
+}
+
+static void dp_coalesce_work_cb(void *data)
+{
+    dp_coalesce_t *co = dp_coalesce_get();
+
+    if (co) {
+        dp_coalesce_flush(co);
+        dp_coalesce_unref(co);
+    }
+}
+
+/**
+ * @brief Merges a report into the coalescing window.
+ *
+ * The first report after a quiet window is sent at once, later ones wait for
+ * the window to close, so a chatty dp goes out at most once per window.
+ *
+ * @param co The coalescing window.
+ * @param schema The schema of the reporting device.
+ * @param dps An array of device object data.
+ * @param dpscnt The number of device object data elements in the array.
+ * @param flags Additional flags for the report.
+ * @return OPRT_OK when merged, or the result of the immediate report.
+ */
+static int dp_coalesce_put(dp_coalesce_t *co, dp_schema_t *schema, dp_obj_t *dps, uint16_t dpscnt, int flags)
+{
+    uint16_t i;
+    bool flush_now = false;
+
+    // refuse a bad report as a whole, like dp_rept_valid_check does
+    for (i = 0; i < dpscnt; i++) {
+        dp_node_t *dpnode = dp_node_find(schema, dps[i].id);
+        if (dpnode && dps[i].type != dpnode->desc.prop_tp) {
+            PR_ERR("dparr[%d] type not match:%d %d", i, dps[i].type, dpnode->desc.prop_tp);
+            return OPRT_SVC_DP_TP_NOT_MATCH;
+        }
+        if (PROP_STR == dps[i].type && NULL == dps[i].value.dp_str) {
+            return OPRT_INVALID_PARM;
+        }
+    }
+
+    tal_mutex_lock(co->mutex);
+    for (i = 0; i < dpscnt; i++) {
+        dp_coalesce_slot_t *slot = NULL;
+        char *str = NULL;
+
+        if (NULL == dp_node_find(schema, dps[i].id)) {
+            PR_ERR("dparr[%d]: dpid %d not find", i, dps[i].id);
+            continue;
+        }
+        if (0 == co->slot_index[dps[i].id]) {
+            if (co->slot_num >= co->slot_max) {
+                // the schema grew since the window was enabled
+                PR_WARN("dp coalesce slots full, dp %d", dps[i].id);
+                continue;
+            }
+            co->slot[co->slot_num].id = dps[i].id;
+            co->slot_index[dps[i].id] = ++co->slot_num;
+        }
+        slot = &co->slot[co->slot_index[dps[i].id] - 1];
+
+        if (PROP_STR == dps[i].type) {
+            str = mm_strdup(dps[i].value.dp_str);
+            if (NULL == str) {
+                tal_mutex_unlock(co->mutex);
+                return OPRT_MALLOC_FAILED;
+            }
+        }
+        if (slot->pending) {
+            slot->stat.suppressed++;
+            if (PROP_STR == slot->dp.type) {
+                tal_free(slot->dp.value.dp_str);
+            }
+        } else {
+            slot->pending = true;
+            co->pend_num++;
+        }
+        slot->stat.queued++;
+        slot->dp = dps[i];
+        if (str) {
+            slot->dp.value.dp_str = str;
+        }
+    }
+    co->flags |= flags;
+
+    SYS_TIME_T elapsed = tal_system_get_millisecond() - co->last_flush_ms;
+    if ((flags & DP_REPT_IMMEDIATE_FLAG) || (!co->scheduled && elapsed >= co->window_ms)) {
+        flush_now = true;
+    } else if (!co->scheduled && co->work) {
+        co->scheduled = true;
+        tal_workq_start_delayed(co->work, co->window_ms - elapsed, LOOP_ONCE);
+    }
+    tal_mutex_unlock(co->mutex);
+
+    if (flush_now) {
+        return dp_coalesce_flush(co);
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Reports device object data to the Tuya IoT cloud service.
+ *
+ * This function is used to report the device object data to the Tuya IoT cloud
+ * service. With tuya_iot_dp_coalesce_set() the reports of the activated device
+ * pass through the coalescing window first.
+ *
+ * @param client The Tuya IoT client instance.
+ * @param devid The device ID.
+ * @param dps An array of device object data.
+ * @param dpscnt The number of device object data elements in the array.
+ * @param flags Additional flags for the report.
+ *
+ * @return The result of the operation. Returns 0 on success, or a negative
+ * error code on failure.
+ */
+int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_t *dps, uint16_t dpscnt, int flags)
+{
+    if (!client->is_activated) {
+        PR_DEBUG("client no active");
+        return OPRT_COM_ERROR;
+    }
+    if (NULL == dps || 0 == dpscnt) {
+        return OPRT_INVALID_PARM;
+    }
+
+    dp_coalesce_t *co = dp_coalesce_get();
+    if (co) {
+        int ret = OPRT_INVALID_PARM;
+        if (0 != strcmp(devid, co->devid)) {
+            ret = dp_obj_report_now(client, devid, dps, dpscnt, flags, NULL);
+        } else {
+            dp_schema_t *schema = dp_schema_find(devid);
+            if (schema) {
+                ret = dp_coalesce_put(co, schema, dps, dpscnt, flags);
+            }
+        }
+        dp_coalesce_unref(co);
+        return ret;
+    }
+
+    return dp_obj_report_now(client, devid, dps, dpscnt, flags, NULL);
+}
+
+/**
+ * @brief Enables, changes or disables coalescing of object DP reports.
+ *
+ * @param client The Tuya IoT client instance.
+ * @param window_ms The window, 0 flushes what is pending and disables it.
+ * @note Not thread safe against tuya_iot_dp_obj_report, set it up from the
+ * thread that reports.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tuya_iot_dp_coalesce_set(tuya_iot_client_t *client, uint32_t window_ms)
+{
+    OPERATE_RET rt = OPRT_OK;
+    dp_coalesce_t *co = NULL;
+
+    TUYA_CHECK_NULL_RETURN(client, OPRT_INVALID_PARM);
+
+    if (NULL == s_dp_coalesce_mutex) {
+        TUYA_CALL_ERR_RETURN(tal_mutex_create_init(&s_dp_coalesce_mutex));
+    }
+
+    if (window_ms) {
+        co = dp_coalesce_get();
+        if (co) {
+            tal_mutex_lock(co->mutex);
+            co->window_ms = window_ms;
+            tal_mutex_unlock(co->mutex);
+            dp_coalesce_unref(co);
+            return OPRT_OK;
+        }
+    } else {
+        co = dp_coalesce_detach();
+        if (co) {
+            rt = dp_coalesce_flush(co);
+            if (OPRT_OK == rt && co->pend_num) {
+                rt = OPRT_COM_ERROR;
+            }
+            // freed here or by the last report still using it
+            dp_coalesce_unref(co);
+        }
+        return rt;
+    }
+
+    if (!client->is_activated) {
+        return OPRT_COM_ERROR;
+    }
+    dp_schema_t *schema = dp_schema_find(client->activate.devid);
+    TUYA_CHECK_NULL_RETURN(schema, OPRT_INVALID_PARM);
+
+    co = tal_malloc(sizeof(dp_coalesce_t) + sizeof(dp_coalesce_slot_t) * schema->num);
+    TUYA_CHECK_NULL_RETURN(co, OPRT_MALLOC_FAILED);
+    memset(co, 0, sizeof(dp_coalesce_t) + sizeof(dp_coalesce_slot_t) * schema->num);
+    co->ref = 1;
+    co->client = client;
+    co->window_ms = window_ms;
+    co->slot_max = schema->num;
+    strncpy(co->devid, client->activate.devid, DEV_ID_LEN);
+    co->last_flush_ms = tal_system_get_millisecond() - window_ms;
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&co->mutex), __ERR);
+    // the work looks the window up through s_dp_coalesce, it may run after a detach
+    TUYA_CALL_ERR_GOTO(tal_workq_init_delayed(WORKQ_HIGHTPRI, dp_coalesce_work_cb, NULL, &co->work), __ERR);
+
+    tal_mutex_lock(s_dp_coalesce_mutex);
+    s_dp_coalesce = co;
+    tal_mutex_unlock(s_dp_coalesce_mutex);
+    PR_DEBUG("dp coalesce window %d ms, %d slots", window_ms, co->slot_max);
+
+    return OPRT_OK;
+
+__ERR:
+    if (co->mutex) {
+        tal_mutex_release(co->mutex);
+    }
+    tal_free(co);
+    return rt;
+}
+
+/**
+ * @brief Turns coalescing off and drops the values it holds, without sending.
+ *
+ * Called when the device leaves its activation, e.g. on reset.
+ */
+void tuya_iot_dp_coalesce_clear(void)
+{
+    dp_coalesce_t *co = dp_coalesce_detach();
+
+    if (co) {
+        tal_mutex_lock(co->mutex);
+        co->pend_num = 0;
+        tal_mutex_unlock(co->mutex);
+        dp_coalesce_unref(co);
+    }
+}
+
+/**
+ * @brief Gets the coalescing statistics of a DP.
+ *
+ * @param dpid The dp id.
+ * @param stat The statistics since the window was enabled.
+ * @return OPRT_OK on success, OPRT_NOT_FOUND when coalescing is off or the dp
+ * has not been reported.
+ */
+int tuya_iot_dp_coalesce_stat_get(uint8_t dpid, tuya_iot_dp_coalesce_stat_t *stat)
+{
+    int ret = OPRT_OK;
+
+    TUYA_CHECK_NULL_RETURN(stat, OPRT_INVALID_PARM);
+    dp_coalesce_t *co = dp_coalesce_get();
+    if (NULL == co) {
+        return OPRT_NOT_FOUND;
+    }
+
+    tal_mutex_lock(co->mutex);
+    if (0 == co->slot_index[dpid]) {
+        ret = OPRT_NOT_FOUND;
+    } else {
+        *stat = co->slot[co->slot_index[dpid] - 1].stat;
     }
+    tal_mutex_unlock(co->mutex);
+    dp_coalesce_unref(co);
 
     return ret;
 }
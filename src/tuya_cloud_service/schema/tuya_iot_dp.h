@@ -55,6 +55,51 @@ int tuya_iot_dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_s
  */
 int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_t *dps, uint16_t dpscnt, int flags);
 
+/**
+ * @brief per DP statistics of the report coalescing window
+ */
+typedef struct {
+    /** values given to tuya_iot_dp_obj_report */
+    uint32_t queued;
+    /** values replaced by a later one of the same dp before the flush */
+    uint32_t suppressed;
+    /** values handed to the report channel */
+    uint32_t flushed;
+} tuya_iot_dp_coalesce_stat_t;
+
+/**
+ * @brief Enables, changes or disables coalescing of object DP reports.
+ *
+ * With a window, object reports of the activated device are sent at most once
+ * per window. Values reported while a window is open are merged per dp, the
+ * last value wins, and go out together when it closes. A report with
+ * DP_REPT_IMMEDIATE_FLAG, e.g. an alarm, flushes the merged values together
+ * with its own right away.
+ *
+ * @param client The Tuya IoT client instance.
+ * @param window_ms The window, 0 flushes what is pending and disables it.
+ * @note Values that cannot be sent, e.g. while offline, stay in the window and
+ * are retried. Disabling drops the ones that still cannot be sent and returns
+ * an error.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tuya_iot_dp_coalesce_set(tuya_iot_client_t *client, uint32_t window_ms);
+
+/**
+ * @brief Disables coalescing and drops the pending values without sending them.
+ */
+void tuya_iot_dp_coalesce_clear(void);
+
+/**
+ * @brief Gets the coalescing statistics of a DP.
+ *
+ * @param dpid The dp id.
+ * @param stat The statistics since the window was enabled.
+ * @return OPRT_OK on success, OPRT_NOT_FOUND when coalescing is off or the dp
+ * has not been reported.
+ */
+int tuya_iot_dp_coalesce_stat_get(uint8_t dpid, tuya_iot_dp_coalesce_stat_t *stat);
+
 /**
  * @brief
  *
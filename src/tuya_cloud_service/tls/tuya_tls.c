@@ -38,9 +38,41 @@
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/hkdf.h"
 #include "mbedtls/aes.h"
+#include "mbedtls/sha256.h"
 
 #define TLS_URL_LEN (128 + 16)
 
+#ifndef TLS_SESSION_CACHE_NUM
+#define TLS_SESSION_CACHE_NUM (4) // host:port kept with a resumable session
+#endif
+
+#ifndef TLS_SESSION_CACHE_PERSIST
+#define TLS_SESSION_CACHE_PERSIST (0) // 1 keeps sessions in KV across a reboot
+#endif
+
+#ifndef TLS_SHARED_CONF_NUM
+#define TLS_SHARED_CONF_NUM (2) // parsed CA chains kept with their ssl config
+#endif
+
+#define TLS_SESSION_KV_KEY "tls_session"
+#define TLS_MASTER_LEN     (48)
+
+typedef struct {
+    bool valid;
+    bool verify;
+    int ref;            // connections using conf
+    uint32_t used;      // stamp of the last use, the oldest idle entry is replaced
+    uint8_t digest[32]; // sha256 of the CA
+    mbedtls_x509_crt cacert;
+    mbedtls_ssl_config conf;
+} tuya_tls_shared_conf_t;
+
+typedef struct {
+    char host[TLS_URL_LEN]; // "host:port", empty when free
+    uint32_t used;
+    mbedtls_ssl_session session;
+} tuya_tls_session_t;
+
 typedef struct {
     tuya_tls_config_t config;
     mbedtls_ssl_context ssl_ctx;
@@ -48,6 +80,7 @@ typedef struct {
     mbedtls_x509_crt cacert;
     mbedtls_x509_crt client_cert;
     mbedtls_pk_context client_pkey;
+    tuya_tls_shared_conf_t *shared; // config in use instead of conf_ctx
     int socket_fd;
     int overtime_s;
     MUTEX_HANDLE mutex;
@@ -60,6 +93,13 @@ static tuya_tls_pre_conn_cb s_pre_conn_cb = NULL;
 static mbedtls_entropy_context ty_entropy;
 static mbedtls_ctr_drbg_context ty_ctr_drbg;
 
+static MUTEX_HANDLE s_cache_mutex = NULL;
+static tuya_tls_shared_conf_t s_shared_conf[TLS_SHARED_CONF_NUM];
+static tuya_tls_session_t s_session_cache[TLS_SESSION_CACHE_NUM];
+static bool s_session_loaded = false;
+static uint32_t s_cache_stamp = 0;
+static tuya_tls_stats_t s_tls_stats;
+
 /* -------------------------------------------------------------------------- */
 /*                                  TLS Mutex                                 */
 /* -------------------------------------------------------------------------- */
@@ -393,6 +433,367 @@ static int tuya_tls_ciphersuite_list[] = {MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC
                                           MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
                                           MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256, 0};
 
+/* -------------------------------------------------------------------------- */
+/*                       Shared config and session cache                      */
+/* -------------------------------------------------------------------------- */
+static int __tuya_tls_conf_defaults(mbedtls_ssl_config *conf)
+{
+    int ret = 0;
+
+    mbedtls_ssl_conf_dbg(conf, __tuya_tls_log, NULL);
+    mbedtls_ssl_conf_rng(conf, __tuya_tls_random, NULL);
+
+    ret = mbedtls_ssl_config_defaults(conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                      MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret != 0) {
+        PR_ERR("mbedtls_ssl_config_defaults Fail. %x %d", ret, ret);
+        return ret;
+    }
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+#if (MBEDTLS_SSL_MAX_CONTENT_LEN >= 4096)
+    mbedtls_ssl_conf_max_frag_len(conf, MBEDTLS_SSL_MAX_FRAG_LEN_4096);
+#else
+    mbedtls_ssl_conf_max_frag_len(conf, MBEDTLS_SSL_MAX_FRAG_LEN_1024);
+#endif
+#endif
+
+    return 0;
+}
+
+static int __tuya_tls_shared_conf_build(tuya_tls_shared_conf_t *shared, const tuya_tls_config_t *config)
+{
+    int ret = 0;
+
+    mbedtls_ssl_config_init(&shared->conf);
+    mbedtls_x509_crt_init(&shared->cacert);
+
+    ret = __tuya_tls_conf_defaults(&shared->conf);
+    if (ret != 0) {
+        goto __exit;
+    }
+
+    mbedtls_ssl_conf_authmode(&shared->conf, config->verify ? MBEDTLS_SSL_VERIFY_REQUIRED : MBEDTLS_SSL_VERIFY_NONE);
+    if (config->ca_cert) {
+        PR_DEBUG("load root ca cert.");
+        ret = mbedtls_x509_crt_parse(&shared->cacert, (const unsigned char *)config->ca_cert, config->ca_cert_size);
+        if (ret != 0) {
+            PR_ERR("mbedtls_x509_crt_parse Fail. 0x%x %d", -ret, ret);
+            goto __exit;
+        }
+        mbedtls_ssl_conf_ca_chain(&shared->conf, &shared->cacert, NULL);
+    }
+    mbedtls_ssl_conf_ciphersuites(&shared->conf, tuya_tls_ciphersuite_list);
+
+    return 0;
+
+__exit:
+    mbedtls_x509_crt_free(&shared->cacert);
+    mbedtls_ssl_config_free(&shared->conf);
+    return ret;
+}
+
+/**
+ * @brief take a config for server authentication with the CA of config
+ *
+ * The CA is parsed once, later connects with the same CA reuse the config. An
+ * idle config is replaced when all entries are taken by other CAs.
+ *
+ * @return the shared config, NULL to build a private one
+ */
+static tuya_tls_shared_conf_t *__tuya_tls_shared_conf_get(const tuya_tls_config_t *config)
+{
+    uint8_t digest[32];
+    tuya_tls_shared_conf_t *shared = NULL, *idle = NULL;
+    int i = 0;
+
+    if (NULL == s_cache_mutex) {
+        return NULL;
+    }
+
+    mbedtls_sha256((const unsigned char *)config->ca_cert, config->ca_cert ? config->ca_cert_size : 0, digest, 0);
+
+    tal_mutex_lock(s_cache_mutex);
+    for (i = 0; i < TLS_SHARED_CONF_NUM; i++) {
+        tuya_tls_shared_conf_t *entry = &s_shared_conf[i];
+        if (entry->valid && entry->verify == config->verify && 0 == memcmp(entry->digest, digest, sizeof(digest))) {
+            shared = entry;
+            break;
+        }
+        if (0 == entry->ref && (NULL == idle || !entry->valid || (idle->valid && entry->used < idle->used))) {
+            idle = entry;
+        }
+    }
+
+    if (shared) {
+        s_tls_stats.conf_reuse_cnt++;
+    } else if (idle) {
+        if (idle->valid) {
+            mbedtls_x509_crt_free(&idle->cacert);
+            mbedtls_ssl_config_free(&idle->conf);
+            idle->valid = false;
+        }
+        if (0 == __tuya_tls_shared_conf_build(idle, config)) {
+            memcpy(idle->digest, digest, sizeof(digest));
+            idle->verify = config->verify;
+            idle->valid = true;
+            shared = idle;
+            s_tls_stats.ca_parse_cnt++;
+        }
+    }
+
+    if (shared) {
+        shared->ref++;
+        shared->used = ++s_cache_stamp;
+    }
+    tal_mutex_unlock(s_cache_mutex);
+
+    return shared;
+}
+
+static void __tuya_tls_shared_conf_put(tuya_tls_shared_conf_t *shared)
+{
+    if (NULL == shared) {
+        return;
+    }
+
+    tal_mutex_lock(s_cache_mutex);
+    shared->ref--;
+    tal_mutex_unlock(s_cache_mutex);
+}
+
+static tuya_tls_session_t *__tuya_tls_session_find(const char *host)
+{
+    int i = 0;
+
+    for (i = 0; i < TLS_SESSION_CACHE_NUM; i++) {
+        if (0 == strcmp(s_session_cache[i].host, host)) {
+            return &s_session_cache[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief read the sessions saved by __tuya_tls_session_save, under s_cache_mutex
+ *
+ * Record: per session a byte of host length, the host, two bytes of session
+ * length and the session serialized by mbedtls_ssl_session_save.
+ */
+static void __tuya_tls_session_load(void)
+{
+#if TLS_SESSION_CACHE_PERSIST
+    uint8_t *record = NULL;
+    size_t length = 0, pos = 0, host_len = 0, session_len = 0;
+    int i = 0;
+
+    if (OPRT_OK != tal_kv_get(TLS_SESSION_KV_KEY, &record, &length)) {
+        return;
+    }
+
+    while (i < TLS_SESSION_CACHE_NUM && pos + 1 <= length) {
+        tuya_tls_session_t *entry = &s_session_cache[i];
+
+        host_len = record[pos];
+        if (0 == host_len || host_len >= TLS_URL_LEN || pos + 1 + host_len + 2 > length) {
+            break;
+        }
+        session_len = (record[pos + 1 + host_len] << 8) | record[pos + 2 + host_len];
+        if (pos + 3 + host_len + session_len > length) {
+            break;
+        }
+        // fails on a record of another mbedtls version or configuration
+        if (0 != mbedtls_ssl_session_load(&entry->session, record + pos + 3 + host_len, session_len)) {
+            mbedtls_ssl_session_free(&entry->session);
+            break;
+        }
+        memcpy(entry->host, record + pos + 1, host_len);
+        entry->host[host_len] = '\0';
+        pos += 3 + host_len + session_len;
+        i++;
+    }
+    PR_DEBUG("tls sessions loaded: %d", i);
+
+    tal_kv_free(record);
+#endif
+}
+
+static void __tuya_tls_session_save(void)
+{
+#if TLS_SESSION_CACHE_PERSIST
+    uint8_t *record = NULL;
+    size_t length = 0, pos = 0, host_len = 0, session_len = 0;
+    int i = 0;
+
+    tal_mutex_lock(s_cache_mutex);
+    for (i = 0; i < TLS_SESSION_CACHE_NUM; i++) {
+        if (s_session_cache[i].host[0]) {
+            mbedtls_ssl_session_save(&s_session_cache[i].session, NULL, 0, &session_len);
+            length += 3 + strlen(s_session_cache[i].host) + session_len;
+        }
+    }
+    if (0 == length) {
+        tal_mutex_unlock(s_cache_mutex);
+        tal_kv_del(TLS_SESSION_KV_KEY);
+        return;
+    }
+
+    record = tal_malloc(length);
+    if (NULL == record) {
+        tal_mutex_unlock(s_cache_mutex);
+        PR_ERR("tls session record malloc fail");
+        return;
+    }
+    for (i = 0; i < TLS_SESSION_CACHE_NUM; i++) {
+        tuya_tls_session_t *entry = &s_session_cache[i];
+        if (0 == entry->host[0]) {
+            continue;
+        }
+        host_len = strlen(entry->host);
+        record[pos] = host_len;
+        memcpy(record + pos + 1, entry->host, host_len);
+        if (0 != mbedtls_ssl_session_save(&entry->session, record + pos + 3 + host_len, length - pos - 3 - host_len,
+                                          &session_len)) {
+            break;
+        }
+        record[pos + 1 + host_len] = session_len >> 8;
+        record[pos + 2 + host_len] = session_len & 0xff;
+        pos += 3 + host_len + session_len;
+    }
+    tal_mutex_unlock(s_cache_mutex);
+
+    tal_kv_set(TLS_SESSION_KV_KEY, record, pos);
+    tal_free(record);
+#endif
+}
+
+/**
+ * @brief offer the cached session of host to the handshake of ssl
+ *
+ * @param[out] master master secret of the offered session, a resumed handshake
+ * keeps it while a full handshake derives a new one
+ *
+ * @return true when a session was offered
+ */
+static bool __tuya_tls_session_offer(const char *host, mbedtls_ssl_context *ssl, uint8_t master[TLS_MASTER_LEN])
+{
+    tuya_tls_session_t *entry = NULL;
+    bool offered = false;
+
+    if (NULL == s_cache_mutex) {
+        return false;
+    }
+
+    tal_mutex_lock(s_cache_mutex);
+    if (!s_session_loaded) {
+        s_session_loaded = true;
+        __tuya_tls_session_load();
+    }
+    entry = __tuya_tls_session_find(host);
+    if (entry && 0 == mbedtls_ssl_set_session(ssl, &entry->session)) {
+        memcpy(master, entry->session.MBEDTLS_PRIVATE(master), TLS_MASTER_LEN);
+        entry->used = ++s_cache_stamp;
+        offered = true;
+    }
+    tal_mutex_unlock(s_cache_mutex);
+
+    return offered;
+}
+
+/**
+ * @brief cache the session of a completed handshake for the next connect
+ *
+ * Only a full handshake is saved to KV, a resumed one at most refreshed the
+ * ticket, which is not worth a flash write.
+ *
+ * @param[in] master returned by __tuya_tls_session_offer, NULL when nothing was
+ * offered
+ *
+ * @return true when the handshake resumed the offered session
+ */
+static bool __tuya_tls_session_update(const char *host, mbedtls_ssl_context *ssl, const uint8_t *master)
+{
+    mbedtls_ssl_session session;
+    tuya_tls_session_t *entry = NULL;
+    bool resumed = false;
+    int i = 0;
+
+    if (NULL == s_cache_mutex) {
+        return false;
+    }
+
+    mbedtls_ssl_session_init(&session);
+    if (0 != mbedtls_ssl_get_session(ssl, &session)) {
+        mbedtls_ssl_session_free(&session);
+        return false;
+    }
+    resumed = master && 0 == memcmp(master, session.MBEDTLS_PRIVATE(master), TLS_MASTER_LEN);
+
+    tal_mutex_lock(s_cache_mutex);
+    entry = __tuya_tls_session_find(host);
+    if (NULL == entry) {
+        // a free entry, else the least recently used one
+        entry = &s_session_cache[0];
+        for (i = 1; i < TLS_SESSION_CACHE_NUM && entry->host[0]; i++) {
+            if (0 == s_session_cache[i].host[0] || s_session_cache[i].used < entry->used) {
+                entry = &s_session_cache[i];
+            }
+        }
+    }
+    mbedtls_ssl_session_free(&entry->session);
+    entry->session = session; // the cache owns the ticket now
+    snprintf(entry->host, sizeof(entry->host), "%s", host);
+    entry->used = ++s_cache_stamp;
+    tal_mutex_unlock(s_cache_mutex);
+
+    if (!resumed) {
+        __tuya_tls_session_save();
+    }
+
+    return resumed;
+}
+
+static void __tuya_tls_session_drop(const char *host)
+{
+    tuya_tls_session_t *entry = NULL;
+
+    if (NULL == s_cache_mutex) {
+        return;
+    }
+
+    tal_mutex_lock(s_cache_mutex);
+    entry = __tuya_tls_session_find(host);
+    if (entry) {
+        mbedtls_ssl_session_free(&entry->session);
+        entry->host[0] = '\0';
+    }
+    tal_mutex_unlock(s_cache_mutex);
+
+    if (entry) {
+        __tuya_tls_session_save();
+    }
+}
+
+static void __tuya_tls_stats_update(OPERATE_RET result, bool resumed, uint32_t cost_ms)
+{
+    if (s_cache_mutex) {
+        tal_mutex_lock(s_cache_mutex);
+    }
+    if (OPRT_OK != result) {
+        s_tls_stats.fail_cnt++;
+    } else if (resumed) {
+        s_tls_stats.resumed_cnt++;
+        s_tls_stats.resumed_ms += cost_ms;
+    } else {
+        s_tls_stats.full_cnt++;
+        s_tls_stats.full_ms += cost_ms;
+    }
+    if (s_cache_mutex) {
+        tal_mutex_unlock(s_cache_mutex);
+    }
+}
+
 /**
  * @brief Initializes the Tuya TLS module.
  *
@@ -425,6 +826,14 @@ OPERATE_RET tuya_tls_init(void)
     }
     mbedtls_ctr_drbg_set_prediction_resistance(&ty_ctr_drbg, MBEDTLS_CTR_DRBG_PR_OFF);
 
+    if (NULL == s_cache_mutex) {
+        op_ret = tal_mutex_create_init(&s_cache_mutex);
+        if (op_ret != OPRT_OK) {
+            PR_ERR("cache mutex create Fail. %d", op_ret);
+            goto exit;
+        }
+    }
+
     PR_NOTICE("tuya_tls_init ok!");
 
     return OPRT_OK;
@@ -550,6 +959,11 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
 {
     OPERATE_RET op_ret;
     tuya_mbedtls_context_t *tls_context = (tuya_mbedtls_context_t *)p_tls_handler;
+    char session_host[TLS_URL_LEN] = {0};
+    uint8_t offered_master[TLS_MASTER_LEN];
+    bool offered = false, resumed = false;
+    SYS_TIME_T start_ms = 0;
+    uint32_t cost_ms = 0;
 
     if (NULL == p_tls_handler || socket_fd < 0) {
         PR_ERR("INPUT INVALID PARM");
@@ -573,60 +987,65 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
 
     mbedtls_ssl_init(p_ssl_ctx);
     mbedtls_ssl_config_init(p_conf_ctx);
-
-    mbedtls_ssl_conf_dbg(p_conf_ctx, __tuya_tls_log, NULL);
-    mbedtls_ssl_conf_rng(p_conf_ctx, __tuya_tls_random, NULL);
+    tls_context->shared = NULL;
 
 #if defined(ENABLE_MBEDTLS_DEBUG) && (ENABLE_MBEDTLS_DEBUG == 1)
     mbedtls_debug_set_threshold(3);
     mbedtls_ssl_set_export_keys_cb(p_ssl_ctx, __tuya_tls_export_keys, NULL);
 #endif
 
-    op_ret = mbedtls_ssl_config_defaults(p_conf_ctx, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
-                                         MBEDTLS_SSL_PRESET_DEFAULT);
-    if (op_ret != 0) {
-        PR_ERR("mbedtls_ssl_config_defaults Fail. %x %d", op_ret, op_ret);
-        goto tuya_tls_connect_EXIT;
-    }
-
-#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
-#if (MBEDTLS_SSL_MAX_CONTENT_LEN >= 4096)
-    mbedtls_ssl_conf_max_frag_len(p_conf_ctx, MBEDTLS_SSL_MAX_FRAG_LEN_4096);
-#else
-    mbedtls_ssl_conf_max_frag_len(p_conf_ctx, MBEDTLS_SSL_MAX_FRAG_LEN_1024);
-#endif
-#endif
     if (s_pre_conn_cb) {
         PR_DEBUG("s_pre_conn_cb  %08x", s_pre_conn_cb);
         s_pre_conn_cb(hostname, (tuya_tls_hander *)tls_context);
     }
     if (tls_context->config.psk_key_size > 0 && tls_context->config.psk_id_size > 0) {
+        op_ret = __tuya_tls_conf_defaults(p_conf_ctx);
+        if (op_ret != 0) {
+            goto tuya_tls_connect_EXIT;
+        }
         mbedtls_ssl_conf_psk(p_conf_ctx, (const unsigned char *)tls_context->config.psk_key,
                              tls_context->config.psk_key_size, (const unsigned char *)tls_context->config.psk_id,
                              tls_context->config.psk_id_size);
         mbedtls_ssl_conf_ciphersuites(p_conf_ctx, tuya_tls_ciphersuite_list_PSK);
     } else {
-        op_ret = mbedtls_cert_pkey_parse(p_tls_handler);
-        if (op_ret != 0) {
-            PR_ERR("mbedtls_cert_parse_process Fail. 0x%x %d", -op_ret, op_ret);
-            mbedtls_cert_pkey_free(p_tls_handler);
-            return op_ret;
+        if (NULL == tls_context->config.client_cert || NULL == tls_context->config.client_pkey) {
+            // server authentication only, connects with the same CA share the config
+            tls_context->shared = __tuya_tls_shared_conf_get(&tls_context->config);
+        }
+        if (tls_context->shared) {
+            p_conf_ctx = &tls_context->shared->conf;
+        } else {
+            op_ret = __tuya_tls_conf_defaults(p_conf_ctx);
+            if (op_ret != 0) {
+                goto tuya_tls_connect_EXIT;
+            }
+            op_ret = mbedtls_cert_pkey_parse(p_tls_handler);
+            if (op_ret != 0) {
+                PR_ERR("mbedtls_cert_parse_process Fail. 0x%x %d", -op_ret, op_ret);
+                mbedtls_cert_pkey_free(p_tls_handler);
+                return op_ret;
+            }
+            mbedtls_ssl_conf_ciphersuites(p_conf_ctx, tuya_tls_ciphersuite_list);
         }
         if (hostname) {
             op_ret = mbedtls_ssl_set_hostname(p_ssl_ctx, hostname);
             if (op_ret != 0) {
                 PR_ERR("mbedtls_ssl_set_hostname Fail. 0x%x", -op_ret);
-                mbedtls_cert_pkey_free(p_tls_handler);
+                if (NULL == tls_context->shared) {
+                    mbedtls_cert_pkey_free(p_tls_handler);
+                }
+                // not set up on the ssl context yet, give the reference back here
+                __tuya_tls_shared_conf_put(tls_context->shared);
+                tls_context->shared = NULL;
                 return op_ret;
             }
         }
-        mbedtls_ssl_conf_ciphersuites(p_conf_ctx, tuya_tls_ciphersuite_list);
     }
     /* Setup */
     op_ret = mbedtls_ssl_setup(p_ssl_ctx, p_conf_ctx);
     if (op_ret != 0) {
         PR_ERR("mbedtls_ssl_setup Fail. 0x%x", op_ret);
-        if (tls_context->config.mode != TUYA_TLS_PSK_MODE) {
+        if (tls_context->config.mode != TUYA_TLS_PSK_MODE && NULL == tls_context->shared) {
             mbedtls_cert_pkey_free(p_tls_handler);
         }
         goto tuya_tls_connect_EXIT;
@@ -639,7 +1058,13 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
     mbedtls_ssl_set_bio(p_ssl_ctx, tls_context, __tuya_tls_socket_send_cb, __tuya_tls_socket_recv_cb, NULL);
     PR_DEBUG("socket fd is set. set to inner send/recv to handshake");
 
+    if (hostname) {
+        snprintf(session_host, sizeof(session_host), "%s:%d", hostname, port_num);
+        offered = __tuya_tls_session_offer(session_host, p_ssl_ctx, offered_master);
+    }
+
     TIME_T cur_time = tal_time_get_posix();
+    start_ms = tal_system_get_millisecond();
 
     while ((op_ret = mbedtls_ssl_handshake(p_ssl_ctx)) != 0) {
         if (op_ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
@@ -662,9 +1087,12 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
             break;
         }
     }
+    cost_ms = (uint32_t)(tal_system_get_millisecond() - start_ms);
 
     if (tls_context->config.mode != TUYA_TLS_PSK_MODE) {
-        mbedtls_cert_pkey_free(p_tls_handler);
+        if (NULL == tls_context->shared) {
+            mbedtls_cert_pkey_free(p_tls_handler);
+        }
 
         uint32_t handshake_flags = 0;
         /* In real life, we probably want to bail out when ret != 0 */
@@ -678,7 +1106,13 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
         goto tuya_tls_connect_EXIT;
     }
 
-    PR_DEBUG("handshake finish for %s. set send/recv to user set", (hostname ? hostname : ""));
+    if (session_host[0]) {
+        resumed = __tuya_tls_session_update(session_host, p_ssl_ctx, offered ? offered_master : NULL);
+    }
+    __tuya_tls_stats_update(OPRT_OK, resumed, cost_ms);
+
+    PR_DEBUG("handshake finish for %s in %d ms, %s. set send/recv to user set", (hostname ? hostname : ""),
+             cost_ms, resumed ? "resumed" : "full");
     if (tls_context->config.f_send && tls_context->config.f_recv) {
         mbedtls_ssl_set_bio(p_ssl_ctx, tls_context->config.user_data, tls_context->config.f_send,
                             tls_context->config.f_recv, NULL);
@@ -692,6 +1126,11 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
 tuya_tls_connect_EXIT:
 
     PR_ERR("TUYA_TLS faild Connect %s:%d", (hostname ? hostname : ""), port_num);
+    __tuya_tls_stats_update(OPRT_COM_ERROR, false, 0);
+    if (offered) {
+        // a stale session must not fail the next connect too
+        __tuya_tls_session_drop(session_host);
+    }
 
     return op_ret;
 }
@@ -783,6 +1222,28 @@ int tuya_tls_read(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len)
     return value;
 }
 
+/**
+ * @brief Gets the number of decrypted bytes waiting in the TLS connection.
+ *
+ * mbedtls decrypts a whole record at a time, the part a read did not take
+ * stays in its buffer and no longer shows up as readable on the socket.
+ *
+ * @param[in] tls_handler The TLS handler.
+ *
+ * @return The number of bytes tuya_tls_read() returns without touching the
+ * socket, 0 if none.
+ */
+int tuya_tls_read_pending(tuya_tls_hander tls_handler)
+{
+    if (tls_handler == NULL) {
+        return 0;
+    }
+
+    tuya_mbedtls_context_t *tls_context = (tuya_mbedtls_context_t *)tls_handler;
+
+    return (int)mbedtls_ssl_get_bytes_avail(&(tls_context->ssl_ctx));
+}
+
 /**
  * @brief generated random
  *
@@ -814,6 +1275,8 @@ OPERATE_RET tuya_tls_disconnect(tuya_tls_hander tls_handler)
 
     mbedtls_ssl_free(p_ssl_ctx);
     mbedtls_ssl_config_free(p_conf_ctx);
+    __tuya_tls_shared_conf_put(tls_context->shared);
+    tls_context->shared = NULL;
 
     mu_ret = tal_mutex_unlock(tls_context->read_mutex);
     if (OPRT_OK != mu_ret) {
@@ -835,4 +1298,41 @@ OPERATE_RET tuya_tls_disconnect(tuya_tls_hander tls_handler)
 tuya_tls_event_cb tuya_cert_get_tls_event_cb(void)
 {
     return __tuya_tls_event_cb;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Retrieves the handshake statistics.
+ *
+ * @param[out] stats Handshake counts and durations since tuya_tls_init.
+ */
+void tuya_tls_stats_get(tuya_tls_stats_t *stats)
+{
+    if (NULL == stats || NULL == s_cache_mutex) {
+        return;
+    }
+
+    tal_mutex_lock(s_cache_mutex);
+    memcpy(stats, &s_tls_stats, sizeof(tuya_tls_stats_t));
+    tal_mutex_unlock(s_cache_mutex);
+}
+
+/**
+ * @brief Drops the cached TLS sessions, in memory and in KV.
+ */
+void tuya_tls_session_cache_clear(void)
+{
+    int i = 0;
+
+    if (s_cache_mutex) {
+        tal_mutex_lock(s_cache_mutex);
+        for (i = 0; i < TLS_SESSION_CACHE_NUM; i++) {
+            mbedtls_ssl_session_free(&s_session_cache[i].session);
+            s_session_cache[i].host[0] = '\0';
+        }
+        s_session_loaded = true;
+        tal_mutex_unlock(s_cache_mutex);
+    }
+
+    // also drops a record saved by a build that kept sessions
+    tal_kv_del(TLS_SESSION_KV_KEY);
+}
@@ -91,6 +91,16 @@ typedef struct {
     void *user_data;
 } tuya_tls_config_t;
 
+typedef struct {
+    uint32_t full_cnt;       // handshakes with key exchange and certificate verification
+    uint32_t full_ms;        // total time of the full handshakes
+    uint32_t resumed_cnt;    // abbreviated handshakes on a cached session
+    uint32_t resumed_ms;     // total time of the resumed handshakes
+    uint32_t fail_cnt;       // failed handshakes
+    uint32_t ca_parse_cnt;   // CA chains parsed into a shared config
+    uint32_t conf_reuse_cnt; // connects that reused a shared config
+} tuya_tls_stats_t;
+
 /**
  * @brief Get mbedtls random data in the specified length
  *
@@ -198,6 +208,15 @@ int tuya_tls_write(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len);
  */
 int tuya_tls_read(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len);
 
+/**
+ * @brief bytes already decrypted and waiting to be read
+ *
+ * @param[in] tls_handler refer to tuya_tls_hander
+ *
+ * @return the count tuya_tls_read returns without reading the socket, 0 if none
+ */
+int tuya_tls_read_pending(tuya_tls_hander tls_handler);
+
 /**
  * @brief generated random
  *
@@ -208,6 +227,24 @@ int tuya_tls_read(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len);
  */
 OPERATE_RET tuya_tls_disconnect(tuya_tls_hander tls_handler);
 
+/**
+ * @brief get the handshake statistics
+ *
+ * Connects to a host:port that completed a handshake before offer the cached
+ * session, the server may then skip the key exchange and the certificate
+ * chain. The statistics tell how often that worked and what it saved.
+ *
+ * @param[out] stats handshake statistics since tuya_tls_init
+ */
+void tuya_tls_stats_get(tuya_tls_stats_t *stats);
+
+/**
+ * @brief drop the cached sessions, in memory and in KV
+ *
+ * Called when the device leaves its endpoint, e.g. on reset.
+ */
+void tuya_tls_session_cache_clear(void);
+
 /**
  * @brief Retrieves the configuration for the Tuya TLS PSK mode.
  *
@@ -187,7 +187,8 @@ OPERATE_RET tuya_tls_transporter_write(tuya_transporter_t t, uint8_t *buf, int l
  *
  * This function reads data from the TLS transporter specified by the parameter
  * `t`. The function will block for up to `timeout_ms` milliseconds waiting for
- * data to be available.
+ * data to be available. Data already decrypted by a previous read counts as
+ * readable at once, the socket no longer signals it.
  *
  * @param t The TLS transporter to read data from.
  * @param timeout_ms The timeout value in milliseconds for the read operation.
@@ -200,6 +201,10 @@ OPERATE_RET tuya_tls_transporter_poll_read(tuya_transporter_t t, int timeout_ms)
 
     tuya_tls_transporter_t tls_transporter = (tuya_tls_transporter_t)t;
 
+    if (tuya_tls_read_pending(tls_transporter->tls_handler) > 0) {
+        return 1;
+    }
+
     return tuya_transporter_poll_read(tls_transporter->tcp_transporter, timeout_ms);
 }
 
@@ -0,0 +1,85 @@
+/**
+ * @file ut_tuya_iot_dp.cpp
+ * @brief Unit tests of the object DP report coalescing window.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <mockcpp/mockcpp.hpp>
+#include <string.h>
+
+#include "tuya_iot.h"
+#include "tuya_iot_dp.h"
+#include "dp_schema.h"
+#include "tuya_lan.h"
+
+extern "C" {
+#include "tal_workq_service.h"
+}
+
+#define UT_DEVID       "ut_coalesce_dev"
+#define UT_SCHEMA_JSON "[{\"id\":1,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"bool\"}}]"
+
+class DpCoalesceTest : public ::testing::Test {
+  protected:
+    tuya_iot_client_t client;
+    dp_schema_t *schema = NULL;
+    DELAYED_WORK_HANDLE work = (DELAYED_WORK_HANDLE)&work;
+
+    void SetUp() override
+    {
+        memset(&client, 0, sizeof(client));
+        client.is_activated = true;
+        strcpy(client.activate.devid, UT_DEVID);
+        ASSERT_EQ(OPRT_OK, dp_schema_create((char *)UT_DEVID, (char *)UT_SCHEMA_JSON, &schema));
+
+        MOCKER(tuya_lan_get_connect_client_num).stubs().will(returnValue(0));
+        MOCKER(tuya_iot_is_connected).stubs().will(returnValue(true));
+        MOCKER(tal_workq_init_delayed)
+            .stubs()
+            .with(any(), any(), any(), outBoundP(&work))
+            .will(returnValue(OPRT_OK));
+        MOCKER(tal_workq_cancel_delayed).stubs().will(returnValue(OPRT_OK));
+    }
+
+    void TearDown() override
+    {
+        tuya_iot_dp_coalesce_clear();
+        dp_schema_delete((char *)UT_DEVID);
+        GlobalMockObject::verify();
+        GlobalMockObject::reset();
+    }
+};
+
+// a flush whose values all equal the reported ones has nothing to send and
+// must not be kept for a retry
+TEST_F(DpCoalesceTest, UnchangedFlushIsDropped)
+{
+    tuya_iot_dp_coalesce_stat_t stat;
+    dp_obj_t dp;
+
+    // the cloud already holds false
+    dp_pv_stat_set(schema, 1, PV_STAT_CLOUD);
+
+    MOCKER(tuya_mqtt_protocol_data_publish_common).expects(never());
+    // a retry would start the window work again
+    MOCKER(tal_workq_start_delayed).expects(never());
+
+    ASSERT_EQ(OPRT_OK, tuya_iot_dp_coalesce_set(&client, 1000));
+
+    memset(&dp, 0, sizeof(dp));
+    dp.id = 1;
+    dp.type = PROP_BOOL;
+    dp.value.dp_bool = false;
+    // the first report after a quiet window flushes at once
+    EXPECT_EQ(OPRT_OK, tuya_iot_dp_obj_report(&client, UT_DEVID, &dp, 1, 0));
+
+    ASSERT_EQ(OPRT_OK, tuya_iot_dp_coalesce_stat_get(1, &stat));
+    EXPECT_EQ(1u, stat.queued);
+    EXPECT_EQ(1u, stat.flushed);
+
+    // nothing is pending, so disabling has nothing left to drop
+    EXPECT_EQ(OPRT_OK, tuya_iot_dp_coalesce_set(&client, 0));
+}
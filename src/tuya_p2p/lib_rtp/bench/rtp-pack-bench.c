@@ -0,0 +1,204 @@
+// RTP packetizer micro benchmark
+//
+// Packetizes synthetic 1080p H.264 GOPs the way the P2P stream sender does, once
+// with an encoder created and destroyed per frame plus a malloc'ed packet that is
+// copied behind the extension head (the old sender), and once with one encoder per
+// stream that serializes every packet straight into the channel send buffer.
+// The send itself is a sink that only touches the packet, so the numbers show the
+// packetizer cost alone.
+//
+// Host build, from lib_rtp:
+//   cc -O2 -Iinclude -Ipayload bench/rtp-pack-bench.c payload/*.c src/*.c rtpext/*.c -o rtp-pack-bench
+//   ./rtp-pack-bench
+
+#include "rtp-payload.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SEND_BUF  (1100 + 128) // P2P_RTP_PACK_LEN
+#define BENCH_EXT_HEAD  44           // fixed av head + video ext + rtp length
+#define BENCH_SECONDS   2.0
+#define BENCH_FPS       25
+
+struct bench_mix_t {
+    const char *name;
+    int gop;     // frames per GOP, the first one is an I frame
+    int i_bytes; // IDR slice size
+    int p_bytes; // P slice size
+};
+
+// 1080p at roughly 2/4/8 Mbps with common GOP lengths, plus an all I stream
+static const struct bench_mix_t s_mix[] = {
+    {"1080p 2M gop50", 50, 90 * 1024, 7 * 1024},
+    {"1080p 4M gop25", 25, 150 * 1024, 14 * 1024},
+    {"1080p 8M gop25", 25, 250 * 1024, 30 * 1024},
+    {"1080p I only", 1, 150 * 1024, 0},
+};
+
+struct bench_sink_t {
+    uint8_t buf[BENCH_SEND_BUF]; // channel send buffer
+    uint8_t head[BENCH_EXT_HEAD];
+    int fix_len;
+    uint64_t packets;
+    uint64_t bytes;
+    uint32_t check;
+};
+
+static int bench_send(struct bench_sink_t *sink, const uint8_t *data, int bytes)
+{
+    sink->packets++;
+    sink->bytes += bytes;
+    sink->check += data[0] + data[bytes - 1];
+    return 0;
+}
+
+// old sender, a heap packet per RTP packet copied behind the ext head
+static void *old_alloc(void *param, int bytes)
+{
+    void *p = malloc(bytes);
+    if (p)
+        memset(p, 0, bytes);
+    return p;
+}
+
+static void old_free(void *param, void *packet)
+{
+    free(packet);
+}
+
+static int old_packet(void *param, const void *packet, int bytes, uint32_t timestamp, int flags)
+{
+    struct bench_sink_t *sink = (struct bench_sink_t *)param;
+    memcpy(sink->buf, sink->head, sink->fix_len);
+    *(int *)&sink->buf[sink->fix_len - 4] = bytes;
+    memcpy(sink->buf + sink->fix_len, packet, bytes);
+    return bench_send(sink, sink->buf, bytes + sink->fix_len);
+}
+
+// persistent sender, packets are serialized in place behind the ext head
+static void *new_alloc(void *param, int bytes)
+{
+    struct bench_sink_t *sink = (struct bench_sink_t *)param;
+    return bytes <= BENCH_SEND_BUF - sink->fix_len ? sink->buf + sink->fix_len : NULL;
+}
+
+static void new_free(void *param, void *packet)
+{
+}
+
+static int new_packet(void *param, const void *packet, int bytes, uint32_t timestamp, int flags)
+{
+    struct bench_sink_t *sink = (struct bench_sink_t *)param;
+    *(int *)&sink->buf[sink->fix_len - 4] = bytes;
+    return bench_send(sink, sink->buf, bytes + sink->fix_len);
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_nalu(uint8_t *p, uint8_t type, int bytes)
+{
+    int i;
+    p[0] = 0;
+    p[1] = 0;
+    p[2] = 0;
+    p[3] = 1;
+    p[4] = type;
+    // never 0, so no start code shows up inside the payload
+    for (i = 1; i < bytes; i++)
+        p[4 + i] = (uint8_t)(1 + (i * 131) % 255);
+    return 4 + bytes;
+}
+
+// sps + pps + idr, or a single p slice
+static int bench_frame(uint8_t *p, int key, int bytes)
+{
+    int n = 0;
+    if (key) {
+        n += bench_nalu(p + n, 0x67, 24);
+        n += bench_nalu(p + n, 0x68, 5);
+        n += bench_nalu(p + n, 0x65, bytes);
+    } else {
+        n += bench_nalu(p + n, 0x41, bytes);
+    }
+    return n;
+}
+
+static void bench_head(struct bench_sink_t *sink, int key, uint32_t timestamp)
+{
+    memset(sink->head, 0, sizeof(sink->head));
+    memcpy(sink->head + 8, &timestamp, sizeof(timestamp));
+    sink->fix_len = key ? BENCH_EXT_HEAD : BENCH_EXT_HEAD - 8;
+}
+
+static void bench_run(const struct bench_mix_t *mix, uint8_t *iframe, int ilen, uint8_t *pframe, int plen, int persistent)
+{
+    struct rtp_payload_t old_handler = {old_alloc, old_free, old_packet};
+    struct rtp_payload_t new_handler = {new_alloc, new_free, new_packet};
+    struct bench_sink_t sink;
+    void *encoder = NULL;
+    uint16_t seq = 0;
+    uint32_t timestamp = 0;
+    uint64_t frames = 0;
+    double start, elapsed;
+    int n, key;
+
+    memset(&sink, 0, sizeof(sink));
+    if (persistent)
+        encoder = rtp_payload_encode_create(96, "H264", seq, 10, &new_handler, &sink);
+
+    start = bench_now();
+    do {
+        // check the clock once per GOP
+        for (n = 0; n < mix->gop; n++, frames++) {
+            key = (0 == n);
+            timestamp += 90000 / BENCH_FPS;
+            bench_head(&sink, key, timestamp);
+            if (persistent) {
+                memcpy(sink.buf, sink.head, sink.fix_len);
+                rtp_payload_encode_input(encoder, key ? iframe : pframe, key ? ilen : plen, timestamp);
+            } else {
+                encoder = rtp_payload_encode_create(96, "H264", seq, 10, &old_handler, &sink);
+                rtp_payload_encode_input(encoder, key ? iframe : pframe, key ? ilen : plen, timestamp);
+                rtp_payload_encode_getinfo(encoder, &seq, &timestamp);
+                rtp_payload_encode_destroy(encoder);
+            }
+        }
+        elapsed = bench_now() - start;
+    } while (elapsed < BENCH_SECONDS);
+
+    if (persistent)
+        rtp_payload_encode_destroy(encoder);
+
+    printf("%-16s %-10s %9.0f pkt/s %8.0f frame/s %8.1f MB/s (check %u)\n", mix->name,
+           persistent ? "persistent" : "per-frame", sink.packets / elapsed, frames / elapsed,
+           sink.bytes / elapsed / (1024.0 * 1024.0), sink.check);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t i;
+    uint8_t *iframe = malloc(512 * 1024);
+    uint8_t *pframe = malloc(64 * 1024);
+    if (!iframe || !pframe)
+        return -1;
+
+    printf("rtp packet size %d, send buffer %d, ext head %d\n", rtp_packet_getsize(), BENCH_SEND_BUF, BENCH_EXT_HEAD);
+    for (i = 0; i < sizeof(s_mix) / sizeof(s_mix[0]); i++) {
+        int ilen = bench_frame(iframe, 1, s_mix[i].i_bytes);
+        int plen = s_mix[i].p_bytes ? bench_frame(pframe, 0, s_mix[i].p_bytes) : 0;
+        bench_run(&s_mix[i], iframe, ilen, pframe, plen, 0);
+        bench_run(&s_mix[i], iframe, ilen, pframe, plen, 1);
+    }
+
+    free(iframe);
+    free(pframe);
+    return 0;
+}
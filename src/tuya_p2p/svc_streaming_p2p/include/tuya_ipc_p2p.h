@@ -75,6 +75,30 @@ OPERATE_RET p2p_rtc_listen_stop();
 // OPERATE_RET tuya_ipc_init_trans_av_info(TRANS_IPC_AV_INFO_T *av_info);
 OPERATE_RET tuya_p2p_rtc_register_get_video_frame_cb(tuya_p2p_rtc_get_frame_cb_t pCallback);
 OPERATE_RET tuya_p2p_rtc_register_get_audio_frame_cb(tuya_p2p_rtc_get_frame_cb_t pCallback);
+
+/**
+ * @brief hand an encoded video frame to the live stream
+ *
+ * The frame is copied into a bounded queue and sent by the media send thread in pts
+ * order with audio. When the queue is full pending frames are dropped and the stream
+ * resumes on the next I frame.
+ *
+ * @param[in] pMediaFrame encoded frame, pts 0 falls back to timestamp
+ *
+ * @return OPRT_OK when queued, OPRT_RESOURCE_NOT_READY when nobody plays video or the frame was dropped
+ */
+OPERATE_RET tuya_p2p_rtc_push_video_frame(IN CONST MEDIA_FRAME *pMediaFrame);
+
+/**
+ * @brief hand an encoded audio frame to the live stream
+ *
+ * Same as tuya_p2p_rtc_push_video_frame, a full queue drops its oldest frame.
+ *
+ * @param[in] pMediaFrame encoded frame, pts 0 falls back to timestamp
+ *
+ * @return OPRT_OK when queued, OPRT_RESOURCE_NOT_READY when nobody plays audio
+ */
+OPERATE_RET tuya_p2p_rtc_push_audio_frame(IN CONST MEDIA_FRAME *pMediaFrame);
 INT_T OnGetVideoFrameCallback(MEDIA_FRAME *pMediaFrame);
 INT_T OnGetAudioFrameCallback(MEDIA_FRAME *pMediaFrame);
 
@@ -10,6 +10,7 @@
 #include "tal_system.h"
 #include "tal_memory.h"
 #include "tal_thread.h"
+#include "tal_semaphore.h"
 #include "tuya_ipc_p2p.h"
 #include "tuya_ipc_p2p_error.h"
 #include "tuya_ipc_p2p_inner.h"
@@ -72,14 +73,30 @@ typedef struct P2P_CMD_PARSE_ {
 #define STACK_SIZE_P2P_CMD_RECV   65536
 #define STACK_SIZE_P2P_DETECT     65536
 #define STACK_SIZE_P2P_LISTEN     131072
+#define STACK_SIZE_P2P_MEDIA_PULL 16384
 
+#define P2P_VIDEO_QUEUE_DEPTH (4)
+#define P2P_AUDIO_QUEUE_DEPTH (8)
+#define P2P_VIDEO_FRAME_MAX   (300 * 1024)
+#define P2P_AUDIO_FRAME_MAX   (1280)
+#define P2P_FRAME_BUF_ALIGN   (4096)
+#define P2P_MEDIA_WAIT_MS     (1000) // Only bounds how long a thread takes to notice it is stopped
+#define P2P_PULL_RETRY_MS     (10)   // Pull callbacks cannot tell when the next frame is ready
+
+#define P2P_MAX_VIEWER (4) // Viewers sharing one encoded stream
+
+// RTP packetizer of one stream, kept across frames and only used by the media send thread
 typedef struct {
-    INT_T client;
+    VOID *encoder;      // rtp_payload encoder, recreated when the payload type or the session changes
+    INT_T payload;      // RTP payload type of encoder
+    UINT_T gen;         // Session generation of encoder
     INT_T channel;
-    CHAR_T *p_rtp_buff;                         // RTP data buffer, reference size MTU+100
-    INT_T fix_len;                              // Supplementary private header data
-    CHAR_T ext_head_buff[P2P_EXT_HEAD_MAX_LEN]; // According to extended video header protocol head+ext(8)+rtp_len
-} RTP_PACK_NAL_ARG_T;
+    CHAR_T *p_rtp_buff; // Channel send buffer, RTP packets are serialized right after the ext head
+    INT_T fix_len;      // Ext head length, the last 4 bytes carry the RTP packet length
+    INT_T fan[P2P_MAX_VIEWER]; // Viewers taking the current frame
+    INT_T fan_cnt;
+    INT_T head_owner; // Viewer whose ext head is in front of p_rtp_buff, -1 for none
+} P2P_RTP_STREAM_T;
 
 typedef enum {
     P2P_IDLE = 0,
@@ -99,27 +116,56 @@ typedef struct {
 } P2P_DATA_PARSE_T;
 
 typedef struct {
-    MUTEX_HANDLE cmutex;
-    TUYA_IPC_P2P_AUTH_T str_P2p_auth;
-    /*******client*******/
+    MEDIA_FRAME frame; // frame.data points to a slot owned buffer of cap bytes
+    UINT_T cap;
+} P2P_FRAME_SLOT_T;
+
+// Bounded frame queue between the encoder and the media send thread
+typedef struct {
+    P2P_FRAME_SLOT_T *slot;
+    UINT_T depth;
+    UINT_T head;
+    UINT_T count;
+    UINT_T max_size;  // Largest frame accepted
+    BOOL_T is_video;  // Video drops whole GOPs, audio drops the oldest frame
+    BOOL_T sending;   // Head frame is being sent, the producer must not touch it
+    BOOL_T wait_key;  // Video only, frames are dropped until the next I frame
+    UINT_T drop_cnt;
+} P2P_FRAME_QUEUE_T;
+
+// One viewer, all viewers share the encoded frames and their RTP packets
+typedef struct {
+    INT_T index;   // Slot in the session table, passed as client to the send helpers
     INT_T session; // Save session number
     INT_T status;  // Session status  0 not started
-    /*******p2p server*******/
     P2P_CMD_E cmd; // Signal status information
     P2P_CMD_PARSE_T pb_resp_head;
+    INT_T video_req_id;                              // Video request ID, used for preview, playback and other services
+    INT_T audio_req_id;                              // Audio request ID
+    TRANSFER_VIDEO_CLARITY_TYPE_INNER_E cur_clarity; // Current video clarity type
+    P2P_DATA_PARSE_T proto_parse;
+    CHAR_T ext_head[P2P_EXT_HEAD_MAX_LEN]; // Ext head of the frame being fanned out
+    BOOL_T wait_key;                       // Video resumes on the next I frame, set on start and on congestion
+    UINT_T video_sent;                     // Send cursor, frames taken by this viewer
+    UINT_T video_drop;                     // Frames skipped while the send buffer was full or waiting for an I frame
+    UINT_T audio_sent;
+    UINT_T audio_drop;
+} P2P_SESSION_T;
+
+typedef struct {
+    MUTEX_HANDLE cmutex; // Protects the session table
+    TUYA_IPC_P2P_AUTH_T str_P2p_auth;
+    INT_T max_viewer;
+    P2P_SESSION_T viewer[P2P_MAX_VIEWER];
     CHAR_T *p_video_rtp_buff; // Video RTP data buffer, reference size MTU+100
     CHAR_T *p_audio_rtp_buff; // Audio RTP data buffer, reference size MTU+100
     USHORT_T video_seq_num;   // Video RTP packet sequence number
     USHORT_T audio_seq_num;   // Audio RTP packet sequence number
     BOOL_T key_frame;
-    UINT64_T v_pts;                                  // Video PTS
-    UINT64_T v_timestamp;                            // Video absolute time (ms)
-    UINT64_T a_pts;                                  // Audio PTS
-    UINT64_T a_timestamp;                            // Audio absolute time (ms)
-    INT_T video_req_id;                              // Video request ID, used for preview, playback and other services
-    INT_T audio_req_id;                              // Audio request ID
-    TRANSFER_VIDEO_CLARITY_TYPE_INNER_E cur_clarity; // Current video clarity type
-    P2P_DATA_PARSE_T proto_parse;
+    UINT64_T v_pts;              // Video PTS
+    UINT64_T v_timestamp;        // Video absolute time (ms)
+    UINT64_T a_pts;              // Audio PTS
+    UINT64_T a_timestamp;        // Audio absolute time (ms)
     TRANS_IPC_AV_INFO_T av_Info; // TODO currently video parameters must be consistent
 
     tuya_p2p_rtc_disconnect_cb_t on_disconnect_callback;
@@ -127,14 +173,22 @@ typedef struct {
     tuya_p2p_rtc_get_frame_cb_t on_get_audio_frame_callback;
     THREAD_HANDLE cmd_recv_proc_thread;   // Command receive thread handle
     THREAD_HANDLE video_send_proc_thread; // Video send thread handle
+    THREAD_HANDLE media_pull_proc_thread; // Pull callback adapter thread handle
+    MUTEX_HANDLE qmutex;                  // Protects video_q and audio_q
+    SEM_HANDLE frame_sem;                 // Posted once per queued frame
+    SEM_HANDLE pull_sem;                  // Posted when a stream starts
+    P2P_FRAME_QUEUE_T video_q;
+    P2P_FRAME_QUEUE_T audio_q;
+    P2P_RTP_STREAM_T video_rtp;
+    P2P_RTP_STREAM_T audio_rtp;
+    UINT_T rtp_gen; // Bumped when the last viewer leaves, packetizers restart their sequence numbers
     // TAL_VENC_FRAME_T tal_video_frame;
     // TAL_AUDIO_FRAME_INFO_T tal_audio_frame;
     MEDIA_FRAME media_frame;
     MEDIA_FRAME media_audio_frame;
-    /******* p2p server*******/
-} P2P_SESSION_T;
+} P2P_CTL_T;
 
-STATIC P2P_SESSION_T *sg_p2p_session = NULL;
+STATIC P2P_CTL_T *sg_p2p_ctl = NULL;
 INT_T g_listen_start = 0;               // Flag variable to control listen thread start or stop
 THREAD_HANDLE g_listen_thrd_hdl = NULL; // Listen thread handle
 
@@ -142,19 +196,17 @@ OPERATE_RET p2p_deal_with_listen(INT_T session);
 OPERATE_RET p2p_get_userinfo(INT_T session, INT_T p2pType);
 IPC_STREAM_TYPE p2p_get_chn_idx(TRANSFER_VIDEO_CLARITY_TYPE_INNER_E cur_clarity);
 TRANSFER_VIDEO_CLARITY_TYPE p2p_clarity_trans(TRANSFER_VIDEO_CLARITY_TYPE_INNER_E type);
-INT_T p2p_prepare_video_send_resource(P2P_SESSION_T *pSession);
-INT_T p2p_release_video_send_resource(P2P_SESSION_T *pSession);
-INT_T p2p_prepare_audio_send_resource(P2P_SESSION_T *pSession);
-INT_T p2p_release_audio_send_resource(P2P_SESSION_T *pSession);
+INT_T p2p_prepare_video_send_resource(P2P_CTL_T *pCtl);
+INT_T p2p_release_video_send_resource(P2P_CTL_T *pCtl);
+INT_T p2p_prepare_audio_send_resource(P2P_CTL_T *pCtl);
+INT_T p2p_release_audio_send_resource(P2P_CTL_T *pCtl);
 INT_T __p2p_session_clear(P2P_SESSION_T *pSession);
 INT_T __p2p_session_all_stop(P2P_SESSION_T *pSession);
 INT_T __p2p_session_release_va(P2P_SESSION_T *pSession);
 VOID __p2p_thread_exit(THREAD_HANDLE thread);
+STATIC OPERATE_RET __p2p_media_pull_start(VOID);
 VOID __p2p_rtc_close(INT_T rtc_session, INT_T reason, P2P_SESSION_T* p2p_session);
 
-void *rtp_alloc(void *param, int bytes);
-void rtp_free(void *param, void *packet);
-int rtp_pack_packet_handler(void *param, const void *packet, int bytes, uint32_t timestamp, int flags);
 
 void ctx_listen_thread_func(void *arg)
 {
@@ -206,25 +258,39 @@ OPERATE_RET p2p_rtc_listen_stop()
 
 P2P_SESSION_T *p2p_get_idle_session(INT_T *index)
 {
-    INT_T status = -1;
+    P2P_SESSION_T *pSession = NULL;
     INT_T i;
-    if (sg_p2p_session == NULL)
+    if (sg_p2p_ctl == NULL)
         return NULL;
     PR_DEBUG("p2p_get_idle_session begin\n");
-    status = sg_p2p_session->status;
-    if (P2P_SESSION_IDLE == status) {
-        *index = i;
-        sg_p2p_session->status = P2P_SESSION_INITING;
-        return sg_p2p_session;
+    tal_mutex_lock(sg_p2p_ctl->cmutex);
+    for (i = 0; i < sg_p2p_ctl->max_viewer; i++) {
+        if (P2P_SESSION_IDLE == sg_p2p_ctl->viewer[i].status) {
+            *index = i;
+            pSession = &sg_p2p_ctl->viewer[i];
+            pSession->status = P2P_SESSION_INITING;
+            break;
+        }
     }
+    tal_mutex_unlock(sg_p2p_ctl->cmutex);
     PR_DEBUG("p2p_get_idle_session end\n");
-    return NULL;
+    return pSession;
 }
 
 OPERATE_RET p2p_deal_with_listen(INT_T session)
 {
     OPERATE_RET ret = OPRT_OK;
     BOOL_T userCheckEnable = FALSE;
+    P2P_SESSION_T *pSession = NULL;
+    INT_T index = 0;
+
+    // Take a viewer slot first, a full table refuses the session before reading user information
+    pSession = p2p_get_idle_session(&index);
+    if (NULL == pSession) {
+        PR_ERR("no idle viewer for session[%d], max[%d]", session, sg_p2p_ctl ? sg_p2p_ctl->max_viewer : 0);
+        __p2p_rtc_close(session, RTC_CLOSE_REASON_SESSION_FULL, NULL);
+        return OPRT_COM_ERROR;
+    }
 
     // First verify user information, close corresponding session if not qualified
     if (OPRT_OK != p2p_get_userinfo(session, 1)) {
@@ -234,10 +300,11 @@ OPERATE_RET p2p_deal_with_listen(INT_T session)
         if (FALSE == userCheckEnable) {
             PR_ERR("resend p2p passwd to service");
             // Resend passwd once
-            if (OPRT_OK == tuya_ipc_p2p_update_pw(sg_p2p_session->str_P2p_auth.p2p_passwd)) {
+            if (OPRT_OK == tuya_ipc_p2p_update_pw(sg_p2p_ctl->str_P2p_auth.p2p_passwd)) {
                 userCheckEnable = TRUE;
             }
         }
+        pSession->status = P2P_SESSION_IDLE;
         __p2p_rtc_close(session, RTC_CLOSE_REASON_AUTH_FAIL, NULL);
         tuya_p2p_rtc_notify_exit();
         tuya_p2p_rtc_deinit();
@@ -247,19 +314,33 @@ OPERATE_RET p2p_deal_with_listen(INT_T session)
         userCheckEnable = TRUE;
     }
 
-    // Request session-related resources
-    if (OPRT_OK != (ret = p2p_prepare_video_send_resource(sg_p2p_session))) {
+    // Request shared send resources, they are kept until deinit
+    if (OPRT_OK != (ret = p2p_prepare_video_send_resource(sg_p2p_ctl))) {
         goto RET;
     }
-    if (OPRT_OK != (ret = p2p_prepare_audio_send_resource(sg_p2p_session))) {
+    if (OPRT_OK != (ret = p2p_prepare_audio_send_resource(sg_p2p_ctl))) {
         goto RET;
     }
 
     // Save connection information
-    sg_p2p_session->session = session;
-    sg_p2p_session->status = P2P_SESSION_RUNNING;
+    pSession->cmd = P2P_IDLE;
+    pSession->wait_key = TRUE;
+    pSession->video_sent = 0;
+    pSession->video_drop = 0;
+    pSession->audio_sent = 0;
+    pSession->audio_drop = 0;
+    memset(&pSession->proto_parse, 0x00, sizeof(P2P_DATA_PARSE_T));
+    pSession->proto_parse.read_size = P2P_CMD_HEAD_LEN;
+    pSession->proto_parse.flag = READ_HEADER_PART;
+    pSession->session = session;
+    pSession->status = P2P_SESSION_RUNNING;
+    PR_DEBUG("session[%d] takes viewer[%d]", session, index);
 
 RET:
+    if (OPRT_OK != ret) {
+        pSession->status = P2P_SESSION_IDLE;
+        __p2p_rtc_close(session, RTC_CLOSE_REASON_SESSION_FULL, NULL);
+    }
     return ret;
 }
 
@@ -335,11 +416,11 @@ OPERATE_RET p2p_get_userinfo(INT_T session, INT_T p2pType)
     tal_md5_create_init(&md5);
     tal_md5_starts_ret(md5);
     unsigned char decrypt[16];
-    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_session->str_P2p_auth.p2p_passwd),
-                       strlen(sg_p2p_session->str_P2p_auth.p2p_passwd));
+    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_ctl->str_P2p_auth.p2p_passwd),
+                       strlen(sg_p2p_ctl->str_P2p_auth.p2p_passwd));
     tal_md5_update_ret(md5, (BYTE_T *)"||", 2);
-    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_session->str_P2p_auth.gw_local_key),
-                       strlen(sg_p2p_session->str_P2p_auth.gw_local_key));
+    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_ctl->str_P2p_auth.gw_local_key),
+                       strlen(sg_p2p_ctl->str_P2p_auth.gw_local_key));
     tal_md5_finish_ret(md5, decrypt);
     tal_md5_free(md5);
 
@@ -351,7 +432,7 @@ OPERATE_RET p2p_get_userinfo(INT_T session, INT_T p2pType)
     }
     sign[offset] = 0;
 
-    if (strcmp(strUserInfo.user, sg_p2p_session->str_P2p_auth.p2p_name) == 0 && strcmp(strUserInfo.passwd, sign) == 0) {
+    if (strcmp(strUserInfo.user, sg_p2p_ctl->str_P2p_auth.p2p_name) == 0 && strcmp(strUserInfo.passwd, sign) == 0) {
         PR_DEBUG("auth success");
         return OPRT_OK;
     }
@@ -359,8 +440,8 @@ OPERATE_RET p2p_get_userinfo(INT_T session, INT_T p2pType)
     CHAR_T lk_dm5[32 + 1] = {0};
     tal_md5_create_init(&md5);
     tal_md5_starts_ret(md5);
-    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_session->str_P2p_auth.gw_local_key),
-                       strlen(sg_p2p_session->str_P2p_auth.gw_local_key));
+    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_ctl->str_P2p_auth.gw_local_key),
+                       strlen(sg_p2p_ctl->str_P2p_auth.gw_local_key));
     tal_md5_finish_ret(md5, decrypt);
     tal_md5_free(md5);
     offset = 0;
@@ -430,99 +511,100 @@ TRANSFER_VIDEO_CLARITY_TYPE p2p_clarity_trans(TRANSFER_VIDEO_CLARITY_TYPE_INNER_
     return eVideoClarityHigh;
 }
 
-INT_T p2p_prepare_video_send_resource(P2P_SESSION_T *pSession)
+INT_T p2p_prepare_video_send_resource(P2P_CTL_T *pCtl)
 {
-    if (pSession == NULL) {
-        PR_DEBUG("session is NULL");
+    if (pCtl == NULL) {
+        PR_DEBUG("ctl is NULL");
         return OPRT_INVALID_PARM;
     }
 
-    if (NULL != pSession->p_video_rtp_buff) {
+    if (NULL != pCtl->p_video_rtp_buff) {
         return OPRT_OK;
     }
 
-    pSession->p_video_rtp_buff = (CHAR_T *)Malloc(P2P_RTP_PACK_LEN);
-    if (NULL == pSession->p_video_rtp_buff) {
-        PR_ERR("session:[%d] video rtp buffer malloc failed", pSession->session);
+    pCtl->p_video_rtp_buff = (CHAR_T *)Malloc(P2P_RTP_PACK_LEN);
+    if (NULL == pCtl->p_video_rtp_buff) {
+        PR_ERR("video rtp buffer malloc failed");
         return OPRT_MALLOC_FAILED;
     }
-    memset(pSession->p_video_rtp_buff, 0x00, P2P_RTP_PACK_LEN);
+    memset(pCtl->p_video_rtp_buff, 0x00, P2P_RTP_PACK_LEN);
 
-    PR_DEBUG("session:[%d] malloc video send buffer success", pSession->session);
+    PR_DEBUG("malloc video send buffer success");
     return OPRT_OK;
 }
 
-INT_T p2p_release_video_send_resource(P2P_SESSION_T *pSession)
+INT_T p2p_release_video_send_resource(P2P_CTL_T *pCtl)
 {
-    if (pSession == NULL) {
-        PR_DEBUG("session is NULL");
+    if (pCtl == NULL) {
+        PR_DEBUG("ctl is NULL");
         return OPRT_INVALID_PARM;
     }
 
-    if (NULL == pSession->p_video_rtp_buff) {
+    if (NULL == pCtl->p_video_rtp_buff) {
         return OPRT_OK;
     }
 
-    Free(pSession->p_video_rtp_buff);
-    pSession->p_video_rtp_buff = NULL;
+    Free(pCtl->p_video_rtp_buff);
+    pCtl->p_video_rtp_buff = NULL;
 
-    PR_DEBUG("session:[%d] release video send buffer success", pSession->session);
+    PR_DEBUG("release video send buffer success");
     return OPRT_OK;
 }
 
-INT_T p2p_prepare_audio_send_resource(P2P_SESSION_T *pSession)
+INT_T p2p_prepare_audio_send_resource(P2P_CTL_T *pCtl)
 {
-    if (pSession == NULL) {
-        PR_DEBUG("session is NULL");
+    if (pCtl == NULL) {
+        PR_DEBUG("ctl is NULL");
         return OPRT_INVALID_PARM;
     }
 
-    if (NULL != pSession->p_audio_rtp_buff) {
+    if (NULL != pCtl->p_audio_rtp_buff) {
         return OPRT_OK;
     }
 
-    pSession->p_audio_rtp_buff = (CHAR_T *)Malloc(P2P_RTP_PACK_LEN);
-    if (NULL == pSession->p_audio_rtp_buff) {
-        PR_ERR("session:[%d] audio rtp buffer malloc failed", pSession->session);
+    pCtl->p_audio_rtp_buff = (CHAR_T *)Malloc(P2P_RTP_PACK_LEN);
+    if (NULL == pCtl->p_audio_rtp_buff) {
+        PR_ERR("audio rtp buffer malloc failed");
         return OPRT_MALLOC_FAILED;
     }
-    memset(pSession->p_audio_rtp_buff, 0x00, P2P_RTP_PACK_LEN);
+    memset(pCtl->p_audio_rtp_buff, 0x00, P2P_RTP_PACK_LEN);
 
-    PR_DEBUG("session:[%d] malloc audio send buffer success", pSession->session);
+    PR_DEBUG("malloc audio send buffer success");
     return OPRT_OK;
 }
 
-INT_T p2p_release_audio_send_resource(P2P_SESSION_T *pSession)
+INT_T p2p_release_audio_send_resource(P2P_CTL_T *pCtl)
 {
-    if (pSession == NULL) {
-        PR_DEBUG("session is NULL");
+    if (pCtl == NULL) {
+        PR_DEBUG("ctl is NULL");
         return OPRT_INVALID_PARM;
     }
 
-    if (NULL == pSession->p_audio_rtp_buff) {
+    if (NULL == pCtl->p_audio_rtp_buff) {
         return OPRT_OK;
     }
 
-    Free(pSession->p_audio_rtp_buff);
-    pSession->p_audio_rtp_buff = NULL;
+    Free(pCtl->p_audio_rtp_buff);
+    pCtl->p_audio_rtp_buff = NULL;
 
-    PR_DEBUG("session:[%d] release audio send buffer success", pSession->session);
+    PR_DEBUG("release audio send buffer success");
     return OPRT_OK;
 }
 
 OPERATE_RET p2p_send_rtp_data(INT_T client, INT_T channel, CHAR_T *buff, INT_T length)
 {
-    if (channel < TUYA_VDATA_CHANNEL || channel > TUYA_ADATA_CHANNEL) {
+    if (channel < TUYA_VDATA_CHANNEL || channel > TUYA_ADATA_CHANNEL || client < 0 || client >= P2P_MAX_VIEWER) {
         PR_ERR("input errorclient[%d]channel[%d]", client, channel);
         return OPRT_INVALID_PARM;
     }
     INT_T ret = 0;
+    P2P_SESSION_T *pSession = &sg_p2p_ctl->viewer[client];
     // Send data
-    if ((0 == (P2P_VIDEO & sg_p2p_session->cmd)) && (0 == (P2P_PB_VIDEO & sg_p2p_session->cmd)) &&
-        (0 == (P2P_AUDIO & sg_p2p_session->cmd)) && (0 == (P2P_PB_AUDIO & sg_p2p_session->cmd))) {
+    if ((0 == (P2P_VIDEO & pSession->cmd)) && (0 == (P2P_PB_VIDEO & pSession->cmd)) &&
+        (0 == (P2P_AUDIO & pSession->cmd)) && (0 == (P2P_PB_AUDIO & pSession->cmd))) {
         return OPRT_OK;
     }
-    ret = tuya_p2p_rtc_send_data(sg_p2p_session->session, channel, buff, length, -1);
+    ret = tuya_p2p_rtc_send_data(pSession->session, channel, buff, length, -1);
     if (ret != length) {
         PR_ERR("Write data failed [%d][%d]", ret, length);
     }
@@ -546,37 +628,38 @@ STATIC VOID __p2p_ext_protocol_pack(INT_T client, INT_T type, CHAR_T *p_result,
     INT_T fix_len = 0; // 20180428 supplementary header data
     UINT64_T tmpTime;
     INT_T ipcChan = client;
-    IPC_STREAM_E curClirtyChn = p2p_get_chn_idx(sg_p2p_session->cur_clarity);
+    P2P_SESSION_T *pSession = &sg_p2p_ctl->viewer[client];
+    IPC_STREAM_E curClirtyChn = p2p_get_chn_idx(pSession->cur_clarity);
     C2C_AV_TRANS_FIXED_HEADER *pav_Info = (C2C_AV_TRANS_FIXED_HEADER *)p_result;
 
     if (0 == type) {
-        tmpTime = sg_p2p_session->v_timestamp;
-        pav_Info->request_id = sg_p2p_session->video_req_id;
-        if (TRUE == sg_p2p_session->key_frame) {
+        tmpTime = sg_p2p_ctl->v_timestamp;
+        pav_Info->request_id = pSession->video_req_id;
+        if (TRUE == sg_p2p_ctl->key_frame) {
             fix_len = sizeof(C2C_AV_TRANS_FIXED_HEADER) + EXT_PROTOCOL_V0_LEN;
             pav_Info->extension_length = 8;
             *(BYTE_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER)] = TY_EXT_VIDEO_PARAM;
             *(BYTE_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 1] = 0;
             *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 2] =
-                (SHORT_T)sg_p2p_session->av_Info.width[curClirtyChn];
+                (SHORT_T)sg_p2p_ctl->av_Info.width[curClirtyChn];
             *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 4] =
-                (SHORT_T)sg_p2p_session->av_Info.height[curClirtyChn];
+                (SHORT_T)sg_p2p_ctl->av_Info.height[curClirtyChn];
             *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 6] =
-                (SHORT_T)sg_p2p_session->av_Info.fps[curClirtyChn];
+                (SHORT_T)sg_p2p_ctl->av_Info.fps[curClirtyChn];
         } else {
             fix_len = sizeof(C2C_AV_TRANS_FIXED_HEADER) + 4;
             pav_Info->extension_length = 0;
         }
     } else {
-        tmpTime = sg_p2p_session->a_timestamp;
-        pav_Info->request_id = sg_p2p_session->audio_req_id;
+        tmpTime = sg_p2p_ctl->a_timestamp;
+        pav_Info->request_id = pSession->audio_req_id;
         fix_len = sizeof(C2C_AV_TRANS_FIXED_HEADER) + EXT_PROTOCOL_V0_LEN;
         pav_Info->extension_length = 8;
         *(BYTE_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER)] = TY_EXT_AUDIO_PARAM;
         *(BYTE_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 1] = 0;
-        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 2] = (SHORT_T)sg_p2p_session->av_Info.audio_sample;
-        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 4] = (SHORT_T)sg_p2p_session->av_Info.audio_channel;
-        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 6] = (SHORT_T)sg_p2p_session->av_Info.audio_databits;
+        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 2] = (SHORT_T)sg_p2p_ctl->av_Info.audio_sample;
+        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 4] = (SHORT_T)sg_p2p_ctl->av_Info.audio_channel;
+        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 6] = (SHORT_T)sg_p2p_ctl->av_Info.audio_databits;
     }
     pav_Info->time_ms = tmpTime;
     *p_result_len = fix_len;
@@ -589,9 +672,9 @@ STATIC OPERATE_RET __p2p_check_free_buffer_size(INT_T client, INT_T channel, INT
     OPERATE_RET ret = OPRT_OK;
     INT_T sendFreeSize = 0;
     INT_T writeSize = 0;
+    INT_T session = sg_p2p_ctl->viewer[client].session;
 
-    ret = tuya_p2p_rtc_check_buffer(sg_p2p_session->session, channel, (uint32_t *)&writeSize, NULL,
-                                    (uint32_t *)&sendFreeSize);
+    ret = tuya_p2p_rtc_check_buffer(session, channel, (uint32_t *)&writeSize, NULL, (uint32_t *)&sendFreeSize);
     if (OPRT_OK != ret) {
         return ret;
     }
@@ -602,7 +685,7 @@ STATIC OPERATE_RET __p2p_check_free_buffer_size(INT_T client, INT_T channel, INT
         STATIC INT_T retry_sum = 0; // Total retry count when buffer is full
         if (retry_sum % 100 == 0) {
             PR_ERR("Check_Buffer not enough writeSize[%d] sendFreeSize[%d] len[%d] session[%d] channel[%d]", writeSize,
-                   sendFreeSize, len, sg_p2p_session->session, channel);
+                   sendFreeSize, len, session, channel);
         }
         retry_sum++;
         ret = OPRT_RESOURCE_NOT_READY;
@@ -610,64 +693,153 @@ STATIC OPERATE_RET __p2p_check_free_buffer_size(INT_T client, INT_T channel, INT
     return ret;
 }
 
+STATIC void *__p2p_rtp_alloc(void *param, int bytes)
+{
+    P2P_RTP_STREAM_T *stream = (P2P_RTP_STREAM_T *)param;
+
+    // One packet is in flight at a time, it is serialized straight into the send buffer
+    if (bytes > P2P_RTP_PACK_LEN - stream->fix_len) {
+        PR_ERR("rtp packet too big[%d]", bytes);
+        return NULL;
+    }
+    return stream->p_rtp_buff + stream->fix_len;
+}
+
+STATIC void __p2p_rtp_free(void *param, void *packet)
+{
+    return;
+}
+
+STATIC int __p2p_rtp_packet(void *param, const void *packet, int bytes, uint32_t timestamp, int flags)
+{
+    P2P_RTP_STREAM_T *stream = (P2P_RTP_STREAM_T *)param;
+    INT_T i, client;
+
+    // Every viewer gets the same RTP packet, only the ext head in front of it differs
+    for (i = 0; i < stream->fan_cnt; i++) {
+        client = stream->fan[i];
+        if (stream->head_owner != client) {
+            memcpy(stream->p_rtp_buff, sg_p2p_ctl->viewer[client].ext_head, stream->fix_len);
+            stream->head_owner = client;
+        }
+        *(INT_T *)&stream->p_rtp_buff[stream->fix_len - 4] = bytes;
+        p2p_send_rtp_data(client, stream->channel, stream->p_rtp_buff, bytes + stream->fix_len);
+    }
+    return 0;
+}
+
 /***********************************************************
- *  Function: __p2p_pack_h265_rtp_and_send
- *  Note:IPC stream data assembly RTP and send
- *  Input: pData data header address, len data length, client channel number
- *  Output: none
+ *  Function: __p2p_rtp_stream_send
+ *  Note:Packetize one frame once with the persistent packetizer of its stream and
+ *       fan every RTP packet out to the viewers taking the stream. Viewers whose
+ *       send buffer is full skip the frame, video then resumes on the next I frame.
+ *  Input: stream packetizer, cmd stream flag, type 0/1 video/audio, payload/name RTP
+ *         payload type and name, ssrc RTP ssrc, pts frame pts, pData/len frame data
+ *  Output: seq last RTP sequence number
  *  Return:
  ***********************************************************/
-STATIC OPERATE_RET __p2p_pack_h265_rtp_and_send(INT_T client, CHAR_T *pData, INT_T len)
+STATIC OPERATE_RET __p2p_rtp_stream_send(P2P_RTP_STREAM_T *stream, P2P_CMD_E cmd, INT_T type, INT_T payload,
+                                         CONST CHAR_T *name, UINT_T ssrc, USHORT_T *seq, UINT64_T pts,
+                                         CHAR_T *pData, INT_T len)
 {
-    if (NULL == pData) {
-        PR_ERR("input error");
+    OPERATE_RET ret = OPRT_OK;
+    uint32_t timestamp = (UINT_T)pts;
+    CHAR_T *p_rtp_buff = (0 == type) ? sg_p2p_ctl->p_video_rtp_buff : sg_p2p_ctl->p_audio_rtp_buff;
+    INT_T channel = (0 == type) ? TUYA_VDATA_CHANNEL : TUYA_ADATA_CHANNEL;
+    P2P_SESSION_T *pSession = NULL;
+    INT_T i;
+
+    if (NULL == p_rtp_buff) {
+        PR_ERR("%s rtp buffer is NULL", (0 == type) ? "video" : "audio");
         return OPRT_INVALID_PARM;
     }
 
-    OPERATE_RET ret = __p2p_check_free_buffer_size(client, TUYA_VDATA_CHANNEL, len);
-    if (OPRT_OK != ret) {
-        return ret;
+    // The table only changes status under cmutex, a viewer leaving mid frame just stops taking packets
+    stream->fan_cnt = 0;
+    for (i = 0; i < sg_p2p_ctl->max_viewer; i++) {
+        pSession = &sg_p2p_ctl->viewer[i];
+        if (P2P_SESSION_RUNNING != pSession->status || 0 == (cmd & pSession->cmd)) {
+            continue;
+        }
+        if (0 == type && pSession->wait_key && !sg_p2p_ctl->key_frame) {
+            pSession->video_drop++;
+            continue;
+        }
+        if (OPRT_OK != __p2p_check_free_buffer_size(i, channel, len)) {
+            if (0 == type) {
+                pSession->video_drop++;
+                pSession->wait_key = TRUE;
+            } else {
+                pSession->audio_drop++;
+            }
+            continue;
+        }
+        if (0 == type) {
+            pSession->wait_key = FALSE;
+            pSession->video_sent++;
+        } else {
+            pSession->audio_sent++;
+        }
+        __p2p_ext_protocol_pack(i, type, pSession->ext_head, &stream->fix_len);
+        stream->fan[stream->fan_cnt++] = i;
+    }
+    if (0 == stream->fan_cnt) {
+        return OPRT_RESOURCE_NOT_READY;
     }
 
-    if (NULL == sg_p2p_session->p_video_rtp_buff) {
-        PR_ERR("video rtp buffer is NULL");
-        return OPRT_INVALID_PARM;
+    if (stream->encoder && (stream->payload != payload || stream->gen != sg_p2p_ctl->rtp_gen)) {
+        rtp_payload_encode_destroy(stream->encoder);
+        stream->encoder = NULL;
     }
+    if (NULL == stream->encoder) {
+        struct rtp_payload_t rtp_packer = {__p2p_rtp_alloc, __p2p_rtp_free, __p2p_rtp_packet};
+        stream->encoder = rtp_payload_encode_create(payload, name, *seq, ssrc, &rtp_packer, stream);
+        if (NULL == stream->encoder) {
+            PR_ERR("create %s rtp encoder failed", name);
+            return OPRT_COM_ERROR;
+        }
+        stream->payload = payload;
+        stream->gen = sg_p2p_ctl->rtp_gen;
+    }
+
+    stream->channel = channel;
+    stream->p_rtp_buff = p_rtp_buff;
+    stream->head_owner = -1;
 
-    RTP_PACK_NAL_ARG_T rtp_pack_nal_arg;
-    rtp_pack_nal_arg.client = client;
-    rtp_pack_nal_arg.channel = TUYA_VDATA_CHANNEL;
-    rtp_pack_nal_arg.p_rtp_buff = sg_p2p_session->p_video_rtp_buff;
-    memset(rtp_pack_nal_arg.ext_head_buff, 0, P2P_EXT_HEAD_MAX_LEN);
-    __p2p_ext_protocol_pack(client, 0, rtp_pack_nal_arg.ext_head_buff, &rtp_pack_nal_arg.fix_len);
-
-    void *pRtpDelegate = NULL;
-    struct rtp_payload_t rtp_packer;
-    rtp_packer.alloc = rtp_alloc;
-    rtp_packer.free = rtp_free;
-    rtp_packer.packet = rtp_pack_packet_handler;
-    uint16_t seq = sg_p2p_session->video_seq_num;
-    uint32_t ssrc = 10;
-    uint32_t timestamp = (UINT_T)sg_p2p_session->v_pts;
-    pRtpDelegate = rtp_payload_encode_create(/*H265_PAY_LOAD*/ 95, "H265", seq, ssrc, &rtp_packer, &rtp_pack_nal_arg);
-    ret = rtp_payload_encode_input(pRtpDelegate, pData, len, timestamp);
+    ret = rtp_payload_encode_input(stream->encoder, pData, len, timestamp);
     if (OPRT_OK != ret) {
-        PR_ERR("rtp_payload_encode_input h264 error:%d", ret);
+        PR_ERR("rtp_payload_encode_input %s error:%d", name, ret);
     }
-    rtp_payload_encode_getinfo(pRtpDelegate, &sg_p2p_session->video_seq_num, &timestamp);
-    rtp_payload_encode_destroy(pRtpDelegate);
-
+    rtp_payload_encode_getinfo(stream->encoder, seq, &timestamp);
     return ret;
 }
 
+/***********************************************************
+ *  Function: __p2p_pack_h265_rtp_and_send
+ *  Note:IPC stream data assembly RTP and send
+ *  Input: pData data header address, len data length
+ *  Output: none
+ *  Return:
+ ***********************************************************/
+STATIC OPERATE_RET __p2p_pack_h265_rtp_and_send(CHAR_T *pData, INT_T len)
+{
+    if (NULL == pData) {
+        PR_ERR("input error");
+        return OPRT_INVALID_PARM;
+    }
+
+    return __p2p_rtp_stream_send(&sg_p2p_ctl->video_rtp, P2P_VIDEO, 0, /*H265_PAY_LOAD*/ 95, "H265", 10,
+                                 &sg_p2p_ctl->video_seq_num, sg_p2p_ctl->v_pts, pData, len);
+}
+
 /***********************************************************
  *  Function: __p2p_pack_h264_rtp_and_send
  *  Note:IPC stream data assembly RTP and send
- *  Input: pData data header address, len data length, client channel number
+ *  Input: pData data header address, len data length
  *  Output: none
  *  Return:
  ***********************************************************/
-STATIC OPERATE_RET __p2p_pack_h264_rtp_and_send(INT_T client, CHAR_T *pData, INT_T len)
+STATIC OPERATE_RET __p2p_pack_h264_rtp_and_send(CHAR_T *pData, INT_T len)
 {
     if (NULL == pData) {
         PR_ERR("input error");
@@ -680,41 +852,8 @@ STATIC OPERATE_RET __p2p_pack_h264_rtp_and_send(INT_T client, CHAR_T *pData, INT
         return OPRT_INVALID_PARM;
     }
 
-    OPERATE_RET ret;
-    ret = __p2p_check_free_buffer_size(client, TUYA_VDATA_CHANNEL, len);
-    if (OPRT_OK != ret) {
-        return ret;
-    }
-
-    if (NULL == sg_p2p_session->p_video_rtp_buff) {
-        PR_ERR("video rtp buffer is NULL");
-        return OPRT_INVALID_PARM;
-    }
-
-    RTP_PACK_NAL_ARG_T rtp_pack_nal_arg;
-    rtp_pack_nal_arg.client = client;
-    rtp_pack_nal_arg.channel = TUYA_VDATA_CHANNEL;
-    rtp_pack_nal_arg.p_rtp_buff = sg_p2p_session->p_video_rtp_buff;
-    memset(rtp_pack_nal_arg.ext_head_buff, 0, P2P_EXT_HEAD_MAX_LEN);
-    __p2p_ext_protocol_pack(client, 0, rtp_pack_nal_arg.ext_head_buff, &rtp_pack_nal_arg.fix_len);
-
-    void *pRtpDelegate = NULL;
-    struct rtp_payload_t rtp_packer;
-    rtp_packer.alloc = rtp_alloc;
-    rtp_packer.free = rtp_free;
-    rtp_packer.packet = rtp_pack_packet_handler;
-    uint16_t seq = sg_p2p_session->video_seq_num;
-    uint32_t ssrc = 10;
-    uint32_t timestamp = (UINT_T)sg_p2p_session->v_pts;
-    pRtpDelegate = rtp_payload_encode_create(/*H264_PAY_LOAD*/ 96, "H264", seq, ssrc, &rtp_packer, &rtp_pack_nal_arg);
-    ret = rtp_payload_encode_input(pRtpDelegate, pData, len, timestamp);
-    if (OPRT_OK != ret) {
-        PR_ERR("rtp_payload_encode_input h264 error:%d", ret);
-    }
-    rtp_payload_encode_getinfo(pRtpDelegate, &sg_p2p_session->video_seq_num, &timestamp);
-    rtp_payload_encode_destroy(pRtpDelegate);
-
-    return ret;
+    return __p2p_rtp_stream_send(&sg_p2p_ctl->video_rtp, P2P_VIDEO, 0, /*H264_PAY_LOAD*/ 96, "H264", 10,
+                                 &sg_p2p_ctl->video_seq_num, sg_p2p_ctl->v_pts, pData, len);
 }
 
 /***********************************************************
@@ -743,7 +882,7 @@ STATIC OPERATE_RET __p2p_pack_h264_rtp_and_send(INT_T client, CHAR_T *pData, INT
 //         return ret;
 //     }
 
-//     if (NULL == sg_p2p_session->p_audio_rtp_buff) {
+//     if (NULL == sg_p2p_ctl->p_audio_rtp_buff) {
 //         PR_ERR("audio rtp buffer is NULL");
 //         return OPRT_INVALID_PARM;
 //     }
@@ -771,13 +910,13 @@ STATIC OPERATE_RET __p2p_pack_h264_rtp_and_send(INT_T client, CHAR_T *pData, INT
 //         if (strAdts.aac_frame_length - ADTS_HEADER_LENGTH < P2P_RTP_PACK_LEN) {
 //             if (OPRT_OK == tuya_ipc_pack_aac_rtp((BYTE_T * )(pData + i + ADTS_HEADER_LENGTH),
 //             strAdts.aac_frame_length - ADTS_HEADER_LENGTH,\
-//                 &audioRtpLen, sg_p2p_session->p_audio_rtp_buff + fix_len,client)) {
+//                 &audioRtpLen, sg_p2p_ctl->p_audio_rtp_buff + fix_len,client)) {
 
-//                 memcpy(sg_p2p_session->p_audio_rtp_buff, ext_head_buff, fix_len);
-//                 *(int *)&sg_p2p_session->p_audio_rtp_buff[fix_len - 4] = audioRtpLen;
+//                 memcpy(sg_p2p_ctl->p_audio_rtp_buff, ext_head_buff, fix_len);
+//                 *(int *)&sg_p2p_ctl->p_audio_rtp_buff[fix_len - 4] = audioRtpLen;
 //                 audioRtpLen += fix_len;
 
-//                 ret = __p2p_send_rtp_data(client, TUYA_ADATA_CHANNEL,sg_p2p_session->p_audio_rtp_buff,audioRtpLen);
+//                 ret = __p2p_send_rtp_data(client, TUYA_ADATA_CHANNEL,sg_p2p_ctl->p_audio_rtp_buff,audioRtpLen);
 //             }
 //         } else {
 //             PR_DEBUG("aac data too big [%d] [%d]",P2P_RTP_PACK_LEN,strAdts.aac_frame_length);
@@ -791,14 +930,14 @@ STATIC OPERATE_RET __p2p_pack_h264_rtp_and_send(INT_T client, CHAR_T *pData, INT
 /***********************************************************
  *  Function: __p2p_pack_g711_rtp_and_send
  *  Note:IPC audio data assembly RTP and send
- *  Input: pData data header address, len data length, client channel number, mode g711 mode
+ *  Input: pData data header address, len data length, mode g711 mode
  *  Output: none
  *  Return:
  ***********************************************************/
-STATIC OPERATE_RET __p2p_pack_g711_rtp_and_send(INT_T client, CHAR_T *pData, INT_T len, INT_T mode)
+STATIC OPERATE_RET __p2p_pack_g711_rtp_and_send(CHAR_T *pData, INT_T len, INT_T mode)
 {
     if (NULL == pData) {
-        PR_ERR("data[%p] client num [%d]", pData, client);
+        PR_ERR("data[%p] len [%d]", pData, len);
         return OPRT_INVALID_PARM;
     }
 
@@ -807,34 +946,8 @@ STATIC OPERATE_RET __p2p_pack_g711_rtp_and_send(INT_T client, CHAR_T *pData, INT
         return OPRT_INVALID_PARM;
     }
 
-    OPERATE_RET ret = OPRT_OK;
-    ret = __p2p_check_free_buffer_size(client, TUYA_ADATA_CHANNEL, len);
-    if (OPRT_OK != ret) {
-        return ret;
-    }
-
-    if (NULL == sg_p2p_session->p_audio_rtp_buff) {
-        PR_ERR("audio rtp buffer is NULL");
-        return OPRT_INVALID_PARM;
-    }
-
-    RTP_PACK_NAL_ARG_T rtp_pack_nal_arg;
-    rtp_pack_nal_arg.client = client;
-    rtp_pack_nal_arg.channel = TUYA_ADATA_CHANNEL;
-    rtp_pack_nal_arg.p_rtp_buff = sg_p2p_session->p_audio_rtp_buff;
-    memset(rtp_pack_nal_arg.ext_head_buff, 0, P2P_EXT_HEAD_MAX_LEN);
-    __p2p_ext_protocol_pack(client, 1, rtp_pack_nal_arg.ext_head_buff, &rtp_pack_nal_arg.fix_len);
-
-    void *pRtpDelegate = NULL;
-    struct rtp_payload_t rtp_packer;
-    rtp_packer.alloc = rtp_alloc;
-    rtp_packer.free = rtp_free;
-    rtp_packer.packet = rtp_pack_packet_handler;
-    uint16_t seq = sg_p2p_session->audio_seq_num;
-    uint32_t ssrc = 11;
-    uint32_t timestamp = (UINT_T)sg_p2p_session->a_pts;
-    int payload = 0;
-    char *codec_name = NULL;
+    INT_T payload = 0;
+    CHAR_T *codec_name = NULL;
     if (TY_AV_CODEC_AUDIO_G711U == mode) {
         codec_name = "PCMU";
         payload = 0 /*RTP_PCMU_PAYLOAD*/;
@@ -845,15 +958,8 @@ STATIC OPERATE_RET __p2p_pack_g711_rtp_and_send(INT_T client, CHAR_T *pData, INT
         codec_name = "PCM";
         payload = 99 /*RTP_PCM_PAYLOAD*/;
     }
-    pRtpDelegate = rtp_payload_encode_create(payload, codec_name, seq, ssrc, &rtp_packer, &rtp_pack_nal_arg);
-    ret = rtp_payload_encode_input(pRtpDelegate, pData, len, timestamp);
-    if (OPRT_OK != ret) {
-        PR_ERR("rtp_payload_encode_input h264 error:%d", ret);
-    }
-    rtp_payload_encode_getinfo(pRtpDelegate, &sg_p2p_session->audio_seq_num, &timestamp);
-    rtp_payload_encode_destroy(pRtpDelegate);
-
-    return ret;
+    return __p2p_rtp_stream_send(&sg_p2p_ctl->audio_rtp, P2P_AUDIO, 1, payload, codec_name, 11,
+                                 &sg_p2p_ctl->audio_seq_num, sg_p2p_ctl->a_pts, pData, len);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -870,20 +976,20 @@ OPERATE_RET tuya_ipc_p2p_set_limit_mode(BOOL_T islimit)
 
 OPERATE_RET tuya_ipc_init_trans_av_info(TRANS_IPC_AV_INFO_T *av_info)
 {
-    memcpy(&sg_p2p_session->av_Info, av_info, sizeof(TRANS_IPC_AV_INFO_T));
+    memcpy(&sg_p2p_ctl->av_Info, av_info, sizeof(TRANS_IPC_AV_INFO_T));
     return OPRT_OK;
 }
 
 OPERATE_RET tuya_p2p_rtc_register_get_video_frame_cb(tuya_p2p_rtc_get_frame_cb_t pCallback)
 {
-    sg_p2p_session->on_get_video_frame_callback = pCallback;
-    return OPRT_OK;
+    sg_p2p_ctl->on_get_video_frame_callback = pCallback;
+    return (NULL == pCallback) ? OPRT_OK : __p2p_media_pull_start();
 }
 
 OPERATE_RET tuya_p2p_rtc_register_get_audio_frame_cb(tuya_p2p_rtc_get_frame_cb_t pCallback)
 {
-    sg_p2p_session->on_get_audio_frame_callback = pCallback;
-    return OPRT_OK;
+    sg_p2p_ctl->on_get_audio_frame_callback = pCallback;
+    return (NULL == pCallback) ? OPRT_OK : __p2p_media_pull_start();
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -903,7 +1009,9 @@ STATIC INT_T __p2p_session_trans_video_start(P2P_SESSION_T *pSession)
     }
     // Wait for previous data transmission to end
     PR_DEBUG("session[%d]video video_start wait_concurr_idle", pSession->session);
+    pSession->wait_key = TRUE;
     pSession->cmd |= P2P_VIDEO;
+    tal_semaphore_post(sg_p2p_ctl->pull_sem);
     PR_DEBUG("session[%d] video start success", pSession->session);
     return OPRT_OK;
 }
@@ -942,6 +1050,7 @@ STATIC INT_T __p2p_session_trans_audio_start(P2P_SESSION_T *pSession)
 
     PR_DEBUG("session[%d] send audio start to dev", pSession->session);
     pSession->cmd |= P2P_AUDIO;
+    tal_semaphore_post(sg_p2p_ctl->pull_sem);
     PR_DEBUG("session:[%d] audio start success", pSession->session);
     return OPRT_OK;
 }
@@ -1294,36 +1403,33 @@ STATIC void __p2p_cmd_recv_proc(PVOID_T pArg)
 {
     P2P_SESSION_T *pSession = NULL;
     INT_T ret;
-
-    memset(&sg_p2p_session->proto_parse, 0x00, sizeof(sg_p2p_session->proto_parse));
-    sg_p2p_session->proto_parse.read_size = P2P_CMD_HEAD_LEN;
-    sg_p2p_session->proto_parse.flag = READ_HEADER_PART;
-    while (tal_thread_get_state(sg_p2p_session->cmd_recv_proc_thread) == THREAD_STATE_RUNNING) {
-        if (P2P_SESSION_IDLE == sg_p2p_session->status) {
-            tal_system_sleep(5);
-            continue;
+    INT_T i;
+    INT_T running;
+
+    while (tal_thread_get_state(sg_p2p_ctl->cmd_recv_proc_thread) == THREAD_STATE_RUNNING) {
+        // Viewers are polled in turn, each read waits at most P2P_RECV_TIMEOUT
+        running = 0;
+        for (i = 0; i < sg_p2p_ctl->max_viewer; i++) {
+            pSession = &sg_p2p_ctl->viewer[i];
+            tal_mutex_lock(sg_p2p_ctl->cmutex);
+            if (P2P_SESSION_RUNNING != pSession->status) {
+                tal_mutex_unlock(sg_p2p_ctl->cmutex);
+                continue;
+            }
+            tal_mutex_unlock(sg_p2p_ctl->cmutex);
+            running++;
+
+            ret = __p2p_read_cmd(pSession);
+            if (0 != ret) {
+                PR_ERR("session[%d] read cmd failed [%d]", pSession->session, ret);
+                __p2p_session_clear(pSession);
+                //__p2p_wait_concurr_idle(pSession, WAIT_ALL_BUF);
+                __p2p_session_release_va(pSession);
+                tuya_p2p_rtc_notify_exit();
+            }
         }
-        pSession = sg_p2p_session;
-        tal_mutex_lock(pSession->cmutex);
-        if (P2P_SESSION_CLOSING == pSession->status) {
-            tal_mutex_unlock(pSession->cmutex);
+        if (0 == running) {
             tal_system_sleep(5);
-            continue;
-        }
-        if (P2P_SESSION_RUNNING != pSession->status) {
-            tal_mutex_unlock(pSession->cmutex);
-            continue;
-        }
-        tal_mutex_unlock(pSession->cmutex);
-
-        ret = __p2p_read_cmd(pSession);
-        if (0 != ret) {
-            PR_ERR("session[%d] read cmd failed [%d]", pSession->session, ret);
-            __p2p_session_clear(pSession);
-            //__p2p_wait_concurr_idle(pSession, WAIT_ALL_BUF);
-            __p2p_session_release_va(pSession);
-            tuya_p2p_rtc_notify_exit();
-            printf("pSession->cmd: %d\n", sg_p2p_session->cmd);
         }
     }
 
@@ -1333,114 +1439,378 @@ STATIC void __p2p_cmd_recv_proc(PVOID_T pArg)
 }
 
 /***********************************************************
- *  Function: __p2p_video_send_proc
- *  Note:Video data transmission thread
- *  Input:
+ *  Function: __p2p_frame_queue_init
+ *  Note:Create a bounded frame queue, slot buffers grow on first use
+ *  Input:queue frame queue, depth slot count, max_size largest frame, is_video drop policy
  *  Output: none
  *  Return:
  ***********************************************************/
-STATIC void __p2p_media_send_proc(PVOID_T pArg)
+STATIC OPERATE_RET __p2p_frame_queue_init(P2P_FRAME_QUEUE_T *queue, UINT_T depth, UINT_T max_size, BOOL_T is_video)
 {
-    INT_T index = 0;
-    UINT_T runCnt = 0;
-    P2P_SESSION_T *pSession = NULL;
-    OPERATE_RET op_ret = -1;
-    TY_AV_CODEC_ID type;
-    type = sg_p2p_session->av_Info.audio_codec;
-    // type = TY_AV_CODEC_AUDIO_PCM;
+    memset(queue, 0, sizeof(P2P_FRAME_QUEUE_T));
+    queue->slot = (P2P_FRAME_SLOT_T *)Malloc(depth * sizeof(P2P_FRAME_SLOT_T));
+    if (NULL == queue->slot) {
+        PR_ERR("malloc frame queue failed");
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(queue->slot, 0, depth * sizeof(P2P_FRAME_SLOT_T));
+    queue->depth = depth;
+    queue->max_size = max_size;
+    queue->is_video = is_video;
+    return OPRT_OK;
+}
 
-    PR_DEBUG("into p2p video send");
+STATIC VOID __p2p_frame_queue_deinit(P2P_FRAME_QUEUE_T *queue)
+{
+    UINT_T i;
 
-    while (tal_thread_get_state(sg_p2p_session->video_send_proc_thread) == THREAD_STATE_RUNNING) {
-        if (runCnt % 2000 == 0) {
-            PR_DEBUG("media send proc alive [%d]", runCnt);
+    if (NULL == queue->slot) {
+        return;
+    }
+    for (i = 0; i < queue->depth; i++) {
+        if (queue->slot[i].frame.data) {
+            Free(queue->slot[i].frame.data);
         }
-        runCnt++;
+    }
+    Free(queue->slot);
+    memset(queue, 0, sizeof(P2P_FRAME_QUEUE_T));
+}
 
-        if (P2P_SESSION_IDLE == sg_p2p_session->status) {
-            tal_system_sleep(5);
-            continue;
-        }
+/***********************************************************
+ *  Function: __p2p_frame_queue_flush
+ *  Note:Drop every queued frame except the one being sent, called with qmutex held
+ *  Input:queue frame queue
+ *  Output: none
+ *  Return:
+ ***********************************************************/
+STATIC VOID __p2p_frame_queue_flush(P2P_FRAME_QUEUE_T *queue)
+{
+    UINT_T keep = (queue->sending && queue->count) ? 1 : 0;
 
-        pSession = sg_p2p_session;
-        tal_mutex_lock(pSession->cmutex);
-        INT_T status = pSession->status;
-        P2P_CMD_E cmd = pSession->cmd;
+    queue->drop_cnt += queue->count - keep;
+    queue->count = keep;
+}
 
-        if (P2P_SESSION_CLOSING == pSession->status) {
-            tal_mutex_unlock(pSession->cmutex);
-            tal_system_sleep(5);
-            continue;
+STATIC VOID __p2p_frame_queue_drop(P2P_FRAME_QUEUE_T *queue, CONST CHAR_T *reason)
+{
+    queue->drop_cnt++;
+    if (queue->drop_cnt % 100 == 1) {
+        PR_WARN("%s frame dropped, %s, total[%d]", queue->is_video ? "video" : "audio", reason, queue->drop_cnt);
+    }
+}
+
+/***********************************************************
+ *  Function: __p2p_frame_queue_push
+ *  Note:Copy a frame into the queue, called with qmutex held.
+ *       A full video queue is flushed and restarts on the next I frame, since a P frame
+ *       is useless without the frames before it. A full audio queue drops its oldest frame.
+ *  Input:queue frame queue, pMediaFrame frame from the encoder
+ *  Output: none
+ *  Return:OPRT_OK when queued
+ ***********************************************************/
+STATIC OPERATE_RET __p2p_frame_queue_push(P2P_FRAME_QUEUE_T *queue, CONST MEDIA_FRAME *pMediaFrame)
+{
+    P2P_FRAME_SLOT_T *pSlot = NULL;
+    BOOL_T key_frame = (eVideoIFrame == pMediaFrame->type);
+
+    if (pMediaFrame->size > queue->max_size) {
+        PR_ERR("frame len too big[%d]", pMediaFrame->size);
+        return OPRT_INVALID_PARM;
+    }
+
+    if (queue->is_video) {
+        if (queue->count == queue->depth) {
+            __p2p_frame_queue_flush(queue);
+            queue->wait_key = TRUE;
         }
-        if (P2P_SESSION_RUNNING != status) {
-            tal_mutex_unlock(pSession->cmutex);
-            continue;
+        if (queue->wait_key && !key_frame) {
+            __p2p_frame_queue_drop(queue, "wait for I frame");
+            return OPRT_RESOURCE_NOT_READY;
         }
+        queue->wait_key = FALSE;
+    } else if (queue->count == queue->depth) {
+        if (queue->sending) {
+            __p2p_frame_queue_drop(queue, "queue full");
+            return OPRT_RESOURCE_NOT_READY;
+        }
+        queue->head = (queue->head + 1) % queue->depth;
+        queue->count--;
+        __p2p_frame_queue_drop(queue, "queue full");
+    }
+    if (queue->count == queue->depth) {
+        // Only a single slot video queue still holds the frame being sent here
+        __p2p_frame_queue_drop(queue, "queue full");
+        return OPRT_RESOURCE_NOT_READY;
+    }
 
-        // The judgment when both are not opened should be placed at the end, otherwise it will appear: users close
-        // audio and video at the same time, but do not release resources This judgment cannot be omitted, otherwise
-        // thread idle running will occur
-        if (!(P2P_VIDEO & cmd) && !(P2P_AUDIO & cmd)) {
-            // pSession->p2p_buff_stat.live_video = P2P_BUFF_IDLE;
-            // pSession->p2p_buff_stat.live_audio = P2P_BUFF_IDLE;
-            tal_mutex_unlock(pSession->cmutex);
-            tal_system_sleep(5);
-            continue;
+    pSlot = &queue->slot[(queue->head + queue->count) % queue->depth];
+    if (pMediaFrame->size > pSlot->cap) {
+        UINT_T cap = (pMediaFrame->size + P2P_FRAME_BUF_ALIGN - 1) & ~(P2P_FRAME_BUF_ALIGN - 1);
+        if (pSlot->frame.data) {
+            Free(pSlot->frame.data);
         }
-        tal_mutex_unlock(pSession->cmutex);
+        pSlot->frame.data = (UCHAR_T *)Malloc(cap);
+        pSlot->cap = (NULL == pSlot->frame.data) ? 0 : cap;
+        if (NULL == pSlot->frame.data) {
+            PR_ERR("malloc frame buffer %d failed", cap);
+            return OPRT_MALLOC_FAILED;
+        }
+    }
+    memcpy(pSlot->frame.data, pMediaFrame->data, pMediaFrame->size);
+    pSlot->frame.size = pMediaFrame->size;
+    pSlot->frame.type = pMediaFrame->type;
+    pSlot->frame.timestamp = pMediaFrame->timestamp;
+    pSlot->frame.pts = (pMediaFrame->pts == 0) ? pMediaFrame->timestamp * 1000 : pMediaFrame->pts;
+    queue->count++;
+    return OPRT_OK;
+}
 
-        if (P2P_VIDEO & cmd) {
-            if (sg_p2p_session->on_get_video_frame_callback == NULL) {
-                tal_system_sleep(10);
-                continue;
+/***********************************************************
+ *  Function: __p2p_ctl_cmd
+ *  Note:Streams requested by any running viewer
+ *  Input:
+ *  Output: none
+ *  Return:union of the viewer cmds
+ ***********************************************************/
+STATIC P2P_CMD_E __p2p_ctl_cmd(VOID)
+{
+    P2P_CMD_E cmd = P2P_IDLE;
+    INT_T i;
+
+    tal_mutex_lock(sg_p2p_ctl->cmutex);
+    for (i = 0; i < sg_p2p_ctl->max_viewer; i++) {
+        if (P2P_SESSION_RUNNING == sg_p2p_ctl->viewer[i].status) {
+            cmd |= sg_p2p_ctl->viewer[i].cmd;
+        }
+    }
+    tal_mutex_unlock(sg_p2p_ctl->cmutex);
+    return cmd;
+}
+
+/***********************************************************
+ *  Function: __p2p_media_next_frame
+ *  Note:Pick the queued frame with the smallest pts, called with qmutex held.
+ *       Queues of streams that are not playing are flushed.
+ *  Input:pCtl p2p control, cmd viewer cmd snapshot
+ *  Output: ppQueue queue owning the frame
+ *  Return:frame to send, NULL when nothing is queued
+ ***********************************************************/
+STATIC MEDIA_FRAME *__p2p_media_next_frame(P2P_CTL_T *pCtl, P2P_CMD_E cmd, P2P_FRAME_QUEUE_T **ppQueue)
+{
+    P2P_FRAME_QUEUE_T *video_q = &pCtl->video_q;
+    P2P_FRAME_QUEUE_T *audio_q = &pCtl->audio_q;
+    P2P_FRAME_QUEUE_T *queue = NULL;
+
+    if (!(P2P_VIDEO & cmd)) {
+        __p2p_frame_queue_flush(video_q);
+    }
+    if (!(P2P_AUDIO & cmd)) {
+        __p2p_frame_queue_flush(audio_q);
+    }
+
+    if (video_q->count && audio_q->count) {
+        queue = (audio_q->slot[audio_q->head].frame.pts < video_q->slot[video_q->head].frame.pts) ? audio_q
+                                                                                                     : video_q;
+    } else if (video_q->count) {
+        queue = video_q;
+    } else if (audio_q->count) {
+        queue = audio_q;
+    } else {
+        return NULL;
+    }
+
+    queue->sending = TRUE;
+    *ppQueue = queue;
+    return &queue->slot[queue->head].frame;
+}
+
+STATIC OPERATE_RET __p2p_media_push(P2P_FRAME_QUEUE_T *queue, P2P_CMD_E media, CONST MEDIA_FRAME *pMediaFrame)
+{
+    OPERATE_RET ret = OPRT_OK;
+
+    if (NULL == sg_p2p_ctl || NULL == pMediaFrame || NULL == pMediaFrame->data) {
+        return OPRT_INVALID_PARM;
+    }
+    // Nobody is watching, do not keep stale frames around
+    if (!(media & __p2p_ctl_cmd())) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    tal_mutex_lock(sg_p2p_ctl->qmutex);
+    ret = __p2p_frame_queue_push(queue, pMediaFrame);
+    tal_mutex_unlock(sg_p2p_ctl->qmutex);
+    if (OPRT_OK == ret) {
+        tal_semaphore_post(sg_p2p_ctl->frame_sem);
+    }
+    return ret;
+}
+
+OPERATE_RET tuya_p2p_rtc_push_video_frame(IN CONST MEDIA_FRAME *pMediaFrame)
+{
+    if (NULL == sg_p2p_ctl) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    return __p2p_media_push(&sg_p2p_ctl->video_q, P2P_VIDEO, pMediaFrame);
+}
+
+OPERATE_RET tuya_p2p_rtc_push_audio_frame(IN CONST MEDIA_FRAME *pMediaFrame)
+{
+    if (NULL == sg_p2p_ctl) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    return __p2p_media_push(&sg_p2p_ctl->audio_q, P2P_AUDIO, pMediaFrame);
+}
+
+/***********************************************************
+ *  Function: __p2p_media_send_proc
+ *  Note:Media data transmission thread, sleeps on frame_sem until the encoder pushes
+ *       a frame and sends audio and video in pts order
+ *  Input:
+ *  Output: none
+ *  Return:
+ ***********************************************************/
+STATIC void __p2p_media_send_proc(PVOID_T pArg)
+{
+    P2P_CTL_T *pCtl = sg_p2p_ctl;
+    P2P_FRAME_QUEUE_T *queue = NULL;
+    MEDIA_FRAME *pMediaFrame = NULL;
+    TY_AV_CODEC_ID type;
+
+    PR_DEBUG("into p2p media send");
+
+    while (tal_thread_get_state(pCtl->video_send_proc_thread) == THREAD_STATE_RUNNING) {
+        // One post per queued frame, a wakeup with an empty queue is harmless
+        tal_semaphore_wait(pCtl->frame_sem, P2P_MEDIA_WAIT_MS);
+
+        for (;;) {
+            P2P_CMD_E cmd = __p2p_ctl_cmd();
+
+            tal_mutex_lock(pCtl->qmutex);
+            pMediaFrame = __p2p_media_next_frame(pCtl, cmd, &queue);
+            tal_mutex_unlock(pCtl->qmutex);
+            if (NULL == pMediaFrame) {
+                break;
             }
-            MEDIA_FRAME *pMediaFrame = &sg_p2p_session->media_frame;
-            op_ret = sg_p2p_session->on_get_video_frame_callback(pMediaFrame); // OnGetVideoFrameCallback(pMediaFrame)
-            if (op_ret == OPRT_OK) {
-                pSession->v_pts = (pMediaFrame->pts == 0) ? pMediaFrame->timestamp * 1000 : pMediaFrame->pts;
-                pSession->v_timestamp = pMediaFrame->timestamp;
-                if (eVideoIFrame == pMediaFrame->type) {
-                    pSession->key_frame = TRUE;
-                } else {
-                    pSession->key_frame = FALSE;
-                }
-                if (TY_AV_CODEC_VIDEO_H265 != sg_p2p_session->av_Info.video_codec[0]) {
-                    op_ret = __p2p_pack_h264_rtp_and_send(index, (CHAR_T *)pMediaFrame->data, pMediaFrame->size);
+
+            // The head slot stays untouched by the producer until it is popped below
+            if (queue == &pCtl->video_q) {
+                pCtl->v_pts = pMediaFrame->pts;
+                pCtl->v_timestamp = pMediaFrame->timestamp;
+                pCtl->key_frame = (eVideoIFrame == pMediaFrame->type) ? TRUE : FALSE;
+                if (TY_AV_CODEC_VIDEO_H265 != pCtl->av_Info.video_codec[0]) {
+                    __p2p_pack_h264_rtp_and_send((CHAR_T *)pMediaFrame->data, pMediaFrame->size);
                 } else {
-                    op_ret = __p2p_pack_h265_rtp_and_send(index, (CHAR_T *)pMediaFrame->data, pMediaFrame->size);
+                    __p2p_pack_h265_rtp_and_send((CHAR_T *)pMediaFrame->data, pMediaFrame->size);
                 }
             } else {
-                // Buffer has no data yet
-                tal_system_sleep(10);
-            }
-        }
-        if (P2P_AUDIO & cmd) {
-            if (sg_p2p_session->on_get_audio_frame_callback == NULL) {
-                tal_system_sleep(10);
-                continue;
-            }
-            MEDIA_FRAME *pMediaFrame = &sg_p2p_session->media_audio_frame;
-            op_ret = sg_p2p_session->on_get_audio_frame_callback(pMediaFrame); // OnGetAudioFrameCallback(pMediaFrame)
-            if (op_ret == OPRT_OK) {
-                pSession->a_pts = (pMediaFrame->pts == 0) ? pMediaFrame->timestamp * 1000 : pMediaFrame->pts;
-                pSession->a_timestamp = pMediaFrame->timestamp;
+                pCtl->a_pts = pMediaFrame->pts;
+                pCtl->a_timestamp = pMediaFrame->timestamp;
+                type = pCtl->av_Info.audio_codec;
                 if (TY_AV_CODEC_AUDIO_AAC_ADTS == type) {
                     // op_ret = __p2p_pack_aac_rtp_and_send((CHAR_T *)node_a.data, node_a.size,index);
                 } else if (TY_AV_CODEC_AUDIO_G711A == type || TY_AV_CODEC_AUDIO_G711U == type ||
                            TY_AV_CODEC_AUDIO_PCM == type) {
-                    op_ret = __p2p_pack_g711_rtp_and_send(index, (CHAR_T *)pMediaFrame->data, pMediaFrame->size, type);
+                    __p2p_pack_g711_rtp_and_send((CHAR_T *)pMediaFrame->data, pMediaFrame->size, type);
                 }
-            } else {
-                // Buffer has no data yet
-                tal_system_sleep(10);
             }
+
+            tal_mutex_lock(pCtl->qmutex);
+            queue->head = (queue->head + 1) % queue->depth;
+            queue->count--;
+            queue->sending = FALSE;
+            tal_mutex_unlock(pCtl->qmutex);
         }
     } // while
 
-    PR_ERR("video send task exit");
+    PR_ERR("media send task exit");
     return;
 }
 
+/***********************************************************
+ *  Function: __p2p_media_pull_proc
+ *  Note:Adapter for encoders registered through the get frame callbacks, pulls
+ *       frames while a stream is playing and pushes them to the send queues
+ *  Input:
+ *  Output: none
+ *  Return:
+ ***********************************************************/
+STATIC void __p2p_media_pull_proc(PVOID_T pArg)
+{
+    P2P_CTL_T *pCtl = sg_p2p_ctl;
+    MEDIA_FRAME *pMediaFrame = NULL;
+    BOOL_T pulled = FALSE;
+
+    while (tal_thread_get_state(pCtl->media_pull_proc_thread) == THREAD_STATE_RUNNING) {
+        P2P_CMD_E cmd = __p2p_ctl_cmd();
+
+        if (!(P2P_VIDEO & cmd && pCtl->on_get_video_frame_callback) &&
+            !(P2P_AUDIO & cmd && pCtl->on_get_audio_frame_callback)) {
+            tal_semaphore_wait(pCtl->pull_sem, P2P_MEDIA_WAIT_MS);
+            continue;
+        }
+
+        pulled = FALSE;
+        if ((P2P_VIDEO & cmd) && pCtl->on_get_video_frame_callback) {
+            pMediaFrame = &pCtl->media_frame;
+            pMediaFrame->size = P2P_VIDEO_FRAME_MAX;
+            if (OPRT_OK == pCtl->on_get_video_frame_callback(pMediaFrame)) {
+                tuya_p2p_rtc_push_video_frame(pMediaFrame);
+                pulled = TRUE;
+            }
+        }
+        if ((P2P_AUDIO & cmd) && pCtl->on_get_audio_frame_callback) {
+            pMediaFrame = &pCtl->media_audio_frame;
+            pMediaFrame->size = P2P_AUDIO_FRAME_MAX;
+            if (OPRT_OK == pCtl->on_get_audio_frame_callback(pMediaFrame)) {
+                tuya_p2p_rtc_push_audio_frame(pMediaFrame);
+                pulled = TRUE;
+            }
+        }
+        if (!pulled) {
+            // Buffer has no data yet
+            tal_system_sleep(P2P_PULL_RETRY_MS);
+        }
+    }
+
+    PR_DEBUG("media pull task exit");
+    return;
+}
+
+/***********************************************************
+ *  Function: __p2p_media_pull_start
+ *  Note:Start the pull adapter once a get frame callback is registered
+ *  Input:
+ *  Output: none
+ *  Return:
+ ***********************************************************/
+STATIC OPERATE_RET __p2p_media_pull_start(VOID)
+{
+    OPERATE_RET ret = OPRT_OK;
+
+    if (NULL != sg_p2p_ctl->media_pull_proc_thread) {
+        return OPRT_OK;
+    }
+
+    if (NULL == sg_p2p_ctl->media_frame.data) {
+        sg_p2p_ctl->media_frame.data = (UCHAR_T *)Malloc(P2P_VIDEO_FRAME_MAX);
+    }
+    if (NULL == sg_p2p_ctl->media_audio_frame.data) {
+        sg_p2p_ctl->media_audio_frame.data = (UCHAR_T *)Malloc(P2P_AUDIO_FRAME_MAX);
+    }
+    if (NULL == sg_p2p_ctl->media_frame.data || NULL == sg_p2p_ctl->media_audio_frame.data) {
+        PR_ERR("malloc pull frame buffer failed");
+        return OPRT_MALLOC_FAILED;
+    }
+
+    THREAD_CFG_T thrd_param = {STACK_SIZE_P2P_MEDIA_PULL, THREAD_PRIO_2, (char *)"p2p_media_pull"};
+    ret = tal_thread_create_and_start(&(sg_p2p_ctl->media_pull_proc_thread), NULL, NULL, __p2p_media_pull_proc,
+                                      NULL, &thrd_param);
+    if (ret != OPRT_OK) {
+        PR_ERR("create p2p_media_pull task failed");
+    }
+    return ret;
+}
+
 INT_T __p2p_session_clear(P2P_SESSION_T *pSession)
 {
     __p2p_session_all_stop(pSession);
@@ -1456,12 +1826,11 @@ INT_T __p2p_session_clear(P2P_SESSION_T *pSession)
  ***********************************************************/
 INT_T __p2p_session_all_stop(P2P_SESSION_T *pSession)
 {
-    tal_mutex_lock(pSession->cmutex);
     if (NULL == pSession) {
         PR_ERR("param error");
-        tal_mutex_unlock(pSession->cmutex);
         return OPRT_INVALID_PARM;
     }
+    tal_mutex_lock(sg_p2p_ctl->cmutex);
     if (P2P_VIDEO & pSession->cmd) {
         pSession->cmd &= ~P2P_VIDEO;
     }
@@ -1471,80 +1840,130 @@ INT_T __p2p_session_all_stop(P2P_SESSION_T *pSession)
     if ((P2P_PB_VIDEO & pSession->cmd) || (P2P_PB_PAUSE & pSession->cmd)) {
         pSession->cmd &= ~P2P_PB_VIDEO;
     }
-    tal_mutex_unlock(pSession->cmutex);
+    tal_mutex_unlock(sg_p2p_ctl->cmutex);
     return OPRT_OK;
 }
 
 INT_T __p2p_session_release_va(P2P_SESSION_T *pSession)
 {
+    P2P_CTL_T *pCtl = sg_p2p_ctl;
+    INT_T i;
+    INT_T remain = 0;
+
     // All functions closed
-    PR_DEBUG("release va session[%d]", pSession->session);
-    tal_mutex_lock(pSession->cmutex);
-    if (pSession->p_video_rtp_buff) {
-        Free(pSession->p_video_rtp_buff);
-        pSession->p_video_rtp_buff = NULL;
-    }
-    if (pSession->p_audio_rtp_buff) {
-        Free(pSession->p_audio_rtp_buff);
-        pSession->p_audio_rtp_buff = NULL;
-    }
-    // memset(&pSession->session, 0x00, sizeof(P2P_SESSION_T) - OFFSET(P2P_SESSION_T, session));//Clear variables
-    // outside the lock memset(&pSession->str_P2p_auth, 0, sizeof(pSession->str_P2p_auth));
+    PR_DEBUG("release va session[%d] viewer[%d] video sent[%u] drop[%u] audio sent[%u] drop[%u]", pSession->session,
+             pSession->index, pSession->video_sent, pSession->video_drop, pSession->audio_sent, pSession->audio_drop);
+    tal_mutex_lock(pCtl->cmutex);
     pSession->cur_clarity = TY_VIDEO_CLARITY_INNER_HIGH;
     pSession->status = P2P_SESSION_IDLE;
     pSession->cmd = P2P_IDLE;
     memset(&pSession->pb_resp_head, 0, sizeof(pSession->pb_resp_head));
-    pSession->video_seq_num = 0;
-    pSession->audio_seq_num = 0;
-    pSession->key_frame = false;
-    pSession->v_pts = 0;
-    pSession->v_timestamp = 0;
-    pSession->a_pts = 0;
-    pSession->a_timestamp = 0;
     pSession->video_req_id = 0;
     pSession->audio_req_id = 0;
-    // if (pSession->media_frame.data != NULL) {
-    //     free(pSession->media_frame.data);
-    //     pSession->media_frame.data = NULL;
+    pSession->wait_key = TRUE;
+    memset(&pSession->proto_parse, 0, sizeof(pSession->proto_parse));
+
+    for (i = 0; i < pCtl->max_viewer; i++) {
+        if (P2P_SESSION_IDLE != pCtl->viewer[i].status) {
+            remain++;
+        }
+    }
+    if (remain > 0) {
+        // The stream keeps going for the other viewers
+        tal_mutex_unlock(pCtl->cmutex);
+        return 0;
+    }
+
+    // Last viewer gone, the send buffers are kept for the next one
+    pCtl->video_seq_num = 0;
+    pCtl->audio_seq_num = 0;
+    pCtl->rtp_gen++;
+    pCtl->key_frame = false;
+    pCtl->v_pts = 0;
+    pCtl->v_timestamp = 0;
+    pCtl->a_pts = 0;
+    pCtl->a_timestamp = 0;
+    // if (pCtl->media_frame.data != NULL) {
+    //     free(pCtl->media_frame.data);
+    //     pCtl->media_frame.data = NULL;
     // }
-    // memset(&pSession->media_frame, 0, sizeof(pSession->media_frame));
-    // if (pSession->media_audio_frame.data != NULL) {
-    //     free(pSession->media_audio_frame.data);
-    //     pSession->media_audio_frame.data = NULL;
+    // memset(&pCtl->media_frame, 0, sizeof(pCtl->media_frame));
+    // if (pCtl->media_audio_frame.data != NULL) {
+    //     free(pCtl->media_audio_frame.data);
+    //     pCtl->media_audio_frame.data = NULL;
     // }
-    // memset(&pSession->media_audio_frame, 0, sizeof(pSession->media_audio_frame));
-    memset(&pSession->proto_parse, 0, sizeof(pSession->proto_parse));
-    memset(&pSession->av_Info, 0, sizeof(pSession->av_Info));
-    if (pSession->on_disconnect_callback)
-        pSession->on_disconnect_callback(); // Notify upper layer when receiving disconnect signal from cloud
-    tal_mutex_unlock(pSession->cmutex);
+    // memset(&pCtl->media_audio_frame, 0, sizeof(pCtl->media_audio_frame));
+    tal_mutex_lock(pCtl->qmutex);
+    __p2p_frame_queue_flush(&pCtl->video_q);
+    __p2p_frame_queue_flush(&pCtl->audio_q);
+    pCtl->video_q.wait_key = FALSE;
+    tal_mutex_unlock(pCtl->qmutex);
+    memset(&pCtl->av_Info, 0, sizeof(pCtl->av_Info));
+    if (pCtl->on_disconnect_callback)
+        pCtl->on_disconnect_callback(); // Notify upper layer when receiving disconnect signal from cloud
+    tal_mutex_unlock(pCtl->cmutex);
     return 0;
 }
 
 OPERATE_RET p2p_init(IN CONST TUYA_IPC_P2P_VAR_T *p_var)
 {
     OPERATE_RET ret = OPRT_OK;
+    INT_T i;
 
     // Initialize session information
-    sg_p2p_session = (P2P_SESSION_T *)Malloc(sizeof(P2P_SESSION_T));
-    if (NULL == sg_p2p_session) {
+    sg_p2p_ctl = (P2P_CTL_T *)Malloc(sizeof(P2P_CTL_T));
+    if (NULL == sg_p2p_ctl) {
         PR_ERR("malloc p2p session failed");
         return OPRT_MALLOC_FAILED;
     }
-    memset(sg_p2p_session, 0, sizeof(P2P_SESSION_T));
-    tal_mutex_create_init(sg_p2p_session->cmutex);
+    memset(sg_p2p_ctl, 0, sizeof(P2P_CTL_T));
+    if (OPRT_OK != (ret = tal_mutex_create_init(&sg_p2p_ctl->cmutex))) {
+        PR_ERR("create p2p session mutex failed");
+        goto RET;
+    }
     // Get password and other verification information
-    memset(&(sg_p2p_session->str_P2p_auth), 0x00, sizeof(TUYA_IPC_P2P_AUTH_T));
-    tuya_ipc_get_p2p_auth(&(sg_p2p_session->str_P2p_auth));
+    memset(&(sg_p2p_ctl->str_P2p_auth), 0x00, sizeof(TUYA_IPC_P2P_AUTH_T));
+    tuya_ipc_get_p2p_auth(&(sg_p2p_ctl->str_P2p_auth));
     tuya_ipc_check_p2p_auth_update();
 
-    sg_p2p_session->cur_clarity = TY_VIDEO_CLARITY_INNER_HIGH;
+    // Viewer table, every viewer shares the frame queues and RTP packetizers below
+    sg_p2p_ctl->max_viewer = p_var->max_client_num;
+    if (sg_p2p_ctl->max_viewer < 1) {
+        sg_p2p_ctl->max_viewer = 1;
+    } else if (sg_p2p_ctl->max_viewer > P2P_MAX_VIEWER) {
+        PR_WARN("max client num %d limited to %d", p_var->max_client_num, P2P_MAX_VIEWER);
+        sg_p2p_ctl->max_viewer = P2P_MAX_VIEWER;
+    }
+    for (i = 0; i < P2P_MAX_VIEWER; i++) {
+        sg_p2p_ctl->viewer[i].index = i;
+        sg_p2p_ctl->viewer[i].cur_clarity = TY_VIDEO_CLARITY_INNER_HIGH;
+        sg_p2p_ctl->viewer[i].wait_key = TRUE;
+    }
+    memcpy(&sg_p2p_ctl->av_Info, &p_var->av_info, sizeof(TRANS_IPC_AV_INFO_T));
+    sg_p2p_ctl->on_disconnect_callback = p_var->on_disconnect_callback;
+    sg_p2p_ctl->on_get_video_frame_callback = p_var->on_get_video_frame_callback;
+    sg_p2p_ctl->on_get_audio_frame_callback = p_var->on_get_audio_frame_callback;
+
+    // Frame queues between the encoder and the media send thread
+    if (OPRT_OK != (ret = tal_mutex_create_init(&sg_p2p_ctl->qmutex)) ||
+        OPRT_OK != (ret = tal_semaphore_create_init(&sg_p2p_ctl->frame_sem, 0,
+                                                    P2P_VIDEO_QUEUE_DEPTH + P2P_AUDIO_QUEUE_DEPTH)) ||
+        OPRT_OK != (ret = tal_semaphore_create_init(&sg_p2p_ctl->pull_sem, 0, 1))) {
+        PR_ERR("create p2p media sync failed");
+        goto RET;
+    }
+    if (OPRT_OK != (ret = __p2p_frame_queue_init(&sg_p2p_ctl->video_q, P2P_VIDEO_QUEUE_DEPTH,
+                                                 P2P_VIDEO_FRAME_MAX, TRUE)) ||
+        OPRT_OK != (ret = __p2p_frame_queue_init(&sg_p2p_ctl->audio_q, P2P_AUDIO_QUEUE_DEPTH,
+                                                 P2P_AUDIO_FRAME_MAX, FALSE))) {
+        goto RET;
+    }
 
     // Start media-related threads
     THREAD_CFG_T thrd_param = {STACK_SIZE_P2P_MEDIA_RECV, THREAD_PRIO_2, NULL};
     thrd_param.stackDepth = STACK_SIZE_P2P_CMD_RECV;
     thrd_param.thrdname = (char *)"p2p_cmd_recv";
-    ret = tal_thread_create_and_start(&(sg_p2p_session->cmd_recv_proc_thread), NULL, NULL, __p2p_cmd_recv_proc, NULL,
+    ret = tal_thread_create_and_start(&(sg_p2p_ctl->cmd_recv_proc_thread), NULL, NULL, __p2p_cmd_recv_proc, NULL,
                                       &thrd_param);
     if (ret != OPRT_OK) {
         PR_ERR("create p2p_cmd_recv task failed");
@@ -1552,47 +1971,32 @@ OPERATE_RET p2p_init(IN CONST TUYA_IPC_P2P_VAR_T *p_var)
     }
     thrd_param.stackDepth = STACK_SIZE_P2P_MEDIA_SEND;
     thrd_param.thrdname = (char *)"p2p_media_send";
-    ret = tal_thread_create_and_start(&(sg_p2p_session->video_send_proc_thread), NULL, NULL, __p2p_media_send_proc,
+    ret = tal_thread_create_and_start(&(sg_p2p_ctl->video_send_proc_thread), NULL, NULL, __p2p_media_send_proc,
                                       NULL, &thrd_param);
     if (ret != OPRT_OK) {
         PR_ERR("create p2p_media_send task failed");
         goto RET;
     }
 
-    // Initialize
-    int bufSize = 300 * 1024; // MAX_MEDIA_FRAME_SIZE
-    // memset(&sg_p2p_session->tal_video_frame, 0, sizeof(sg_p2p_session->tal_video_frame));
-    // sg_p2p_session->tal_video_frame.pbuf = (char*)malloc(bufSize);
-    // sg_p2p_session->tal_video_frame.buf_size = bufSize;
-
-    memset(&sg_p2p_session->media_frame, 0, sizeof(sg_p2p_session->media_frame));
-    sg_p2p_session->media_frame.data = (UCHAR_T *)malloc(bufSize);
-    sg_p2p_session->media_frame.size = bufSize;
-
-    bufSize = 1280;
-    // memset(&sg_p2p_session->tal_audio_frame, 0, sizeof(sg_p2p_session->tal_audio_frame));
-    // sg_p2p_session->tal_audio_frame.pbuf = (char*)malloc(bufSize);
-    // sg_p2p_session->tal_audio_frame.buf_size = bufSize;
-
-    memset(&sg_p2p_session->media_audio_frame, 0, sizeof(sg_p2p_session->media_audio_frame));
-    sg_p2p_session->media_audio_frame.data = (UCHAR_T *)malloc(bufSize);
-    sg_p2p_session->media_audio_frame.size = bufSize;
-
-    memcpy(&sg_p2p_session->av_Info, &p_var->av_info, sizeof(TRANS_IPC_AV_INFO_T));
-    sg_p2p_session->on_disconnect_callback = p_var->on_disconnect_callback;
-    sg_p2p_session->on_get_video_frame_callback = p_var->on_get_video_frame_callback;
-    sg_p2p_session->on_get_audio_frame_callback = p_var->on_get_audio_frame_callback;
+    // Encoders that still use the get frame callbacks are fed through the pull adapter
+    if (sg_p2p_ctl->on_get_video_frame_callback || sg_p2p_ctl->on_get_audio_frame_callback) {
+        if (OPRT_OK != (ret = __p2p_media_pull_start())) {
+            goto RET;
+        }
+    }
 
     return OPRT_OK;
 
 RET:
-    if (NULL != sg_p2p_session->p_video_rtp_buff) {
-        p2p_release_video_send_resource(sg_p2p_session);
+    __p2p_frame_queue_deinit(&sg_p2p_ctl->video_q);
+    __p2p_frame_queue_deinit(&sg_p2p_ctl->audio_q);
+    if (NULL != sg_p2p_ctl->p_video_rtp_buff) {
+        p2p_release_video_send_resource(sg_p2p_ctl);
     }
-    if (NULL != sg_p2p_session->p_audio_rtp_buff) {
-        p2p_release_audio_send_resource(sg_p2p_session);
+    if (NULL != sg_p2p_ctl->p_audio_rtp_buff) {
+        p2p_release_audio_send_resource(sg_p2p_ctl);
     }
-    __p2p_thread_exit(sg_p2p_session->cmd_recv_proc_thread);
+    __p2p_thread_exit(sg_p2p_ctl->cmd_recv_proc_thread);
     return ret;
 }
 
@@ -1692,39 +2096,11 @@ OPERATE_RET tuya_imm_p2p_album_play_send_finish(IN CONST CHAR_T *dev_id, IN CONS
     return 0;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void *rtp_alloc(void *param, int bytes)
-{
-    int nBufferSize = bytes;
-    unsigned char *pBuffer = (unsigned char *)malloc(nBufferSize);
-    memset(pBuffer, 0, nBufferSize);
-    return pBuffer;
-}
-
-void rtp_free(void *param, void *packet)
-{
-    free(packet);
-    packet = NULL;
-    return;
-}
-
-int rtp_pack_packet_handler(void *param, const void *packet, int bytes, uint32_t timestamp, int flags)
-{
-    //return 0;
-    CHAR_T *buf = (CHAR_T *)packet;
-    INT_T len = bytes;
-    RTP_PACK_NAL_ARG_T *nal_arg = (RTP_PACK_NAL_ARG_T *)param;
-    memcpy(nal_arg->p_rtp_buff, nal_arg->ext_head_buff, nal_arg->fix_len);
-    *(INT_T *)&nal_arg->p_rtp_buff[nal_arg->fix_len - 4] = len;
-    memcpy(nal_arg->p_rtp_buff + nal_arg->fix_len, buf, len);
-    return p2p_send_rtp_data(nal_arg->client, nal_arg->channel, nal_arg->p_rtp_buff, len + nal_arg->fix_len);
-}
-
 ////////////////////////////////////////////////////////////////////////////////////////////
 
 INT_T OnGetVideoFrameCallback(MEDIA_FRAME *pMediaFrame)
 {
-    // TAL_VENC_FRAME_T *pTalVideoFrame = &sg_p2p_session->tal_video_frame;
+    // TAL_VENC_FRAME_T *pTalVideoFrame = &sg_p2p_ctl->tal_video_frame;
     // if (tal_venc_get_frame(0, 0, pTalVideoFrame) != 0)
     // {
     //     return -1;
@@ -1739,7 +2115,7 @@ INT_T OnGetVideoFrameCallback(MEDIA_FRAME *pMediaFrame)
 
 INT_T OnGetAudioFrameCallback(MEDIA_FRAME *pMediaFrame)
 {
-    // TAL_AUDIO_FRAME_INFO_T *pTalAudioFrame = &sg_p2p_session->tal_audio_frame;
+    // TAL_AUDIO_FRAME_INFO_T *pTalAudioFrame = &sg_p2p_ctl->tal_audio_frame;
     // if (tal_ai_get_frame(0, 0, pTalAudioFrame) != 0)
     // {
     //     return -1;
@@ -0,0 +1,300 @@
+#!/usr/bin/env python3
+"""
+Binary log decoder
+Rebuilds text logs from the binary frames written by tal_log_bin_output_set()
+
+A binary log carries a 32 bit format id instead of the format string. The id
+is FNV-1a of "<file basename>:<format>", so the table is generated from the
+sources that were built:
+
+    python3 tools/log_decoder.py gen -o log_ids.json src apps
+    python3 tools/log_decoder.py decode -t log_ids.json log.bin
+
+Frame layout, all integers are LEB128 varints unless noted:
+    0xA5, payload length, payload
+    payload = flags (bit 0-2 level, bit 3 absolute time), time ms (absolute
+              or delta to the previous frame), u32 id (little endian), line,
+              arguments in format order
+    arguments: '*' width/precision and signed integers zigzag, unsigned
+               integers, chars and pointers plain, doubles 8 bytes little
+               endian, strings length + 1 (0 for NULL) then the bytes
+"""
+
+import os
+import re
+import sys
+import json
+import time
+import struct
+import argparse
+
+LOG_BIN_SYNC = 0xA5
+LOG_BIN_ABS_TIME = 0x08
+LEVEL_STR = ["E", "W", "N", "I", "D", "T"]
+
+# formats logged on behalf of the caller, e.g. tal_log_print_escape()
+GENERIC_FMTS = ["%s", "%s%s"]
+
+LOG_CALL_RE = re.compile(r"\bPR_(?:ERR|WARN|NOTICE|INFO|DEBUG|TRACE)\s*\(")
+PRI_RE = re.compile(r"PRI([diouxX])(8|16|32|64|PTR|MAX)")
+SPEC_RE = re.compile(r"%([-+ #0'I]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?([diouxXcspfFeEgGaAn%])")
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def format_id(file_name, fmt):
+    return fnv1a(file_name.encode() + b":" + fmt.encode("utf-8", "surrogateescape"))
+
+
+def unescape_c(body):
+    """Value of the body of a C string literal"""
+    out = []
+    i = 0
+    simple = {"n": "\n", "t": "\t", "r": "\r", "a": "\a", "b": "\b", "f": "\f", "v": "\v",
+              "\\": "\\", "'": "'", '"': '"', "?": "?"}
+    while i < len(body):
+        c = body[i]
+        if c != "\\":
+            out.append(c)
+            i += 1
+            continue
+        i += 1
+        c = body[i] if i < len(body) else ""
+        if c in simple:
+            out.append(simple[c])
+            i += 1
+        elif c == "x":
+            m = re.match(r"[0-9a-fA-F]+", body[i + 1:])
+            out.append(chr(int(m.group(0), 16) & 0xFF) if m else "x")
+            i += 1 + (len(m.group(0)) if m else 0)
+        elif c.isdigit():
+            m = re.match(r"[0-7]{1,3}", body[i:])
+            out.append(chr(int(m.group(0), 8)))
+            i += len(m.group(0))
+        else:
+            out.append(c)
+            i += 1
+    return "".join(out)
+
+
+def pri_macro(m):
+    conv, width = m.group(1), m.group(2)
+    return ("ll" if width in ("64", "MAX") else "") + conv
+
+
+def parse_format(text, pos):
+    """Format string at pos, adjacent literals and PRIxx macros joined, None when not a plain literal"""
+    parts = []
+    while True:
+        m = re.compile(r'\s*(?:"((?:[^"\\\n]|\\.)*)"|(PRI[diouxX](?:8|16|32|64|PTR|MAX)))').match(text, pos)
+        if not m:
+            break
+        if m.group(2):
+            parts.append(PRI_RE.sub(pri_macro, m.group(2)))
+        else:
+            parts.append(unescape_c(m.group(1)))
+        pos = m.end()
+    if not parts or not re.match(r"\s*[,)]", text[pos:]):
+        return None
+    return "".join(parts)
+
+
+def scan_sources(paths):
+    """{id: [file, line, fmt]} of every PR_xxx call with a literal format"""
+    table = {}
+    files = set()
+    for top in paths:
+        for root, _, names in os.walk(top):
+            for name in names:
+                if not name.endswith((".c", ".h", ".cpp")):
+                    continue
+                path = os.path.join(root, name)
+                files.add(name)
+                try:
+                    with open(path, "r", encoding="utf-8", errors="surrogateescape") as f:
+                        text = f.read()
+                except OSError:
+                    continue
+                for m in LOG_CALL_RE.finditer(text):
+                    fmt = parse_format(text, m.end())
+                    if fmt is None:
+                        continue
+                    line = text.count("\n", 0, m.start()) + 1
+                    table["%08x" % format_id(name, fmt)] = [name, line, fmt]
+    for name in files:
+        for fmt in GENERIC_FMTS:
+            table.setdefault("%08x" % format_id(name, fmt), [name, 0, fmt])
+    return table
+
+
+def read_varint(data, pos):
+    val = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise ValueError("truncated varint")
+        b = data[pos]
+        pos += 1
+        val |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return val, pos
+
+
+def unzigzag(val):
+    return (val >> 1) ^ -(val & 1)
+
+
+def to_signed(val, bits):
+    val &= (1 << bits) - 1
+    return val - (1 << bits) if val >> (bits - 1) else val
+
+
+INT_BITS = {"hh": 8, "h": 16, "": 32, "l": 32, "ll": 64, "j": 64, "z": 32, "t": 32}
+
+
+def render(fmt, args, pos, long_bits):
+    """Text of fmt with the arguments at args[pos:]"""
+    out = []
+    last = 0
+    for m in SPEC_RE.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        flags = flags.replace("'", "").replace("I", "")
+        length = length or ""
+        if width == "*":
+            v, pos = read_varint(args, pos)
+            width = str(unzigzag(v))
+        if prec == "*":
+            v, pos = read_varint(args, pos)
+            prec = str(max(unzigzag(v), 0))
+        spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+        bits = long_bits if length in ("l", "z", "t") else INT_BITS.get(length, 32)
+        if conv in "fFeEgGaA":
+            val = struct.unpack_from("<d", args, pos)[0]
+            pos += 8
+            if conv in "aA":
+                out.append(float.hex(val))
+            else:
+                out.append((spec + conv) % val)
+        elif conv == "s":
+            n, pos = read_varint(args, pos)
+            val = "(null)" if n == 0 else args[pos:pos + n - 1].decode("utf-8", "replace")
+            pos += max(n - 1, 0)
+            out.append((spec + "s") % val)
+        elif conv in "di":
+            v, pos = read_varint(args, pos)
+            out.append((spec + "d") % to_signed(unzigzag(v), bits))
+        elif conv == "c":
+            v, pos = read_varint(args, pos)
+            out.append((spec + "c") % chr(v & 0xFF))
+        elif conv == "p":
+            v, pos = read_varint(args, pos)
+            out.append((spec + "s") % ("0x%x" % v if v else "(nil)"))
+        else:
+            v, pos = read_varint(args, pos)
+            v &= (1 << bits) - 1
+            out.append((spec + ("d" if conv == "u" else conv)) % v)
+    out.append(fmt[last:])
+    return "".join(out)
+
+
+def decode_stream(data, table, long_bits, out):
+    pos = 0
+    now_ms = None
+    frames = 0
+    skipped = 0
+    while pos < len(data):
+        if data[pos] != LOG_BIN_SYNC:
+            pos += 1
+            skipped += 1
+            continue
+        try:
+            length, start = read_varint(data, pos + 1)
+            payload = data[start:start + length]
+            if len(payload) < length:
+                break
+            flags = payload[0]
+            t, p = read_varint(payload, 1)
+            fid = struct.unpack_from("<I", payload, p)[0]
+            line, p = read_varint(payload, p + 4)
+        except (ValueError, struct.error):
+            pos += 1
+            skipped += 1
+            continue
+
+        if flags & LOG_BIN_ABS_TIME:
+            now_ms = t
+        elif now_ms is not None:
+            now_ms += t
+        level = LEVEL_STR[flags & 0x07] if (flags & 0x07) < len(LEVEL_STR) else "?"
+        if now_ms is None:
+            stamp = "--:--:--:---"
+        else:
+            tm = time.localtime(now_ms // 1000)
+            stamp = "%02d-%02d %02d:%02d:%02d:%d" % (tm.tm_mon, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                                                      now_ms % 1000)
+        entry = table.get("%08x" % fid)
+        if entry is None:
+            msg = "<unknown format %08x, %d argument bytes>" % (fid, length - p)
+            name = "?"
+        else:
+            name = entry[0]
+            try:
+                msg = render(entry[2], payload, p, long_bits)
+            except (ValueError, struct.error, TypeError) as e:
+                msg = "<bad arguments for \"%s\": %s>" % (entry[2], e)
+        out.write("[%s ty %s][%s:%d] %s\n" % (stamp, level, name, line, msg))
+        frames += 1
+        pos = start + length
+    return frames, skipped
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode binary tal_log streams")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    gen = sub.add_parser("gen", help="generate the format id table from the sources")
+    gen.add_argument("-o", "--output", required=True, help="id table, json")
+    gen.add_argument("paths", nargs="+", help="source directories")
+
+    dec = sub.add_parser("decode", help="decode a binary log")
+    dec.add_argument("-t", "--table", help="id table from gen")
+    dec.add_argument("-s", "--src", nargs="*", default=[], help="source directories, instead of a table")
+    dec.add_argument("--long-bits", type=int, default=32, choices=(32, 64), help="width of long on the device")
+    dec.add_argument("input", help="binary log file, - for stdin")
+
+    args = parser.parse_args()
+    if args.cmd == "gen":
+        table = scan_sources(args.paths)
+        with open(args.output, "w") as f:
+            json.dump(table, f, indent=0, sort_keys=True)
+        print("%d formats" % len(table))
+        return 0
+
+    if args.table:
+        with open(args.table, "r") as f:
+            table = json.load(f)
+    else:
+        table = scan_sources(args.src or ["."])
+    if args.input == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.input, "rb") as f:
+            data = f.read()
+    frames, skipped = decode_stream(data, table, args.long_bits, sys.stdout)
+    sys.stderr.write("%d frames, %d bytes skipped\n" % (frames, skipped))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""
+OTA HTTP stand-in server
+Serves a firmware image with Range support for http_file_download() throughput
+and resume tests, without the cloud
+
+    python3 tools/ota_http_server.py -f firmware.bin -p 8080
+    python3 tools/ota_http_server.py --size 4M --rate 256K --latency 50 --drop 300K
+
+The device downloads http://<host>:<port>/<any path>. Every connection is kept
+alive and paced on its own, like a CDN limiting each flow, so the gain of
+parallel range connections shows up on a LAN as well. --drop closes a
+connection after that many body bytes, to exercise reconnects and resuming.
+The SHA-256 of the image is printed at start, each request is logged with its
+range and rate.
+"""
+
+import os
+import re
+import sys
+import time
+import hashlib
+import argparse
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+RANGE_RE = re.compile(r"bytes=(\d*)-(\d*)$")
+SEND_BLOCK = 4096
+
+
+def parse_size(text):
+    """Bytes of 123, 64K, 4M"""
+    m = re.match(r"(\d+)([kKmM]?)$", text)
+    if not m:
+        raise argparse.ArgumentTypeError("bad size: %s" % text)
+    return int(m.group(1)) * {"": 1, "k": 1024, "m": 1024 * 1024}[m.group(2).lower()]
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.requests = 0
+        self.connections = 0
+        self.bytes = 0
+
+    def add(self, requests=0, connections=0, nbytes=0):
+        with self.lock:
+            self.requests += requests
+            self.connections += connections
+            self.bytes += nbytes
+
+
+class ImageHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "OtaStandIn/1.0"
+    # headers and body go out in separate writes, Nagle would hold the body
+    # for the delayed ACK of the headers on every request
+    disable_nagle_algorithm = True
+
+    def setup(self):
+        super().setup()
+        self.server.stats.add(connections=1)
+        self.sent = 0
+
+    def log_message(self, fmt, *args):
+        if not self.server.args.quiet:
+            sys.stderr.write("%s %s\n" % (self.address_string(), fmt % args))
+
+    def send_body(self, data):
+        """Paced send, closes the connection at --drop"""
+        args = self.server.args
+        start = time.monotonic()
+        done = 0
+        while done < len(data):
+            block = data[done:done + SEND_BLOCK]
+            if args.drop and self.sent + len(block) > args.drop:
+                block = block[:args.drop - self.sent]
+                self.wfile.write(block)
+                self.close_connection = True
+                self.log_message("dropped after %d bytes", self.sent + len(block))
+                return done + len(block)
+            self.wfile.write(block)
+            done += len(block)
+            self.sent += len(block)
+            if args.rate:
+                ahead = done / args.rate - (time.monotonic() - start)
+                if ahead > 0:
+                    time.sleep(ahead)
+        return done
+
+    def do_HEAD(self):
+        self.handle_get(head=True)
+
+    def do_GET(self):
+        self.handle_get(head=False)
+
+    def handle_get(self, head):
+        image = self.server.image
+        size = len(image)
+        start, end = 0, size - 1
+        status = 200
+
+        if self.server.args.latency:
+            time.sleep(self.server.args.latency / 1000.0)
+        rng = self.headers.get("Range")
+        if rng and not self.server.args.no_range:
+            m = RANGE_RE.match(rng.strip())
+            if not m or (m.group(1) == "" and m.group(2) == ""):
+                self.send_error(400, "bad range")
+                return
+            if m.group(1) == "":
+                start = max(size - int(m.group(2)), 0)
+            else:
+                start = int(m.group(1))
+                if m.group(2) != "":
+                    end = min(int(m.group(2)), size - 1)
+            if start >= size or start > end:
+                self.send_response(416)
+                self.send_header("Content-Range", "bytes */%d" % size)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            status = 206
+
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(end - start + 1))
+        self.send_header("Accept-Ranges", "bytes")
+        if status == 206:
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, end, size))
+        self.end_headers()
+        self.server.stats.add(requests=1)
+        if head:
+            return
+
+        begin = time.monotonic()
+        sent = self.send_body(memoryview(image)[start:end + 1])
+        self.server.stats.add(nbytes=sent)
+        cost = max(time.monotonic() - begin, 1e-6)
+        self.log_message("%d-%d %d bytes %.1f KB/s", start, end, sent, sent / cost / 1024)
+
+
+def report(server, interval):
+    stats = server.stats
+    last = 0
+    while True:
+        time.sleep(interval)
+        with stats.lock:
+            nbytes, requests, connections = stats.bytes, stats.requests, stats.connections
+        if nbytes != last:
+            sys.stderr.write("total %d bytes, %.1f KB/s, %d requests on %d connections\n" %
+                             (nbytes, (nbytes - last) / interval / 1024, requests, connections))
+            last = nbytes
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Serve an OTA image with Range support")
+    parser.add_argument("-f", "--file", help="image to serve, random bytes when omitted")
+    parser.add_argument("--size", type=parse_size, default=parse_size("1M"), help="size of the random image")
+    parser.add_argument("-b", "--bind", default="0.0.0.0", help="address to listen on")
+    parser.add_argument("-p", "--port", type=int, default=8080, help="port to listen on")
+    parser.add_argument("--rate", type=parse_size, default=0, help="bytes per second of each connection")
+    parser.add_argument("--latency", type=int, default=0, help="delay before each response, ms")
+    parser.add_argument("--drop", type=parse_size, default=0, help="close a connection after these body bytes")
+    parser.add_argument("--no-range", action="store_true", help="ignore Range, answer 200 with the whole image")
+    parser.add_argument("-q", "--quiet", action="store_true", help="no per request log")
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            image = f.read()
+    else:
+        image = os.urandom(args.size)
+
+    server = ThreadingHTTPServer((args.bind, args.port), ImageHandler)
+    server.daemon_threads = True
+    server.image = image
+    server.args = args
+    server.stats = Stats()
+    sys.stderr.write("serving %d bytes on %s:%d, sha256 %s\n" %
+                     (len(image), args.bind, server.server_address[1], hashlib.sha256(image).hexdigest()))
+    threading.Thread(target=report, args=(server, 5), daemon=True).start()
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())